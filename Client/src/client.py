@@ -7,11 +7,191 @@ import json
 import threading
 import subprocess
 import requests
+import struct
+import time
+import datetime
+import collections
+
+try:
+    # Slave のデバッグログの書式 (make log-table で Common/Source/LogEvents.h から作る)
+    from logevents import LOG_EVENTS
+except ImportError:
+    LOG_EVENTS = {}
+
+
+# Master のバイナリ出力 (Common/Source/BinFrame.h と同じ形式)
+BINFRAME_TYPE_FELICA = 0x01
+BINFRAME_TYPE_TEXT = 0x02
+BINFRAME_TYPE_LOG = 0x03
+
+
+def crc16(data, crc=0xFFFF):
+    "CRC-16/CCITT-FALSE"
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            raise ValueError("bad COBS block")
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_binframe(data):
+    """区切り (0x00) を除いた 1 フレームを JSON 版と同じ形の dict にする。
+    壊れていれば ValueError"""
+    raw = cobs_decode(data)
+    if len(raw) < 4 or raw[0] + 4 != len(raw):
+        raise ValueError("bad length")
+    if crc16(raw[:-2]) != struct.unpack(">H", raw[-2:])[0]:
+        raise ValueError("bad CRC")
+
+    frame_type, body = raw[1], raw[2:-2]
+    if frame_type == BINFRAME_TYPE_FELICA:
+        src, idm, seq, lqi, tick = struct.unpack(">I8sBBI", body[:18])
+        return {
+            "type": "felica",
+            "macaddress": "{0:08X}".format(src),
+            "idm": idm.hex().upper(),
+            "seq": seq,
+            "lqi": lqi,
+            "tick": tick,
+            "time": tick,
+        }
+    if frame_type == BINFRAME_TYPE_TEXT:
+        return json.loads(body.decode("ascii").strip())
+    if frame_type == BINFRAME_TYPE_LOG:
+        # JSON 版の log 行と同じ形にする
+        return {
+            "type": "log",
+            "macaddress": "{0:08X}".format(struct.unpack(">I", body[:4])[0]),
+            "data": body[4:].hex().upper(),
+        }
+    raise ValueError("unknown frame type {0}".format(frame_type))
+
+
+def decode_log_records(data):
+    """Slave のデバッグログ (Common/Source/LogRecord.h の記録を並べたもの) を
+    (事象番号, 引数のリスト) のリストにする。壊れたところから後ろは捨てる"""
+    records = []
+    i = 0
+    while i + 2 <= len(data):
+        event, argc = data[i], data[i + 1]
+        i += 2
+        args = []
+        for _ in range(argc):
+            value = shift = 0
+            while True:
+                if i >= len(data) or shift > 28:
+                    return records
+                b = data[i]
+                i += 1
+                value |= (b & 0x7F) << shift
+                shift += 7
+                if not b & 0x80:
+                    break
+            args.append(value)
+        records.append((event, args))
+    return records
+
+
+def format_log(event, args):
+    "LogEvents.h の書式で読める形にする (知らない番号なら番号と引数を並べる)"
+    entry = LOG_EVENTS.get(event)
+    if entry:
+        try:
+            return entry[1] % tuple(args)
+        except TypeError:
+            pass
+    return " ".join(["event 0x{0:02X}".format(event)] + [str(a) for a in args])
+
+
+class MasterClock(object):
+    """Master の時刻 (ms) を PC の時刻に直す。
+
+    clock 行を読んだ時刻から行に書かれた時刻を引いた差のうち、直近 WINDOW 個
+    の最小値を使う (UART や受信スレッドで遅れた行ほど差が大きくなる)。
+    時刻が戻ったら Master が再起動したものとして測り直す。最後の clock 行から
+    SPAN ms 以上離れた時刻は (再起動の前後かもしれないので) 直さない"""
+
+    WINDOW = 30
+    SPAN = 600000
+
+    def __init__(self):
+        self.offsets = collections.deque(maxlen=self.WINDOW)
+        self.last_tick = None
+
+    def update(self, tick, now=None):
+        if now is None:
+            now = time.time()
+        if self.last_tick is not None and tick < self.last_tick:
+            self.offsets.clear()
+        self.last_tick = tick
+        self.offsets.append(now - tick / 1000.0)
+
+    def to_datetime(self, tick):
+        "PC の時刻 (datetime.now() と同じ形)。まだ分からなければ None"
+        if not self.offsets or abs(tick - self.last_tick) > self.SPAN:
+            return None
+        return datetime.datetime.fromtimestamp(min(self.offsets) + tick / 1000.0)
+
+
+class BinFrameReader(object):
+    "シリアルから 0x00 区切りのフレームを読む"
+
+    def __init__(self, serial):
+        self.serial = serial
+        self.frames = 0
+        self.bad_frames = 0
+
+    def read(self):
+        data = self.serial.read_until(b"\x00")
+        if not data.endswith(b"\x00"):
+            return None
+        if len(data) > 1:
+            self.frames += 1
+        try:
+            return decode_binframe(data[:-1]) if len(data) > 1 else None
+        except ValueError:
+            self.bad_frames += 1
+            return None
+
 
 class Client(threading.Thread):
+    """Master の出力を読むスレッド。
+
+    起動時に Master へ出力形式 (binary) を伝える。credit を True にすると
+    読んだ分だけ Master にクレジットを返し (Master/Source/HostLink.h)、
+    読むのが追いつかないときは Master が統計などを捨ててタッチを待たせる"""
 
-    def __init__(self, port=None, daemon=True):
+    CREDIT_WINDOW = 64  # 最初に渡すクレジット
+    CREDIT_BATCH = 16   # これだけ読むごとにまとめて返す
+    ALLOW_WINDOW = 2    # 返事を待たずに送る allow の行 (Master の UART 受信キュー 64 バイトに収まる数)
+    ALLOW_TIMEOUT = 2.0 # allow の返事を待つ秒数
+    ALLOW_TRIES = 3     # 一覧を渡し損ねたときに最初からやり直す回数
+
+    def __init__(self, port=None, daemon=True, binary=False, credit=False, baudrate=115200):
         self.serial = None
+        self.binary = binary
+        self.credit = credit
+        self.unreturned = 0
+        self.write_lock = threading.Lock()
+        self.allow_cond = threading.Condition()
+        self.allow_reply = None  # 最後に受けた allow の返事
+        self.clock = MasterClock()
         self.logger = logging.getLogger(__name__).getChild("Client")
 
         if not port:
@@ -23,7 +203,10 @@ class Client(threading.Thread):
                 raise ValueError("Cannot find port")
 
         self.logger.info("Open %s", port)
-        self.serial = serial.Serial(port, 115200)
+        self.serial = serial.Serial(port, baudrate)
+        self.send_command("format binary" if binary else "format json")
+        if credit:
+            self.send_command("credit {0}".format(self.CREDIT_WINDOW))
 
         super().__init__()
         self.daemon = daemon
@@ -36,11 +219,14 @@ class Client(threading.Thread):
 
     def run(self):
         self.logger.info("Start read thread")
+        if self.binary:
+            self._run_binary()
         while True:
-            line = self.serial.readline().strip().decode("ascii")
+            line = self.serial.readline().strip().decode("ascii", "replace")
             if not line:
                 continue
             self.logger.debug("Receive new line '%s'", line)
+            self._received()
 
             if line.startswith("{"):
                 # JSON
@@ -51,6 +237,81 @@ class Client(threading.Thread):
                 else:
                     self._on_message(data)
 
+    def _run_binary(self):
+        "Master を make OUTPUT=BINARY でビルドしたとき"
+        reader = BinFrameReader(self.serial)
+        while True:
+            frames = reader.frames
+            data = reader.read()
+            if reader.frames != frames:
+                self._received()
+            if data:
+                self.logger.debug("Receive new frame %s", data)
+                self._on_message(data)
+
+    def send_command(self, command):
+        "Master へコマンドを 1 行送る (HostLink.h)"
+        with self.write_lock:
+            self.serial.write((command + "\n").encode("ascii"))
+
+    def request_stats(self):
+        "統計をすぐに出させる (uart, host, dedup などの行が届く)"
+        self.send_command("stats")
+
+    def rescan(self):
+        "全チャネルを測り直させる (静かなチャネルがあれば channel_switch が届く)"
+        self.send_command("rescan")
+
+    def send_allowlist(self, idms):
+        """有効な IDm の一覧を Master に渡す (Slave がタッチの場で受け付け・拒否を鳴らし分ける)。
+        idms は 16 桁の 16 進の文字列の並び。None なら一覧を配るのをやめる。
+        Master が返す件数を確かめながら送り、渡せたら True を返す"""
+        if idms is None:
+            self.send_command("allow off")
+            return True
+        idms = list(idms)
+        for idm in idms:
+            if len(idm) != 16 or any(c not in "0123456789abcdefABCDEF" for c in idm):
+                raise ValueError("Invalid IDm {0!r}".format(idm))
+        for _ in range(self.ALLOW_TRIES):
+            if self._send_allowlist(idms):
+                return True
+            self.logger.warning("Allowlist was not fully received by the Master, retrying")
+        self.logger.error("Could not send the allowlist")
+        return False
+
+    def _send_allowlist(self, idms):
+        "一覧を 1 回送る。Master の数えた件数が合えば True"
+        with self.allow_cond:
+            self.allow_reply = None
+        self.send_command("allow clear")
+        if not self._wait_allow(lambda r: r.get("idms") == 0):
+            return False
+        for i, idm in enumerate(idms):
+            # 返事のない行を ALLOW_WINDOW より多くしない (受信キューが溢れると行が失われる)
+            if i >= self.ALLOW_WINDOW and not self._wait_allow(lambda r: r.get("idms", -1) >= i - self.ALLOW_WINDOW + 1):
+                return False
+            self.send_command("allow {0}".format(idm))
+        if not self._wait_allow(lambda r: r.get("idms") == len(idms)):
+            return False
+        self.send_command("allow commit")
+        return self._wait_allow(lambda r: "version" in r and r.get("idms") == len(idms))
+
+    def _wait_allow(self, pred):
+        "allow の返事が pred を満たすまで待つ (ALLOW_TIMEOUT 秒で諦める)"
+        with self.allow_cond:
+            return self.allow_cond.wait_for(
+                lambda: self.allow_reply is not None and pred(self.allow_reply), self.ALLOW_TIMEOUT)
+
+    def _received(self):
+        "1 件読んだ。溜まったらクレジットを返す"
+        if not self.credit:
+            return
+        self.unreturned += 1
+        if self.unreturned >= self.CREDIT_BATCH:
+            self.send_command("credit {0}".format(self.unreturned))
+            self.unreturned = 0
+
     def _on_message(self, data):
 
         message_type = data.get("type")
@@ -59,8 +320,41 @@ class Client(threading.Thread):
 
         if message_type == "debug":
             "debug message"
+        elif message_type == "clock":
+            self.clock.update(data["tick"])
         elif message_type == "felica":
+            # タッチを読んだ時刻 (古い Master なら None)
+            if "time" in data:
+                data["detected"] = self.clock.to_datetime(data["time"])
             self.on_felica(data)
+        elif message_type == "log":
+            # 1 件ずつ読める形にして渡す
+            for event, args in decode_log_records(bytes.fromhex(data.get("data", ""))):
+                self.on_log({
+                    "type": "log",
+                    "macaddress": data.get("macaddress"),
+                    "event": LOG_EVENTS.get(event, ("event 0x{0:02X}".format(event),))[0],
+                    "message": format_log(event, args),
+                })
+        elif message_type == "reader":
+            # リーダごとの受信状況 (Master が 30 秒で一巡するよう出す)
+            self.on_reader(data)
+        elif message_type == "command":
+            if data.get("command") == "allow" and "idms" in data:
+                with self.allow_cond:
+                    self.allow_reply = data
+                    self.allow_cond.notify_all()
+            self.on_command(data)
 
     def on_felica(self, data):
         pass
+
+    def on_reader(self, data):
+        pass
+
+    def on_command(self, data):
+        if data.get("result") != "ok":
+            self.logger.warning("Command %s: %s", data.get("command"), data.get("result"))
+
+    def on_log(self, data):
+        self.logger.info("%s: %s", data["macaddress"], data["message"])
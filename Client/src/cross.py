@@ -12,6 +12,9 @@ from client import Client
 TOUCH_API_URL = os.environ.get("TOUCH_API_URL", "https://ticket.cross-party.com/tracking/internalapi")
 TOUCH_API_KEY = os.environ.get("TOUCH_API_KEY", "CHANGE_ME")
 
+# 有効な IDm の一覧 (1 行に 1 つ)。あればリーダがタッチの場で受け付け・拒否を鳴らし分ける
+ALLOWLIST_FILE = os.environ.get("ALLOWLIST_FILE", None)
+
 CLIENT_ID = os.environ.get("CLIENT_ID", None)
 if CLIENT_ID:
     CLIENT_ID = int(CLIENT_ID)
@@ -22,7 +25,7 @@ class QueuedClient(Client):
         super().__init__(*args, **kwargs)
 
     def on_felica(self, data):
-        data["date"] = datetime.datetime.now()
+        data["date"] = data.get("detected") or datetime.datetime.now()
         self.queue.put(data)
 
 if __name__ == "__main__":
@@ -31,6 +34,9 @@ if __name__ == "__main__":
 
     q = queue.Queue()
     client = QueuedClient(queue=q, daemon=False)
+    if ALLOWLIST_FILE:
+        with open(ALLOWLIST_FILE) as f:
+            client.send_allowlist([line.strip() for line in f if line.strip()])
 
     try:
         while True:
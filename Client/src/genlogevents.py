@@ -0,0 +1,35 @@
+# coding=utf-8
+"""Common/Source/LogEvents.h の一覧から logevents.py (事象番号と書式の表) を作る。
+
+    make log-table
+"""
+
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+HEADER = os.path.join(HERE, "..", "..", "Common", "Source", "LogEvents.h")
+OUTPUT = os.path.join(HERE, "logevents.py")
+
+ENTRY = re.compile(r'X\(\s*(\w+)\s*,\s*(0x[0-9A-Fa-f]+|\d+)\s*,\s*("(?:[^"\\]|\\.)*")\s*\)')
+
+
+def main(header=HEADER, output=OUTPUT):
+    with open(header, encoding="utf-8") as f:
+        entries = ENTRY.findall(f.read())
+    lines = [
+        "# coding=utf-8",
+        "# Common/Source/LogEvents.h から genlogevents.py で作ったもの。直接書き換えないこと",
+        "",
+        "LOG_EVENTS = {",
+    ]
+    for name, num, fmt in entries:
+        lines.append("    {0}: ({1!r}, {2}),".format(int(num, 0), name, fmt))
+    lines.append("}")
+    with open(output, "w", encoding="utf-8") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main(*sys.argv[1:])
@@ -0,0 +1,18 @@
+# coding=utf-8
+# Common/Source/LogEvents.h から genlogevents.py で作ったもの。直接書き換えないこと
+
+LOG_EVENTS = {
+    1: ('LOG_NFC_INIT', "NFC Init"),
+    2: ('LOG_NFC_RESET', "NFC Reset resync=%u sum=%u ovf=%u err=%u"),
+    3: ('LOG_CONNECTED', "Hello! warm=%u/%u full=%u warm_ms=%u full_ms=%u migrate=%u follow=%u"),
+    4: ('LOG_SYNC', "sync n=%u step=%u err_avg=%u err_max=%u"),
+    5: ('LOG_XPORT', "xport frames=%u acked=%u retx=%u rto_retx=%u fast_retx=%u srtt=%u rttvar=%u rto=%u"),
+    6: ('LOG_POLL', "poll %u/s cards=%u lat_avg=%u lat_max=%u"),
+    7: ('LOG_LOG_DROPPED', "log dropped=%u"),
+    8: ('LOG_READY', "ready nfc=%u assoc=%u ready=%u early=%u"),
+    9: ('LOG_NFC_RECOVER', "NFC recovered stage=%u ms=%u"),
+    10: ('LOG_NFC_STAGE', "nfc stage=%u entered=%u ms<50/100/200/500/1000/more=%u/%u/%u/%u/%u/%u"),
+    11: ('LOG_ALLOW', "allowlist ver=%u fetch_ms=%u requests=%u accepted=%u rejected=%u unchecked=%u"),
+    12: ('LOG_PROFILE', "profile key=%X calls=%u min_us=%u avg_us=%u max_us=%u"),
+    13: ('LOG_PROFILE_HIST', "profile key=%X from_bin=%u hist=%u/%u/%u/%u/%u/%u"),
+}
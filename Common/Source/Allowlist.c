@@ -0,0 +1,57 @@
+/*
+ * Allowlist.c
+ *
+ * 有効な IDm の Bloom フィルタ (Allowlist.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "Allowlist.h"
+
+#define ALLOWLIST_BITS (ALLOWLIST_BYTES * 8)
+
+// IDm (8 バイト) の FNV-1a。2 つ目のハッシュは並べ替えて掛け直し、奇数にする
+static uint32 u32Hash(const uint8 *pu8Idm, uint32 *pu32Step)
+{
+	uint32 u32H = 2166136261UL;
+	uint8 i;
+
+	for (i = 0; i < 8; i++) {
+		u32H = (u32H ^ pu8Idm[i]) * 16777619UL;
+	}
+	*pu32Step = (((u32H >> 16) | (u32H << 16)) * 0x9E3779B1UL) | 1;
+	return u32H;
+}
+
+void Allowlist_vClear(uint8 *pu8Bits)
+{
+	memset(pu8Bits, 0, ALLOWLIST_BYTES);
+}
+
+void Allowlist_vAdd(uint8 *pu8Bits, const uint8 *pu8Idm)
+{
+	uint32 u32Step;
+	uint32 u32H = u32Hash(pu8Idm, &u32Step);
+	uint8 i;
+
+	for (i = 0; i < ALLOWLIST_HASHES; i++, u32H += u32Step) {
+		uint16 u16Bit = u32H % ALLOWLIST_BITS;
+		pu8Bits[u16Bit >> 3] |= 1 << (u16Bit & 7);
+	}
+}
+
+bool_t Allowlist_bCheck(const uint8 *pu8Bits, const uint8 *pu8Idm)
+{
+	uint32 u32Step;
+	uint32 u32H = u32Hash(pu8Idm, &u32Step);
+	uint8 i;
+
+	for (i = 0; i < ALLOWLIST_HASHES; i++, u32H += u32Step) {
+		uint16 u16Bit = u32H % ALLOWLIST_BITS;
+		if (!(pu8Bits[u16Bit >> 3] & (1 << (u16Bit & 7)))) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
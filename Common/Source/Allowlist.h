@@ -0,0 +1,26 @@
+/*
+ * Allowlist.h
+ *
+ * 有効な IDm の一覧を表す Bloom フィルタ。Master がホストから受け取った IDm で
+ * 作り、Slave へ配る (packets.h の BULK_OBJ_ALLOWLIST)。Slave は読んだ IDm を
+ * 引いて、Master の返事を待たずに受け付け・拒否の音を鳴らす。
+ *
+ * ALLOWLIST_BYTES * 8 ビットに、IDm ごとに ALLOWLIST_HASHES 個のビットを立てる。
+ * 一覧にある IDm は必ず通り、ない IDm は一覧の件数 n に応じた確率で誤って通る
+ * (n = 300 でおよそ 0.4%、n = 600 で 4%)。最終的な判定はホスト側で行う。
+ *
+ */
+
+#ifndef ALLOWLIST_H_
+#define ALLOWLIST_H_
+
+#include <jendefs.h>
+
+#define ALLOWLIST_BYTES  512 // 4096 ビット
+#define ALLOWLIST_HASHES 4
+
+void Allowlist_vClear(uint8 *pu8Bits);
+void Allowlist_vAdd(uint8 *pu8Bits, const uint8 *pu8Idm);
+bool_t Allowlist_bCheck(const uint8 *pu8Bits, const uint8 *pu8Idm);
+
+#endif /* ALLOWLIST_H_ */
@@ -0,0 +1,129 @@
+/*
+ * BinFrame.c
+ *
+ * バイナリ出力フレームの符号化・復号 (形式は BinFrame.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "BinFrame.h"
+
+uint16 BinFrame_u16Crc16(const uint8 *pu8Data, uint16 u16Len, uint16 u16Crc)
+{
+	uint16 i;
+	uint8 j;
+
+	for (i = 0; i < u16Len; i++) {
+		u16Crc ^= (uint16)pu8Data[i] << 8;
+		for (j = 0; j < 8; j++) {
+			u16Crc = (u16Crc & 0x8000) ? (u16Crc << 1) ^ 0x1021 : (u16Crc << 1);
+		}
+	}
+	return u16Crc;
+}
+
+// COBS: 0x00 を「次の 0x00 までの距離」に置き換える
+static uint16 u16CobsPut(uint8 *pu8Out, uint16 *pu16Code, uint16 u16Pos, uint8 u8Byte)
+{
+	if (u8Byte != 0x00) {
+		pu8Out[u16Pos++] = u8Byte;
+	}
+	if (u8Byte == 0x00 || u16Pos - *pu16Code == 0xFF) {
+		pu8Out[*pu16Code] = (uint8)(u16Pos - *pu16Code);
+		*pu16Code = u16Pos++;
+	}
+	return u16Pos;
+}
+
+uint16 BinFrame_u16Encode(uint8 u8Type, const uint8 *pu8Body, uint8 u8Len, uint8 *pu8Out)
+{
+	uint8 au8Head[2];
+	uint16 u16Crc;
+	uint16 u16Code = 0;
+	uint16 u16Pos = 1;
+	uint16 i;
+
+	au8Head[0] = u8Len;
+	au8Head[1] = u8Type;
+	u16Crc = BinFrame_u16Crc16(au8Head, 2, 0xFFFF);
+	u16Crc = BinFrame_u16Crc16(pu8Body, u8Len, u16Crc);
+
+	u16Pos = u16CobsPut(pu8Out, &u16Code, u16Pos, au8Head[0]);
+	u16Pos = u16CobsPut(pu8Out, &u16Code, u16Pos, au8Head[1]);
+	for (i = 0; i < u8Len; i++) {
+		u16Pos = u16CobsPut(pu8Out, &u16Code, u16Pos, pu8Body[i]);
+	}
+	u16Pos = u16CobsPut(pu8Out, &u16Code, u16Pos, (uint8)(u16Crc >> 8));
+	u16Pos = u16CobsPut(pu8Out, &u16Code, u16Pos, (uint8)u16Crc);
+
+	pu8Out[u16Code] = (uint8)(u16Pos - u16Code);
+	pu8Out[u16Pos++] = BINFRAME_DELIMITER;
+	return u16Pos;
+}
+
+int16 BinFrame_i16Decode(uint8 *pu8Buf, uint16 u16Len, uint8 *pu8Type, uint8 **ppu8Body)
+{
+	uint16 i = 0, o = 0;
+	uint8 u8Code, j;
+	uint16 u16Crc;
+
+	// 復号後は必ず短くなるので、その場で書き戻す
+	while (i < u16Len) {
+		u8Code = pu8Buf[i++];
+		if (u8Code == 0x00) {
+			return -1;
+		}
+		for (j = 1; j < u8Code; j++) {
+			if (i >= u16Len || pu8Buf[i] == 0x00) {
+				return -1;
+			}
+			pu8Buf[o++] = pu8Buf[i++];
+		}
+		if (u8Code != 0xFF && i < u16Len) {
+			pu8Buf[o++] = 0x00;
+		}
+	}
+
+	if (o < 4 || pu8Buf[0] + 4 != o) {
+		return -1;
+	}
+	u16Crc = BinFrame_u16Crc16(pu8Buf, o - 2, 0xFFFF);
+	if (pu8Buf[o - 2] != (uint8)(u16Crc >> 8) || pu8Buf[o - 1] != (uint8)u16Crc) {
+		return -1;
+	}
+
+	*pu8Type = pu8Buf[1];
+	*ppu8Body = pu8Buf + 2;
+	return pu8Buf[0];
+}
+
+void BinFrame_vPackFelica(const tsBinFrameFelica *psF, uint8 *pu8Body)
+{
+	pu8Body[0] = (uint8)(psF->u32SrcAddr >> 24);
+	pu8Body[1] = (uint8)(psF->u32SrcAddr >> 16);
+	pu8Body[2] = (uint8)(psF->u32SrcAddr >> 8);
+	pu8Body[3] = (uint8)psF->u32SrcAddr;
+	memcpy(pu8Body + 4, psF->au8Idm, 8);
+	pu8Body[12] = psF->u8Seq;
+	pu8Body[13] = psF->u8Lqi;
+	pu8Body[14] = (uint8)(psF->u32Tick >> 24);
+	pu8Body[15] = (uint8)(psF->u32Tick >> 16);
+	pu8Body[16] = (uint8)(psF->u32Tick >> 8);
+	pu8Body[17] = (uint8)psF->u32Tick;
+}
+
+bool_t BinFrame_bUnpackFelica(const uint8 *pu8Body, uint8 u8Len, tsBinFrameFelica *psF)
+{
+	if (u8Len < BINFRAME_FELICA_LEN) {
+		return FALSE;
+	}
+	psF->u32SrcAddr = ((uint32)pu8Body[0] << 24) | ((uint32)pu8Body[1] << 16)
+			| ((uint32)pu8Body[2] << 8) | pu8Body[3];
+	memcpy(psF->au8Idm, pu8Body + 4, 8);
+	psF->u8Seq = pu8Body[12];
+	psF->u8Lqi = pu8Body[13];
+	psF->u32Tick = ((uint32)pu8Body[14] << 24) | ((uint32)pu8Body[15] << 16)
+			| ((uint32)pu8Body[16] << 8) | pu8Body[17];
+	return TRUE;
+}
@@ -0,0 +1,54 @@
+/*
+ * BinFrame.h
+ *
+ * Master からホストへのバイナリ出力フレーム。
+ *
+ *   [LEN][TYPE][BODY (LEN バイト)][CRC16 上位][CRC16 下位]
+ *
+ * を COBS で 0x00 を含まない列に変換し、区切りとして 0x00 を付けて送る。
+ * CRC は CRC-16/CCITT-FALSE (多項式 0x1021, 初期値 0xFFFF) で、LEN から
+ * BODY の末尾までを対象とする。数値はすべてビッグエンディアン。
+ *
+ * ファームウェアとホスト側のデコーダ (Host/Source/BinDump.c) で共用する。
+ * Client/src/client.py の BinFrameReader は同じ形式の Python 実装。
+ *
+ */
+
+#ifndef BINFRAME_H_
+#define BINFRAME_H_
+
+#include <jendefs.h>
+
+#define BINFRAME_TYPE_FELICA 0x01 // タッチ (tsBinFrameFelica)
+#define BINFRAME_TYPE_TEXT   0x02 // JSON 行などのテキスト
+#define BINFRAME_TYPE_LOG    0x03 // Slave のデバッグログ: アドレス (4 バイト) + LogRecord.h の記録
+
+#define BINFRAME_BODY_MAX    250
+#define BINFRAME_DELIMITER   0x00
+
+// BODY が u8Len バイトのとき、区切りを含めた符号化後の最大長
+#define BINFRAME_ENCODED_MAX(u8Len) ((u8Len) + 4 + ((u8Len) + 4) / 254 + 2)
+
+#define BINFRAME_FELICA_LEN  18
+
+typedef struct {
+	uint32 u32SrcAddr;
+	uint8 au8Idm[8];
+	uint8 u8Seq;
+	uint8 u8Lqi;
+	uint32 u32Tick;
+} tsBinFrameFelica;
+
+uint16 BinFrame_u16Crc16(const uint8 *pu8Data, uint16 u16Len, uint16 u16Crc);
+
+// 符号化して pu8Out に書く。戻り値は区切りを含めた長さ。
+uint16 BinFrame_u16Encode(uint8 u8Type, const uint8 *pu8Body, uint8 u8Len, uint8 *pu8Out);
+
+// 区切りを除いた 1 フレームをその場で復号する。
+// 戻り値は BODY の長さ、壊れていれば -1。
+int16 BinFrame_i16Decode(uint8 *pu8Buf, uint16 u16Len, uint8 *pu8Type, uint8 **ppu8Body);
+
+void BinFrame_vPackFelica(const tsBinFrameFelica *psF, uint8 *pu8Body);
+bool_t BinFrame_bUnpackFelica(const uint8 *pu8Body, uint8 u8Len, tsBinFrameFelica *psF);
+
+#endif /* BINFRAME_H_ */
@@ -0,0 +1,38 @@
+/*
+ * LogEvents.h
+ *
+ * Slave のログの事象番号と、それを読める形に戻す書式の一覧。
+ *
+ * Slave は事象番号と整数の引数だけを送り (LogRecord.h)、書式の文字列は
+ * ファームウェアに入らない。書式はホスト側のデコーダが使う。
+ *   Host/Source/BinDump.c     この一覧をそのまま取り込む
+ *   Client/src/logevents.py   make log-table でこの一覧から作る
+ * 書式の変換は %u %d %x %X (幅の指定可) だけで、引数と同じ数にする。
+ * 番号は足すだけにし、使っている番号の意味を変えないこと。
+ *
+ */
+
+#ifndef LOGEVENTS_H_
+#define LOGEVENTS_H_
+
+#define LOG_EVENT_TABLE(X) \
+	X(LOG_NFC_INIT,    0x01, "NFC Init") \
+	X(LOG_NFC_RESET,   0x02, "NFC Reset resync=%u sum=%u ovf=%u err=%u") \
+	X(LOG_CONNECTED,   0x03, "Hello! warm=%u/%u full=%u warm_ms=%u full_ms=%u migrate=%u follow=%u") \
+	X(LOG_SYNC,        0x04, "sync n=%u step=%u err_avg=%u err_max=%u") \
+	X(LOG_XPORT,       0x05, "xport frames=%u acked=%u retx=%u rto_retx=%u fast_retx=%u srtt=%u rttvar=%u rto=%u") \
+	X(LOG_POLL,        0x06, "poll %u/s cards=%u lat_avg=%u lat_max=%u") \
+	X(LOG_LOG_DROPPED, 0x07, "log dropped=%u") \
+	X(LOG_READY,       0x08, "ready nfc=%u assoc=%u ready=%u early=%u") \
+	X(LOG_NFC_RECOVER, 0x09, "NFC recovered stage=%u ms=%u") \
+	X(LOG_NFC_STAGE,   0x0A, "nfc stage=%u entered=%u ms<50/100/200/500/1000/more=%u/%u/%u/%u/%u/%u") \
+	X(LOG_ALLOW,       0x0B, "allowlist ver=%u fetch_ms=%u requests=%u accepted=%u rejected=%u unchecked=%u") \
+	X(LOG_PROFILE,     0x0C, "profile key=%X calls=%u min_us=%u avg_us=%u max_us=%u") \
+	X(LOG_PROFILE_HIST, 0x0D, "profile key=%X from_bin=%u hist=%u/%u/%u/%u/%u/%u")
+
+#define LOG_EVENT_ENUM(eName, u8Id, pcFormat) eName = u8Id,
+typedef enum {
+	LOG_EVENT_TABLE(LOG_EVENT_ENUM)
+} teLogEvent;
+
+#endif /* LOGEVENTS_H_ */
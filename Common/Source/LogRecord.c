@@ -0,0 +1,54 @@
+/*
+ * LogRecord.c
+ *
+ * 書式の文字列を送らないログの 1 件 (LogRecord.h を参照)
+ *
+ */
+
+#include "LogRecord.h"
+
+uint8 LogRecord_u8Encode(uint8 u8Event, const uint32 *pu32Args, uint8 u8Argc, uint8 *pu8Out)
+{
+	uint8 *p = pu8Out;
+	uint8 i;
+
+	if (u8Argc > LOGRECORD_ARGS_MAX) {
+		u8Argc = LOGRECORD_ARGS_MAX;
+	}
+	*p++ = u8Event;
+	*p++ = u8Argc;
+	for (i = 0; i < u8Argc; i++) {
+		uint32 u32 = pu32Args[i];
+		while (u32 >= 0x80) {
+			*p++ = (uint8)u32 | 0x80;
+			u32 >>= 7;
+		}
+		*p++ = (uint8)u32;
+	}
+	return p - pu8Out;
+}
+
+int16 LogRecord_i16Decode(const uint8 *pu8Data, uint8 u8Len, uint8 *pu8Event, uint32 *pu32Args, uint8 *pu8Argc)
+{
+	uint8 u8Pos = 2;
+	uint8 i;
+
+	if (u8Len < 2 || pu8Data[1] > LOGRECORD_ARGS_MAX) {
+		return -1;
+	}
+	*pu8Event = pu8Data[0];
+	*pu8Argc = pu8Data[1];
+	for (i = 0; i < *pu8Argc; i++) {
+		uint32 u32 = 0;
+		uint8 u8Shift = 0;
+		do {
+			if (u8Pos >= u8Len || u8Shift > 28) {
+				return -1;
+			}
+			u32 |= (uint32)(pu8Data[u8Pos] & 0x7F) << u8Shift;
+			u8Shift += 7;
+		} while (pu8Data[u8Pos++] & 0x80);
+		pu32Args[i] = u32;
+	}
+	return u8Pos;
+}
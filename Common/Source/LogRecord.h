@@ -0,0 +1,28 @@
+/*
+ * LogRecord.h
+ *
+ * 書式の文字列を送らないログの 1 件 (Slave から Master へ PACKET_CMD_LOG で送る)。
+ *
+ *   [事象番号 (1 バイト)][引数の数 (1 バイト)][引数 × 数]
+ *
+ * 引数は 32 ビットの符号なし整数を 7 ビットずつ下位から並べた可変長
+ * (上位ビットが 1 なら続きがある) で、小さな値ほど短い。
+ * 事象番号と書式は LogEvents.h。Slave (書く側) とホスト側のデコーダで共用する。
+ *
+ */
+
+#ifndef LOGRECORD_H_
+#define LOGRECORD_H_
+
+#include <jendefs.h>
+
+#define LOGRECORD_ARGS_MAX 8
+#define LOGRECORD_LEN_MAX  (2 + LOGRECORD_ARGS_MAX * 5)
+
+// pu8Out に書き、長さを返す (u8Argc は LOGRECORD_ARGS_MAX まで)
+uint8 LogRecord_u8Encode(uint8 u8Event, const uint32 *pu32Args, uint8 u8Argc, uint8 *pu8Out);
+
+// pu8Data の先頭の 1 件を読み、その長さを返す (壊れていれば -1)
+int16 LogRecord_i16Decode(const uint8 *pu8Data, uint8 u8Len, uint8 *pu8Event, uint32 *pu32Args, uint8 *pu8Argc);
+
+#endif /* LOGRECORD_H_ */
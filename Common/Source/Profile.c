@@ -0,0 +1,119 @@
+/*
+ * Profile.c
+ *
+ * イベントハンドラの処理時間の計測 (Profile.h を参照)
+ *
+ */
+
+#include <string.h>
+#include <AppHardwareApi.h>
+#include "ToCoNet.h"
+
+#include "Profile.h"
+
+#define COUNTS_PER_MS (PROFILE_COUNTS_PER_US * 1000)
+
+static tsProfileEntry asEntry[PROFILE_ENTRIES];
+static uint8 u8Cursor;      // 次に報告する表の位置
+static uint32 u32Overflows;
+
+// u32TickCount_ms と、tick の中の位置 (ティックタイマー) から作る時刻
+static uint32 u32Now()
+{
+	uint32 u32Ms, u32Count;
+
+	do {
+		u32Ms = u32TickCount_ms;
+		u32Count = u32AHI_TickTimerRead();
+	} while (u32Ms != u32TickCount_ms);
+	return u32Ms * COUNTS_PER_MS + u32Count;
+}
+
+static tsProfileEntry *psFind(uint8 u8Site, uint16 u16State, uint16 u16Event)
+{
+	uint8 i = (u8Site * 31 + u16State * 7 + u16Event) & (PROFILE_ENTRIES - 1);
+	uint8 n;
+
+	for (n = 0; n < PROFILE_ENTRIES; n++, i = (i + 1) & (PROFILE_ENTRIES - 1)) {
+		tsProfileEntry *psE = &asEntry[i];
+		if (psE->u8Site == 0) {
+			psE->u8Site = u8Site;
+			psE->u16State = u16State;
+			psE->u16Event = u16Event;
+			psE->u32Min = 0xFFFFFFFF;
+			return psE;
+		}
+		if (psE->u8Site == u8Site && psE->u16State == u16State && psE->u16Event == u16Event) {
+			return psE;
+		}
+	}
+	return NULL;
+}
+
+void Profile_vInit()
+{
+	memset(asEntry, 0, sizeof(asEntry));
+	u8Cursor = 0;
+	u32Overflows = 0;
+}
+
+void Profile_vBegin(tsProfileMark *psMark, uint8 u8Site, uint16 u16State, uint16 u16Event)
+{
+	psMark->u8Site = u8Site;
+	psMark->u16State = u16State;
+	psMark->u16Event = u16Event;
+	psMark->u32At = u32Now();
+}
+
+void Profile_vEnd(tsProfileMark *psMark)
+{
+	uint32 u32Counts = u32Now() - psMark->u32At;
+	uint32 u32Us = u32Counts / PROFILE_COUNTS_PER_US;
+	tsProfileEntry *psE = psFind(psMark->u8Site, psMark->u16State, psMark->u16Event);
+	uint8 u8Bin = 0;
+
+	if (psE == NULL) {
+		u32Overflows++;
+		return;
+	}
+	psE->u32Calls++;
+	psE->u32Sum += u32Counts;
+	if (u32Counts < psE->u32Min) psE->u32Min = u32Counts;
+	if (u32Counts > psE->u32Max) psE->u32Max = u32Counts;
+	while (u32Us >= 2 && u8Bin < PROFILE_HIST_BINS - 1) {
+		u32Us >>= 1;
+		u8Bin++;
+	}
+	if (psE->au16Hist[u8Bin] < 0xFFFF) psE->au16Hist[u8Bin]++;
+}
+
+bool_t Profile_bReport(tsProfileEntry *psOut)
+{
+	uint8 n;
+
+	for (n = 0; n < PROFILE_ENTRIES; n++) {
+		tsProfileEntry *psE = &asEntry[u8Cursor];
+		u8Cursor = (u8Cursor + 1) & (PROFILE_ENTRIES - 1);
+		if (psE->u8Site != 0 && psE->u32Calls != 0) {
+			*psOut = *psE;
+			// キーは残して数え直す (引き直しで表の位置が変わらないように)
+			psE->u32Calls = 0;
+			psE->u32Min = 0xFFFFFFFF;
+			psE->u32Max = 0;
+			psE->u32Sum = 0;
+			memset(psE->au16Hist, 0, sizeof(psE->au16Hist));
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+uint32 Profile_u32Key(const tsProfileEntry *psE)
+{
+	return ((uint32)psE->u8Site << 24) | ((uint32)(psE->u16State & 0xFFF) << 12) | (psE->u16Event & 0xFFF);
+}
+
+uint32 Profile_u32Overflows()
+{
+	return u32Overflows;
+}
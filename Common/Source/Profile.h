@@ -0,0 +1,76 @@
+/*
+ * Profile.h
+ *
+ * イベントハンドラとコールバックの処理時間の計測 (make PROFILE=1 のときのみ)。
+ *
+ * ハンドラの入口と出口で、ToCoNet が tick ごとに数え直させるティックタイマー
+ * (16MHz) と u32TickCount_ms から時刻を取り、差を (場所, 状態, 事象) ごとの
+ * 表に数える。表には回数、最小・平均・最大と、時間 (us) の log2 の
+ * ヒストグラムを持つ。時間は中で呼んだハンドラ (ToCoNet_Event_Process) や
+ * UART・EEPROM の待ちを含む。tick の割り込みと重なると 1 tick (4ms) ずれる
+ * ことがある。
+ * 表は報告した項目から数え直す (Slave は PACKET_CMD_LOG、Master は UART)。
+ * USE_PROFILE を定義しなければ PROFILE_BEGIN/PROFILE_END は何も生成しない。
+ *
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <jendefs.h>
+
+#define PROFILE_ENTRIES   32 // 表の大きさ (2 のべき乗)
+#define PROFILE_HIST_BINS 12 // <2us, <4us, ... <2048us, それ以上
+#define PROFILE_COUNTS_PER_US 16
+
+// 計測する場所
+#define PROFILE_CORE   1 // vProcessEvCore (状態, 事象)
+#define PROFILE_NFC    2 // vProcessEvNfc (状態, 事象)
+#define PROFILE_SERIAL 3 // UART の受信処理 (Slave は vHandleSerialInput、Master は vHostInput)
+#define PROFILE_RX     4 // cbToCoNet_vRxEvent (事象はパケットの種類)
+#define PROFILE_TX     5 // cbToCoNet_vTxEvent
+#define PROFILE_NWK    6 // cbToCoNet_vNwkEvent (事象)
+#define PROFILE_MAIN   7 // cbToCoNet_vMain (中で呼ぶ UART の受信処理などを含む)
+
+typedef struct {
+	uint8 u8Site;       // 0 なら空き
+	uint16 u16State;
+	uint16 u16Event;
+	uint32 u32Calls;
+	uint32 u32Min;      // ティックタイマーのカウント (1/16us)
+	uint32 u32Max;
+	uint32 u32Sum;
+	uint16 au16Hist[PROFILE_HIST_BINS];
+} tsProfileEntry;
+
+typedef struct {
+	uint8 u8Site;
+	uint16 u16State;
+	uint16 u16Event;
+	uint32 u32At;
+} tsProfileMark;
+
+#ifdef USE_PROFILE
+#define PROFILE_BEGIN(u8Site, u16State, u16Event) \
+		tsProfileMark sProfileMark; Profile_vBegin(&sProfileMark, u8Site, u16State, u16Event)
+#define PROFILE_END() Profile_vEnd(&sProfileMark)
+#else
+#define PROFILE_BEGIN(u8Site, u16State, u16Event)
+#define PROFILE_END()
+#endif
+
+void Profile_vInit();
+
+// 入口 (時刻は最後に取る) と出口 (時刻は最初に取る)
+void Profile_vBegin(tsProfileMark *psMark, uint8 u8Site, uint16 u16State, uint16 u16Event);
+void Profile_vEnd(tsProfileMark *psMark);
+
+// 次に報告する項目を psOut へ写し、表の方は数え直す (なければ FALSE)
+bool_t Profile_bReport(tsProfileEntry *psOut);
+// 報告に使うキー: 場所 << 24 | 状態 (12 ビット) << 12 | 事象 (12 ビット)
+uint32 Profile_u32Key(const tsProfileEntry *psE);
+
+// 表が一杯で数えられなかった回数
+uint32 Profile_u32Overflows();
+
+#endif /* PROFILE_H_ */
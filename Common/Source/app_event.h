@@ -27,7 +27,8 @@ typedef enum {
 	E_STATE_TRANSMITTING,
 	E_STATE_NFC_INIT,
 	E_STATE_NFC_RESET,
-	E_STATE_POLLING
+	E_STATE_POLLING,
+	E_STATE_CONNECTED
 } teStateApp;
 
 #endif
@@ -7,7 +7,96 @@ typedef enum
 {
 	PACKET_CMD_DEBUG = TOCONET_PACKET_CMD_APP_USER,
 	PACKET_CMD_KEEP_ALIVE,
-	PACKET_CMD_FELICA
+	PACKET_CMD_FELICA,
+	PACKET_CMD_JOIN,
+	PACKET_CMD_ACK,
+	PACKET_CMD_HEALTH,
+	PACKET_CMD_LOG,
+	PACKET_CMD_BULK      // 7 (TOCONET_PACKET_CMD_APP_USER_MAX) まで
 } tePacketCmdApp;
 
+// PACKET_CMD_FELICA のペイロード: 送信番号 (2 バイト, BE) と、送信窓の先頭 (ACK を
+// 受けていない最も古い番号) がそれより幾つ前か (1 バイト) に続けて次のどれか
+//   1 件: IDm (8 バイト)
+//   まとめ送り: 件数 (1 バイト) + 件数 × [IDm (8 バイト) + 経過時間 ms (2 バイト, BE)]
+//   経過時間はタッチから送信要求までの時間。長さが 8 なら 1 件の形式。
+//   時刻付き: (件数 | FELICA_TIMED) (1 バイト) + 件数 × [IDm (8 バイト) + 時刻 (4 バイト, BE)]
+//   時刻は Master の時計 (Keep-Alive の [4..7]) に合わせた、タッチを読んだ時刻 (ms)。
+//   Slave は Master の時刻をまだ知らなければ時刻なしの形式で送る。
+// 送信番号は Slave がパケットごとに 1 ずつ進め、再送では同じ番号を使う。
+// Master は UART へ出した番号を XPORT_ACK のブロックで知らせる。
+// 窓の先頭より前は ACK を受けている。初めての送信元や作り直した窓は先頭から待つ。
+#define FELICA_SEQ_LEN         3
+#define FELICA_IDM_LEN         8
+#define FELICA_BATCH_ENTRY_LEN (FELICA_IDM_LEN + 2)
+#define FELICA_BATCH_MAX       9 // (98 - 3 - 1) / 10
+#define FELICA_BATCH_LEN(n)    (1 + (n) * FELICA_BATCH_ENTRY_LEN)
+#define FELICA_TIMED           0x80
+#define FELICA_TIMED_ENTRY_LEN (FELICA_IDM_LEN + 4)
+#define FELICA_TIMED_MAX       7 // (98 - 3 - 1) / 12
+#define FELICA_TIMED_LEN(n)    (1 + (n) * FELICA_TIMED_ENTRY_LEN)
+
+// Master から Slave への ACK のブロック
+//   件数 n (1 バイト) + n × [アドレス (4 バイト, BE) + 次に待つ番号 (2 バイト, BE) + 先の受信 (1 バイト)]
+//   次に待つ番号より前はすべて受け取った。先の受信の bit i は (次に待つ番号 + 1 + i) を受け取った。
+//   PACKET_CMD_ACK (ブロードキャスト) のペイロードはこのブロックだけ。
+//   Keep-Alive (TDMA ではビーコンの割り当ての後) にも付くことがある。
+#define XPORT_ACK_ENTRY_LEN 7
+#define XPORT_ACK_MAX       13 // (98 - 1) / 7
+#define XPORT_ACK_SACK_BITS 8
+
+// PACKET_CMD_HEALTH のペイロード (Slave の健全性。起動から数え、16 ビットで一周する。すべて BE)
+//   [0..1] 送信の完了 [2..3] そのうち失敗 [4..5] NFC のリセット [6..7] Master を見つけられなかったスキャン
+#define HEALTH_LEN 8
+
+// PACKET_CMD_LOG のペイロード: LogRecord.h の記録を並べたもの (LOG_FRAME_MAX バイトまで)
+// Master は中身を読まずにホストへ渡す
+#define LOG_FRAME_MAX 64
+
+// PACKET_CMD_KEEP_ALIVE のペイロード (Master の負荷と時刻、チャネルの切り替え)
+//   [0] 負荷 (0..100 %) [1] タッチを送ってくるリーダ数 [2..3] 直近のタッチ数 (毎分, BE)
+//   [4..7] 送信要求時の Master の時刻 (u32TickCount_ms, BE)
+//   [8] 移る先のチャネル (0 なら移らない) [9] 移るまでの時間 (KEEPALIVE_SWITCH_UNIT_MS 単位)
+//   [10] 配っている有効な IDm の一覧の版 (0 なら一覧なし。BULK_OBJ_ALLOWLIST)
+//   長さが KEEPALIVE_LEN に満たなければ負荷と時刻は不明とする。
+#define KEEPALIVE_LEN       11
+#define KEEPALIVE_LOAD_FULL 100
+#define KEEPALIVE_SWITCH_UNIT_MS 10
+
+// 版のついたオブジェクトの一斉配信 (Master の BulkTx、Slave の BulkRx)
+// PACKET_CMD_BULK (Master → ブロードキャスト): 区切り 1 つ
+//   [0] オブジェクト番号 [1] 版 [2] 区切りの番号 [3] 区切りの数 [4..] BULK_CHUNK バイト (最後は短くてよい)
+// PACKET_CMD_BULK (Slave → 接続先へユニキャスト): NACK。足りない区切り
+//   [0] オブジェクト番号 [1] 版 [2..] 足りない区切りのビット表 (区切り i は [2 + i / 8] の bit i % 8)
+// Master は版を出すと全区切りを一通り送り、その後は NACK で頼まれた区切りの和を送り直す。
+// Slave は区切りか Keep-Alive で新しい版を知り、しばらく区切りが届かなければ NACK を送る。
+// Master は版が今のものと違う NACK には答えず、ブロードキャストされた区切りは無視する。
+#define BULK_HDR_LEN       4
+#define BULK_NACK_HDR_LEN  2
+#define BULK_CHUNK         64
+#define BULK_CHUNKS_MAX    64 // オブジェクトは BULK_CHUNK * BULK_CHUNKS_MAX バイトまで
+#define BULK_OBJ_ALLOWLIST 1  // 有効な IDm の一覧 (Allowlist.h)
+#define BULK_OBJECTS       1
+
+// TDMA (make TDMA=1)。Master の Keep-Alive を TDMA_SUPERFRAME_MS ごとのビーコンにする。
+// スーパーフレーム: ビーコン 1 スロット + データ TDMA_SLOTS スロット + 競合 TDMA_CONTENTION スロット
+// ビーコンのペイロード: Keep-Alive の KEEPALIVE_LEN バイトに続けて
+//   [0] スーパーフレーム番号 [1] 周期 c [2] 割り当ての数 n
+//   n × [アドレス (4 バイト, BE) + スロット番号 s (1 バイト)]
+// スロット番号 s の Slave は、番号 % c == s / TDMA_SLOTS のスーパーフレームの
+// (s % TDMA_SLOTS) 番目のデータスロットで送る。スロットのない Slave は競合スロットで送る。
+#define TDMA_SLOT_MS       12 // tick (4ms) の揺らぎ + 送信 + ACK が収まる長さ
+#define TDMA_SLOTS         16
+#define TDMA_CONTENTION    4
+#define TDMA_SUPERFRAME_MS ((1 + TDMA_SLOTS + TDMA_CONTENTION) * TDMA_SLOT_MS)
+#define TDMA_MAX_SLOTS     64 // 周期は最大 4
+#define TDMA_GRANTS_MAX    8
+#define TDMA_BEACON_HDR    (KEEPALIVE_LEN + 3)
+#define TDMA_GRANT_LEN     5
+
+// PACKET_CMD_JOIN のペイロード: [0] TDMA_JOIN_REQUEST (競合スロットで) か
+// TDMA_JOIN_HEARTBEAT (自分のスロットで、しばらく何も送っていないとき)
+#define TDMA_JOIN_REQUEST   0
+#define TDMA_JOIN_HEARTBEAT 1
+
 #endif /* PACKETS_H_ */
@@ -0,0 +1,57 @@
+##########################################################################
+# ホスト (Linux) 向けビルド定義
+#
+# Master/Build, Slave/Build の Makefile から TWE_CHIP_MODEL=HOST のときに
+# 読み込まれ、ToCoNet SDK の代わりに Host/ のランタイムを使って次の二つを
+# 作ります。
+#
+#   $(TARGET_DIR)_HOST     1 ノードを動かす実行ファイル (HostMain.c)
+#   $(TARGET_DIR)_HOST.so  シミュレータ (Host/Build/Sim) が読み込む
+#                          ファームウェア本体
+#
+#   make TWE_CHIP_MODEL=HOST
+##########################################################################
+
+HOST_DIR := $(patsubst %/Build/,%,$(dir $(lastword $(MAKEFILE_LIST))))
+TARGET_DIR ?= $(notdir $(abspath ..))
+
+include $(HOST_DIR)/Build/hostflags.mk
+
+HOST_INCFLAGS += -I../Source -I../../Common/Source
+HOST_MAIN = HostMain.c
+
+OBJDIR = objs_HOST
+TARGET = $(TARGET_DIR)_HOST
+
+vpath %.c ../Source ../../Common/Source $(HOST_DIR)/Source
+
+APPOBJS = $(addprefix $(OBJDIR)/,$(APPSRC:.c=.o))
+PICOBJS = $(addprefix $(OBJDIR)/pic/,$(APPSRC:.c=.o))
+HOSTOBJS = $(addprefix $(OBJDIR)/,$(HOST_SRC:.c=.o))
+MAINOBJS = $(addprefix $(OBJDIR)/,$(HOST_MAIN:.c=.o))
+
+.PHONY: all clean
+
+all: $(TARGET) $(TARGET).so
+
+$(TARGET): $(APPOBJS) $(HOSTOBJS) $(MAINOBJS)
+	$(HOST_CC) $(HOST_LDFLAGS) -o $@ $^
+
+# ランタイムのシンボルは読み込む側 (Sim) が提供する。
+# 自身のシンボルは自身の中で解決し、ノード間で混ざらないようにする。
+$(TARGET).so: $(PICOBJS)
+	$(HOST_CC) -shared -Wl,-Bsymbolic -o $@ $^
+
+$(OBJDIR)/%.o: %.c | $(OBJDIR)
+	$(HOST_CC) $(HOST_CFLAGS) -fno-pie $(CFLAGS) $(HOST_INCFLAGS) $(INCFLAGS) -MMD -MP -c $< -o $@
+
+$(OBJDIR)/pic/%.o: %.c | $(OBJDIR)/pic
+	$(HOST_CC) $(HOST_CFLAGS) -fPIC $(CFLAGS) $(HOST_INCFLAGS) $(INCFLAGS) -MMD -MP -c $< -o $@
+
+$(OBJDIR) $(OBJDIR)/pic:
+	mkdir -p $@
+
+clean:
+	rm -rf $(OBJDIR) $(TARGET) $(TARGET).so
+
+-include $(wildcard $(OBJDIR)/*.d $(OBJDIR)/pic/*.d)
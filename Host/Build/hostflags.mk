@@ -0,0 +1,15 @@
+##########################################################################
+# ホスト (Linux) 向けビルドの共通設定
+#
+# host.mk (ファームウェア) と Host/Build/Makefile (シミュレータ) から読み込
+# まれます。ファームウェアは u32arg (32bit) にポインタを載せるため、実行
+# ファイルは非 PIE でリンクしてランタイムの静的領域を 4GB 未満に置きます。
+##########################################################################
+
+HOST_CC ?= gcc
+HOST_CFLAGS = -std=gnu99 -O2 -g -fno-omit-frame-pointer
+HOST_CFLAGS += -Wall -Wno-pointer-sign -Wno-int-to-pointer-cast -Wno-unused-variable -Wno-unused-function
+HOST_INCFLAGS = -I$(HOST_DIR)/Include -I$(HOST_DIR)/Source
+HOST_LDFLAGS = -no-pie
+
+HOST_SRC = HostCore.c HostSerial.c HostRadio.c HostHw.c
@@ -0,0 +1,59 @@
+/*
+ * AppHardwareApi.h (host)
+ *
+ * NXP ペリフェラル API のうち、本アプリケーションが使用する定義のみを
+ * ホスト上で再現したもの。実体は Host/Source/HostHw.c にある。
+ *
+ */
+
+#ifndef APPHARDWAREAPI_H_
+#define APPHARDWAREAPI_H_
+
+#include "jendefs.h"
+
+// UART
+#define E_AHI_UART_0 0
+#define E_AHI_UART_1 1
+
+#define E_AHI_UART_FIFO_LEVEL_1  0
+#define E_AHI_UART_FIFO_LEVEL_4  1
+#define E_AHI_UART_FIFO_LEVEL_8  2
+#define E_AHI_UART_FIFO_LEVEL_14 3
+
+// デバイス ID (cbToCoNet_vHwEvent 等で渡される)
+#define E_AHI_DEVICE_SYSCTRL    2
+#define E_AHI_DEVICE_UART0      3
+#define E_AHI_DEVICE_UART1      4
+#define E_AHI_DEVICE_TIMER0     5
+#define E_AHI_DEVICE_TIMER1     6
+#define E_AHI_DEVICE_TIMER2     7
+#define E_AHI_DEVICE_TIMER3     8
+#define E_AHI_DEVICE_TIMER4     9
+#define E_AHI_DEVICE_TICK_TIMER 10
+
+// ウェイクアップタイマ
+#define E_AHI_WAKE_TIMER_0 0
+#define E_AHI_WAKE_TIMER_1 1
+
+// DIO
+PUBLIC void vAHI_DioSetDirection(uint32 u32Inputs, uint32 u32Outputs);
+PUBLIC void vAHI_DioSetOutput(uint32 u32On, uint32 u32Off);
+PUBLIC uint32 u32AHI_DioReadInput(void);
+PUBLIC void vAHI_DioWakeEnable(uint32 u32Enable, uint32 u32Disable);
+
+// EEPROM (JN516x: 64 バイト × 64 セグメント。戻り値 0 で成功)
+PUBLIC uint16 u16AHI_InitialiseEEP(uint8 *pu8SegmentDataLength);
+PUBLIC int iAHI_ReadDataFromEEPROMsegment(uint16 u16SegmentIndex, uint8 u8SegmentByteAddress,
+		uint8 *pu8DataBuffer, uint8 u8BytesToRead);
+PUBLIC int iAHI_WriteDataIntoEEPROMsegment(uint16 u16SegmentIndex, uint8 u8SegmentByteAddress,
+		uint8 *pu8DataBuffer, uint8 u8BytesToWrite);
+PUBLIC int iAHI_EraseEEPROMsegment(uint16 u16SegmentIndex);
+
+// ティックタイマ (ToCoNet が tick ごとに 0 から数え直させる 16MHz のカウンタ)
+PUBLIC uint32 u32AHI_TickTimerRead(void);
+
+// システム
+PUBLIC void vAHI_BrownOutConfigure(uint8 u8VboSelect, bool_t bVboRstEn,
+		bool_t bVboEn, bool_t bVboIntEnFalling, bool_t bVboIntEnRising);
+
+#endif /* APPHARDWAREAPI_H_ */
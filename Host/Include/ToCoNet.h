@@ -0,0 +1,129 @@
+/*
+ * ToCoNet.h (host)
+ *
+ * ToCoNet API のうち、本アプリケーションが使用する範囲をホスト上で
+ * 再現したもの。実体は Host/Source/HostCore.c, HostRadio.c にある。
+ *
+ * ホストでは複数ノードを一つのプロセスで動かせるよう、sToCoNet_AppContext
+ * と u32TickCount_ms は実行中ノードのものを返すマクロになっている。
+ *
+ */
+
+#ifndef TOCONET_H_
+#define TOCONET_H_
+
+#include "jendefs.h"
+#include "fprintf.h"
+#include "ToCoNet_event.h"
+#include "ToCoNet_packets.h"
+
+#define _C if(1)
+
+// モジュール
+#define TOCONET_MOD_ENERGYSCAN   0x0001
+#define TOCONET_MOD_NBSCAN       0x0002
+#define TOCONET_MOD_NBSCAN_SLAVE 0x0004
+
+// アドレス
+#define TOCONET_MAC_ADDR_BROADCAST 0xFFFF
+
+// ペイロード長の上限 (拡張アドレス使用時)
+#define TOCONET_MAX_PAYLOAD 98
+
+typedef struct {
+	uint32 u32AppId;
+	uint8 u8Channel;
+	uint32 u32ChMask;
+	uint16 u16ShortAddress;
+	bool_t bRxOnIdle;
+	uint8 u8TxMacRetry;
+	uint8 u8TxPower;
+	uint8 u8CPUClk;
+	uint16 u16TickHz;
+	uint8 u8RandMode;
+} tsToCoNet_AppContext;
+
+#define sToCoNet_AppContext (*ToCoNet_psAppContext())
+#define u32TickCount_ms (ToCoNet_u32GetTickCount_ms())
+
+typedef struct {
+	uint32 u32SrcAddr;
+	uint32 u32DstAddr;
+	bool_t bAckReq;
+	uint8 u8Retry;
+	uint16 u16RetryDur;
+	uint16 u16DelayMin;
+	uint16 u16DelayMax;
+	uint8 u8CbId;
+	uint8 u8Seq;
+	uint8 u8Cmd;
+	uint8 u8Len;
+	uint8 auData[TOCONET_MAX_PAYLOAD];
+} tsTxDataApp;
+
+typedef struct {
+	uint32 u32SrcAddr;
+	uint32 u32DstAddr;
+	uint8 u8Cmd;
+	uint8 u8Seq;
+	uint8 u8Len;
+	uint8 u8Lqi;
+	uint32 u32Tick;
+	uint8 *auData;
+} tsRxDataApp;
+
+// Neighbour Scan
+#define TOCONET_NBSCAN_NORMAL_MASK         0x01
+#define TOCONET_NBSCAN_QUICK_EXTADDR_MASK  0x02
+#define TOCONET_NBSCAN_MAX_RESULT 16
+
+typedef struct {
+	bool_t bFound;
+	uint8 u8ch;
+	uint8 u8lqi;
+	uint16 u16ad;
+	uint32 u32addr;
+} tsToCoNet_NbScan_Entitiy;
+
+typedef struct {
+	uint8 u8scanMode;
+	uint8 u8found;
+	tsToCoNet_NbScan_Entitiy sScanResult[TOCONET_NBSCAN_MAX_RESULT];
+	uint8 u8IdxLqiSort[TOCONET_NBSCAN_MAX_RESULT];
+} tsToCoNet_NbScan_Result;
+
+// コンテキスト
+PUBLIC tsToCoNet_AppContext *ToCoNet_psAppContext(void);
+PUBLIC uint32 ToCoNet_u32GetTickCount_ms(void);
+
+// MAC
+PUBLIC void ToCoNet_vRegModules(uint32 u32Mods);
+PUBLIC void ToCoNet_vMacStart(void);
+PUBLIC void ToCoNet_vRfConfig(void);
+PUBLIC bool_t ToCoNet_bMacTxReq(tsTxDataApp *psTx);
+PUBLIC uint32 ToCoNet_u32GetSerial(void);
+PUBLIC uint16 ToCoNet_u16GetRand(void);
+PUBLIC uint32 ToCoNet_u32GetRand(void);
+
+// スキャン
+PUBLIC bool_t ToCoNet_NbScan_bStart(uint32 u32ChMask, uint16 u16Dur);
+PUBLIC bool_t ToCoNet_EnergyScan_bStart(uint32 u32ChMask, uint8 u8Count);
+
+// デバッグ
+PUBLIC void ToCoNet_vDebugInit(tsFILE *psStream);
+PUBLIC void ToCoNet_vDebugLevel(uint8 u8Level);
+
+// スリープ
+PUBLIC void ToCoNet_vSleep(uint8 u8Device, uint32 u32Period, bool_t bPeriodic, bool_t bRamOff);
+
+// アプリケーションが実装するコールバック
+void cbAppColdStart(bool_t bAfterAhiInit);
+void cbAppWarmStart(bool_t bAfterAhiInit);
+void cbToCoNet_vMain(void);
+void cbToCoNet_vRxEvent(tsRxDataApp *pRx);
+void cbToCoNet_vTxEvent(uint8 u8CbId, uint8 bStatus);
+void cbToCoNet_vNwkEvent(teEvent eEvent, uint32 u32arg);
+void cbToCoNet_vHwEvent(uint32 u32DeviceId, uint32 u32ItemBitmap);
+uint8 cbToCoNet_u8HwInt(uint32 u32DeviceId, uint32 u32ItemBitmap);
+
+#endif /* TOCONET_H_ */
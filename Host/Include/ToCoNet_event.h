@@ -0,0 +1,56 @@
+/*
+ * ToCoNet_event.h (host)
+ *
+ * ステートマシン (イベント処理) の定義。
+ *
+ */
+
+#ifndef TOCONET_EVENT_H_
+#define TOCONET_EVENT_H_
+
+#include "jendefs.h"
+
+typedef uint32 teEvent;
+typedef uint32 teState;
+
+enum {
+	E_EVENT_START_UP = 0,
+	E_EVENT_NEW_STATE,
+	E_EVENT_TICK_TIMER,
+	E_EVENT_TICK_SECOND,
+	E_ORDER_INITIALIZE,
+	E_ORDER_KICK,
+
+	E_EVENT_TOCONET_NWK_START = 0x80,
+	E_EVENT_TOCONET_NWK_SCAN_COMPLETE,
+	E_EVENT_TOCONET_ENERGY_SCAN_COMPLETE,
+
+	ToCoNet_EVENT_APP_BASE = 0x100
+};
+
+enum {
+	E_STATE_IDLE = 0,
+	E_STATE_RUNNING,
+	E_STATE_FINISHED,
+
+	ToCoNet_STATE_APP_BASE = 0x100
+};
+
+// E_EVENT_START_UP の引数
+#define EVARG_START_UP_WAKEUP_MASK        0x01
+#define EVARG_START_UP_WAKEUP_RAMHOLD_MASK 0x03
+
+typedef struct {
+	teState eState;
+	uint32 u32tick_new_state;
+	bool_t bNewState; // SetState で立ち、E_EVENT_NEW_STATE の発行に使う
+} tsEvent;
+
+typedef void (*tpfToCoNet_Event_StateMachine)(tsEvent *pEv, teEvent eEvent, uint32 u32evarg);
+
+PUBLIC uint8 ToCoNet_Event_Register_State_Machine(tpfToCoNet_Event_StateMachine pf);
+PUBLIC void ToCoNet_Event_Process(teEvent eEvent, uint32 u32evarg, tpfToCoNet_Event_StateMachine pf);
+PUBLIC void ToCoNet_Event_SetState(tsEvent *pEv, teState eNewState);
+PUBLIC uint32 ToCoNet_Event_u32TickFrNewState(tsEvent *pEv);
+
+#endif /* TOCONET_EVENT_H_ */
@@ -0,0 +1,35 @@
+/*
+ * ToCoNet_mod_prototype.h (host)
+ *
+ * ToCoNet.h より前に定義された ToCoNet_USE_MOD_* に従って、
+ * 登録するモジュールのビットマップを決める。
+ *
+ */
+
+#ifndef TOCONET_MOD_PROTOTYPE_H_
+#define TOCONET_MOD_PROTOTYPE_H_
+
+#include "ToCoNet.h"
+
+#ifdef ToCoNet_USE_MOD_ENERGYSCAN
+#define _TOCONET_MOD_ENERGYSCAN TOCONET_MOD_ENERGYSCAN
+#else
+#define _TOCONET_MOD_ENERGYSCAN 0
+#endif
+
+#ifdef ToCoNet_USE_MOD_NBSCAN
+#define _TOCONET_MOD_NBSCAN TOCONET_MOD_NBSCAN
+#else
+#define _TOCONET_MOD_NBSCAN 0
+#endif
+
+#ifdef ToCoNet_USE_MOD_NBSCAN_SLAVE
+#define _TOCONET_MOD_NBSCAN_SLAVE TOCONET_MOD_NBSCAN_SLAVE
+#else
+#define _TOCONET_MOD_NBSCAN_SLAVE 0
+#endif
+
+#define ToCoNet_REG_MOD_ALL() \
+	ToCoNet_vRegModules(_TOCONET_MOD_ENERGYSCAN | _TOCONET_MOD_NBSCAN | _TOCONET_MOD_NBSCAN_SLAVE)
+
+#endif /* TOCONET_MOD_PROTOTYPE_H_ */
@@ -0,0 +1,14 @@
+/*
+ * ToCoNet_packets.h (host)
+ *
+ * u8Cmd は 3bit (0..7) のフィールドであり、これを超える値は送信できない。
+ *
+ */
+
+#ifndef TOCONET_PACKETS_H_
+#define TOCONET_PACKETS_H_
+
+#define TOCONET_PACKET_CMD_APP_USER 0
+#define TOCONET_PACKET_CMD_APP_USER_MAX 7
+
+#endif /* TOCONET_PACKETS_H_ */
@@ -0,0 +1,22 @@
+/*
+ * fprintf.h (host)
+ *
+ */
+
+#ifndef FPRINTF_H_
+#define FPRINTF_H_
+
+#include "jendefs.h"
+
+#define LB "\r\n"
+
+typedef struct {
+	uint8 u8Device;
+	bool_t (*bPutChar)(uint8 u8Device, uint8 u8Char);
+} tsFILE;
+
+PUBLIC void vfPrintf(tsFILE *psStream, const char *pcFormat, ...)
+	__attribute__((format(printf, 2, 3)));
+PUBLIC void vPutChar(tsFILE *psStream, uint8 u8Char);
+
+#endif /* FPRINTF_H_ */
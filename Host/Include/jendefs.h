@@ -0,0 +1,40 @@
+/*
+ * jendefs.h (host)
+ *
+ * ホスト (Linux) ビルド用の基本型定義。
+ * JN516x の ba-elf-gcc と同じく int/long を 32bit として扱う前提で定義する。
+ *
+ */
+
+#ifndef JENDEFS_H_
+#define JENDEFS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t  uint8;
+typedef int8_t   int8;
+typedef uint16_t uint16;
+typedef int16_t  int16;
+typedef uint32_t uint32;
+typedef int32_t  int32;
+typedef uint64_t uint64;
+typedef int64_t  int64;
+
+typedef uint8 bool_t;
+
+#ifndef TRUE
+#define TRUE  1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL ((void *)0)
+#endif
+
+#define PUBLIC
+#define PRIVATE static
+
+#endif /* JENDEFS_H_ */
@@ -0,0 +1,40 @@
+/*
+ * serial.h (host)
+ *
+ * UART キュー API。ホストではボーレートに従って仮想時間上で送出される。
+ *
+ */
+
+#ifndef SERIAL_H_
+#define SERIAL_H_
+
+#include "jendefs.h"
+#include "fprintf.h"
+
+typedef struct {
+	uint32 u32BaudRate;
+	bool_t bParityEnable;
+	uint8 u8ParityType;
+	uint8 u8WordLength;
+	bool_t bTwoStopBits;
+	bool_t bUseHwFlowControl;
+
+	uint8 *pu8SerialRxQueueBuffer;
+	uint8 *pu8SerialTxQueueBuffer;
+	uint16 u16SerialRxQueueSize;
+	uint16 u16SerialTxQueueSize;
+	uint8 u8SerialPort;
+	uint8 u8RX_FIFO_LEVEL;
+	uint16 u16AHI_UART_RTS_LOW;
+	uint16 u16AHI_UART_RTS_HIGH;
+} tsSerialPortSetup;
+
+PUBLIC void SERIAL_vInit(tsSerialPortSetup *psSetup);
+PUBLIC bool_t SERIAL_bTxChar(uint8 u8SerialPort, uint8 u8Char);
+PUBLIC bool_t SERIAL_bRxQueueEmpty(uint8 u8SerialPort);
+PUBLIC int16 SERIAL_i16RxChar(uint8 u8SerialPort);
+PUBLIC uint16 SERIAL_u16TxQueueCount(uint8 u8SerialPort);
+PUBLIC uint16 SERIAL_u16RxQueueCount(uint8 u8SerialPort);
+PUBLIC void SERIAL_vFlush(uint8 u8SerialPort);
+
+#endif /* SERIAL_H_ */
@@ -0,0 +1,19 @@
+/*
+ * sprintf.h (host)
+ *
+ */
+
+#ifndef SPRINTF_H_
+#define SPRINTF_H_
+
+#include "jendefs.h"
+#include "fprintf.h"
+
+extern tsFILE *SPRINTF_Stream;
+
+PUBLIC void SPRINTF_vInit128(void);
+PUBLIC void SPRINTF_vRewind(void);
+PUBLIC uint8 *SPRINTF_pu8GetBuff(void);
+PUBLIC uint16 SPRINTF_u16Length(void);
+
+#endif /* SPRINTF_H_ */
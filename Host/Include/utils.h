@@ -0,0 +1,43 @@
+/*
+ * utils.h (host)
+ *
+ * ペリフェラル API のラッパ (ポート・タイマ・UART 待ち)。
+ *
+ */
+
+#ifndef UTILS_H_
+#define UTILS_H_
+
+#include "jendefs.h"
+#include "AppHardwareApi.h"
+#include "serial.h"
+
+// ポート
+PUBLIC void vPortAsOutput(uint8 u8Port);
+PUBLIC void vPortAsInput(uint8 u8Port);
+PUBLIC void vPortSetHi(uint8 u8Port);
+PUBLIC void vPortSetLo(uint8 u8Port);
+PUBLIC bool_t bPortRead(uint8 u8Port);
+
+// タイマ
+typedef struct {
+	uint8 u8Device;
+	uint16 u16Hz;
+	uint8 u8PreScale;
+	uint16 u16duty;
+	bool_t bPWMout;
+	bool_t bDisableInt;
+} tsTimerContext;
+
+PUBLIC void vTimerConfig(tsTimerContext *psTC);
+PUBLIC void vTimerStart(tsTimerContext *psTC);
+PUBLIC void vTimerStop(tsTimerContext *psTC);
+PUBLIC void vTimerChangeHz(tsTimerContext *psTC);
+
+// ビジーウェイト
+PUBLIC void vWait(uint32 u32Count);
+
+// UART 送信完了まで待つ
+#define WAIT_UART_OUTPUT(P) SERIAL_vFlush(P)
+
+#endif /* UTILS_H_ */
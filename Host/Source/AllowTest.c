@@ -0,0 +1,85 @@
+/*
+ * AllowTest.c
+ *
+ * Slave の有効な IDm の一覧 (Slave/Source/AllowFilter.c) の試験。
+ * 新しい版を受け取って判定し、版 0 (allow off や Master の再起動) を知らされたら
+ * 受け取り終えた一覧でも受け取り中の一覧でも判定をやめること、その後に
+ * 新しい版をまた受け取れることを確かめる。
+ *
+ *   usage: AllowTest
+ *
+ * 失敗があれば内容を表示して 1 を返す (make test で実行する)。
+ *
+ */
+
+#include <stdio.h>
+
+#include "AllowFilter.h"
+#include "Allowlist.h"
+
+static uint32 u32Fail = 0;
+
+#define CHECK(c) do { if (!(c)) { u32Fail++; \
+	fprintf(stderr, "%s:%d: NG: %s\n", __FILE__, __LINE__, #c); } } while (0)
+
+static const uint8 au8In[8] = { 0x01, 0x2E, 0x00, 0x01, 0x12, 0x34, 0x56, 0x78 };
+static const uint8 au8Out[8] = { 0x01, 0x2E, 0x00, 0x02, 0x87, 0x65, 0x43, 0x21 };
+
+// 版 u8Version の一覧 (au8In だけ) を受け取る
+static void vLoad(uint8 u8Version, uint32 u32Now)
+{
+	CHECK(AllowFilter_bVersion(u8Version, u32Now));
+	CHECK(AllowFilter_u8Want() == u8Version);
+	Allowlist_vClear(AllowFilter_pu8Buffer());
+	Allowlist_vAdd(AllowFilter_pu8Buffer(), au8In);
+	AllowFilter_vLoaded(u32Now + 100);
+	CHECK(AllowFilter_u8Want() == 0);
+	CHECK(AllowFilter_psStats()->u8Version == u8Version);
+}
+
+// 受け取り終えた一覧の後の allow off
+static void vTestOff(void)
+{
+	AllowFilter_vInit();
+	CHECK(AllowFilter_u8Check(au8In) == ALLOWFILTER_UNCHECKED);
+	vLoad(1, 1000);
+	CHECK(AllowFilter_u8Check(au8In) == ALLOWFILTER_ACCEPT);
+	CHECK(AllowFilter_u8Check(au8Out) == ALLOWFILTER_REJECT);
+	// 同じ版を知らされても受け取り直さない
+	CHECK(!AllowFilter_bVersion(1, 2000));
+
+	CHECK(!AllowFilter_bVersion(0, 3000));
+	CHECK(AllowFilter_u8Want() == 0);
+	CHECK(AllowFilter_psStats()->u8Version == 0);
+	CHECK(AllowFilter_u8Check(au8In) == ALLOWFILTER_UNCHECKED);
+	CHECK(AllowFilter_u8Check(au8Out) == ALLOWFILTER_UNCHECKED);
+
+	// 次の commit で配られた版はまた受け取る
+	vLoad(2, 4000);
+	CHECK(AllowFilter_u8Check(au8Out) == ALLOWFILTER_REJECT);
+}
+
+// 受け取り中の allow off
+static void vTestOffWhileLoading(void)
+{
+	AllowFilter_vInit();
+	vLoad(1, 1000);
+	CHECK(AllowFilter_bVersion(2, 2000));
+	CHECK(AllowFilter_u8Check(au8Out) == ALLOWFILTER_UNCHECKED);
+	CHECK(!AllowFilter_bVersion(0, 2500));
+	CHECK(AllowFilter_u8Want() == 0);
+	// 遅れて届いた区切りで受け取り終えても使わない
+	AllowFilter_vLoaded(2600);
+	CHECK(AllowFilter_psStats()->u8Version == 0);
+	CHECK(AllowFilter_u8Check(au8Out) == ALLOWFILTER_UNCHECKED);
+	CHECK(AllowFilter_psStats()->u32Loads == 1);
+}
+
+int main(void)
+{
+	vTestOff();
+	vTestOffWhileLoading();
+
+	printf("AllowTest: %s\n", u32Fail ? "NG" : "ok");
+	return u32Fail ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * BinDump.c
+ *
+ * Master のバイナリ出力 (Common/Source/BinFrame.h) を JSON 行に戻して
+ * 標準出力へ書く。felica フレームは JSON 版の項目に seq, lqi, tick を
+ * 加えた形、テキストフレームは中身をそのまま出す。
+ * Slave のデバッグログ (LogRecord.h) は LogEvents.h の書式で 1 件ずつ
+ * { "type": "log", "macaddress": ..., "message": ... } 行に戻す。
+ *
+ *   usage: BinDump [file]      (省略時は標準入力)
+ *
+ *   make OUTPUT=BINARY host
+ *   ./Master/Build/Master_HOST -u 0 script.txt | ./Host/Build/BinDump
+ *
+ * 壊れたフレームの数を終了時に標準エラーへ出す。
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "BinFrame.h"
+#include "LogEvents.h"
+#include "LogRecord.h"
+
+#define FRAME_MAX BINFRAME_ENCODED_MAX(BINFRAME_BODY_MAX)
+
+// 事象番号から書式を引く表 (LogEvents.h から作る)
+#define LOG_EVENT_FORMAT(eName, u8Id, pcFormat) [u8Id] = pcFormat,
+static const char *apcLogFormat[256] = {
+	LOG_EVENT_TABLE(LOG_EVENT_FORMAT)
+};
+
+static void vPrintLog(uint8 *pu8Body, uint8 u8Len)
+{
+	uint32 u32Src, au32Args[LOGRECORD_ARGS_MAX] = { 0 };
+	uint8 u8Event, u8Argc, i;
+	int16 i16Rec;
+
+	if (u8Len < 4) return;
+	u32Src = ((uint32)pu8Body[0] << 24) | ((uint32)pu8Body[1] << 16) | ((uint32)pu8Body[2] << 8) | pu8Body[3];
+	pu8Body += 4;
+	u8Len -= 4;
+	while (u8Len && (i16Rec = LogRecord_i16Decode(pu8Body, u8Len, &u8Event, au32Args, &u8Argc)) > 0) {
+		printf("{ \"type\": \"log\", \"macaddress\": \"%08X\", \"message\": \"", u32Src);
+		if (apcLogFormat[u8Event]) {
+			// 余った引数は printf が読み捨てる
+			printf(apcLogFormat[u8Event], au32Args[0], au32Args[1], au32Args[2], au32Args[3],
+					au32Args[4], au32Args[5], au32Args[6], au32Args[7]);
+		} else {
+			// 知らない番号 (デコーダより新しいファームウェア)
+			printf("event 0x%02X", u8Event);
+			for (i = 0; i < u8Argc; i++) printf(" %u", au32Args[i]);
+		}
+		printf("\" }\n");
+		pu8Body += i16Rec;
+		u8Len -= i16Rec;
+	}
+}
+
+static void vPrintFrame(uint8 u8Type, uint8 *pu8Body, uint8 u8Len)
+{
+	tsBinFrameFelica sF;
+	uint8 i;
+
+	switch (u8Type) {
+	case BINFRAME_TYPE_FELICA:
+		if (!BinFrame_bUnpackFelica(pu8Body, u8Len, &sF)) break;
+		printf("{ \"type\": \"felica\", \"macaddress\": \"%08X\", \"idm\": \"", sF.u32SrcAddr);
+		for (i = 0; i < 8; i++) printf("%02X", sF.au8Idm[i]);
+		printf("\", \"seq\": %u, \"lqi\": %u, \"tick\": %u }\n", sF.u8Seq, sF.u8Lqi, sF.u32Tick);
+		break;
+	case BINFRAME_TYPE_LOG:
+		vPrintLog(pu8Body, u8Len);
+		break;
+	case BINFRAME_TYPE_TEXT:
+		// 前後の改行は付け直す
+		while (u8Len && (pu8Body[0] == '\r' || pu8Body[0] == '\n')) { pu8Body++; u8Len--; }
+		while (u8Len && (pu8Body[u8Len - 1] == '\r' || pu8Body[u8Len - 1] == '\n')) u8Len--;
+		printf("%.*s\n", u8Len, pu8Body);
+		break;
+	default:
+		printf("{ \"type\": \"unknown\", \"frame_type\": %u, \"length\": %u }\n", u8Type, u8Len);
+		break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *fp = stdin;
+	uint8 au8Buf[FRAME_MAX];
+	uint16 u16Len = 0;
+	uint32 u32Frames = 0, u32Bad = 0;
+	int c;
+
+	if (argc > 1 && (fp = fopen(argv[1], "rb")) == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	while ((c = fgetc(fp)) != EOF) {
+		if (c != BINFRAME_DELIMITER) {
+			// 長すぎるものは区切りまで読み捨てる
+			if (u16Len < sizeof(au8Buf)) au8Buf[u16Len] = c;
+			u16Len++;
+			continue;
+		}
+		if (u16Len) {
+			uint8 u8Type, *pu8Body;
+			int16 i16Len = u16Len <= sizeof(au8Buf) ? BinFrame_i16Decode(au8Buf, u16Len, &u8Type, &pu8Body) : -1;
+
+			if (i16Len < 0) {
+				u32Bad++;
+			} else {
+				u32Frames++;
+				vPrintFrame(u8Type, pu8Body, i16Len);
+			}
+		}
+		u16Len = 0;
+	}
+	fflush(stdout);
+	fprintf(stderr, "frames: %u, bad: %u\n", u32Frames, u32Bad);
+	return 0;
+}
@@ -0,0 +1,468 @@
+/*
+ * HostCore.c
+ *
+ * ホストランタイムの中核。仮想時間スケジューラ、ノード管理、
+ * ToCoNet のイベント処理 (ステートマシン) とティックを実装する。
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+
+typedef struct {
+	uint64 u64At;
+	uint64 u64Seq;
+	tsHostNode *psNode;
+	tpfHostAction pf;
+	uint32 u32Arg;
+	void *pvArg;
+	uint32 u32Epoch;
+	bool_t bCpu;
+} tsHostEvent;
+
+tsHostNode *psHost_Cur = NULL;
+
+static tsHostEvent *asHeap = NULL;
+static uint32 u32HeapLen = 0;
+static uint32 u32HeapCap = 0;
+static uint64 u64SeqNext = 0;
+static uint64 u64HostNow = 0;
+static uint32 u32HostRand = 1;
+
+// ノードは静的領域に置く (スキャン結果のアドレスを 32bit の u32arg で渡すため)
+static tsHostNode asHostNodes[HOST_MAX_NODES];
+static uint16 u16HostNodes = 0;
+
+/****************************************************************************
+ * スケジューラ
+ ****************************************************************************/
+
+static bool_t bEarlier(const tsHostEvent *a, const tsHostEvent *b)
+{
+	if (a->u64At != b->u64At) return a->u64At < b->u64At;
+	return a->u64Seq < b->u64Seq;
+}
+
+static void vHeapPush(tsHostEvent *psEv)
+{
+	uint32 i;
+
+	if (u32HeapLen == u32HeapCap) {
+		u32HeapCap = u32HeapCap ? u32HeapCap * 2 : 1024;
+		asHeap = realloc(asHeap, u32HeapCap * sizeof(tsHostEvent));
+		if (asHeap == NULL) {
+			fprintf(stderr, "host: out of memory\n");
+			exit(1);
+		}
+	}
+
+	psEv->u64Seq = u64SeqNext++;
+	i = u32HeapLen++;
+	while (i > 0) {
+		uint32 p = (i - 1) / 2;
+		if (!bEarlier(psEv, &asHeap[p])) break;
+		asHeap[i] = asHeap[p];
+		i = p;
+	}
+	asHeap[i] = *psEv;
+}
+
+static void vHeapPop(tsHostEvent *psEv)
+{
+	tsHostEvent sLast;
+	uint32 i = 0;
+
+	*psEv = asHeap[0];
+	sLast = asHeap[--u32HeapLen];
+	for (;;) {
+		uint32 c = i * 2 + 1;
+		if (c >= u32HeapLen) break;
+		if (c + 1 < u32HeapLen && bEarlier(&asHeap[c + 1], &asHeap[c])) c++;
+		if (!bEarlier(&asHeap[c], &sLast)) break;
+		asHeap[i] = asHeap[c];
+		i = c;
+	}
+	if (u32HeapLen) asHeap[i] = sLast;
+}
+
+PUBLIC void HOST_vReset(uint32 u32Seed)
+{
+	u32HeapLen = 0;
+	u64SeqNext = 0;
+	u64HostNow = 0;
+	u32HostRand = u32Seed ? u32Seed : 1;
+	memset(asHostNodes, 0, sizeof(asHostNodes));
+	u16HostNodes = 0;
+	psHost_Cur = NULL;
+}
+
+PUBLIC uint64 HOST_u64Now(void)
+{
+	return u64HostNow;
+}
+
+PUBLIC uint64 HOST_u64NodeNow(tsHostNode *psNode)
+{
+	if (psNode == psHost_Cur && psNode->u64Now > u64HostNow) {
+		return psNode->u64Now;
+	}
+	return u64HostNow;
+}
+
+PUBLIC void HOST_vSchedule(uint64 u64At, tsHostNode *psNode, tpfHostAction pf, uint32 u32Arg, void *pvArg)
+{
+	tsHostEvent sEv;
+
+	sEv.u64At = u64At < u64HostNow ? u64HostNow : u64At;
+	sEv.psNode = psNode;
+	sEv.pf = pf;
+	sEv.u32Arg = u32Arg;
+	sEv.pvArg = pvArg;
+	sEv.u32Epoch = psNode ? psNode->u32Epoch : 0;
+	sEv.bCpu = FALSE;
+	vHeapPush(&sEv);
+}
+
+PUBLIC void HOST_vScheduleCpu(uint64 u64At, tsHostNode *psNode, tpfHostAction pf, uint32 u32Arg, void *pvArg)
+{
+	tsHostEvent sEv;
+
+	sEv.u64At = u64At < u64HostNow ? u64HostNow : u64At;
+	sEv.psNode = psNode;
+	sEv.pf = pf;
+	sEv.u32Arg = u32Arg;
+	sEv.pvArg = pvArg;
+	sEv.u32Epoch = psNode->u32Epoch;
+	sEv.bCpu = TRUE;
+	vHeapPush(&sEv);
+}
+
+// ノードのコールバックを実行する前後の処理
+static void vEnter(tsHostNode *psNode)
+{
+	psHost_Cur = psNode;
+	psNode->u64Now = u64HostNow;
+}
+
+static void vLeave(tsHostNode *psNode)
+{
+	if (psNode->bPowered && !psNode->bSleeping && psNode->sApp.pfvMain) {
+		psNode->sApp.pfvMain();
+	}
+	psNode->u64BusyUntil = psNode->u64Now;
+	psHost_Cur = NULL;
+}
+
+static void vRunCpu(tsHostEvent *psEv)
+{
+	tsHostNode *psNode = psEv->psNode;
+
+	if (!psNode->bPowered || psNode->bSleeping || psEv->u32Epoch != psNode->u32Epoch) {
+		return;
+	}
+
+	// ビジー中 (UART 待ちなど) はビジー終了まで遅らせる
+	if (u64HostNow < psNode->u64BusyUntil) {
+		psEv->u64At = psNode->u64BusyUntil;
+		vHeapPush(psEv);
+		return;
+	}
+
+	vEnter(psNode);
+	psNode->sStats.u32CpuEvents++;
+	psEv->pf(psNode, psEv->u32Arg, psEv->pvArg);
+	vLeave(psNode);
+}
+
+PUBLIC bool_t HOST_bStep(uint64 u64Limit)
+{
+	tsHostEvent sEv;
+
+	if (u32HeapLen == 0 || asHeap[0].u64At > u64Limit) {
+		return FALSE;
+	}
+
+	vHeapPop(&sEv);
+	u64HostNow = sEv.u64At;
+	if (sEv.bCpu) {
+		vRunCpu(&sEv);
+	} else {
+		sEv.pf(sEv.psNode, sEv.u32Arg, sEv.pvArg);
+	}
+	return TRUE;
+}
+
+PUBLIC void HOST_vRunUntil(uint64 u64End)
+{
+	while (HOST_bStep(u64End));
+	if (u64HostNow < u64End) u64HostNow = u64End;
+}
+
+PUBLIC uint32 HOST_u32Rand(void)
+{
+	// xorshift32 (再現性のため libc の乱数は使わない)
+	u32HostRand ^= u32HostRand << 13;
+	u32HostRand ^= u32HostRand >> 17;
+	u32HostRand ^= u32HostRand << 5;
+	return u32HostRand;
+}
+
+PUBLIC uint32 HOST_u32Ptr(void *pv)
+{
+	if ((uintptr_t)pv > 0xFFFFFFFFUL) {
+		fprintf(stderr, "host: %p does not fit in u32arg (link with -no-pie)\n", pv);
+		abort();
+	}
+	return (uint32)(uintptr_t)pv;
+}
+
+/****************************************************************************
+ * ノード
+ ****************************************************************************/
+
+PUBLIC tsHostNode *HOST_psNodeCreate(const tsHostApp *psApp, uint32 u32Serial)
+{
+	tsHostNode *psNode;
+
+	if (u16HostNodes >= HOST_MAX_NODES) {
+		return NULL;
+	}
+
+	psNode = &asHostNodes[u16HostNodes];
+	memset(psNode, 0, sizeof(tsHostNode));
+	psNode->u16Id = u16HostNodes++;
+	psNode->u32Serial = u32Serial;
+	psNode->sApp = *psApp;
+	memset(psNode->au8Eep, 0xFF, sizeof(psNode->au8Eep));
+	psNode->u32Rand = u32Serial ^ HOST_u32Rand();
+	if (psNode->u32Rand == 0) psNode->u32Rand = 1;
+	return psNode;
+}
+
+PUBLIC uint16 HOST_u16Nodes(void)
+{
+	return u16HostNodes;
+}
+
+PUBLIC tsHostNode *HOST_psNode(uint16 u16Id)
+{
+	return u16Id < u16HostNodes ? &asHostNodes[u16Id] : NULL;
+}
+
+static void vDispatch(tsHostMachine *psM, teEvent eEvent, uint32 u32evarg)
+{
+	uint8 u8Loop = 0;
+
+	do {
+		psM->sEv.bNewState = FALSE;
+		psM->pf(&psM->sEv, eEvent, u32evarg);
+		eEvent = E_EVENT_NEW_STATE;
+		u32evarg = 0;
+	} while (psM->sEv.bNewState && ++u8Loop < 32);
+}
+
+PUBLIC void HOST_vDispatchEvent(tsHostNode *psNode, teEvent eEvent, uint32 u32evarg)
+{
+	uint8 i;
+
+	for (i = 0; i < psNode->u8Machines; i++) {
+		vDispatch(&psNode->asMachine[i], eEvent, u32evarg);
+	}
+}
+
+static void vTick(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	uint32 u32Before = psNode->u32TickCount;
+
+	psNode->u32TickCount = ToCoNet_u32GetTickCount_ms();
+	HOST_vDispatchEvent(psNode, E_EVENT_TICK_TIMER, 0);
+	if (u32Before / 1000 != psNode->u32TickCount / 1000) {
+		HOST_vDispatchEvent(psNode, E_EVENT_TICK_SECOND, 0);
+	}
+
+	psNode->u64NextTick += HOST_TICK_MS * HOST_NS_PER_MS;
+	HOST_vScheduleCpu(psNode->u64NextTick, psNode, vTick, 0, NULL);
+}
+
+static void vStart(tsHostNode *psNode, bool_t bWarm)
+{
+	uint8 i;
+
+	psNode->bPowered = TRUE;
+	psNode->bSleeping = FALSE;
+	psNode->u32Epoch++;
+	psNode->bUartWake = FALSE;
+	psNode->bMacStarted = FALSE;
+	psNode->bScanning = FALSE;
+	psNode->bTxActive = FALSE;
+	psNode->u8TxCount = 0;
+	psNode->u8RxCount = 0;
+	psNode->u64BootNs = u64HostNow;
+	psNode->u64BusyUntil = u64HostNow;
+	psNode->u32TickCount = 0;
+	HOST_vUartReset(psNode);
+
+	if (!bWarm) {
+		memset(&psNode->sAppContext, 0, sizeof(tsToCoNet_AppContext));
+		psNode->sAppContext.u8Channel = 18;
+		psNode->sAppContext.u32ChMask = 0x07FFF800;
+		psNode->sAppContext.u8TxMacRetry = 3;
+		psNode->sAppContext.u16ShortAddress = HOST_SHORT_ADDR_NONE;
+		psNode->sAppContext.u16TickHz = 1000 / HOST_TICK_MS;
+		psNode->u8Machines = 0;
+	}
+	for (i = 0; i < psNode->u8Machines; i++) {
+		psNode->asMachine[i].sEv.eState = E_STATE_IDLE;
+		psNode->asMachine[i].sEv.u32tick_new_state = 0;
+	}
+
+	vEnter(psNode);
+	if (bWarm) {
+		if (psNode->sApp.pfvWarmStart) psNode->sApp.pfvWarmStart(FALSE);
+		if (psNode->sApp.pfvWarmStart) psNode->sApp.pfvWarmStart(TRUE);
+		HOST_vDispatchEvent(psNode, E_EVENT_START_UP, EVARG_START_UP_WAKEUP_RAMHOLD_MASK);
+	} else {
+		psNode->sApp.pfvColdStart(FALSE);
+		psNode->sApp.pfvColdStart(TRUE);
+		HOST_vDispatchEvent(psNode, E_EVENT_START_UP, psNode->u32Epoch > 1 ? EVARG_START_UP_WAKEUP_MASK : 0);
+	}
+	vLeave(psNode);
+
+	psNode->u64NextTick = u64HostNow + HOST_TICK_MS * HOST_NS_PER_MS;
+	HOST_vScheduleCpu(psNode->u64NextTick, psNode, vTick, 0, NULL);
+}
+
+static void vPowerOn(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	vStart(psNode, FALSE);
+}
+
+PUBLIC void HOST_vNodePowerOn(tsHostNode *psNode, uint64 u64At)
+{
+	HOST_vSchedule(u64At, psNode, vPowerOn, 0, NULL);
+}
+
+static void vPowerOff(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	// RAM・キューは失われ、EEPROM だけが残る
+	psNode->bPowered = FALSE;
+	psNode->bSleeping = FALSE;
+	psNode->u32Epoch++;
+}
+
+PUBLIC void HOST_vNodePowerOff(tsHostNode *psNode, uint64 u64At)
+{
+	HOST_vSchedule(u64At, psNode, vPowerOff, 0, NULL);
+}
+
+static void vWake(tsHostNode *psNode, uint32 u32Epoch, void *pvArg)
+{
+	if (!psNode->bSleeping || u32Epoch != psNode->u32Epoch) {
+		return;
+	}
+	// RAM OFF スリープからの復帰はコールドスタートとして扱う。
+	// (同一プロセス内のため、ファームウェアの静的変数は初期化されない)
+	vStart(psNode, !psNode->bRamOff);
+}
+
+PUBLIC void HOST_vNodeWake(tsHostNode *psNode, uint64 u64At)
+{
+	HOST_vSchedule(u64At, psNode, vWake, psNode->u32Epoch, NULL);
+}
+
+/****************************************************************************
+ * ToCoNet API
+ ****************************************************************************/
+
+PUBLIC tsToCoNet_AppContext *ToCoNet_psAppContext(void)
+{
+	return &psHost_Cur->sAppContext;
+}
+
+PUBLIC uint32 ToCoNet_u32GetTickCount_ms(void)
+{
+	tsHostNode *psNode = psHost_Cur;
+	uint32 u32ms = (uint32)((psNode->u64Now - psNode->u64BootNs) / HOST_NS_PER_MS);
+	return u32ms - (u32ms % HOST_TICK_MS);
+}
+
+PUBLIC uint8 ToCoNet_Event_Register_State_Machine(tpfToCoNet_Event_StateMachine pf)
+{
+	tsHostNode *psNode = psHost_Cur;
+	tsHostMachine *psM;
+
+	if (psNode->u8Machines >= HOST_MAX_MACHINES) {
+		return 0xFF;
+	}
+	psM = &psNode->asMachine[psNode->u8Machines];
+	memset(psM, 0, sizeof(tsHostMachine));
+	psM->pf = pf;
+	psM->sEv.eState = E_STATE_IDLE;
+	return psNode->u8Machines++;
+}
+
+PUBLIC void ToCoNet_Event_Process(teEvent eEvent, uint32 u32evarg, tpfToCoNet_Event_StateMachine pf)
+{
+	tsHostNode *psNode = psHost_Cur;
+	uint8 i;
+
+	for (i = 0; i < psNode->u8Machines; i++) {
+		if (psNode->asMachine[i].pf == pf) {
+			vDispatch(&psNode->asMachine[i], eEvent, u32evarg);
+			return;
+		}
+	}
+}
+
+PUBLIC void ToCoNet_Event_SetState(tsEvent *pEv, teState eNewState)
+{
+	pEv->eState = eNewState;
+	pEv->u32tick_new_state = ToCoNet_u32GetTickCount_ms();
+	pEv->bNewState = TRUE;
+}
+
+PUBLIC uint32 ToCoNet_Event_u32TickFrNewState(tsEvent *pEv)
+{
+	return ToCoNet_u32GetTickCount_ms() - pEv->u32tick_new_state;
+}
+
+PUBLIC void ToCoNet_vSleep(uint8 u8Device, uint32 u32Period, bool_t bPeriodic, bool_t bRamOff)
+{
+	tsHostNode *psNode = psHost_Cur;
+
+	psNode->bSleeping = TRUE;
+	psNode->bRamOff = bRamOff;
+	psNode->u32Epoch++;
+	psNode->bTxActive = FALSE;
+	psNode->u8TxCount = 0;
+	psNode->u8RxCount = 0;
+	if (u32Period) {
+		HOST_vSchedule(psNode->u64Now + u32Period * HOST_NS_PER_MS, psNode, vWake, psNode->u32Epoch, NULL);
+	}
+}
+
+PUBLIC uint16 ToCoNet_u16GetRand(void)
+{
+	return (uint16)ToCoNet_u32GetRand();
+}
+
+PUBLIC uint32 ToCoNet_u32GetRand(void)
+{
+	tsHostNode *psNode = psHost_Cur;
+
+	psNode->u32Rand ^= psNode->u32Rand << 13;
+	psNode->u32Rand ^= psNode->u32Rand >> 17;
+	psNode->u32Rand ^= psNode->u32Rand << 5;
+	return psNode->u32Rand;
+}
+
+PUBLIC void ToCoNet_vDebugInit(tsFILE *psStream)
+{
+}
+
+PUBLIC void ToCoNet_vDebugLevel(uint8 u8Level)
+{
+}
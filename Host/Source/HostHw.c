@@ -0,0 +1,172 @@
+/*
+ * HostHw.c
+ *
+ * DIO・タイマ・EEPROM・システム制御のホスト実装。
+ * 出力の変化とタイマの再設定は tsHostHooks で観測できる。
+ * EEPROM はノードごとに持ち、セグメントごとの書き換え回数を数える。
+ *
+ */
+
+#include <string.h>
+
+#include "host.h"
+
+#define EEP_WRITE_NS (3 * HOST_NS_PER_MS) // 1 セグメントの書き込み・消去時間 (概算)
+
+static void vDioSet(tsHostNode *psNode, uint32 u32On, uint32 u32Off)
+{
+	uint32 u32Before = psNode->u32DioOut;
+
+	psNode->u32DioOut = (psNode->u32DioOut | u32On) & ~u32Off;
+	if (psNode->u32DioOut != u32Before && psNode->psHooks && psNode->psHooks->pfvDioChange) {
+		psNode->psHooks->pfvDioChange(psNode, u32Before, psNode->u32DioOut);
+	}
+}
+
+PUBLIC void vAHI_DioSetDirection(uint32 u32Inputs, uint32 u32Outputs)
+{
+	psHost_Cur->u32DioDir = (psHost_Cur->u32DioDir | u32Outputs) & ~u32Inputs;
+}
+
+PUBLIC void vAHI_DioSetOutput(uint32 u32On, uint32 u32Off)
+{
+	vDioSet(psHost_Cur, u32On, u32Off);
+}
+
+PUBLIC uint32 u32AHI_DioReadInput(void)
+{
+	tsHostNode *psNode = psHost_Cur;
+	return (psNode->u32DioIn & ~psNode->u32DioDir) | (psNode->u32DioOut & psNode->u32DioDir);
+}
+
+PUBLIC void vAHI_DioWakeEnable(uint32 u32Enable, uint32 u32Disable)
+{
+}
+
+PUBLIC void vAHI_BrownOutConfigure(uint8 u8VboSelect, bool_t bVboRstEn,
+		bool_t bVboEn, bool_t bVboIntEnFalling, bool_t bVboIntEnRising)
+{
+}
+
+PUBLIC void vPortAsOutput(uint8 u8Port)
+{
+	vAHI_DioSetDirection(0, 1UL << u8Port);
+}
+
+PUBLIC void vPortAsInput(uint8 u8Port)
+{
+	vAHI_DioSetDirection(1UL << u8Port, 0);
+}
+
+PUBLIC void vPortSetHi(uint8 u8Port)
+{
+	vDioSet(psHost_Cur, 1UL << u8Port, 0);
+}
+
+PUBLIC void vPortSetLo(uint8 u8Port)
+{
+	vDioSet(psHost_Cur, 0, 1UL << u8Port);
+}
+
+PUBLIC bool_t bPortRead(uint8 u8Port)
+{
+	return (u32AHI_DioReadInput() >> u8Port) & 1;
+}
+
+static void vTimerWrite(tsTimerContext *psTC)
+{
+	tsHostNode *psNode = psHost_Cur;
+
+	psNode->sStats.u32TimerWrites++;
+	if (psNode->psHooks && psNode->psHooks->pfvTimerChange) {
+		psNode->psHooks->pfvTimerChange(psNode, psTC);
+	}
+}
+
+PUBLIC void vTimerConfig(tsTimerContext *psTC)
+{
+	vTimerWrite(psTC);
+}
+
+PUBLIC void vTimerStart(tsTimerContext *psTC)
+{
+	vTimerWrite(psTC);
+}
+
+PUBLIC void vTimerStop(tsTimerContext *psTC)
+{
+	vTimerWrite(psTC);
+}
+
+PUBLIC void vTimerChangeHz(tsTimerContext *psTC)
+{
+	vTimerWrite(psTC);
+}
+
+// ノードの時刻 (UART の待ちなどで進む) の tick の中の位置
+PUBLIC uint32 u32AHI_TickTimerRead(void)
+{
+	tsHostNode *psNode = psHost_Cur;
+
+	return (uint32)((psNode->u64Now - psNode->u64BootNs) % (HOST_TICK_MS * HOST_NS_PER_MS) * 16 / 1000);
+}
+
+PUBLIC uint16 u16AHI_InitialiseEEP(uint8 *pu8SegmentDataLength)
+{
+	*pu8SegmentDataLength = HOST_EEP_SEGMENT_LEN;
+	return HOST_EEP_SEGMENTS;
+}
+
+static bool_t bEepRange(uint16 u16Segment, uint8 u8Addr, uint8 u8Len)
+{
+	return u16Segment < HOST_EEP_SEGMENTS && (uint16)u8Addr + u8Len <= HOST_EEP_SEGMENT_LEN;
+}
+
+PUBLIC int iAHI_ReadDataFromEEPROMsegment(uint16 u16SegmentIndex, uint8 u8SegmentByteAddress,
+		uint8 *pu8DataBuffer, uint8 u8BytesToRead)
+{
+	if (!bEepRange(u16SegmentIndex, u8SegmentByteAddress, u8BytesToRead)) {
+		return 1;
+	}
+	memcpy(pu8DataBuffer, &psHost_Cur->au8Eep[u16SegmentIndex * HOST_EEP_SEGMENT_LEN + u8SegmentByteAddress],
+			u8BytesToRead);
+	return 0;
+}
+
+PUBLIC int iAHI_WriteDataIntoEEPROMsegment(uint16 u16SegmentIndex, uint8 u8SegmentByteAddress,
+		uint8 *pu8DataBuffer, uint8 u8BytesToWrite)
+{
+	tsHostNode *psNode = psHost_Cur;
+
+	if (!bEepRange(u16SegmentIndex, u8SegmentByteAddress, u8BytesToWrite)) {
+		return 1;
+	}
+	memcpy(&psNode->au8Eep[u16SegmentIndex * HOST_EEP_SEGMENT_LEN + u8SegmentByteAddress],
+			pu8DataBuffer, u8BytesToWrite);
+	psNode->au32EepCycles[u16SegmentIndex]++;
+	psNode->sStats.u32EepWrites++;
+	psNode->u64Now += EEP_WRITE_NS;
+	return 0;
+}
+
+PUBLIC int iAHI_EraseEEPROMsegment(uint16 u16SegmentIndex)
+{
+	tsHostNode *psNode = psHost_Cur;
+
+	if (u16SegmentIndex >= HOST_EEP_SEGMENTS) {
+		return 1;
+	}
+	memset(&psNode->au8Eep[u16SegmentIndex * HOST_EEP_SEGMENT_LEN], 0xFF, HOST_EEP_SEGMENT_LEN);
+	psNode->au32EepCycles[u16SegmentIndex]++;
+	psNode->sStats.u32EepErases++;
+	psNode->u64Now += EEP_WRITE_NS;
+	return 0;
+}
+
+PUBLIC void vWait(uint32 u32Count)
+{
+	// 16MHz で 1 ループ 4 サイクル程度とみなす
+	if (psHost_Cur) {
+		psHost_Cur->u64Now += (uint64)u32Count * 250;
+	}
+}
@@ -0,0 +1,349 @@
+/*
+ * HostMain.c
+ *
+ * 1 ノード分のファームウェアを仮想時間で動かすホスト実行ファイル。
+ * Master/Build, Slave/Build で make TWE_CHIP_MODEL=HOST とすると、
+ * このファイルとファームウェアをリンクした実行ファイルができる。
+ *
+ *   usage: Master_HOST [-t ms] [-x serial] [-a] [-u port] [-v] [script]
+ *
+ *   -t ms      仮想時間で何 ms 動かすか (既定 10000)
+ *   -x serial  ToCoNet_u32GetSerial の値 (16 進)
+ *   -a         ユニキャスト送信に ACK を返す (既定は相手なしで失敗)
+ *   -u port    指定ポートの UART 出力のみ標準出力へ出す (既定は全ポート)
+ *   -v         無線送信を標準エラーへ出す
+ *
+ * スクリプトは 1 行 1 命令 ('#' 以降はコメント)。時刻は起動からの ms。
+ *
+ *   rx <ms> <src> <dst> <cmd> <seq> <lqi> <hex> [<count> <interval_us>]
+ *       パケットを受信させる。count を指定すると interval_us ごとに
+ *       seq を 1 ずつ増やしながら繰り返す。
+ *   uart <ms> <port> <hex>
+ *       UART にバイト列を受信させる。
+ *   nb <ch> <addr> <lqi>
+ *       Neighbour Scan で見つかるノードを定義する。
+ *   energy <ch> <value>
+ *       Energy Scan の結果を定義する (未定義のチャネルは 0)。
+ *
+ * 終了時に仮想時間・各種カウンタ・実時間を標準エラーに出す。
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host.h"
+
+#define MAX_NEIGHBOURS TOCONET_NBSCAN_MAX_RESULT
+#define CH_BASE 11
+#define CH_COUNT 16
+
+typedef struct {
+	uint8 u8Ch;
+	uint32 u32Addr;
+	uint8 u8Lqi;
+} tsNeighbour;
+
+typedef struct {
+	tsHostFrame sFrame;
+	uint8 u8Lqi;
+	uint32 u32Count;
+	uint64 u64IntervalNs;
+} tsRxScript;
+
+typedef struct {
+	uint8 u8Port;
+	uint8 u8Len;
+	uint8 au8Data[256];
+} tsUartScript;
+
+static tsHostNode *psNode;
+static bool_t bAutoAck = FALSE;
+static bool_t bVerbose = FALSE;
+static int iUartPort = -1;
+static tsNeighbour asNb[MAX_NEIGHBOURS];
+static uint8 u8Nb = 0;
+static uint8 au8Energy[CH_COUNT];
+
+/****************************************************************************
+ * 媒体 (相手のいない 1 ノード用)
+ ****************************************************************************/
+
+static void vTxDone(tsHostNode *psN, uint32 u32Status, void *pvArg)
+{
+	HOST_vRadioTxDone(psN, (bool_t)u32Status);
+}
+
+static void vBenchTxStart(tsHostNode *psN, tsHostFrame *psFrame)
+{
+	// PHY/MAC ヘッダ込みで 250kbps (32us/byte)
+	uint64 u64Air = (uint64)(psFrame->u8Len + 31) * 32 * HOST_NS_PER_US;
+	bool_t bOk = !psFrame->bAckReq || bAutoAck;
+
+	if (bVerbose) {
+		uint8 i;
+		fprintf(stderr, "[%10.3f] TX ch=%d dst=%08X cmd=%d seq=%d len=%d ",
+				HOST_u64Now() / 1e6, psFrame->u8Channel, psFrame->u32DstAddr,
+				psFrame->u8Cmd, psFrame->u8Seq, psFrame->u8Len);
+		for (i = 0; i < psFrame->u8Len; i++) fprintf(stderr, "%02X", psFrame->auData[i]);
+		fprintf(stderr, "\n");
+	}
+	HOST_vSchedule(HOST_u64Now() + u64Air, psN, vTxDone, bOk, NULL);
+}
+
+static uint8 u8ChCount(uint32 u32ChMask)
+{
+	uint8 i, n = 0;
+	for (i = 0; i < 32; i++) if (u32ChMask & (1UL << i)) n++;
+	return n;
+}
+
+static void vNbScanDone(tsHostNode *psN, uint32 u32ChMask, void *pvArg)
+{
+	tsToCoNet_NbScan_Result *psR = &psN->sNbResult;
+	uint8 i;
+
+	for (i = 0; i < u8Nb && psR->u8found < TOCONET_NBSCAN_MAX_RESULT; i++) {
+		if (u32ChMask & (1UL << asNb[i].u8Ch)) {
+			tsToCoNet_NbScan_Entitiy *psE = &psR->sScanResult[psR->u8found++];
+			psE->bFound = TRUE;
+			psE->u8ch = asNb[i].u8Ch;
+			psE->u32addr = asNb[i].u32Addr;
+			psE->u8lqi = asNb[i].u8Lqi;
+		}
+	}
+	HOST_vNbScanDone(psN);
+}
+
+static void vBenchNbScan(tsHostNode *psN, uint32 u32ChMask, uint16 u16Dur)
+{
+	uint64 u64Dur = (uint64)u16Dur * u8ChCount(u32ChMask) * HOST_NS_PER_MS;
+	HOST_vSchedule(HOST_u64NodeNow(psN) + u64Dur, psN, vNbScanDone, u32ChMask, NULL);
+}
+
+static void vEnergyScanDone(tsHostNode *psN, uint32 u32ChMask, void *pvArg)
+{
+	uint8 i, n = 0;
+
+	for (i = 0; i < CH_COUNT; i++) {
+		if (u32ChMask & (1UL << (i + CH_BASE))) {
+			psN->au8EnergyResult[1 + n++] = au8Energy[i];
+		}
+	}
+	psN->au8EnergyResult[0] = n;
+	HOST_vEnergyScanDone(psN);
+}
+
+static void vBenchEnergyScan(tsHostNode *psN, uint32 u32ChMask, uint8 u8Count)
+{
+	// 1 チャネル 1 回あたり約 2ms
+	uint64 u64Dur = (uint64)u8Count * u8ChCount(u32ChMask) * 2 * HOST_NS_PER_MS;
+	HOST_vSchedule(HOST_u64NodeNow(psN) + u64Dur, psN, vEnergyScanDone, u32ChMask, NULL);
+}
+
+static const tsHostMedium sBenchMedium = {
+	vBenchTxStart,
+	vBenchNbScan,
+	vBenchEnergyScan
+};
+
+/****************************************************************************
+ * 配線
+ ****************************************************************************/
+
+static void vUartTx(tsHostNode *psN, uint8 u8Port, uint8 u8Byte)
+{
+	if (iUartPort < 0 || iUartPort == u8Port) {
+		putchar(u8Byte);
+	}
+}
+
+static const tsHostHooks sHooks = {
+	vUartTx,
+	NULL,
+	NULL
+};
+
+/****************************************************************************
+ * スクリプト
+ ****************************************************************************/
+
+static int iParseHex(const char *pc, uint8 *pu8Out, int iMax)
+{
+	int n = 0;
+
+	if (strcmp(pc, "-") == 0) return 0;
+	while (pc[0] && pc[1] && n < iMax) {
+		unsigned int u;
+		if (sscanf(pc, "%2x", &u) != 1) return -1;
+		pu8Out[n++] = (uint8)u;
+		pc += 2;
+	}
+	return n;
+}
+
+static void vScriptRx(tsHostNode *psN, uint32 u32Arg, void *pvArg)
+{
+	tsRxScript *psS = (tsRxScript *)pvArg;
+
+	psS->sFrame.u32AppId = psN->sAppContext.u32AppId;
+	psS->sFrame.u8Channel = psN->u8Channel;
+	HOST_vRadioRx(psN, &psS->sFrame, psS->u8Lqi);
+
+	if (--psS->u32Count) {
+		psS->sFrame.u8Seq++;
+		HOST_vSchedule(HOST_u64Now() + psS->u64IntervalNs, psN, vScriptRx, 0, psS);
+	} else {
+		free(psS);
+	}
+}
+
+static void vScriptUart(tsHostNode *psN, uint32 u32Arg, void *pvArg)
+{
+	tsUartScript *psS = (tsUartScript *)pvArg;
+	uint8 i;
+
+	for (i = 0; i < psS->u8Len; i++) {
+		HOST_vUartRx(psN, psS->u8Port, psS->au8Data[i]);
+	}
+	free(psS);
+}
+
+static void vLoadScript(const char *pcPath)
+{
+	FILE *fp = fopen(pcPath, "r");
+	char acLine[1024];
+	int iLine = 0;
+
+	if (fp == NULL) {
+		perror(pcPath);
+		exit(1);
+	}
+
+	while (fgets(acLine, sizeof(acLine), fp)) {
+		char acCmd[16], acHex[512];
+		unsigned int uMs, uSrc, uDst, uCmd, uSeq, uLqi, uCh, uVal, uCount, uInterval;
+		char *pc = strchr(acLine, '#');
+		int n;
+
+		iLine++;
+		if (pc) *pc = 0;
+		if (sscanf(acLine, "%15s", acCmd) != 1) continue;
+
+		if (strcmp(acCmd, "rx") == 0) {
+			tsRxScript *psS = calloc(1, sizeof(tsRxScript));
+			uCount = 1;
+			uInterval = 0;
+			n = sscanf(acLine, "%*s %u %x %x %u %u %u %511s %u %u",
+					&uMs, &uSrc, &uDst, &uCmd, &uSeq, &uLqi, acHex, &uCount, &uInterval);
+			if (n < 7 || (n = iParseHex(acHex, psS->sFrame.auData, TOCONET_MAX_PAYLOAD)) < 0) goto error;
+			psS->sFrame.u32SrcAddr = uSrc;
+			psS->sFrame.u32DstAddr = uDst;
+			psS->sFrame.u8Cmd = uCmd;
+			psS->sFrame.u8Seq = uSeq;
+			psS->sFrame.u8Len = n;
+			psS->u8Lqi = uLqi;
+			psS->u32Count = uCount ? uCount : 1;
+			psS->u64IntervalNs = (uint64)uInterval * HOST_NS_PER_US;
+			HOST_vSchedule(uMs * HOST_NS_PER_MS, psNode, vScriptRx, 0, psS);
+		} else if (strcmp(acCmd, "uart") == 0) {
+			tsUartScript *psS = calloc(1, sizeof(tsUartScript));
+			if (sscanf(acLine, "%*s %u %u %511s", &uMs, &uCh, acHex) != 3) goto error;
+			if ((n = iParseHex(acHex, psS->au8Data, sizeof(psS->au8Data))) < 0) goto error;
+			psS->u8Port = uCh;
+			psS->u8Len = n;
+			HOST_vSchedule(uMs * HOST_NS_PER_MS, psNode, vScriptUart, 0, psS);
+		} else if (strcmp(acCmd, "nb") == 0) {
+			if (sscanf(acLine, "%*s %u %x %u", &uCh, &uSrc, &uLqi) != 3 || u8Nb >= MAX_NEIGHBOURS) goto error;
+			asNb[u8Nb].u8Ch = uCh;
+			asNb[u8Nb].u32Addr = uSrc;
+			asNb[u8Nb].u8Lqi = uLqi;
+			u8Nb++;
+		} else if (strcmp(acCmd, "energy") == 0) {
+			if (sscanf(acLine, "%*s %u %u", &uCh, &uVal) != 2 || uCh < CH_BASE || uCh >= CH_BASE + CH_COUNT) goto error;
+			au8Energy[uCh - CH_BASE] = uVal;
+		} else {
+			goto error;
+		}
+	}
+	fclose(fp);
+	return;
+
+error:
+	fprintf(stderr, "%s:%d: syntax error\n", pcPath, iLine);
+	exit(1);
+}
+
+/****************************************************************************
+ * main
+ ****************************************************************************/
+
+static void vPrintStats(double dCpuSec)
+{
+	tsHostStats *psS = &psNode->sStats;
+	uint8 i;
+
+	fprintf(stderr, "virtual time   : %.3f s\n", HOST_u64Now() / 1e9);
+	fprintf(stderr, "host cpu time  : %.3f s\n", dCpuSec);
+	fprintf(stderr, "cpu events     : %u\n", psS->u32CpuEvents);
+	fprintf(stderr, "radio tx       : req=%u ok=%u fail=%u queue_full=%u\n",
+			psS->u32TxReq, psS->u32TxOk, psS->u32TxFail, psS->u32TxQueueFull);
+	fprintf(stderr, "radio rx       : %u (dropped %u)\n", psS->u32Rx, psS->u32RxDrop);
+	for (i = 0; i < HOST_UART_PORTS; i++) {
+		fprintf(stderr, "uart%d          : tx=%u tx_drop=%u rx_drop=%u\n", i,
+				psS->au32UartTxBytes[i], psS->au32UartTxDrop[i], psS->au32UartRxDrop[i]);
+	}
+	fprintf(stderr, "uart wait      : %.3f ms\n", psS->u64UartWaitNs / 1e6);
+	fprintf(stderr, "timer writes   : %u\n", psS->u32TimerWrites);
+	fprintf(stderr, "eeprom         : writes=%u erases=%u\n", psS->u32EepWrites, psS->u32EepErases);
+}
+
+int main(int argc, char *argv[])
+{
+	static const tsHostApp sApp = {
+		cbAppColdStart,
+		cbAppWarmStart,
+		cbToCoNet_vMain,
+		cbToCoNet_vRxEvent,
+		cbToCoNet_vTxEvent,
+		cbToCoNet_vNwkEvent,
+		cbToCoNet_vHwEvent,
+		cbToCoNet_u8HwInt
+	};
+	uint32 u32Ms = 10000;
+	uint32 u32Serial = 0x81000001;
+	clock_t c0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:x:au:v")) != -1) {
+		switch (opt) {
+		case 't': u32Ms = strtoul(optarg, NULL, 0); break;
+		case 'x': u32Serial = strtoul(optarg, NULL, 16); break;
+		case 'a': bAutoAck = TRUE; break;
+		case 'u': iUartPort = atoi(optarg); break;
+		case 'v': bVerbose = TRUE; break;
+		default:
+			fprintf(stderr, "usage: %s [-t ms] [-x serial] [-a] [-u port] [-v] [script]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	HOST_vReset(u32Serial);
+	HOST_vSetMedium(&sBenchMedium);
+	psNode = HOST_psNodeCreate(&sApp, u32Serial);
+	psNode->psHooks = &sHooks;
+	HOST_vNodePowerOn(psNode, 0);
+
+	if (optind < argc) {
+		vLoadScript(argv[optind]);
+	}
+
+	c0 = clock();
+	HOST_vRunUntil(u32Ms * HOST_NS_PER_MS);
+	fflush(stdout);
+	vPrintStats((double)(clock() - c0) / CLOCKS_PER_SEC);
+	return 0;
+}
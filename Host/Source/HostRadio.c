@@ -0,0 +1,301 @@
+/*
+ * HostRadio.c
+ *
+ * ToCoNet の MAC 送受信とスキャン API。
+ *
+ * 送信要求はノードごとの送信キュー (HOST_TX_QUEUE 段) に積まれ、先頭から
+ * 一つずつ媒体 (tsHostMedium) へ渡される。CSMA・ACK・再送・衝突の扱いは
+ * 媒体の実装に任せ、完了時に cbToCoNet_vTxEvent を呼ぶ。
+ *
+ */
+
+#include <string.h>
+
+#include "host.h"
+
+static const tsHostMedium *psHostMedium = NULL;
+
+PUBLIC void HOST_vSetMedium(const tsHostMedium *psMedium)
+{
+	psHostMedium = psMedium;
+}
+
+static uint32 u32NodeTick(tsHostNode *psNode, uint64 u64At)
+{
+	uint32 u32ms = (uint32)((u64At - psNode->u64BootNs) / HOST_NS_PER_MS);
+	return u32ms - (u32ms % HOST_TICK_MS);
+}
+
+/****************************************************************************
+ * 送信
+ ****************************************************************************/
+
+static void vTxKick(tsHostNode *psNode, uint32 u32Epoch, void *pvArg)
+{
+	if (u32Epoch != psNode->u32Epoch || psNode->bTxActive || psNode->u8TxCount == 0) {
+		return;
+	}
+
+	psNode->bTxActive = TRUE;
+	if (psHostMedium && psHostMedium->pfvTxStart) {
+		psHostMedium->pfvTxStart(psNode, &psNode->asTxQueue[psNode->u8TxHead]);
+	} else {
+		HOST_vRadioTxDone(psNode, FALSE);
+	}
+}
+
+static void vTxEvent(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	if (psNode->sApp.pfvTxEvent) {
+		psNode->sApp.pfvTxEvent((uint8)(u32Arg >> 8), (uint8)u32Arg);
+	}
+}
+
+PUBLIC void HOST_vRadioTxDone(tsHostNode *psNode, bool_t bStatus)
+{
+	tsHostFrame *psFrame;
+
+	if (!psNode->bTxActive || psNode->u8TxCount == 0) {
+		return;
+	}
+
+	psFrame = &psNode->asTxQueue[psNode->u8TxHead];
+	if (bStatus) {
+		psNode->sStats.u32TxOk++;
+	} else {
+		psNode->sStats.u32TxFail++;
+	}
+	HOST_vScheduleCpu(HOST_u64Now(), psNode, vTxEvent, ((uint32)psFrame->u8CbId << 8) | (bStatus ? 1 : 0), NULL);
+
+	psNode->u8TxHead = (psNode->u8TxHead + 1) % HOST_TX_QUEUE;
+	psNode->u8TxCount--;
+	psNode->bTxActive = FALSE;
+	if (psNode->u8TxCount) {
+		HOST_vSchedule(HOST_u64Now(), psNode, vTxKick, psNode->u32Epoch, NULL);
+	}
+}
+
+PUBLIC bool_t ToCoNet_bMacTxReq(tsTxDataApp *psTx)
+{
+	tsHostNode *psNode = psHost_Cur;
+	tsHostFrame *psFrame;
+	uint64 u64Delay = 0;
+
+	psNode->sStats.u32TxReq++;
+
+	if (!psNode->bMacStarted || psTx->u8Len > TOCONET_MAX_PAYLOAD
+			|| psTx->u8Cmd > TOCONET_PACKET_CMD_APP_USER_MAX) {
+		return FALSE;
+	}
+	if (psNode->u8TxCount >= HOST_TX_QUEUE) {
+		psNode->sStats.u32TxQueueFull++;
+		return FALSE;
+	}
+
+	psFrame = &psNode->asTxQueue[(psNode->u8TxHead + psNode->u8TxCount) % HOST_TX_QUEUE];
+	memset(psFrame, 0, sizeof(tsHostFrame));
+	psFrame->u32AppId = psNode->sAppContext.u32AppId;
+	psFrame->u8Channel = psNode->u8Channel;
+	psFrame->u32SrcAddr = psTx->u32SrcAddr;
+	psFrame->u32DstAddr = psTx->u32DstAddr;
+	psFrame->bAckReq = psTx->bAckReq;
+	psFrame->u8Retry = psTx->u8Retry;
+	psFrame->u16RetryDur = psTx->u16RetryDur;
+	psFrame->u8CbId = psTx->u8CbId;
+	psFrame->u8Seq = psTx->u8Seq;
+	psFrame->u8Cmd = psTx->u8Cmd;
+	psFrame->u8Len = psTx->u8Len;
+	memcpy(psFrame->auData, psTx->auData, psTx->u8Len);
+	psNode->u8TxCount++;
+
+	// 送信開始遅延 (u16DelayMin..u16DelayMax [ms])
+	if (psTx->u16DelayMax > psTx->u16DelayMin) {
+		u64Delay = psTx->u16DelayMin + ToCoNet_u32GetRand() % (psTx->u16DelayMax - psTx->u16DelayMin + 1);
+	} else {
+		u64Delay = psTx->u16DelayMin;
+	}
+	if (!psNode->bTxActive) {
+		HOST_vSchedule(psNode->u64Now + u64Delay * HOST_NS_PER_MS, psNode, vTxKick, psNode->u32Epoch, NULL);
+	}
+	return TRUE;
+}
+
+/****************************************************************************
+ * 受信
+ ****************************************************************************/
+
+PUBLIC bool_t HOST_bRadioAccept(tsHostNode *psNode, const tsHostFrame *psFrame)
+{
+	uint16 u16Short = psNode->sAppContext.u16ShortAddress;
+
+	if (!psNode->bPowered || psNode->bSleeping || !psNode->bMacStarted
+			|| psNode->bScanning || !psNode->sAppContext.bRxOnIdle) {
+		return FALSE;
+	}
+	if (psFrame->u8Channel != psNode->u8Channel || psFrame->u32AppId != psNode->sAppContext.u32AppId) {
+		return FALSE;
+	}
+	if (psFrame->u32SrcAddr == psNode->u32Serial) {
+		return FALSE;
+	}
+
+	return psFrame->u32DstAddr == TOCONET_MAC_ADDR_BROADCAST
+		|| psFrame->u32DstAddr == psNode->u32Serial
+		|| (u16Short < HOST_SHORT_ADDR_NONE && psFrame->u32DstAddr == u16Short);
+}
+
+static void vRxEvent(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	tsHostRxEntry *psE;
+	tsRxDataApp sRx;
+	uint8 au8Data[TOCONET_MAX_PAYLOAD];
+
+	if (psNode->u8RxCount == 0) {
+		return;
+	}
+	psE = &psNode->asRxQueue[psNode->u8RxHead];
+	psNode->u8RxHead = (psNode->u8RxHead + 1) % HOST_RX_QUEUE;
+	psNode->u8RxCount--;
+
+	memcpy(au8Data, psE->sFrame.auData, psE->sFrame.u8Len);
+	memset(&sRx, 0, sizeof(sRx));
+	sRx.u32SrcAddr = psE->sFrame.u32SrcAddr;
+	sRx.u32DstAddr = psE->sFrame.u32DstAddr;
+	sRx.u8Cmd = psE->sFrame.u8Cmd;
+	sRx.u8Seq = psE->sFrame.u8Seq;
+	sRx.u8Len = psE->sFrame.u8Len;
+	sRx.u8Lqi = psE->u8Lqi;
+	sRx.u32Tick = psE->u32Tick;
+	sRx.auData = au8Data;
+
+	if (psNode->sApp.pfvRxEvent) {
+		psNode->sApp.pfvRxEvent(&sRx);
+	}
+}
+
+PUBLIC void HOST_vRadioRx(tsHostNode *psNode, const tsHostFrame *psFrame, uint8 u8Lqi)
+{
+	tsHostRxEntry *psE;
+
+	if (!HOST_bRadioAccept(psNode, psFrame)) {
+		return;
+	}
+
+	psNode->sStats.u32Rx++;
+	if (psNode->u8RxCount >= HOST_RX_QUEUE) {
+		psNode->sStats.u32RxDrop++;
+		return;
+	}
+
+	psE = &psNode->asRxQueue[(psNode->u8RxHead + psNode->u8RxCount) % HOST_RX_QUEUE];
+	psE->sFrame = *psFrame;
+	psE->u8Lqi = u8Lqi;
+	psE->u32Tick = u32NodeTick(psNode, HOST_u64Now());
+	psNode->u8RxCount++;
+	HOST_vScheduleCpu(HOST_u64Now(), psNode, vRxEvent, 0, NULL);
+}
+
+/****************************************************************************
+ * MAC 制御
+ ****************************************************************************/
+
+PUBLIC void ToCoNet_vRegModules(uint32 u32Mods)
+{
+	psHost_Cur->u32Mods = u32Mods;
+}
+
+PUBLIC void ToCoNet_vMacStart(void)
+{
+	tsHostNode *psNode = psHost_Cur;
+
+	psNode->bMacStarted = TRUE;
+	psNode->u8Channel = psNode->sAppContext.u8Channel;
+}
+
+PUBLIC void ToCoNet_vRfConfig(void)
+{
+	psHost_Cur->u8Channel = psHost_Cur->sAppContext.u8Channel;
+}
+
+PUBLIC uint32 ToCoNet_u32GetSerial(void)
+{
+	return psHost_Cur->u32Serial;
+}
+
+/****************************************************************************
+ * スキャン
+ ****************************************************************************/
+
+PUBLIC bool_t ToCoNet_NbScan_bStart(uint32 u32ChMask, uint16 u16Dur)
+{
+	tsHostNode *psNode = psHost_Cur;
+
+	if (!(psNode->u32Mods & TOCONET_MOD_NBSCAN) || psNode->bScanning
+			|| psHostMedium == NULL || psHostMedium->pfvNbScan == NULL) {
+		return FALSE;
+	}
+
+	psNode->bScanning = TRUE;
+	memset(&psNode->sNbResult, 0, sizeof(psNode->sNbResult));
+	psHostMedium->pfvNbScan(psNode, u32ChMask, u16Dur);
+	return TRUE;
+}
+
+static void vNwkEvent(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	if (psNode->sApp.pfvNwkEvent) {
+		psNode->sApp.pfvNwkEvent(u32Arg, HOST_u32Ptr(pvArg));
+	}
+}
+
+PUBLIC void HOST_vNbScanDone(tsHostNode *psNode)
+{
+	tsToCoNet_NbScan_Result *psR = &psNode->sNbResult;
+	uint8 i, j;
+
+	if (!psNode->bScanning) {
+		return;
+	}
+	psNode->bScanning = FALSE;
+	psNode->u8Channel = psNode->sAppContext.u8Channel;
+
+	// LQI の降順に並べた添字を作る
+	psR->u8scanMode = TOCONET_NBSCAN_NORMAL_MASK;
+	for (i = 0; i < psR->u8found; i++) {
+		psR->u8IdxLqiSort[i] = i;
+	}
+	for (i = 1; i < psR->u8found; i++) {
+		uint8 u8Idx = psR->u8IdxLqiSort[i];
+		for (j = i; j > 0 && psR->sScanResult[psR->u8IdxLqiSort[j - 1]].u8lqi < psR->sScanResult[u8Idx].u8lqi; j--) {
+			psR->u8IdxLqiSort[j] = psR->u8IdxLqiSort[j - 1];
+		}
+		psR->u8IdxLqiSort[j] = u8Idx;
+	}
+
+	HOST_vScheduleCpu(HOST_u64Now(), psNode, vNwkEvent, E_EVENT_TOCONET_NWK_SCAN_COMPLETE, psR);
+}
+
+PUBLIC bool_t ToCoNet_EnergyScan_bStart(uint32 u32ChMask, uint8 u8Count)
+{
+	tsHostNode *psNode = psHost_Cur;
+
+	if (!(psNode->u32Mods & TOCONET_MOD_ENERGYSCAN) || psNode->bScanning
+			|| psHostMedium == NULL || psHostMedium->pfvEnergyScan == NULL) {
+		return FALSE;
+	}
+
+	psNode->bScanning = TRUE;
+	memset(psNode->au8EnergyResult, 0, sizeof(psNode->au8EnergyResult));
+	psHostMedium->pfvEnergyScan(psNode, u32ChMask, u8Count);
+	return TRUE;
+}
+
+PUBLIC void HOST_vEnergyScanDone(tsHostNode *psNode)
+{
+	if (!psNode->bScanning) {
+		return;
+	}
+	psNode->bScanning = FALSE;
+	psNode->u8Channel = psNode->sAppContext.u8Channel;
+	HOST_vScheduleCpu(HOST_u64Now(), psNode, vNwkEvent, E_EVENT_TOCONET_ENERGY_SCAN_COMPLETE, psNode->au8EnergyResult);
+}
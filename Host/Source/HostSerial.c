@@ -0,0 +1,235 @@
+/*
+ * HostSerial.c
+ *
+ * UART モデルと fprintf/sprintf。
+ *
+ * 送信: SERIAL_bTxChar で積んだバイトは、ボーレート (8N1, 10bit/byte) に
+ * 従って仮想時間上で 1 バイトずつ送出され、送出完了時刻に
+ * tsHostHooks.pfvUartTx へ渡される。キューが満杯なら捨てて FALSE を返す。
+ * WAIT_UART_OUTPUT (SERIAL_vFlush) はノードを送出完了までビジーにする。
+ *
+ * 受信: HOST_vUartRx で積まれたバイトは受信キューに入り、vMain が呼ばれる。
+ * ノードがビジーの間に届いたバイトは、ビジー明けの 1 回の vMain にまとめられる。
+ *
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "host.h"
+#include "sprintf.h"
+
+static tsHostUart *psUart(tsHostNode *psNode, uint8 u8Port)
+{
+	if (psNode == NULL || u8Port >= HOST_UART_PORTS || !psNode->asUart[u8Port].bInit) {
+		return NULL;
+	}
+	return &psNode->asUart[u8Port];
+}
+
+// 送信キューに残っているバイト数
+static uint16 u16TxPending(tsHostUart *psU, uint64 u64Now)
+{
+	if (psU->u64WireFree <= u64Now) {
+		return 0;
+	}
+	return (uint16)((psU->u64WireFree - u64Now + psU->u64ByteNs - 1) / psU->u64ByteNs);
+}
+
+PUBLIC void HOST_vUartReset(tsHostNode *psNode)
+{
+	memset(psNode->asUart, 0, sizeof(psNode->asUart));
+}
+
+PUBLIC void SERIAL_vInit(tsSerialPortSetup *psSetup)
+{
+	tsHostNode *psNode = psHost_Cur;
+	tsHostUart *psU;
+
+	if (psSetup->u8SerialPort >= HOST_UART_PORTS) {
+		return;
+	}
+
+	psU = &psNode->asUart[psSetup->u8SerialPort];
+	memset(psU, 0, sizeof(tsHostUart));
+	psU->bInit = TRUE;
+	psU->pu8RxBuf = psSetup->pu8SerialRxQueueBuffer;
+	psU->u16RxSize = psSetup->u16SerialRxQueueSize;
+	psU->u16TxSize = psSetup->u16SerialTxQueueSize;
+	psU->u64ByteNs = 10 * HOST_NS_PER_S / (psSetup->u32BaudRate ? psSetup->u32BaudRate : 115200);
+	psU->u64WireFree = psNode->u64Now;
+}
+
+static void vTxDone(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	uint8 u8Port = (uint8)(u32Arg >> 8);
+	uint8 u8Byte = (uint8)u32Arg;
+
+	if (psNode->psHooks && psNode->psHooks->pfvUartTx) {
+		psNode->psHooks->pfvUartTx(psNode, u8Port, u8Byte);
+	}
+}
+
+PUBLIC bool_t SERIAL_bTxChar(uint8 u8SerialPort, uint8 u8Char)
+{
+	tsHostNode *psNode = psHost_Cur;
+	tsHostUart *psU = psUart(psNode, u8SerialPort);
+
+	if (psU == NULL) {
+		return FALSE;
+	}
+
+	if (u16TxPending(psU, psNode->u64Now) >= psU->u16TxSize) {
+		psNode->sStats.au32UartTxDrop[u8SerialPort]++;
+		return FALSE;
+	}
+
+	if (psU->u64WireFree < psNode->u64Now) {
+		psU->u64WireFree = psNode->u64Now;
+	}
+	psU->u64WireFree += psU->u64ByteNs;
+	psNode->sStats.au32UartTxBytes[u8SerialPort]++;
+	HOST_vSchedule(psU->u64WireFree, psNode, vTxDone, ((uint32)u8SerialPort << 8) | u8Char, NULL);
+	return TRUE;
+}
+
+PUBLIC uint16 SERIAL_u16TxQueueCount(uint8 u8SerialPort)
+{
+	tsHostNode *psNode = psHost_Cur;
+	tsHostUart *psU = psUart(psNode, u8SerialPort);
+
+	return psU ? u16TxPending(psU, psNode->u64Now) : 0;
+}
+
+PUBLIC void SERIAL_vFlush(uint8 u8SerialPort)
+{
+	tsHostNode *psNode = psHost_Cur;
+	tsHostUart *psU = psUart(psNode, u8SerialPort);
+
+	if (psU && psU->u64WireFree > psNode->u64Now) {
+		psNode->sStats.u64UartWaitNs += psU->u64WireFree - psNode->u64Now;
+		psNode->u64Now = psU->u64WireFree;
+	}
+}
+
+PUBLIC bool_t SERIAL_bRxQueueEmpty(uint8 u8SerialPort)
+{
+	tsHostUart *psU = psUart(psHost_Cur, u8SerialPort);
+
+	return psU == NULL || psU->u16RxCount == 0;
+}
+
+PUBLIC uint16 SERIAL_u16RxQueueCount(uint8 u8SerialPort)
+{
+	tsHostUart *psU = psUart(psHost_Cur, u8SerialPort);
+
+	return psU ? psU->u16RxCount : 0;
+}
+
+PUBLIC int16 SERIAL_i16RxChar(uint8 u8SerialPort)
+{
+	tsHostUart *psU = psUart(psHost_Cur, u8SerialPort);
+	uint8 u8Char;
+
+	if (psU == NULL || psU->u16RxCount == 0) {
+		return -1;
+	}
+	u8Char = psU->pu8RxBuf[psU->u16RxHead];
+	psU->u16RxHead = (psU->u16RxHead + 1) % psU->u16RxSize;
+	psU->u16RxCount--;
+	return u8Char;
+}
+
+static void vUartWake(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	// vMain は vLeave から呼ばれる
+	psNode->bUartWake = FALSE;
+}
+
+PUBLIC void HOST_vUartRx(tsHostNode *psNode, uint8 u8Port, uint8 u8Byte)
+{
+	tsHostUart *psU;
+
+	if (!psNode->bPowered || psNode->bSleeping) {
+		return;
+	}
+	psU = psUart(psNode, u8Port);
+	if (psU == NULL) {
+		return;
+	}
+
+	if (psU->u16RxCount >= psU->u16RxSize) {
+		psNode->sStats.au32UartRxDrop[u8Port]++;
+	} else {
+		psU->pu8RxBuf[(psU->u16RxHead + psU->u16RxCount) % psU->u16RxSize] = u8Byte;
+		psU->u16RxCount++;
+	}
+
+	if (!psNode->bUartWake) {
+		psNode->bUartWake = TRUE;
+		HOST_vScheduleCpu(HOST_u64Now(), psNode, vUartWake, 0, NULL);
+	}
+}
+
+/****************************************************************************
+ * fprintf / sprintf
+ ****************************************************************************/
+
+PUBLIC void vPutChar(tsFILE *psStream, uint8 u8Char)
+{
+	psStream->bPutChar(psStream->u8Device, u8Char);
+}
+
+PUBLIC void vfPrintf(tsFILE *psStream, const char *pcFormat, ...)
+{
+	char acBuf[512];
+	va_list ap;
+	int i, n;
+
+	va_start(ap, pcFormat);
+	n = vsnprintf(acBuf, sizeof(acBuf), pcFormat, ap);
+	va_end(ap);
+
+	if (n > (int)sizeof(acBuf) - 1) n = sizeof(acBuf) - 1;
+	for (i = 0; i < n; i++) {
+		psStream->bPutChar(psStream->u8Device, (uint8)acBuf[i]);
+	}
+}
+
+static uint8 au8SprintfBuf[128];
+static uint16 u16SprintfLen;
+
+static bool_t bSprintfPutChar(uint8 u8Device, uint8 u8Char)
+{
+	if (u16SprintfLen >= sizeof(au8SprintfBuf) - 1) {
+		return FALSE;
+	}
+	au8SprintfBuf[u16SprintfLen++] = u8Char;
+	au8SprintfBuf[u16SprintfLen] = 0;
+	return TRUE;
+}
+
+static tsFILE sSprintfStream = { 0, bSprintfPutChar };
+tsFILE *SPRINTF_Stream = &sSprintfStream;
+
+PUBLIC void SPRINTF_vInit128(void)
+{
+	SPRINTF_vRewind();
+}
+
+PUBLIC void SPRINTF_vRewind(void)
+{
+	u16SprintfLen = 0;
+	au8SprintfBuf[0] = 0;
+}
+
+PUBLIC uint8 *SPRINTF_pu8GetBuff(void)
+{
+	return au8SprintfBuf;
+}
+
+PUBLIC uint16 SPRINTF_u16Length(void)
+{
+	return u16SprintfLen;
+}
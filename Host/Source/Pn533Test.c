@@ -0,0 +1,301 @@
+/*
+ * Pn533Test.c
+ *
+ * Slave の PN533 フレームパーサ (Slave/Source/Pn533Parser.c) の単体試験と
+ * ランダム入力による試験。組み立て済みのコマンド (Pn533Cmd.h) も確かめる。
+ *
+ *   usage: Pn533Test [-n rounds] [-S seed]
+ *
+ * 失敗があれば内容を表示して 1 を返す (make test で実行する)。
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Pn533Parser.h"
+#include "Pn533Cmd.h"
+
+#define STREAM_MAX 4096
+
+static uint32 u32Fail = 0;
+static uint32 u32Rand = 1;
+
+#define CHECK(c) do { if (!(c)) { u32Fail++; \
+	fprintf(stderr, "%s:%d: NG: %s\n", __FILE__, __LINE__, #c); } } while (0)
+
+static uint32 u32Next(void)
+{
+	// xorshift32
+	u32Rand ^= u32Rand << 13;
+	u32Rand ^= u32Rand >> 17;
+	u32Rand ^= u32Rand << 5;
+	return u32Rand;
+}
+
+// データ部 (TFI から) をフレームにする。bExt なら拡張フレーム
+static uint16 u16Frame(uint8 *pu8Out, const uint8 *pu8Data, uint16 u16Len, bool_t bExt)
+{
+	uint16 n = 0, i;
+	uint8 u8Sum = 0;
+
+	pu8Out[n++] = 0x00;
+	pu8Out[n++] = 0x00;
+	pu8Out[n++] = 0xFF;
+	if (bExt) {
+		pu8Out[n++] = 0xFF;
+		pu8Out[n++] = 0xFF;
+		pu8Out[n++] = u16Len >> 8;
+		pu8Out[n++] = u16Len;
+		pu8Out[n++] = (uint8)-((u16Len >> 8) + u16Len);
+	} else {
+		pu8Out[n++] = u16Len;
+		pu8Out[n++] = (uint8)-u16Len;
+	}
+	for (i = 0; i < u16Len; i++) {
+		pu8Out[n++] = pu8Data[i];
+		u8Sum += pu8Data[i];
+	}
+	pu8Out[n++] = (uint8)-u8Sum;
+	pu8Out[n++] = 0x00;
+	return n;
+}
+
+// 結果の列を返す (FRAME のときは最後のデータを pu8Last に写す)
+static uint16 u16Feed(tsPn533Parser *psP, const uint8 *pu8, uint16 u16Len,
+		tePn533Result *peRes, uint16 u16ResMax, uint8 *pu8Last, uint16 *pu16LastLen)
+{
+	uint16 i, n = 0;
+
+	for (i = 0; i < u16Len; i++) {
+		tePn533Result e = Pn533_eParse(psP, pu8[i]);
+		if (e == E_PN533_NONE) continue;
+		if (n < u16ResMax) peRes[n] = e;
+		n++;
+		if (e == E_PN533_FRAME && pu8Last) {
+			CHECK(Pn533_u16Len(psP) <= PN533_DATA_MAX);
+			memcpy(pu8Last, Pn533_pu8Data(psP), Pn533_u16Len(psP));
+			*pu16LastLen = Pn533_u16Len(psP);
+		}
+	}
+	return n;
+}
+
+static void vTestBasic(void)
+{
+	static const uint8 au8Ack[] = { 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00 };
+	static const uint8 au8Nack[] = { 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00 };
+	static const uint8 au8Err[] = { 0x00, 0x00, 0xFF, 0x01, 0xFF, 0x7F, 0x81, 0x00 };
+	static const uint8 au8Poll[] = { 0xD5, 0x4B, 0x01, 0x01, 0x12, 0x01,
+			1, 2, 3, 4, 5, 6, 7, 8, 0x01, 0x20, 0x22, 0x04, 0x27, 0x67, 0x4E, 0xFF };
+	tsPn533Parser sP;
+	tePn533Result ae[8];
+	uint8 au8S[STREAM_MAX], au8Got[PN533_DATA_MAX], au8Big[300];
+	uint16 n, u16Got = 0, i;
+
+	Pn533_vInit(&sP);
+	CHECK(u16Feed(&sP, au8Ack, sizeof(au8Ack), ae, 8, NULL, NULL) == 1 && ae[0] == E_PN533_ACK);
+	CHECK(u16Feed(&sP, au8Nack, sizeof(au8Nack), ae, 8, NULL, NULL) == 1 && ae[0] == E_PN533_NACK);
+	CHECK(u16Feed(&sP, au8Err, sizeof(au8Err), ae, 8, NULL, NULL) == 1 && ae[0] == E_PN533_ERROR);
+	CHECK(sP.sStats.u32Errors == 1);
+
+	// ACK と応答が続けて届く
+	n = 0;
+	memcpy(au8S, au8Ack, sizeof(au8Ack));
+	n = sizeof(au8Ack);
+	n += u16Frame(au8S + n, au8Poll, sizeof(au8Poll), FALSE);
+	CHECK(u16Feed(&sP, au8S, n, ae, 8, au8Got, &u16Got) == 2 && ae[0] == E_PN533_ACK && ae[1] == E_PN533_FRAME);
+	CHECK(u16Got == sizeof(au8Poll) && memcmp(au8Got, au8Poll, sizeof(au8Poll)) == 0);
+
+	// 余分な 00 の後、ポストアンブルなし
+	n = u16Frame(au8S + 1, au8Poll, sizeof(au8Poll), FALSE);
+	au8S[0] = 0x00;
+	CHECK(u16Feed(&sP, au8S, n + 1, ae, 8, au8Got, &u16Got) == 1 && ae[0] == E_PN533_FRAME);
+	n = u16Frame(au8S, au8Poll, sizeof(au8Poll), FALSE);
+	CHECK(u16Feed(&sP, au8S, n - 1, ae, 8, au8Got, &u16Got) == 1 && ae[0] == E_PN533_FRAME);
+	CHECK(u16Feed(&sP, au8S, n, ae, 8, au8Got, &u16Got) == 1 && ae[0] == E_PN533_FRAME);
+
+	// ポストアンブルの 00 の後の FF はスタートコードとみなさない
+	au8S[0] = 0xFF;
+	au8S[1] = 0x02;
+	au8S[2] = 0xFE;
+	n = u16Frame(au8S + 3, au8Poll, sizeof(au8Poll), FALSE) + 3;
+	CHECK(u16Feed(&sP, au8S, n, ae, 8, au8Got, &u16Got) == 1 && ae[0] == E_PN533_FRAME);
+
+	// 前にゴミ
+	au8S[0] = 0x12;
+	au8S[1] = 0xFF;
+	au8S[2] = 0x00;
+	au8S[3] = 0x34;
+	n = u16Frame(au8S + 4, au8Poll, sizeof(au8Poll), FALSE) + 4;
+	i = sP.sStats.u32Resyncs;
+	CHECK(u16Feed(&sP, au8S, n, ae, 8, au8Got, &u16Got) == 1 && ae[0] == E_PN533_FRAME);
+	CHECK(sP.sStats.u32Resyncs == i + 3u);
+
+	// LCS・DCS の誤り
+	n = u16Frame(au8S, au8Poll, sizeof(au8Poll), FALSE);
+	au8S[4] ^= 1;
+	i = sP.sStats.u32Checksum;
+	CHECK(u16Feed(&sP, au8S, n, ae, 8, NULL, NULL) == 0);
+	CHECK(sP.sStats.u32Checksum == i + 1u);
+	n = u16Frame(au8S, au8Poll, sizeof(au8Poll), FALSE);
+	au8S[10] ^= 0x40;
+	CHECK(u16Feed(&sP, au8S, n, ae, 8, NULL, NULL) == 0);
+	CHECK(sP.sStats.u32Checksum == i + 2u);
+
+	// 拡張フレーム
+	for (i = 0; i < sizeof(au8Big); i++) au8Big[i] = i * 7;
+	au8Big[0] = 0xD5;
+	n = u16Frame(au8S, au8Big, PN533_DATA_MAX, TRUE);
+	CHECK(u16Feed(&sP, au8S, n, ae, 8, au8Got, &u16Got) == 1 && ae[0] == E_PN533_FRAME);
+	CHECK(u16Got == PN533_DATA_MAX && memcmp(au8Got, au8Big, PN533_DATA_MAX) == 0);
+	n = u16Frame(au8S, au8Big, 10, TRUE);
+	CHECK(u16Feed(&sP, au8S, n, ae, 8, au8Got, &u16Got) == 1 && ae[0] == E_PN533_FRAME && u16Got == 10);
+
+	// 長すぎるフレームは捨て、次のフレームは読める
+	i = sP.sStats.u32Overflows;
+	n = u16Frame(au8S, au8Big, sizeof(au8Big), TRUE);
+	n += u16Frame(au8S + n, au8Poll, sizeof(au8Poll), FALSE);
+	CHECK(u16Feed(&sP, au8S, n, ae, 8, au8Got, &u16Got) == 1 && ae[0] == E_PN533_FRAME);
+	CHECK(sP.sStats.u32Overflows == i + 1u && u16Got == sizeof(au8Poll));
+
+	// 途中で捨てる
+	n = u16Frame(au8S, au8Poll, sizeof(au8Poll), FALSE);
+	u16Feed(&sP, au8S, 12, ae, 8, NULL, NULL);
+	Pn533_vReset(&sP);
+	CHECK(u16Feed(&sP, au8S, n, ae, 8, NULL, NULL) == 1 && ae[0] == E_PN533_FRAME);
+}
+
+// 組み立て済みのコマンドがパーサで正しいフレームとして読める
+static void vTestCommands(void)
+{
+	static const struct {
+		const uint8 *pu8;
+		uint16 u16Len;
+	} asCmd[] = {
+		{ au8Pn533Init, sizeof(au8Pn533Init) },
+		{ au8Pn533Timeout, sizeof(au8Pn533Timeout) },
+		{ au8Pn533Retry, sizeof(au8Pn533Retry) },
+		{ au8Pn533Config, sizeof(au8Pn533Config) },
+		{ au8Pn533Poll, sizeof(au8Pn533Poll) },
+		{ au8Pn533RfOff, sizeof(au8Pn533RfOff) },
+	};
+	static const uint8 au8Retry[] = PN533_CMD6(0xD4, 0x32, 0x05, 0x00, 0x00, 0x08);
+	tsPn533Parser sP;
+	tePn533Result ae[4];
+	uint8 au8Got[PN533_DATA_MAX];
+	uint16 u16Got, i;
+
+	Pn533_vInit(&sP);
+	CHECK(u16Feed(&sP, au8Pn533Ack, sizeof(au8Pn533Ack), ae, 4, NULL, NULL) == 1 && ae[0] == E_PN533_ACK);
+	for (i = 0; i < sizeof(asCmd) / sizeof(asCmd[0]); i++) {
+		u16Got = 0;
+		CHECK(u16Feed(&sP, asCmd[i].pu8, asCmd[i].u16Len, ae, 4, au8Got, &u16Got) == 1 && ae[0] == E_PN533_FRAME);
+		CHECK(u16Got == asCmd[i].u16Len - 7 && au8Got[0] == 0xD4);
+	}
+	CHECK(u16Feed(&sP, au8Retry, sizeof(au8Retry), ae, 4, au8Got, &u16Got) == 1 && ae[0] == E_PN533_FRAME);
+	CHECK(au8Got[5] == 0x08);
+	CHECK(sP.sStats.u32Checksum == 0 && sP.sStats.u32Resyncs == 0);
+}
+
+// 00 を含まないゴミを挟んだフレーム列は全て取り出せる
+static void vFuzzJunk(uint32 u32Rounds)
+{
+	static uint8 au8S[STREAM_MAX];
+	static uint8 au8Data[PN533_DATA_MAX];
+	uint8 au8Got[PN533_DATA_MAX];
+	uint16 u16Got;
+	tePn533Result ae[4];
+	tsPn533Parser sP;
+	uint32 r;
+
+	Pn533_vInit(&sP);
+	for (r = 0; r < u32Rounds; r++) {
+		uint16 u16Len = 1 + u32Next() % PN533_DATA_MAX;
+		bool_t bExt = u16Len > 255 || (u32Next() & 1);
+		uint16 n = 0, i, u16Junk = u32Next() % 16;
+
+		for (i = 0; i < u16Junk; i++) au8S[n++] = 1 + u32Next() % 255;
+		for (i = 0; i < u16Len; i++) au8Data[i] = u32Next();
+		if (u16Len == 1 && au8Data[0] == 0x7F) au8Data[0] = 0xD5;
+		n += u16Frame(au8S + n, au8Data, u16Len, bExt);
+
+		u16Got = 0;
+		if (u16Feed(&sP, au8S, n, ae, 4, au8Got, &u16Got) != 1 || ae[0] != E_PN533_FRAME
+				|| u16Got != u16Len || memcmp(au8Got, au8Data, u16Len) != 0) {
+			u32Fail++;
+			fprintf(stderr, "junk: round %u len %u ext %d: NG\n", r, u16Len, bExt);
+			return;
+		}
+	}
+}
+
+// ランダムに壊した入力でも範囲外に書かず、0x01 を 300 バイト流せば同期が戻る
+static void vFuzzCorrupt(uint32 u32Rounds)
+{
+	static uint8 au8S[STREAM_MAX];
+	static const uint8 au8Poll[] = { 0xD5, 0x4B, 0x00 };
+	uint8 au8Got[PN533_DATA_MAX], au8Data[64];
+	uint16 u16Got;
+	tePn533Result ae[64];
+	tsPn533Parser sP;
+	uint32 r;
+
+	Pn533_vInit(&sP);
+	for (r = 0; r < u32Rounds; r++) {
+		uint16 n = 0, i, u16Len;
+
+		// フレームとゴミを混ぜ、ビットを反転させる
+		while (n < 1024) {
+			if (u32Next() & 1) {
+				u16Len = 1 + u32Next() % sizeof(au8Data);
+				for (i = 0; i < u16Len; i++) au8Data[i] = u32Next();
+				n += u16Frame(au8S + n, au8Data, u16Len, (u32Next() & 3) == 0);
+			} else {
+				au8S[n++] = (u32Next() & 1) ? 0x00 : (uint8)u32Next();
+			}
+		}
+		for (i = u32Next() % 8; i > 0; i--) {
+			au8S[u32Next() % n] ^= 1 << (u32Next() % 8);
+		}
+		u16Feed(&sP, au8S, n, ae, 64, au8Got, &u16Got);
+		CHECK(sP.u16Pos <= PN533_DATA_MAX);
+
+		memset(au8S, 0x01, 300);
+		n = 300 + u16Frame(au8S + 300, au8Poll, sizeof(au8Poll), FALSE);
+		u16Got = 0;
+		if (u16Feed(&sP, au8S, n, ae, 64, au8Got, &u16Got) < 1 || ae[0] != E_PN533_FRAME
+				|| u16Got != sizeof(au8Poll)) {
+			u32Fail++;
+			fprintf(stderr, "corrupt: round %u: not resynchronized\n", r);
+			return;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	uint32 u32Rounds = 20000;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:S:")) != -1) {
+		switch (opt) {
+		case 'n': u32Rounds = strtoul(optarg, NULL, 0); break;
+		case 'S': u32Rand = strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-n rounds] [-S seed]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (u32Rand == 0) u32Rand = 1;
+
+	vTestBasic();
+	vTestCommands();
+	vFuzzJunk(u32Rounds);
+	vFuzzCorrupt(u32Rounds / 10);
+
+	printf("Pn533Test: %s\n", u32Fail ? "NG" : "ok");
+	return u32Fail ? 1 : 0;
+}
@@ -0,0 +1,886 @@
+/*
+ * Sim.c
+ *
+ * 複数の Master / Slave を 1 つの仮想時間上で動かす離散事象シミュレータ。
+ *
+ *   usage: Sim [-n list] [-M masters] [-t sec] [-w sec] [-r per_min]
+ *              [-h ms] [-l loss] [-q lqi] [-S seed] [-m so] [-s so] [-c csv] [-b]
+ *              [-o sec,sec] [-f p] [-p sec] [-j ch,sec,sec[,loss]] [-H n]
+ *              [-e p[,p[,p]]] [-A n]
+ *
+ *   -n list    Slave (リーダ) 数。カンマ区切りで複数回実行する (既定 10,25,50,100)
+ *   -M n       Master 数 (既定 1)
+ *   -t sec     計測時間 (既定 60)
+ *   -w sec     計測前の立ち上がり時間 (既定 10)
+ *   -r n       1 リーダあたりの毎分のタッチ数 (既定 6)
+ *   -h ms      カードをかざしている時間 (既定 400)
+ *   -l p       リンクに依らないパケットロス率 (既定 0.01)
+ *   -q lqi     リンク LQI の平均 (既定 120)
+ *   -S seed    乱数の種
+ *   -m so      Master のファームウェア (既定 ../../Master/Build/Master_HOST.so)
+ *   -s so      Slave のファームウェア (既定 ../../Slave/Build/Slave_HOST.so)
+ *   -c csv     結果を CSV にも書き出す
+ *   -b         Master の出力をバイナリフレームとして読む (make OUTPUT=BINARY host)
+ *   -o s,d     開始から s 秒後に Master の電源を d 秒間切る (停電・再起動の試験)
+ *   -f p       かざしている途中で確率 p でカードが一瞬 (60ms) 外れる
+ *   -p s       開始から s 秒後に全 Slave の電源を入れ直す (RAM は失われ EEPROM は残る)
+ *   -j c,s,d[,p] 開始から s 秒後から d 秒間、チャネル c に妨害 (Wi-Fi など) を加え、
+ *              受信を確率 p (既定 0.5) で失わせる。c が 0 なら最初の Master のチャネル
+ *   -H n       ホストが毎秒 n 件しか読めないものとし、Master にクレジット
+ *              (HostLink.h) を SIM_CREDIT_MS ごとに送って出力を絞る
+ *   -e d,s,h   PN533 がコマンドごとに確率 d で読み落とし、確率 s で ACK フレームを
+ *              受けるまで固まり、確率 h で電源を入れ直すまで固まる (SimPn533.c)
+ *   -A n       ホストが各 Master に、リーダごとに偶数番目のタッチ n 件の IDm を
+ *              有効な IDm の一覧として渡す (HostLink.h の allow。Master の返事を待って 1 行ずつ)
+ *
+ * ファームウェアは make host で作られる *_HOST.so を、ノードごとに別名で
+ * コピーして dlopen する。これでノードごとに独立した静的変数を持つ。
+ *
+ * 各 Slave の PN533 には、指数分布の間隔でカードがかざされる。IDm は
+ * 01 2E <ノード番号 2 バイト> <タッチ番号 4 バイト> とし、Master の UART
+ * に出た felica 行から、どのタッチがいつ届いたかを照合する。
+ *
+ * polls_per_s は 1 リーダあたりの PN533 のポーリング試行回数、detect_ms は
+ * カードをかざしてから Slave が送信を始める (PORT_LED_2 が点く) までの平均。
+ * warm/full は前回のチャネルだけで / 全チャネルを調べて接続した回数 (起動時を
+ * 含む)、warm_ms/full_ms はそれぞれの切断から接続までの平均時間。migrate は
+ * 混んでいる Master から他の Master へ移った回数。
+ * ts_err_ms/ts_err_max は Master が出力したタッチの時刻 (felica 行の time、
+ * バイナリでは tick) から、カードをかざした時刻を受け取った Master の時計で
+ * 表したものを引いた差の平均と絶対値の最大 (読むまでの遅れを含む)。
+ * chsw は Master がチャネルを移った回数、follow は Slave がそれに付いて
+ * 移った回数。
+ * retx は Slave が Master の ACK を待たずに送り直したタッチパケットの数、
+ * srtt_ms は Slave ごとの送信から ACK までの時間 (平滑値) の平均。
+ * seq_loss_pct は Master がシーケンス番号の飛びから見積もった Slave からの
+ * パケットのロス率 (Roster。MAC の再送でも届かなかったもの)。
+ * Master は SIM_MASTER_STAGGER_MS ずつずらして起動し、Energy Scan で先に
+ * 起動した Master のいないチャネルを選ぶ。
+ * debounced は Slave が同じカードの読み直しとして抑えた数 (IdmCache)。
+ * eep_max は Slave の EEPROM で最も多く書き換えられたセグメントの回数
+ * (make TOUCH_LOG=EEPROM host のときのみ 0 以外になる)。
+ * ready_ms/ready_max は Slave が起動してから Master への接続と PN533 の
+ * 初期化が揃うまでの時間 (BootStats。-p の入れ直しでは最後の起動) の
+ * 平均と最大。
+ * nfc_rec は Slave が PN533 の無応答から立て直した回数、nfc_ms は無応答に
+ * 気づいてから応答が戻るまでの平均 (NfcRecovery)。
+ * accept/reject/unchecked は Slave が一覧で受け付けた・拒否した・一覧がなく
+ * 判定しなかったタッチ (-A。起動から数える)、allow_ms は一覧の受け取りに
+ * かかった時間の平均 (AllowFilter)。
+ *
+ */
+
+#include <dlfcn.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "BinFrame.h"
+#include "IdmCache.h"
+#include "ParentCache.h"
+#include "ChannelMonitor.h"
+#include "TxWindow.h"
+#include "Roster.h"
+#include "BootStats.h"
+#include "NfcRecovery.h"
+#include "AllowFilter.h"
+
+#define SIM_MASTER_SERIAL 0x81000000UL
+#define SIM_SLAVE_SERIAL  0x82000000UL
+#define SIM_PN533_PORT    E_AHI_UART_1
+#define SIM_PN533_POWER   5            // PORT_FELICA
+#define SIM_SEND_LED      2            // PORT_LED_2 (sendIdm で点く)
+#define SIM_DRAIN_S       3            // 計測終了後、届くのを待つ時間
+#define SIM_LINE_MAX      256
+#define SIM_FLICKER_MS    60           // -f でカードが外れている時間
+#define SIM_MASTER_STAGGER_MS 500      // Master の起動をずらす間隔
+#define SIM_JAM_ENERGY    150          // -j の妨害で Energy Scan に加わる値
+#define SIM_CREDIT_MS     100          // -H のクレジットを送る間隔
+
+typedef struct {
+	uint64 u64At;
+	bool_t bSeen;
+} tsSimTouch;
+
+typedef struct {
+	void *pvDl;
+	bool_t bMaster;
+
+	// Master: UART0 の行バッファ
+	char acLine[SIM_LINE_MAX];
+	uint16 u16Line;
+	double dCredit;        // -H: まだ送っていないクレジット (端数)
+
+	// Slave: PN533 とタッチ履歴
+	tsSimPn533 sPn533;
+	tsSimTouch *asTouch;
+	uint32 u32Touches;
+	uint32 u32TouchCap;
+	uint32 u32Delivered;
+	uint64 u64CardAt;      // 送信が始まっていないタッチの時刻 (0 ならなし)
+} tsSimNode;
+
+typedef struct {
+	uint16 u16Slaves;
+	uint16 u16Masters;
+	uint32 u32MeasureMs;
+	uint32 u32WarmupMs;
+	double dTouchPerMin;
+	uint32 u32HoldMs;
+	tsSimChannelConf sChannel;
+	uint32 u32Seed;
+	const char *pcMasterSo;
+	const char *pcSlaveSo;
+	bool_t bBinary;
+	uint32 u32OutageMs;    // Master の電源を切る時刻 (0 なら切らない)
+	uint32 u32OutageLenMs;
+	double dFlicker;
+	uint32 u32SlaveCycleMs; // Slave の電源を入れ直す時刻 (0 ならしない)
+	uint8 u8JamCh;          // 妨害するチャネル (0 なら最初の Master のチャネル)
+	uint32 u32JamMs;        // 妨害を始める時刻 (0 ならしない)
+	uint32 u32JamLenMs;
+	double dJamLoss;
+	double dHostRate;       // ホストが読める毎秒の件数 (0 ならクレジットを使わない)
+	double dNfcDrop;        // -e: PN533 の故障の確率
+	double dNfcStuck;
+	double dNfcHang;
+	uint32 u32AllowPerReader; // -A: リーダごとに一覧に載せるタッチ (0 なら一覧を渡さない)
+} tsSimConf;
+
+typedef struct {
+	uint32 u32Touches;
+	uint32 u32Delivered;
+	uint32 u32Duplicates;
+	uint32 u32Unknown;
+	uint16 u16Active;
+	uint32 u32TxFail;
+	uint32 u32EepMax;
+	uint32 u32Debounced;
+	double dPollsPerSec;
+	double dDetectMs;
+	tsReconnectStats sReconnect;
+	uint32 u32ChSwitches;
+	uint32 u32Retransmits;
+	double dSrttMs;
+	uint32 u32SeqRx;       // Master の Roster が数えた受信とロス
+	uint32 u32SeqLost;
+	double dLatP50, dLatP90, dLatP99, dLatMax;
+	double dTsErrMs, dTsErrMax;
+	double dReadyMs, dReadyMax; // 起動から使えるようになるまで
+	uint16 u16Ready;
+	uint32 u32NfcRecoveries;
+	uint32 u32NfcDownMsSum;
+	uint32 u32Accepted;
+	uint32 u32Rejected;
+	uint32 u32Unchecked;
+	uint32 u32AllowLoads;
+	uint32 u32AllowMsSum;
+	double dCpuSec;
+	tsSimChannelStats sChannel;
+} tsSimResult;
+
+static tsSimNode asSim[HOST_MAX_NODES];
+static tsSimConf sConf;
+static char acTmpDir[64];
+
+static double *adLatency = NULL;
+static uint32 u32Latency = 0;
+static uint32 u32LatencyCap = 0;
+static uint32 u32Duplicates = 0;
+static uint32 u32Unknown = 0;
+static double dDetectSum = 0;
+static uint32 u32Detect = 0;
+static double dTsErrSum = 0;
+static double dTsErrMax = 0;
+static uint32 u32TsErr = 0;
+
+static double dRand(void)
+{
+	return HOST_u32Rand() / 4294967296.0;
+}
+
+/****************************************************************************
+ * ファームウェアの読み込み
+ ****************************************************************************/
+
+static void *pvLoadFirmware(const char *pcSo, uint16 u16Id, tsHostApp *psApp)
+{
+	static const char *apcSym[] = {
+		"cbAppColdStart", "cbAppWarmStart", "cbToCoNet_vMain", "cbToCoNet_vRxEvent",
+		"cbToCoNet_vTxEvent", "cbToCoNet_vNwkEvent", "cbToCoNet_vHwEvent", "cbToCoNet_u8HwInt"
+	};
+	void **apv = (void **)psApp;
+	char acPath[128], acBuf[65536];
+	FILE *fi, *fo;
+	size_t n;
+	void *pvDl;
+	uint8 i;
+
+	// 同じパスは 1 度しか読み込まれないので、ノードごとにコピーする
+	snprintf(acPath, sizeof(acPath), "%s/%u.so", acTmpDir, u16Id);
+	fi = fopen(pcSo, "rb");
+	fo = fopen(acPath, "wb");
+	if (fi == NULL || fo == NULL) {
+		perror(fi == NULL ? pcSo : acPath);
+		exit(1);
+	}
+	while ((n = fread(acBuf, 1, sizeof(acBuf), fi)) > 0) {
+		fwrite(acBuf, 1, n, fo);
+	}
+	fclose(fi);
+	fclose(fo);
+
+	pvDl = dlopen(acPath, RTLD_NOW | RTLD_LOCAL);
+	unlink(acPath);
+	if (pvDl == NULL) {
+		fprintf(stderr, "%s\n", dlerror());
+		exit(1);
+	}
+
+	for (i = 0; i < sizeof(apcSym) / sizeof(apcSym[0]); i++) {
+		if ((apv[i] = dlsym(pvDl, apcSym[i])) == NULL) {
+			fprintf(stderr, "%s: %s not found\n", pcSo, apcSym[i]);
+			exit(1);
+		}
+	}
+	return pvDl;
+}
+
+/****************************************************************************
+ * 配線
+ ****************************************************************************/
+
+// u32Time は psMaster の時計で表したタッチの時刻
+static void vDelivered(tsHostNode *psMaster, const uint8 *pu8Idm, uint32 u32Time)
+{
+	uint16 u16Id = ((uint16)pu8Idm[2] << 8) | pu8Idm[3];
+	uint32 u32Idx = ((uint32)pu8Idm[4] << 24) | ((uint32)pu8Idm[5] << 16) | ((uint32)pu8Idm[6] << 8) | pu8Idm[7];
+	tsHostNode *psNode = HOST_psNode(u16Id);
+	tsSimNode *psS;
+	tsSimTouch *psT;
+
+	if (pu8Idm[0] != 0x01 || pu8Idm[1] != 0x2E || psNode == NULL
+			|| asSim[u16Id].bMaster || u32Idx >= asSim[u16Id].u32Touches) {
+		u32Unknown++;
+		return;
+	}
+	psS = &asSim[u16Id];
+	psT = &psS->asTouch[u32Idx];
+	if (psT->bSeen) {
+		u32Duplicates++;
+		return;
+	}
+	psT->bSeen = TRUE;
+
+	// 立ち上がり中のタッチは数えない
+	if (psT->u64At < sConf.u32WarmupMs * HOST_NS_PER_MS) {
+		return;
+	}
+	psS->u32Delivered++;
+	if (u32Latency == u32LatencyCap) {
+		u32LatencyCap = u32LatencyCap ? u32LatencyCap * 2 : 1024;
+		adLatency = realloc(adLatency, u32LatencyCap * sizeof(double));
+	}
+	adLatency[u32Latency++] = (HOST_u64Now() - psT->u64At) / 1e6;
+
+	// Master が再起動する前のタッチは比べられない
+	if (psT->u64At >= psMaster->u64BootNs) {
+		uint64 u64Ns = psT->u64At - psMaster->u64BootNs;
+		double dErr = (int32)(u32Time - (uint32)(u64Ns / HOST_NS_PER_MS))
+				- (double)(u64Ns % HOST_NS_PER_MS) / HOST_NS_PER_MS;
+		dTsErrSum += dErr;
+		if (dTsErrMax < fabs(dErr)) dTsErrMax = fabs(dErr);
+		u32TsErr++;
+	}
+}
+
+static void vHostAllow(tsHostNode *psNode, uint32 u32Arg, void *pvArg);
+
+// -A: Master の allow の返事。受け取った件数の次の行を送る (commit の返事には版が付くので終わり)
+static void vAllowReply(tsHostNode *psNode, const char *pcText)
+{
+	const char *pc;
+	unsigned int uIdms;
+
+	if (!sConf.u32AllowPerReader || strstr(pcText, "\"command\": \"allow\"") == NULL
+			|| strstr(pcText, "\"version\"") != NULL
+			|| (pc = strstr(pcText, "\"idms\": ")) == NULL || sscanf(pc + 8, "%u", &uIdms) != 1) {
+		return;
+	}
+	HOST_vSchedule(HOST_u64Now(), psNode, vHostAllow, uIdms + 1, NULL);
+}
+
+static void vMasterLine(tsHostNode *psNode, tsSimNode *psS)
+{
+	const char *pc;
+	uint8 au8Idm[8];
+	unsigned int uTime = 0;
+	uint8 i;
+
+	vAllowReply(psNode, psS->acLine);
+	if (strstr(psS->acLine, "\"type\": \"felica\"") == NULL
+			|| (pc = strstr(psS->acLine, "\"idm\": \"")) == NULL) {
+		return;
+	}
+	pc += 8;
+	for (i = 0; i < 8; i++) {
+		unsigned int u;
+		if (sscanf(pc + i * 2, "%2x", &u) != 1) return;
+		au8Idm[i] = (uint8)u;
+	}
+	if ((pc = strstr(psS->acLine, "\"time\": ")) != NULL) {
+		sscanf(pc + 8, "%u", &uTime);
+	}
+	vDelivered(psNode, au8Idm, uTime);
+}
+
+static void vMasterFrame(tsHostNode *psNode, tsSimNode *psS)
+{
+	tsBinFrameFelica sF;
+	uint8 u8Type, *pu8Body;
+	int16 i16Len = BinFrame_i16Decode((uint8 *)psS->acLine, psS->u16Line, &u8Type, &pu8Body);
+
+	if (i16Len >= 0 && u8Type == BINFRAME_TYPE_FELICA && BinFrame_bUnpackFelica(pu8Body, i16Len, &sF)) {
+		vDelivered(psNode, sF.au8Idm, sF.u32Tick);
+	} else if (i16Len >= 0 && u8Type == BINFRAME_TYPE_TEXT) {
+		char acText[SIM_LINE_MAX];
+		memcpy(acText, pu8Body, i16Len);
+		acText[i16Len] = 0;
+		vAllowReply(psNode, acText);
+	}
+}
+
+static void vUartTx(tsHostNode *psNode, uint8 u8Port, uint8 u8Byte)
+{
+	tsSimNode *psS = (tsSimNode *)psNode->pvUser;
+
+	if (!psS->bMaster) {
+		if (u8Port == SIM_PN533_PORT) {
+			SIM_vPn533Byte(&psS->sPn533, u8Byte);
+		}
+		return;
+	}
+
+	if (u8Port != E_AHI_UART_0) {
+		return;
+	}
+	if (sConf.bBinary && u8Byte == BINFRAME_DELIMITER) {
+		vMasterFrame(psNode, psS);
+		psS->u16Line = 0;
+	} else if (!sConf.bBinary && u8Byte == '\n') {
+		psS->acLine[psS->u16Line] = 0;
+		vMasterLine(psNode, psS);
+		psS->u16Line = 0;
+	} else if (psS->u16Line < SIM_LINE_MAX - 1) {
+		psS->acLine[psS->u16Line++] = u8Byte;
+	}
+}
+
+static void vDioChange(tsHostNode *psNode, uint32 u32Before, uint32 u32After)
+{
+	tsSimNode *psS = (tsSimNode *)psNode->pvUser;
+
+	if (psS->bMaster) {
+		return;
+	}
+	if ((u32Before ^ u32After) & (1UL << SIM_PN533_POWER)) {
+		SIM_vPn533Power(&psS->sPn533, (u32After >> SIM_PN533_POWER) & 1);
+	}
+	if ((~u32Before & u32After & (1UL << SIM_SEND_LED)) && psS->u64CardAt) {
+		dDetectSum += (HOST_u64Now() - psS->u64CardAt) / 1e6;
+		u32Detect++;
+		psS->u64CardAt = 0;
+	}
+}
+
+static const tsHostHooks sHooks = {
+	vUartTx,
+	vDioChange,
+	NULL
+};
+
+/****************************************************************************
+ * タッチ
+ ****************************************************************************/
+
+static void vTouchArrive(tsHostNode *psNode, uint32 u32Arg, void *pvArg);
+
+static void vCardRemove(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	tsSimNode *psS = (tsSimNode *)psNode->pvUser;
+	SIM_vPn533Card(&psS->sPn533, NULL);
+}
+
+static void vCardReturn(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	tsSimNode *psS = (tsSimNode *)psNode->pvUser;
+	psS->sPn533.bCard = TRUE;
+}
+
+static void vScheduleTouch(tsHostNode *psNode, uint64 u64From)
+{
+	// 平均 60/r 秒ごと (かざしている時間を含む)
+	double dMeanMs = 60000.0 / sConf.dTouchPerMin - sConf.u32HoldMs;
+	double dGapMs = dMeanMs > 0 ? -log(1.0 - dRand()) * dMeanMs : 0;
+
+	HOST_vSchedule(u64From + (uint64)(dGapMs * HOST_NS_PER_MS), psNode, vTouchArrive, 0, NULL);
+}
+
+static void vTouchArrive(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	tsSimNode *psS = (tsSimNode *)psNode->pvUser;
+	uint64 u64End = (uint64)(sConf.u32WarmupMs + sConf.u32MeasureMs) * HOST_NS_PER_MS;
+	uint32 u32Idx = psS->u32Touches;
+	uint8 au8Idm[8];
+
+	if (HOST_u64Now() >= u64End) {
+		return;
+	}
+
+	if (psS->u32Touches == psS->u32TouchCap) {
+		psS->u32TouchCap = psS->u32TouchCap ? psS->u32TouchCap * 2 : 64;
+		psS->asTouch = realloc(psS->asTouch, psS->u32TouchCap * sizeof(tsSimTouch));
+	}
+	psS->asTouch[u32Idx].u64At = HOST_u64Now();
+	psS->asTouch[u32Idx].bSeen = FALSE;
+	psS->u32Touches++;
+	if (HOST_u64Now() >= sConf.u32WarmupMs * HOST_NS_PER_MS) {
+		psS->u64CardAt = HOST_u64Now();
+	}
+
+	au8Idm[0] = 0x01;
+	au8Idm[1] = 0x2E;
+	au8Idm[2] = psNode->u16Id >> 8;
+	au8Idm[3] = psNode->u16Id;
+	au8Idm[4] = u32Idx >> 24;
+	au8Idm[5] = u32Idx >> 16;
+	au8Idm[6] = u32Idx >> 8;
+	au8Idm[7] = u32Idx;
+	SIM_vPn533Card(&psS->sPn533, au8Idm);
+
+	if (sConf.dFlicker > 0 && dRand() < sConf.dFlicker && sConf.u32HoldMs > 2 * SIM_FLICKER_MS) {
+		uint64 u64Off = HOST_u64Now() + sConf.u32HoldMs / 2 * HOST_NS_PER_MS;
+		HOST_vSchedule(u64Off, psNode, vCardRemove, 0, NULL);
+		HOST_vSchedule(u64Off + SIM_FLICKER_MS * HOST_NS_PER_MS, psNode, vCardReturn, 0, NULL);
+	}
+	HOST_vSchedule(HOST_u64Now() + sConf.u32HoldMs * HOST_NS_PER_MS, psNode, vCardRemove, 0, NULL);
+	vScheduleTouch(psNode, HOST_u64Now() + sConf.u32HoldMs * HOST_NS_PER_MS);
+}
+
+/****************************************************************************
+ * 妨害
+ ****************************************************************************/
+
+static void vJamStart(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	uint8 u8Ch = sConf.u8JamCh ? sConf.u8JamCh : HOST_psNode(0)->u8Channel;
+	SIM_vChannelJam(u8Ch, SIM_JAM_ENERGY, sConf.dJamLoss);
+}
+
+static void vJamEnd(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	SIM_vChannelJam(0, 0, 0);
+}
+
+// -H: 読めた分だけクレジットを送る
+static void vHostCredit(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	tsSimNode *psS = (tsSimNode *)psNode->pvUser;
+	char acCmd[24];
+	uint32 u32N;
+	char *pc;
+
+	psS->dCredit += sConf.dHostRate * SIM_CREDIT_MS / 1000;
+	u32N = (uint32)psS->dCredit;
+	if (u32N) {
+		psS->dCredit -= u32N;
+		snprintf(acCmd, sizeof(acCmd), "credit %u\n", u32N);
+		for (pc = acCmd; *pc; pc++) {
+			HOST_vUartRx(psNode, E_AHI_UART_0, (uint8)*pc);
+		}
+	}
+	HOST_vSchedule(HOST_u64Now() + SIM_CREDIT_MS * HOST_NS_PER_MS, psNode, vHostCredit, 0, NULL);
+}
+
+// -A: ホストが有効な IDm の一覧を 1 行ずつ送る (u32Arg は次の行。0 が clear、最後が commit)
+static void vHostAllow(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	uint32 u32Lines = (uint32)sConf.u16Slaves * sConf.u32AllowPerReader;
+	char acCmd[32];
+	char *pc;
+
+	if (u32Arg == 0) {
+		snprintf(acCmd, sizeof(acCmd), "allow clear\n");
+	} else if (u32Arg <= u32Lines) {
+		uint32 u32Reader = (u32Arg - 1) / sConf.u32AllowPerReader;
+		uint32 u32Idx = (u32Arg - 1) % sConf.u32AllowPerReader * 2;
+		snprintf(acCmd, sizeof(acCmd), "allow 012E%04X%08X\n", sConf.u16Masters + u32Reader, u32Idx);
+	} else {
+		snprintf(acCmd, sizeof(acCmd), "allow commit\n");
+	}
+	// 次の行は Master の返事 (vAllowReply) で送る
+	for (pc = acCmd; *pc; pc++) {
+		HOST_vUartRx(psNode, E_AHI_UART_0, (uint8)*pc);
+	}
+}
+
+/****************************************************************************
+ * 実行
+ ****************************************************************************/
+
+static int iCmpDouble(const void *a, const void *b)
+{
+	double d = *(const double *)a - *(const double *)b;
+	return d < 0 ? -1 : d > 0;
+}
+
+static double dPercentile(double dP)
+{
+	uint32 u32Idx;
+
+	if (u32Latency == 0) return 0;
+	u32Idx = (uint32)ceil(dP * u32Latency);
+	return adLatency[u32Idx ? u32Idx - 1 : 0];
+}
+
+static void vRun(tsSimResult *psR)
+{
+	uint64 u64MeasureFrom = sConf.u32WarmupMs * HOST_NS_PER_MS;
+	uint64 u64MeasureTo = u64MeasureFrom + sConf.u32MeasureMs * HOST_NS_PER_MS;
+	uint16 u16Nodes = sConf.u16Masters + sConf.u16Slaves;
+	clock_t c0 = clock();
+	uint16 i;
+	uint32 j;
+
+	HOST_vReset(sConf.u32Seed);
+	SIM_vChannelInit(&sConf.sChannel);
+	HOST_vSetMedium(SIM_psChannelMedium());
+	u32Latency = 0;
+	u32Duplicates = 0;
+	u32Unknown = 0;
+	dDetectSum = 0;
+	u32Detect = 0;
+	dTsErrSum = 0;
+	dTsErrMax = 0;
+	u32TsErr = 0;
+
+	for (i = 0; i < u16Nodes; i++) {
+		bool_t bMaster = i < sConf.u16Masters;
+		tsHostApp sApp;
+		tsHostNode *psNode;
+		tsSimNode *psS = &asSim[i];
+
+		memset(psS, 0, sizeof(tsSimNode));
+		psS->bMaster = bMaster;
+		psS->pvDl = pvLoadFirmware(bMaster ? sConf.pcMasterSo : sConf.pcSlaveSo, i, &sApp);
+
+		psNode = HOST_psNodeCreate(&sApp, bMaster
+				? SIM_MASTER_SERIAL + i : SIM_SLAVE_SERIAL + i - sConf.u16Masters);
+		psNode->psHooks = &sHooks;
+		psNode->pvUser = psS;
+
+		if (bMaster) {
+			uint64 u64Stagger = (uint64)i * SIM_MASTER_STAGGER_MS * HOST_NS_PER_MS;
+			HOST_vNodePowerOn(psNode, u64Stagger);
+			if (sConf.dHostRate > 0) {
+				HOST_vSchedule(u64Stagger + HOST_NS_PER_S, psNode, vHostCredit, 0, NULL);
+			}
+			if (sConf.u32AllowPerReader) {
+				HOST_vSchedule(u64Stagger + HOST_NS_PER_S, psNode, vHostAllow, 0, NULL);
+			}
+			if (sConf.u32OutageMs) {
+				HOST_vNodePowerOff(psNode, sConf.u32OutageMs * HOST_NS_PER_MS);
+				HOST_vNodePowerOn(psNode, (uint64)(sConf.u32OutageMs + sConf.u32OutageLenMs) * HOST_NS_PER_MS
+						+ u64Stagger);
+			}
+		} else {
+			SIM_vPn533Init(&psS->sPn533, psNode, SIM_PN533_PORT);
+			psS->sPn533.dDrop = sConf.dNfcDrop;
+			psS->sPn533.dStuck = sConf.dNfcStuck;
+			psS->sPn533.dHang = sConf.dNfcHang;
+			HOST_vNodePowerOn(psNode, HOST_u32Rand() % HOST_NS_PER_S);
+			if (sConf.u32SlaveCycleMs) {
+				uint64 u64Off = sConf.u32SlaveCycleMs * HOST_NS_PER_MS + HOST_u32Rand() % HOST_NS_PER_S;
+				HOST_vNodePowerOff(psNode, u64Off);
+				HOST_vNodePowerOn(psNode, u64Off + 100 * HOST_NS_PER_MS);
+			}
+			vScheduleTouch(psNode, 0);
+		}
+	}
+
+	if (sConf.u32JamMs) {
+		HOST_vSchedule(sConf.u32JamMs * HOST_NS_PER_MS, HOST_psNode(0), vJamStart, 0, NULL);
+		HOST_vSchedule((uint64)(sConf.u32JamMs + sConf.u32JamLenMs) * HOST_NS_PER_MS, HOST_psNode(0), vJamEnd, 0, NULL);
+	}
+
+	HOST_vRunUntil(u64MeasureTo + SIM_DRAIN_S * HOST_NS_PER_S);
+
+	memset(psR, 0, sizeof(tsSimResult));
+	for (i = sConf.u16Masters; i < u16Nodes; i++) {
+		tsSimNode *psS = &asSim[i];
+		const tsIdmCacheStats *(*pfpsStats)(void);
+		const tsReconnectStats *(*pfpsReconnect)(void);
+		const tsTxWindowStats *(*pfpsTxWin)(void);
+		const tsBootStats *(*pfpsBoot)(void);
+		const tsNfcRecoveryStats *(*pfpsNfcRec)(void);
+		const tsAllowFilterStats *(*pfpsAllow)(void);
+
+		for (j = 0; j < psS->u32Touches; j++) {
+			if (psS->asTouch[j].u64At >= u64MeasureFrom) psR->u32Touches++;
+		}
+		psR->u32Delivered += psS->u32Delivered;
+		if (psS->u32Delivered) psR->u16Active++;
+		psR->u32TxFail += HOST_psNode(i)->sStats.u32TxFail;
+		psR->dPollsPerSec += psS->sPn533.u32Polls;
+		pfpsStats = (const tsIdmCacheStats *(*)(void))dlsym(psS->pvDl, "IdmCache_psStats");
+		if (pfpsStats) psR->u32Debounced += pfpsStats()->u32Absorbed;
+		pfpsReconnect = (const tsReconnectStats *(*)(void))dlsym(psS->pvDl, "ParentCache_psStats");
+		if (pfpsReconnect) {
+			const tsReconnectStats *psRs = pfpsReconnect();
+			psR->sReconnect.u16WarmOk += psRs->u16WarmOk;
+			psR->sReconnect.u16Full += psRs->u16Full;
+			psR->sReconnect.u32WarmMsSum += psRs->u32WarmMsSum;
+			psR->sReconnect.u32FullMsSum += psRs->u32FullMsSum;
+			psR->sReconnect.u16Migrations += psRs->u16Migrations;
+			psR->sReconnect.u16Follows += psRs->u16Follows;
+		}
+		pfpsTxWin = (const tsTxWindowStats *(*)(void))dlsym(psS->pvDl, "TxWindow_psStats");
+		if (pfpsTxWin) {
+			psR->u32Retransmits += pfpsTxWin()->u32Retransmits;
+			psR->dSrttMs += pfpsTxWin()->u16SrttMs;
+		}
+		pfpsBoot = (const tsBootStats *(*)(void))dlsym(psS->pvDl, "BootStats_psStats");
+		if (pfpsBoot && pfpsBoot()->u32ReadyMs) {
+			psR->dReadyMs += pfpsBoot()->u32ReadyMs;
+			if (psR->dReadyMax < pfpsBoot()->u32ReadyMs) psR->dReadyMax = pfpsBoot()->u32ReadyMs;
+			psR->u16Ready++;
+		}
+		pfpsNfcRec = (const tsNfcRecoveryStats *(*)(void))dlsym(psS->pvDl, "NfcRecovery_psStats");
+		if (pfpsNfcRec) {
+			for (j = 0; j < NFCREC_STAGES; j++) {
+				psR->u32NfcRecoveries += pfpsNfcRec()->au32Recovered[j];
+			}
+			psR->u32NfcDownMsSum += pfpsNfcRec()->u32DownMsSum;
+		}
+		pfpsAllow = (const tsAllowFilterStats *(*)(void))dlsym(psS->pvDl, "AllowFilter_psStats");
+		if (pfpsAllow) {
+			psR->u32Accepted += pfpsAllow()->u32Accepted;
+			psR->u32Rejected += pfpsAllow()->u32Rejected;
+			psR->u32Unchecked += pfpsAllow()->u32Unchecked;
+			psR->u32AllowLoads += pfpsAllow()->u32Loads;
+			psR->u32AllowMsSum += pfpsAllow()->u32FetchMsSum;
+		}
+		for (j = 0; j < HOST_EEP_SEGMENTS; j++) {
+			if (psR->u32EepMax < HOST_psNode(i)->au32EepCycles[j]) {
+				psR->u32EepMax = HOST_psNode(i)->au32EepCycles[j];
+			}
+		}
+	}
+	for (i = 0; i < sConf.u16Masters; i++) {
+		const tsChannelMonitorStats *(*pfpsChMon)(void);
+		const tsRosterStats *(*pfpsRoster)(void);
+		pfpsChMon = (const tsChannelMonitorStats *(*)(void))dlsym(asSim[i].pvDl, "ChannelMonitor_psStats");
+		if (pfpsChMon) psR->u32ChSwitches += pfpsChMon()->u16Switches;
+		pfpsRoster = (const tsRosterStats *(*)(void))dlsym(asSim[i].pvDl, "Roster_psStats");
+		if (pfpsRoster) {
+			psR->u32SeqRx += pfpsRoster()->u32Received;
+			psR->u32SeqLost += pfpsRoster()->u32Lost;
+		}
+	}
+	psR->u32Duplicates = u32Duplicates;
+	psR->dSrttMs /= sConf.u16Slaves;
+	if (psR->u16Ready) psR->dReadyMs /= psR->u16Ready;
+	psR->dPollsPerSec /= (double)sConf.u16Slaves * HOST_u64Now() / HOST_NS_PER_S;
+	psR->dDetectMs = u32Detect ? dDetectSum / u32Detect : 0;
+	psR->u32Unknown = u32Unknown;
+	psR->sChannel = *SIM_psChannelStats();
+
+	qsort(adLatency, u32Latency, sizeof(double), iCmpDouble);
+	psR->dLatP50 = dPercentile(0.50);
+	psR->dLatP90 = dPercentile(0.90);
+	psR->dLatP99 = dPercentile(0.99);
+	psR->dLatMax = u32Latency ? adLatency[u32Latency - 1] : 0;
+	psR->dTsErrMs = u32TsErr ? dTsErrSum / u32TsErr : 0;
+	psR->dTsErrMax = dTsErrMax;
+
+	for (i = 0; i < u16Nodes; i++) {
+		dlclose(asSim[i].pvDl);
+		free(asSim[i].asTouch);
+	}
+	psR->dCpuSec = (double)(clock() - c0) / CLOCKS_PER_SEC;
+}
+
+/****************************************************************************
+ * main
+ ****************************************************************************/
+
+static const char *pcDefaultSo(const char *pcRel)
+{
+	static char acExe[2][512];
+	static uint8 u8Use = 0;
+	char *pc = acExe[u8Use++ & 1];
+	ssize_t n = readlink("/proc/self/exe", pc, 400);
+
+	if (n <= 0) {
+		return pcRel;
+	}
+	pc[n] = 0;
+	if (strrchr(pc, '/')) *strrchr(pc, '/') = 0;
+	strcat(pc, "/");
+	strcat(pc, pcRel);
+	return pc;
+}
+
+static void vPrintRow(FILE *fp, const char *pcSep, const tsSimResult *psR)
+{
+	double dLoss = psR->u32Touches ? 100.0 * (psR->u32Touches - psR->u32Delivered) / psR->u32Touches : 0;
+
+	fprintf(fp, "%u%s%u%s%u%s%u%s%.2f%s%.2f%s%.1f%s%.1f%s%.1f%s%.1f%s%u%s%u%s%u%s%u%s%u%s%u%s%.1f%s%.1f%s%u%s%u%s%.0f%s%.0f%s%u%s%u%s%u%s%u%s%.1f%s%.2f%s%.1f%s%.1f%s%.0f%s%.0f%s%u%s%.0f%s%u%s%u%s%u%s%.0f%s%.2f\n",
+			sConf.u16Slaves, pcSep, sConf.u16Masters, pcSep,
+			psR->u32Touches, pcSep, psR->u32Delivered, pcSep, dLoss, pcSep,
+			psR->u32Delivered * 1000.0 / sConf.u32MeasureMs, pcSep,
+			psR->dLatP50, pcSep, psR->dLatP90, pcSep, psR->dLatP99, pcSep, psR->dLatMax, pcSep,
+			psR->u16Active, pcSep, psR->u32TxFail, pcSep,
+			psR->sChannel.u32Collisions, pcSep, psR->u32Duplicates, pcSep,
+			psR->u32Debounced, pcSep, psR->u32EepMax, pcSep,
+			psR->dPollsPerSec, pcSep, psR->dDetectMs, pcSep,
+			psR->sReconnect.u16WarmOk, pcSep, psR->sReconnect.u16Full, pcSep,
+			psR->sReconnect.u16WarmOk ? (double)psR->sReconnect.u32WarmMsSum / psR->sReconnect.u16WarmOk : 0, pcSep,
+			psR->sReconnect.u16Full ? (double)psR->sReconnect.u32FullMsSum / psR->sReconnect.u16Full : 0, pcSep,
+			psR->sReconnect.u16Migrations, pcSep,
+			psR->u32ChSwitches, pcSep, psR->sReconnect.u16Follows, pcSep,
+			psR->u32Retransmits, pcSep, psR->dSrttMs, pcSep,
+			psR->u32SeqRx + psR->u32SeqLost ? 100.0 * psR->u32SeqLost / (psR->u32SeqRx + psR->u32SeqLost) : 0, pcSep,
+			psR->dTsErrMs, pcSep, psR->dTsErrMax, pcSep,
+			psR->dReadyMs, pcSep, psR->dReadyMax, pcSep,
+			psR->u32NfcRecoveries, pcSep,
+			psR->u32NfcRecoveries ? (double)psR->u32NfcDownMsSum / psR->u32NfcRecoveries : 0, pcSep,
+			psR->u32Accepted, pcSep, psR->u32Rejected, pcSep, psR->u32Unchecked, pcSep,
+			psR->u32AllowLoads ? (double)psR->u32AllowMsSum / psR->u32AllowLoads : 0, pcSep,
+			psR->dCpuSec);
+}
+
+static const char acHeader[] = "readers masters touches delivered loss_pct touch_per_s "
+		"lat_p50_ms lat_p90_ms lat_p99_ms lat_max_ms active tx_fail collisions duplicates debounced eep_max polls_per_s detect_ms warm full warm_ms full_ms migrate chsw follow retx srtt_ms seq_loss_pct ts_err_ms ts_err_max ready_ms ready_max nfc_rec nfc_ms accept reject unchecked allow_ms cpu_s";
+
+int main(int argc, char *argv[])
+{
+	const char *pcList = "10,25,50,100";
+	const char *pcCsv = NULL;
+	FILE *fpCsv = NULL;
+	char *pcDup, *pcTok;
+	uint8 i;
+	int opt;
+
+	memset(&sConf, 0, sizeof(sConf));
+	sConf.u16Masters = 1;
+	sConf.u32MeasureMs = 60000;
+	sConf.u32WarmupMs = 10000;
+	sConf.dTouchPerMin = 6;
+	sConf.u32HoldMs = 400;
+	sConf.u32Seed = 1;
+	sConf.sChannel.dLoss = 0.01;
+	sConf.sChannel.u8LqiMean = 120;
+	sConf.sChannel.u8LqiSpread = 40;
+	sConf.sChannel.u8LqiNoise = 8;
+	sConf.sChannel.u8LqiMin = 30;
+	for (i = 0; i < 16; i++) {
+		sConf.sChannel.au8Noise[i] = 20 + (i * 37) % 40;
+	}
+	sConf.pcMasterSo = pcDefaultSo("../../Master/Build/Master_HOST.so");
+	sConf.pcSlaveSo = pcDefaultSo("../../Slave/Build/Slave_HOST.so");
+
+	while ((opt = getopt(argc, argv, "n:M:t:w:r:h:l:q:S:m:s:c:bo:f:p:j:H:e:A:")) != -1) {
+		switch (opt) {
+		case 'n': pcList = optarg; break;
+		case 'M': sConf.u16Masters = atoi(optarg); break;
+		case 't': sConf.u32MeasureMs = atof(optarg) * 1000; break;
+		case 'w': sConf.u32WarmupMs = atof(optarg) * 1000; break;
+		case 'r': sConf.dTouchPerMin = atof(optarg); break;
+		case 'h': sConf.u32HoldMs = atoi(optarg); break;
+		case 'l': sConf.sChannel.dLoss = atof(optarg); break;
+		case 'q': sConf.sChannel.u8LqiMean = atoi(optarg); break;
+		case 'S': sConf.u32Seed = strtoul(optarg, NULL, 0); break;
+		case 'm': sConf.pcMasterSo = optarg; break;
+		case 's': sConf.pcSlaveSo = optarg; break;
+		case 'c': pcCsv = optarg; break;
+		case 'b': sConf.bBinary = TRUE; break;
+		case 'o':
+			sConf.u32OutageMs = atof(optarg) * 1000;
+			sConf.u32OutageLenMs = strchr(optarg, ',') ? atof(strchr(optarg, ',') + 1) * 1000 : 10000;
+			break;
+		case 'f': sConf.dFlicker = atof(optarg); break;
+		case 'p': sConf.u32SlaveCycleMs = atof(optarg) * 1000; break;
+		case 'H': sConf.dHostRate = atof(optarg); break;
+		case 'A': sConf.u32AllowPerReader = atoi(optarg); break;
+		case 'e':
+			if (sscanf(optarg, "%lf,%lf,%lf", &sConf.dNfcDrop, &sConf.dNfcStuck, &sConf.dNfcHang) < 1) {
+				fprintf(stderr, "-e p[,p[,p]]\n");
+				return 2;
+			}
+			break;
+		case 'j': {
+			double dCh = 0, dAt = 0, dLen = 0, dLoss = 0.5;
+			if (sscanf(optarg, "%lf,%lf,%lf,%lf", &dCh, &dAt, &dLen, &dLoss) < 3) {
+				fprintf(stderr, "-j ch,sec,sec[,loss]\n");
+				return 2;
+			}
+			sConf.u8JamCh = (uint8)dCh;
+			sConf.u32JamMs = dAt * 1000;
+			sConf.u32JamLenMs = dLen * 1000;
+			sConf.dJamLoss = dLoss;
+			break;
+		}
+		default:
+			fprintf(stderr, "usage: %s [-n list] [-M masters] [-t sec] [-w sec] [-r per_min] "
+					"[-h ms] [-l loss] [-q lqi] [-S seed] [-m so] [-s so] [-c csv] [-b] [-o sec,sec] [-f p] [-p sec] [-j ch,sec,sec[,loss]] [-H n] [-e p[,p[,p]]] [-A n]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (sConf.u16Masters == 0 || sConf.dTouchPerMin <= 0 || sConf.u32MeasureMs == 0) {
+		fprintf(stderr, "invalid option\n");
+		return 2;
+	}
+
+	strcpy(acTmpDir, "/tmp/toconet-sim.XXXXXX");
+	if (mkdtemp(acTmpDir) == NULL) {
+		perror("mkdtemp");
+		return 1;
+	}
+	if (pcCsv) {
+		if ((fpCsv = fopen(pcCsv, "w")) == NULL) {
+			perror(pcCsv);
+			return 1;
+		}
+		for (pcTok = strcpy(malloc(sizeof(acHeader)), acHeader); strchr(pcTok, ' '); ) {
+			*strchr(pcTok, ' ') = ',';
+		}
+		fprintf(fpCsv, "%s\n", pcTok);
+		free(pcTok);
+	}
+
+	printf("%s\n", acHeader);
+	pcDup = strdup(pcList);
+	for (pcTok = strtok(pcDup, ","); pcTok; pcTok = strtok(NULL, ",")) {
+		tsSimResult sR;
+
+		sConf.u16Slaves = atoi(pcTok);
+		if (sConf.u16Masters + sConf.u16Slaves > HOST_MAX_NODES) {
+			fprintf(stderr, "too many nodes: %u\n", sConf.u16Masters + sConf.u16Slaves);
+			continue;
+		}
+		vRun(&sR);
+		vPrintRow(stdout, " ", &sR);
+		fflush(stdout);
+		if (fpCsv) vPrintRow(fpCsv, ",", &sR);
+	}
+	free(pcDup);
+
+	if (fpCsv) fclose(fpCsv);
+	rmdir(acTmpDir);
+	return 0;
+}
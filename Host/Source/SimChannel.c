@@ -0,0 +1,469 @@
+/*
+ * SimChannel.c
+ *
+ * IEEE 802.15.4 (2.4GHz, 250kbps) の簡易チャネルモデル。
+ *
+ *  - 全ノードが互いに聞こえる単一の衝突ドメインとし、同一チャネル上で
+ *    送信時間が重なったフレームはすべて失われる (キャプチャ効果なし)。
+ *  - 送信は unslotted CSMA-CA (macMinBE=3, macMaxBE=5,
+ *    macMaxCSMABackoffs=4, バックオフ単位 320us, CCA 128us,
+ *    RX/TX 切替 192us) に従う。
+ *  - ACK 要求付きユニキャストは ACK (352us) を待ち、864us 以内に届かな
+ *    ければ u8TxMacRetry 回まで MAC 再送する。それでも失敗すれば
+ *    tsTxDataApp.u8Retry 回まで送信全体をやり直す。ACK だけが失われた
+ *    場合、受信側には同じフレームが重複して届く。
+ *  - ブロードキャストは u8Retry 回繰り返して送る。
+ *  - リンク LQI はノード対ごとに固定のばらつきを持ち、パケットごとに
+ *    揺らぐ。u8LqiMin 未満、または確率 dLoss で受信に失敗する。
+ *  - Energy Scan は au8Noise に加え、他の Master (NbScan に応答するノード)
+ *    が動いているチャネルを OCCUPIED_ENERGY だけ高く返す (そのネット
+ *    ワークの通信を拾ったものとみなす)。
+ *  - SIM_vChannelJam で 1 チャネルに妨害 (会場の Wi-Fi など) を加えると、
+ *    そのチャネルの Energy Scan が高くなり、受信が確率 dLoss で失われる。
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+#define SYMBOL_NS      (16 * HOST_NS_PER_US)
+#define BYTE_NS        (32 * HOST_NS_PER_US)
+#define BACKOFF_NS     (20 * SYMBOL_NS)
+#define CCA_NS         (8 * SYMBOL_NS)
+#define TURNAROUND_NS  (12 * SYMBOL_NS)
+#define ACK_WAIT_NS    (54 * SYMBOL_NS)
+#define ACK_BYTES      11
+#define MIN_BE         3
+#define MAX_BE         5
+#define MAX_BACKOFFS   4
+#define RETRY_DUR_MS   4  // u16RetryDur 未指定時の再送間隔
+#define OCCUPIED_ENERGY 60
+
+// 送信中・送信済みの電波
+typedef struct {
+	uint64 u64Start;
+	uint64 u64End;
+	uint8 u8Ch;
+	uint16 u16Src;
+} tsSimAir;
+
+// ノードごとの MAC 送信状態
+typedef struct {
+	tsHostFrame *psFrame;
+	uint32 u32Token;
+	uint8 u8Nb;
+	uint8 u8Be;
+	uint8 u8MacTry;
+	uint8 u8AppTry;
+	uint64 u64Start;
+	uint64 u64End;
+} tsSimMac;
+
+static tsSimChannelConf sConf;
+static tsSimChannelStats sStats;
+static tsSimMac asMac[HOST_MAX_NODES];
+static tsSimAir *asAir = NULL;
+static uint32 u32Air = 0;
+static uint32 u32AirCap = 0;
+static uint32 u32Seed;
+static uint8 u8JamCh = 0;
+static uint8 u8JamEnergy;
+static double dJamLoss;
+
+static double dRand(void)
+{
+	return HOST_u32Rand() / 4294967296.0;
+}
+
+/****************************************************************************
+ * 電波
+ ****************************************************************************/
+
+static uint64 u64Airtime(const tsHostFrame *psFrame)
+{
+	// PHY 6 + MAC (FCF 2, Seq 1, PAN 2, 宛先 2/8, 送信元 8, FCS 2) + ToCoNet 4
+	uint8 u8Dst = psFrame->u32DstAddr == TOCONET_MAC_ADDR_BROADCAST ? 2 : 8;
+	return (uint64)(6 + 2 + 1 + 2 + u8Dst + 8 + 2 + 4 + psFrame->u8Len) * BYTE_NS;
+}
+
+static void vAirAdd(uint16 u16Src, uint8 u8Ch, uint64 u64Start, uint64 u64End)
+{
+	uint32 i, n = 0;
+
+	// 十分古い電波は捨てる
+	for (i = 0; i < u32Air; i++) {
+		if (asAir[i].u64End + 10 * HOST_NS_PER_MS >= u64Start) {
+			asAir[n++] = asAir[i];
+		}
+	}
+	u32Air = n;
+
+	if (u32Air == u32AirCap) {
+		u32AirCap = u32AirCap ? u32AirCap * 2 : 256;
+		asAir = realloc(asAir, u32AirCap * sizeof(tsSimAir));
+	}
+	asAir[u32Air].u64Start = u64Start;
+	asAir[u32Air].u64End = u64End;
+	asAir[u32Air].u8Ch = u8Ch;
+	asAir[u32Air].u16Src = u16Src;
+	u32Air++;
+	sStats.u64AirNs += u64End - u64Start;
+}
+
+static bool_t bBusy(uint8 u8Ch, uint64 u64At)
+{
+	uint32 i;
+
+	for (i = 0; i < u32Air; i++) {
+		if (asAir[i].u8Ch == u8Ch && asAir[i].u64Start <= u64At && u64At < asAir[i].u64End) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static bool_t bOverlap(uint16 u16Src, uint8 u8Ch, uint64 u64Start, uint64 u64End)
+{
+	uint32 i;
+
+	for (i = 0; i < u32Air; i++) {
+		tsSimAir *psA = &asAir[i];
+		if (psA->u16Src == u16Src && psA->u64Start == u64Start) continue;
+		if (psA->u8Ch == u8Ch && psA->u64Start < u64End && u64Start < psA->u64End) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static uint8 u8LinkLqi(tsHostNode *psA, tsHostNode *psB)
+{
+	uint32 h = (psA->u32Serial ^ psB->u32Serial) * 2654435761UL ^ u32Seed;
+	int iLqi = sConf.u8LqiMean;
+
+	h ^= h >> 15;
+	h *= 2246822519UL;
+	h ^= h >> 13;
+	if (sConf.u8LqiSpread) {
+		iLqi += (int)(h % (2 * sConf.u8LqiSpread + 1)) - sConf.u8LqiSpread;
+	}
+	if (sConf.u8LqiNoise) {
+		iLqi += (int)(HOST_u32Rand() % (2 * sConf.u8LqiNoise + 1)) - sConf.u8LqiNoise;
+	}
+	if (iLqi < 0) iLqi = 0;
+	if (iLqi > 255) iLqi = 255;
+	return (uint8)iLqi;
+}
+
+static bool_t bReceived(tsHostNode *psTx, tsHostNode *psRx, uint8 u8Ch, uint8 *pu8Lqi)
+{
+	uint8 u8Lqi = u8LinkLqi(psTx, psRx);
+
+	if (pu8Lqi) *pu8Lqi = u8Lqi;
+	if (u8Lqi < sConf.u8LqiMin || dRand() < sConf.dLoss
+			|| (u8Ch == u8JamCh && dRand() < dJamLoss)) {
+		sStats.u32Lost++;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/****************************************************************************
+ * MAC
+ ****************************************************************************/
+
+static void vCsmaBegin(tsHostNode *psNode, uint32 u32Token, void *pvArg);
+
+static bool_t bStale(tsHostNode *psNode, uint32 u32Token)
+{
+	return asMac[psNode->u16Id].u32Token != u32Token || asMac[psNode->u16Id].psFrame == NULL;
+}
+
+static void vFinish(tsHostNode *psNode, bool_t bStatus)
+{
+	tsSimMac *psM = &asMac[psNode->u16Id];
+
+	psM->psFrame = NULL;
+	psM->u32Token++;
+	HOST_vRadioTxDone(psNode, bStatus);
+}
+
+// 送信全体のやり直し (u8Retry)
+static void vAppRetry(tsHostNode *psNode)
+{
+	tsSimMac *psM = &asMac[psNode->u16Id];
+	uint16 u16Dur = psM->psFrame->u16RetryDur ? psM->psFrame->u16RetryDur : RETRY_DUR_MS;
+
+	if (psM->u8AppTry < (psM->psFrame->u8Retry & 0x0F)) {
+		psM->u8AppTry++;
+		psM->u8MacTry = 0;
+		sStats.u32AppRetries++;
+		HOST_vSchedule(HOST_u64Now() + u16Dur * HOST_NS_PER_MS + HOST_u32Rand() % HOST_NS_PER_MS,
+				psNode, vCsmaBegin, psM->u32Token, NULL);
+	} else {
+		vFinish(psNode, FALSE);
+	}
+}
+
+// ACK が来なかった
+static void vMacRetry(tsHostNode *psNode, uint32 u32Token, void *pvArg)
+{
+	tsSimMac *psM = &asMac[psNode->u16Id];
+
+	if (bStale(psNode, u32Token)) return;
+
+	if (psM->u8MacTry < psNode->sAppContext.u8TxMacRetry) {
+		psM->u8MacTry++;
+		sStats.u32MacRetries++;
+		vCsmaBegin(psNode, u32Token, NULL);
+	} else {
+		vAppRetry(psNode);
+	}
+}
+
+static void vAckEnd(tsHostNode *psNode, uint32 u32Token, void *pvArg)
+{
+	tsSimMac *psM = &asMac[psNode->u16Id];
+	tsHostNode *psDst = (tsHostNode *)pvArg;
+	uint64 u64AckStart = HOST_u64Now() - ACK_BYTES * BYTE_NS;
+
+	if (bStale(psNode, u32Token)) return;
+
+	if (!bOverlap(psDst->u16Id, psM->psFrame->u8Channel, u64AckStart, HOST_u64Now())
+			&& bReceived(psDst, psNode, psM->psFrame->u8Channel, NULL)) {
+		vFinish(psNode, TRUE);
+	} else {
+		sStats.u32AckLost++;
+		HOST_vSchedule(psM->u64End + ACK_WAIT_NS, psNode, vMacRetry, u32Token, NULL);
+	}
+}
+
+static void vTxEnd(tsHostNode *psNode, uint32 u32Token, void *pvArg)
+{
+	tsSimMac *psM = &asMac[psNode->u16Id];
+	tsHostFrame *psFrame;
+	tsHostNode *psDst = NULL;
+	bool_t bColl;
+	uint16 i;
+
+	if (bStale(psNode, u32Token)) return;
+	psFrame = psM->psFrame;
+
+	sStats.u32Frames++;
+	bColl = bOverlap(psNode->u16Id, psFrame->u8Channel, psM->u64Start, psM->u64End);
+	if (bColl) {
+		sStats.u32Collisions++;
+	}
+
+	for (i = 0; i < HOST_u16Nodes(); i++) {
+		tsHostNode *psRx = HOST_psNode(i);
+		uint8 u8Lqi;
+
+		if (psRx == psNode || !HOST_bRadioAccept(psRx, psFrame)) continue;
+		if (bColl || !bReceived(psNode, psRx, psFrame->u8Channel, &u8Lqi)) continue;
+
+		HOST_vRadioRx(psRx, psFrame, u8Lqi);
+		if (psFrame->u32DstAddr != TOCONET_MAC_ADDR_BROADCAST) {
+			psDst = psRx;
+		}
+	}
+
+	if (psFrame->u32DstAddr == TOCONET_MAC_ADDR_BROADCAST) {
+		// ブロードキャストは u8Retry 回繰り返す
+		if (psM->u8AppTry < (psFrame->u8Retry & 0x0F)) {
+			psM->u8AppTry++;
+			HOST_vSchedule(HOST_u64Now() + (psFrame->u16RetryDur ? psFrame->u16RetryDur : RETRY_DUR_MS) * HOST_NS_PER_MS,
+					psNode, vCsmaBegin, u32Token, NULL);
+		} else {
+			vFinish(psNode, TRUE);
+		}
+	} else if (!psFrame->bAckReq) {
+		vFinish(psNode, TRUE);
+	} else if (psDst) {
+		uint64 u64AckStart = HOST_u64Now() + TURNAROUND_NS;
+		uint64 u64AckEnd = u64AckStart + ACK_BYTES * BYTE_NS;
+		vAirAdd(psDst->u16Id, psFrame->u8Channel, u64AckStart, u64AckEnd);
+		HOST_vSchedule(u64AckEnd, psNode, vAckEnd, u32Token, psDst);
+	} else {
+		HOST_vSchedule(HOST_u64Now() + ACK_WAIT_NS, psNode, vMacRetry, u32Token, NULL);
+	}
+}
+
+static void vTxBegin(tsHostNode *psNode, uint32 u32Token, void *pvArg)
+{
+	tsSimMac *psM = &asMac[psNode->u16Id];
+
+	if (bStale(psNode, u32Token)) return;
+
+	psM->u64Start = HOST_u64Now();
+	psM->u64End = psM->u64Start + u64Airtime(psM->psFrame);
+	vAirAdd(psNode->u16Id, psM->psFrame->u8Channel, psM->u64Start, psM->u64End);
+	HOST_vSchedule(psM->u64End, psNode, vTxEnd, u32Token, NULL);
+}
+
+static void vBackoff(tsHostNode *psNode, uint32 u32Token);
+
+static void vCca(tsHostNode *psNode, uint32 u32Token, void *pvArg)
+{
+	tsSimMac *psM = &asMac[psNode->u16Id];
+
+	if (bStale(psNode, u32Token)) return;
+
+	if (!bBusy(psM->psFrame->u8Channel, HOST_u64Now())) {
+		HOST_vSchedule(HOST_u64Now() + TURNAROUND_NS, psNode, vTxBegin, u32Token, NULL);
+		return;
+	}
+
+	psM->u8Nb++;
+	if (psM->u8Be < MAX_BE) psM->u8Be++;
+	if (psM->u8Nb > MAX_BACKOFFS) {
+		sStats.u32CcaFail++;
+		vAppRetry(psNode);
+	} else {
+		vBackoff(psNode, u32Token);
+	}
+}
+
+static void vBackoff(tsHostNode *psNode, uint32 u32Token)
+{
+	tsSimMac *psM = &asMac[psNode->u16Id];
+	uint32 u32Slots = HOST_u32Rand() % (1U << psM->u8Be);
+
+	HOST_vSchedule(HOST_u64Now() + u32Slots * BACKOFF_NS + CCA_NS, psNode, vCca, u32Token, NULL);
+}
+
+static void vCsmaBegin(tsHostNode *psNode, uint32 u32Token, void *pvArg)
+{
+	tsSimMac *psM = &asMac[psNode->u16Id];
+
+	if (bStale(psNode, u32Token)) return;
+
+	psM->u8Nb = 0;
+	psM->u8Be = MIN_BE;
+	vBackoff(psNode, u32Token);
+}
+
+static void vChTxStart(tsHostNode *psNode, tsHostFrame *psFrame)
+{
+	tsSimMac *psM = &asMac[psNode->u16Id];
+
+	psM->u32Token++;
+	psM->psFrame = psFrame;
+	psM->u8MacTry = 0;
+	psM->u8AppTry = 0;
+	vCsmaBegin(psNode, psM->u32Token, NULL);
+}
+
+/****************************************************************************
+ * スキャン
+ ****************************************************************************/
+
+static uint8 u8ChCount(uint32 u32ChMask)
+{
+	uint8 i, n = 0;
+	for (i = 0; i < 32; i++) if (u32ChMask & (1UL << i)) n++;
+	return n;
+}
+
+static void vNbScanDone(tsHostNode *psNode, uint32 u32ChMask, void *pvArg)
+{
+	tsToCoNet_NbScan_Result *psR = &psNode->sNbResult;
+	uint16 i;
+
+	for (i = 0; i < HOST_u16Nodes() && psR->u8found < TOCONET_NBSCAN_MAX_RESULT; i++) {
+		tsHostNode *psN = HOST_psNode(i);
+		uint8 u8Lqi;
+
+		if (psN == psNode || !(psN->u32Mods & TOCONET_MOD_NBSCAN_SLAVE)) continue;
+		if (!psN->bPowered || psN->bSleeping || !psN->bMacStarted || psN->bScanning) continue;
+		if (!(u32ChMask & (1UL << psN->u8Channel))) continue;
+		if (psN->sAppContext.u32AppId != psNode->sAppContext.u32AppId) continue;
+		if (!bReceived(psN, psNode, psN->u8Channel, &u8Lqi)) continue;
+
+		psR->sScanResult[psR->u8found].bFound = TRUE;
+		psR->sScanResult[psR->u8found].u8ch = psN->u8Channel;
+		psR->sScanResult[psR->u8found].u8lqi = u8Lqi;
+		psR->sScanResult[psR->u8found].u32addr = psN->u32Serial;
+		psR->sScanResult[psR->u8found].u16ad = psN->sAppContext.u16ShortAddress;
+		psR->u8found++;
+	}
+	HOST_vNbScanDone(psNode);
+}
+
+static void vChNbScan(tsHostNode *psNode, uint32 u32ChMask, uint16 u16Dur)
+{
+	uint64 u64Dur = (uint64)u16Dur * u8ChCount(u32ChMask) * HOST_NS_PER_MS;
+	HOST_vSchedule(HOST_u64NodeNow(psNode) + u64Dur, psNode, vNbScanDone, u32ChMask, NULL);
+}
+
+static void vEnergyScanDone(tsHostNode *psNode, uint32 u32ChMask, void *pvArg)
+{
+	uint16 au16Occupied[16] = { 0 };
+	uint16 j;
+	uint8 i, n = 0;
+
+	for (j = 0; j < HOST_u16Nodes(); j++) {
+		tsHostNode *psN = HOST_psNode(j);
+
+		if (psN == psNode || !(psN->u32Mods & TOCONET_MOD_NBSCAN_SLAVE)) continue;
+		if (!psN->bPowered || !psN->bMacStarted || psN->u8Channel < 11 || psN->u8Channel > 26) continue;
+		au16Occupied[psN->u8Channel - 11] = OCCUPIED_ENERGY;
+	}
+	if (u8JamCh) {
+		au16Occupied[u8JamCh - 11] += u8JamEnergy;
+	}
+	for (i = 0; i < 16; i++) {
+		if (u32ChMask & (1UL << (i + 11))) {
+			uint16 u16E = sConf.au8Noise[i] + au16Occupied[i] + HOST_u32Rand() % 4;
+			psNode->au8EnergyResult[1 + n++] = u16E > 255 ? 255 : u16E;
+		}
+	}
+	psNode->au8EnergyResult[0] = n;
+	HOST_vEnergyScanDone(psNode);
+}
+
+static void vChEnergyScan(tsHostNode *psNode, uint32 u32ChMask, uint8 u8Count)
+{
+	uint64 u64Dur = (uint64)u8Count * u8ChCount(u32ChMask) * 2 * HOST_NS_PER_MS;
+	HOST_vSchedule(HOST_u64NodeNow(psNode) + u64Dur, psNode, vEnergyScanDone, u32ChMask, NULL);
+}
+
+/****************************************************************************
+ * 公開 API
+ ****************************************************************************/
+
+static const tsHostMedium sChannelMedium = {
+	vChTxStart,
+	vChNbScan,
+	vChEnergyScan
+};
+
+PUBLIC void SIM_vChannelInit(const tsSimChannelConf *psConf)
+{
+	sConf = *psConf;
+	memset(&sStats, 0, sizeof(sStats));
+	memset(asMac, 0, sizeof(asMac));
+	u32Air = 0;
+	u32Seed = HOST_u32Rand();
+	u8JamCh = 0;
+}
+
+PUBLIC void SIM_vChannelJam(uint8 u8Ch, uint8 u8Energy, double dLoss)
+{
+	u8JamCh = u8Ch;
+	u8JamEnergy = u8Energy;
+	dJamLoss = dLoss;
+}
+
+PUBLIC const tsHostMedium *SIM_psChannelMedium(void)
+{
+	return &sChannelMedium;
+}
+
+PUBLIC const tsSimChannelStats *SIM_psChannelStats(void)
+{
+	return &sStats;
+}
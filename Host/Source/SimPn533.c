@@ -0,0 +1,254 @@
+/*
+ * SimPn533.c
+ *
+ * Slave の UART に繋がる PN533 (RC-S380 相当) の簡易モデル。
+ *
+ *  - ホストから 00 00 FF LEN LCS ... DCS 00 の通常フレームを受け取り、
+ *    約 0.5ms で ACK、続いて応答フレーム (D5 cmd+1 ...) を返す。
+ *  - InListPassiveTarget (D4 4A) はカードがあれば約 2.5ms で
+ *    D5 4B 01 01 12 01 IDm PMm を、なければ約 4ms で D5 4B 00 を返す。
+ *    RFConfiguration (D4 32 05 xx xx n) の MxRtyPassiveActivation = n なら
+ *    カードがないとき 4ms ごとに n 回まで試し直し、その間に来たカードを返す。
+ *  - それ以外のコマンドは約 1ms で D5 cmd+1 を返す。
+ *  - ACK フレーム (00 00 FF 00 FF 00) を受けると処理中のコマンドを捨てる。
+ *  - 応答は 115200bps で 1 バイトずつ Slave の UART へ送る。
+ *  - PORT_FELICA で電源を切ると、送信予定の応答も含めて全て捨てる。
+ *  - 故障を混ぜられる (dDrop/dStuck/dHang)。コマンドを読み落とす、
+ *    ACK フレームで中断されるまで固まる、電源を入れ直すまで固まる、の 3 通り。
+ *
+ */
+
+#include <string.h>
+
+#include "sim.h"
+
+#define PN533_BYTE_NS    (10 * HOST_NS_PER_S / 115200)
+#define PN533_BOOT_NS    (10 * HOST_NS_PER_MS)
+#define PN533_ACK_NS     (500 * HOST_NS_PER_US)
+#define PN533_CARD_NS    (2500 * HOST_NS_PER_US)
+#define PN533_NOCARD_NS  (4000 * HOST_NS_PER_US)
+#define PN533_CMD_NS     (1000 * HOST_NS_PER_US)
+
+static const uint8 au8Pmm[8] = { 0x01, 0x20, 0x22, 0x04, 0x27, 0x67, 0x4E, 0xFF };
+
+static void vByte(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	tsSimPn533 *psR = (tsSimPn533 *)pvArg;
+
+	if ((u32Arg >> 8) != (psR->u32Token & 0xFFFFFF) || !psR->bPowered) {
+		return;
+	}
+	HOST_vUartRx(psNode, psR->u8Port, (uint8)u32Arg);
+}
+
+static void vSend(tsSimPn533 *psR, uint64 u64At, const uint8 *pu8Data, uint16 u16Len)
+{
+	uint16 i;
+
+	if (psR->u64TxFree < u64At) {
+		psR->u64TxFree = u64At;
+	}
+	for (i = 0; i < u16Len; i++) {
+		psR->u64TxFree += PN533_BYTE_NS;
+		HOST_vSchedule(psR->u64TxFree, psR->psNode, vByte,
+				((psR->u32Token & 0xFFFFFF) << 8) | pu8Data[i], psR);
+	}
+}
+
+static void vSendFrame(tsSimPn533 *psR, uint64 u64At, const uint8 *pu8Data, uint8 u8Len)
+{
+	uint8 au8Buf[5 + 255 + 2];
+	uint8 u8Sum = 0;
+	uint8 i;
+
+	au8Buf[0] = 0x00;
+	au8Buf[1] = 0x00;
+	au8Buf[2] = 0xFF;
+	au8Buf[3] = u8Len;
+	au8Buf[4] = (uint8)-u8Len;
+	for (i = 0; i < u8Len; i++) {
+		au8Buf[5 + i] = pu8Data[i];
+		u8Sum += pu8Data[i];
+	}
+	au8Buf[5 + u8Len] = (uint8)-u8Sum;
+	au8Buf[6 + u8Len] = 0x00;
+	vSend(psR, u64At, au8Buf, 7 + u8Len);
+}
+
+static void vPollResult(tsSimPn533 *psR, uint64 u64At, bool_t bCard)
+{
+	uint8 au8Res[22];
+
+	au8Res[0] = 0xD5;
+	au8Res[1] = 0x4B;
+	if (bCard) {
+		au8Res[2] = 0x01;  // NbTg
+		au8Res[3] = 0x01;  // Tg
+		au8Res[4] = 0x12;  // POL_RES 長
+		au8Res[5] = 0x01;  // 応答コード
+		memcpy(au8Res + 6, psR->au8Idm, 8);
+		memcpy(au8Res + 14, au8Pmm, 8);
+		vSendFrame(psR, u64At, au8Res, 22);
+	} else {
+		au8Res[2] = 0x00;
+		vSendFrame(psR, u64At, au8Res, 3);
+	}
+}
+
+// InListPassiveTarget の試し直し (u32Arg の下位 8 ビットが残り回数)
+static void vPollRetry(tsHostNode *psNode, uint32 u32Arg, void *pvArg)
+{
+	tsSimPn533 *psR = (tsSimPn533 *)pvArg;
+	uint8 u8Left = u32Arg & 0xFF;
+
+	if ((u32Arg >> 8) != (psR->u32Token & 0xFFFFFF) || !psR->bPowered) {
+		return;
+	}
+	psR->u32Polls++;
+	if (psR->bCard) {
+		vPollResult(psR, HOST_u64Now() + PN533_CARD_NS, TRUE);
+	} else if (u8Left == 0) {
+		vPollResult(psR, HOST_u64Now(), FALSE);
+	} else {
+		HOST_vSchedule(HOST_u64Now() + PN533_NOCARD_NS, psNode, vPollRetry,
+				((psR->u32Token & 0xFFFFFF) << 8) | (u8Left - 1), psR);
+	}
+}
+
+static void vCommand(tsSimPn533 *psR, const uint8 *pu8Cmd, uint8 u8Len)
+{
+	static const uint8 au8Ack[6] = { 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00 };
+	uint8 au8Res[32];
+	uint8 u8ResLen;
+	uint64 u64Now = HOST_u64Now();
+	uint64 u64Dur = PN533_CMD_NS;
+
+	double dFault = HOST_u32Rand() / 4294967296.0;
+
+	psR->u32Frames++;
+	if (psR->bStuck) {
+		return;
+	}
+	if (dFault < psR->dHang) {
+		psR->bHung = TRUE;
+		psR->u32Faults++;
+		return;
+	}
+	dFault -= psR->dHang;
+	if (dFault < psR->dDrop) {
+		psR->u32Faults++;
+		return;
+	}
+	dFault -= psR->dDrop;
+	vSend(psR, u64Now + PN533_ACK_NS, au8Ack, sizeof(au8Ack));
+	if (dFault < psR->dStuck) {
+		psR->bStuck = TRUE;
+		psR->u32Faults++;
+		return;
+	}
+
+	au8Res[0] = 0xD5;
+	au8Res[1] = pu8Cmd[1] + 1;
+	u8ResLen = 2;
+
+	if (pu8Cmd[1] == 0x4A) {
+		if (psR->bCard) {
+			psR->u32Polls++;
+			vPollResult(psR, u64Now + PN533_CARD_NS, TRUE);
+		} else {
+			// 1 回目の試行の終わりに残りの回数を見る
+			HOST_vSchedule(u64Now + PN533_NOCARD_NS, psR->psNode, vPollRetry,
+					((psR->u32Token & 0xFFFFFF) << 8) | psR->u8PollRetries, psR);
+		}
+		return;
+	}
+	if (pu8Cmd[1] == 0x32 && u8Len >= 6 && pu8Cmd[2] == 0x05) {
+		psR->u8PollRetries = pu8Cmd[5];
+	}
+	vSendFrame(psR, u64Now + u64Dur, au8Res, u8ResLen);
+}
+
+PUBLIC void SIM_vPn533Init(tsSimPn533 *psR, tsHostNode *psNode, uint8 u8Port)
+{
+	memset(psR, 0, sizeof(tsSimPn533));
+	psR->psNode = psNode;
+	psR->u8Port = u8Port;
+}
+
+PUBLIC void SIM_vPn533Power(tsSimPn533 *psR, bool_t bOn)
+{
+	if (psR->bPowered == bOn) {
+		return;
+	}
+	psR->bPowered = bOn;
+	psR->u32Token++;
+	psR->u16Len = 0;
+	psR->u64TxFree = 0;
+	psR->u8PollRetries = 0;
+	psR->bStuck = FALSE;
+	psR->bHung = FALSE;
+	if (bOn) {
+		psR->u64ReadyAt = HOST_u64Now() + PN533_BOOT_NS;
+	}
+}
+
+PUBLIC void SIM_vPn533Byte(tsSimPn533 *psR, uint8 u8Byte)
+{
+	uint8 *pu8 = psR->au8Frame;
+	uint8 u8Len, u8Sum, i;
+
+	if (!psR->bPowered || HOST_u64Now() < psR->u64ReadyAt || psR->bHung) {
+		return;
+	}
+
+	pu8[psR->u16Len++] = u8Byte;
+
+	// プリアンブル・スタートコード (00 00 FF) で同期する
+	if ((psR->u16Len == 1 && u8Byte != 0x00)
+			|| (psR->u16Len == 2 && u8Byte != 0x00)
+			|| (psR->u16Len == 3 && u8Byte != 0xFF)) {
+		// 00 が続く間は直近の 00 00 を残す
+		psR->u16Len = (u8Byte != 0x00) ? 0 : (psR->u16Len == 3 ? 2 : 1);
+		return;
+	}
+	if (psR->u16Len < 5) {
+		return;
+	}
+
+	u8Len = pu8[3];
+	if (psR->u16Len == 5) {
+		if (u8Len == 0x00 && pu8[4] == 0xFF) {
+			// ACK: 処理中のコマンドを中断 (ポストアンブルは読み捨て)
+			psR->u32Token++;
+			psR->u64TxFree = 0;
+			psR->u16Len = 0;
+			psR->bStuck = FALSE;
+		} else if ((uint8)(u8Len + pu8[4]) != 0 || u8Len < 2) {
+			psR->u32BadFrames++;
+			psR->u16Len = 0;
+		}
+		return;
+	}
+	if (psR->u16Len < 5 + u8Len + 2) {
+		return;
+	}
+
+	u8Sum = 0;
+	for (i = 0; i < u8Len; i++) {
+		u8Sum += pu8[5 + i];
+	}
+	if ((uint8)(u8Sum + pu8[5 + u8Len]) == 0 && pu8[5] == 0xD4) {
+		vCommand(psR, pu8 + 5, u8Len);
+	} else {
+		psR->u32BadFrames++;
+	}
+	psR->u16Len = 0;
+}
+
+PUBLIC void SIM_vPn533Card(tsSimPn533 *psR, const uint8 *pu8Idm)
+{
+	psR->bCard = pu8Idm != NULL;
+	if (pu8Idm) {
+		memcpy(psR->au8Idm, pu8Idm, 8);
+	}
+}
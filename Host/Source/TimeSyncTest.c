@@ -0,0 +1,106 @@
+/*
+ * TimeSyncTest.c
+ *
+ * ネットワーク時刻 (Slave/Source/TimeSync.c) の試験。
+ * Master が Slave より何日も長く動いているとき、u32TickCount_ms が一周するとき、
+ * Master が再起動したときに、Keep-Alive の時刻を 4ms の tick で受けながら
+ * 変換した時刻が Master の時刻から 2ms 以内に収まることを確かめる。
+ *
+ *   usage: TimeSyncTest
+ *
+ * 失敗があれば内容を表示して 1 を返す (make test で実行する)。
+ *
+ */
+
+#include <stdio.h>
+
+#include "TimeSync.h"
+
+#define DAY_MS     (24UL * 3600 * 1000)
+#define KEEP_MS    1000 // Keep-Alive の間隔
+#define TICK_MS    4    // Slave の tick
+#define ERR_MAX_MS 2
+
+static uint32 u32Fail = 0;
+
+#define CHECK(c) do { if (!(c)) { u32Fail++; \
+	fprintf(stderr, "%s:%d: NG: %s\n", __FILE__, __LINE__, #c); } } while (0)
+
+// u32Master を基準に、Slave の時刻で u32Ms だけ Keep-Alive を受け続ける。
+// 最後に変換した時刻と Master の時刻の差の絶対値を返す
+static uint32 u32Run(uint32 u32Master, uint32 u32Local, uint32 u32Ms)
+{
+	uint32 u32Err = 0;
+	uint32 t;
+
+	for (t = 0; t <= u32Ms; t += KEEP_MS) {
+		// Slave の時刻は tick 単位で、受信は送信の 0..TICK_MS-1 ms 後に見える
+		uint32 u32Lag = (t / KEEP_MS * 7) % TICK_MS;
+		uint32 u32Rx = u32Local + t + TIMESYNC_DELAY_MS + u32Lag;
+		int32 i32Err;
+
+		TimeSync_vSample(u32Master + t, u32Rx - u32Rx % TICK_MS);
+		i32Err = (int32)(TimeSync_u32ToNetwork(u32Local + t) - (u32Master + t));
+		u32Err = (uint32)(i32Err < 0 ? -i32Err : i32Err);
+	}
+	return u32Err;
+}
+
+// Master が 40 時間、Slave が 1 秒動いたところ
+static void vTestLongUptime(void)
+{
+	uint32 u32Master = 40 * 3600UL * 1000;
+
+	TimeSync_vInit();
+	TimeSync_vConnected(0x81000001);
+	TimeSync_vSample(u32Master, 1000 + TIMESYNC_DELAY_MS);
+	CHECK(TimeSync_bSynced());
+	CHECK(TimeSync_u32ToNetwork(1000) == u32Master);
+	CHECK(TimeSync_u32ToNetwork(2000) == u32Master + 1000);
+}
+
+// 数日の差で寄せ続けても、合わせ直さずに誤差が収まる
+static void vTestMultiDay(void)
+{
+	TimeSync_vInit();
+	TimeSync_vConnected(0x81000001);
+	CHECK(u32Run(5 * DAY_MS + 12345, 3000, 600000) <= ERR_MAX_MS);
+	CHECK(TimeSync_psStats()->u32Steps == 1);
+	CHECK(TimeSync_psStats()->u16ErrMaxMs <= TICK_MS);
+
+	// Slave の方が長く動いている (オフセットが負)
+	TimeSync_vInit();
+	TimeSync_vConnected(0x81000001);
+	CHECK(u32Run(3000, 6 * DAY_MS + 777, 600000) <= ERR_MAX_MS);
+	CHECK(TimeSync_psStats()->u32Steps == 1);
+}
+
+// Master の時刻が一周をまたぐ
+static void vTestWrap(void)
+{
+	TimeSync_vInit();
+	TimeSync_vConnected(0x81000001);
+	CHECK(u32Run(0xFFFFFFFFUL - 300000, 4000, 600000) <= ERR_MAX_MS);
+	CHECK(TimeSync_psStats()->u32Steps == 1);
+}
+
+// Master の再起動で時刻が戻ると、寄せずに合わせ直す
+static void vTestRestart(void)
+{
+	TimeSync_vInit();
+	TimeSync_vConnected(0x81000001);
+	CHECK(u32Run(3 * DAY_MS, 1000, 60000) <= ERR_MAX_MS);
+	CHECK(u32Run(5000, 1000 + 70000, 60000) <= ERR_MAX_MS);
+	CHECK(TimeSync_psStats()->u32Steps == 2);
+}
+
+int main(void)
+{
+	vTestLongUptime();
+	vTestMultiDay();
+	vTestWrap();
+	vTestRestart();
+
+	printf("TimeSyncTest: %s\n", u32Fail ? "NG" : "ok");
+	return u32Fail ? 1 : 0;
+}
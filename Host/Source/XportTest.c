@@ -0,0 +1,489 @@
+/*
+ * XportTest.c
+ *
+ * タッチパケットの送信確認 (Slave/Source/TxWindow.c と Master/Source/AckTable.c) の試験。
+ * 1 台の Slave と Master の間で、パケットの入れ替わり・欠落・重複、ACK の欠落、
+ * Master の再起動、Slave の他の Master への移動を試し、どのタッチも落とさないこと、
+ * 再起動を挟まなければ同じタッチを 2 回出さないこと、Master の受信リングに
+ * 残っているパケットを ACK しないことを確かめる。MAC の番号による重複の除去
+ * (Master/Source/DupFilter.c) が、再起動した Slave のパケットを落とさないことも確かめる。
+ *
+ *   usage: XportTest [-n rounds] [-S seed]
+ *
+ * 失敗があれば内容を表示して 1 を返す (make test で実行する)。
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "packets.h"
+#include "TxWindow.h"
+#include "SrcTable.h"
+
+#define ADDR       0x81001234
+#define LOG_MAX    32     // Slave の送信待ちログ
+#define FRAME_MAX  2      // 1 フレームに入れるタッチ
+#define FLIGHT_MAX 8      // 無線の中にいるパケット
+#define RING_MAX   16     // Master の受信リング
+#define TOUCH_MAX  100000 // 1 回の試験で作るタッチ
+
+static uint32 u32Fail = 0;
+static uint32 u32Rand = 1;
+
+#define CHECK(c) do { if (!(c)) { u32Fail++; \
+	fprintf(stderr, "%s:%d: NG: %s\n", __FILE__, __LINE__, #c); } } while (0)
+
+typedef struct {
+	uint16 u16Seq;
+	uint8 u8Back; // 窓の先頭が何番前か
+	uint8 u8Count;
+	uint32 au32Touch[FRAME_MAX];
+} tsPkt;
+
+static uint32 u32Now;
+static uint32 au32Log[LOG_MAX]; // Slave のログ (タッチの番号)
+static uint8 u8Log;
+static uint32 u32Touches;       // 作ったタッチ
+static uint8 au8Out[TOUCH_MAX]; // Master が出した回数
+static tsPkt asFlight[FLIGHT_MAX];
+static uint8 u8Flight;
+static tsPkt asRing[RING_MAX];  // まだ UART へ出していないパケット
+static uint8 u8Ring;
+
+static uint32 u32Next(void)
+{
+	// xorshift32
+	u32Rand ^= u32Rand << 13;
+	u32Rand ^= u32Rand >> 17;
+	u32Rand ^= u32Rand << 5;
+	return u32Rand;
+}
+
+// Master の起動 (受信リングは失われる)
+static void vMasterInit(void)
+{
+	SrcTable_vInit();
+	DupFilter_vInit();
+	AckTable_vInit();
+	Roster_vInit();
+	u8Ring = 0;
+}
+
+static bool_t bAccept(uint16 u16Seq, uint16 u16Base)
+{
+	return AckTable_bAccept(SrcTable_u8Get(ADDR, u32Now), u16Seq, u16Base, u32Now);
+}
+
+static void vReset(uint16 u16Seq)
+{
+	TxWindow_vInit(u16Seq);
+	vMasterInit();
+	u8Log = 0;
+	u32Touches = 0;
+	u8Flight = 0;
+	memset(au8Out, 0, sizeof(au8Out));
+}
+
+static void vTouch(void)
+{
+	if (u8Log < LOG_MAX && u32Touches < TOUCH_MAX) {
+		au32Log[u8Log++] = u32Touches++;
+	}
+}
+
+// Slave が次に送るパケット (送るものがなければ FALSE)
+static bool_t bSlaveSend(tsPkt *psP)
+{
+	int8 i8Frame = TxWindow_i8Due(u32Now);
+	uint8 i;
+
+	if (i8Frame < 0) {
+		uint8 u8Count = u8Log - TxWindow_u8Entries();
+		if (u8Count == 0 || !TxWindow_bCanOpen()) {
+			return FALSE;
+		}
+		i8Frame = TxWindow_i8Open(u8Count > FRAME_MAX ? FRAME_MAX : u8Count);
+	}
+	psP->u16Seq = TxWindow_u16Seq(i8Frame);
+	psP->u8Back = psP->u16Seq - TxWindow_u16Base();
+	psP->u8Count = TxWindow_u8Count(i8Frame);
+	for (i = 0; i < psP->u8Count; i++) {
+		psP->au32Touch[i] = au32Log[TxWindow_u8First(i8Frame) + i];
+	}
+	TxWindow_vSent(psP->u16Seq, TRUE, u32Now, 0);
+	return TRUE;
+}
+
+// 無線へ出す (欠落させるなら bLose)
+static void vFly(const tsPkt *psP, bool_t bLose)
+{
+	if (!bLose && u8Flight < FLIGHT_MAX) {
+		asFlight[u8Flight++] = *psP;
+	}
+}
+
+// Master の受信 (リングが一杯なら受け取らない)
+static void vMasterRx(const tsPkt *psP)
+{
+	CHECK(psP->u8Back <= XPORT_ACK_SACK_BITS);
+	if (u8Ring < RING_MAX && bAccept(psP->u16Seq, psP->u16Seq - psP->u8Back)) {
+		asRing[u8Ring++] = *psP;
+	}
+}
+
+// 受信リングの先頭から u8Count 個を UART へ出す
+static void vMasterOut(uint8 u8Count)
+{
+	uint8 i;
+
+	while (u8Count-- && u8Ring) {
+		tsPkt *psP = &asRing[0];
+		for (i = 0; i < psP->u8Count; i++) {
+			if (au8Out[psP->au32Touch[i]] < 0xFF) au8Out[psP->au32Touch[i]]++;
+		}
+		AckTable_vDelivered(SrcTable_u8Find(ADDR), psP->u16Seq, u32Now);
+		memmove(asRing, asRing + 1, --u8Ring * sizeof(tsPkt));
+	}
+}
+
+// 無線の中の u8Index 番目を Master へ届ける (bKeep なら重複として残す)
+static void vLand(uint8 u8Index, bool_t bKeep)
+{
+	tsPkt sP = asFlight[u8Index];
+
+	if (!bKeep) {
+		asFlight[u8Index] = asFlight[--u8Flight];
+	}
+	vMasterRx(&sP);
+}
+
+// ACK を受けたタッチをログから消す
+static void vPop(uint8 u8Pop)
+{
+	CHECK(u8Pop <= u8Log);
+	memmove(au32Log, au32Log + u8Pop, (u8Log - u8Pop) * sizeof(uint32));
+	u8Log -= u8Pop;
+}
+
+// Master の ACK を Slave へ (届けないなら bLose)
+static void vAck(bool_t bLose)
+{
+	uint8 au8Buf[98];
+	uint8 u8Len = AckTable_u8Build(au8Buf, sizeof(au8Buf), u32Now);
+	uint8 i;
+
+	if (u8Len == 0 || bLose) {
+		return;
+	}
+	for (i = 0; i < au8Buf[0]; i++) {
+		const uint8 *p = au8Buf + 1 + i * XPORT_ACK_ENTRY_LEN;
+		uint32 u32Addr = ((uint32)p[0] << 24) | ((uint32)p[1] << 16) | ((uint32)p[2] << 8) | p[3];
+		uint8 j, u8Pop;
+		if (u32Addr != ADDR) {
+			continue;
+		}
+		u8Pop = TxWindow_u8Ack(((uint16)p[4] << 8) | p[5], p[6], u32Now);
+		// ACK を受けたタッチは UART へ出ている
+		for (j = 0; j < u8Pop && j < u8Log; j++) {
+			CHECK(au8Out[au32Log[j]] != 0);
+		}
+		vPop(u8Pop);
+	}
+}
+
+// 損失なしで送り切る。送り切れたら TRUE
+static bool_t bDrain(void)
+{
+	tsPkt sP;
+	uint32 n;
+
+	while (u8Flight) {
+		vLand(0, FALSE);
+	}
+	for (n = 0; n < 1000 && u8Log; n++) {
+		u32Now += TXWINDOW_RTO_MAX_MS;
+		while (bSlaveSend(&sP)) {
+			vMasterRx(&sP);
+		}
+		vMasterOut(RING_MAX);
+		vAck(FALSE);
+	}
+	return u8Log == 0;
+}
+
+// どのタッチも出たか (bOnce なら 1 回だけ)
+static bool_t bAllOut(bool_t bOnce)
+{
+	uint32 i;
+
+	for (i = 0; i < u32Touches; i++) {
+		if (au8Out[i] == 0 || (bOnce && au8Out[i] != 1)) {
+			fprintf(stderr, "touch %u: output %u times\n", i, au8Out[i]);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+// 先に届いた後の番号より前を、初めての送信元でも落とさない
+static void vTestReorder(void)
+{
+	tsPkt asP[4];
+	uint8 i;
+
+	vMasterInit();
+	CHECK(bAccept(101, 100));
+	CHECK(bAccept(100, 100));
+	CHECK(!bAccept(100, 100));
+	CHECK(!bAccept(101, 100));
+
+	vReset(0xFFFE); // 番号の一周もまたぐ
+	for (i = 0; i < 4; i++) {
+		vTouch();
+		CHECK(bSlaveSend(&asP[i]));
+	}
+	vMasterRx(&asP[1]);
+	vMasterRx(&asP[0]);
+	vMasterRx(&asP[3]);
+	vMasterRx(&asP[2]);
+	vMasterRx(&asP[1]);
+	vMasterOut(RING_MAX);
+	vAck(FALSE);
+	CHECK(u8Log == 0);
+	CHECK(bAllOut(TRUE));
+}
+
+// 受信リングに残っているパケットは、再送されても ACK しない
+static void vTestRing(void)
+{
+	tsPkt asP[4];
+	uint8 i;
+
+	vReset(7);
+	for (i = 0; i < 4; i++) {
+		vTouch();
+		CHECK(bSlaveSend(&asP[i]));
+		vMasterRx(&asP[i]);
+	}
+	CHECK(!AckTable_bWaiting());
+	vMasterRx(&asP[0]);
+	vMasterRx(&asP[2]);
+	CHECK(!AckTable_bWaiting() && u8Ring == 4);
+
+	vMasterOut(1);
+	vAck(FALSE);
+	CHECK(u8Log == 3);
+	vMasterRx(&asP[0]); // UART へ出した後の再送には ACK を返す
+	CHECK(AckTable_bWaiting());
+	vMasterRx(&asP[1]);
+	vAck(FALSE);
+	CHECK(u8Log == 3);
+	vMasterOut(RING_MAX);
+	vAck(FALSE);
+	CHECK(u8Log == 0);
+	CHECK(bAllOut(TRUE));
+}
+
+// Master が再起動して、先に送られた番号が後から届く
+static void vTestRestart(void)
+{
+	tsPkt asP[4];
+	uint8 i;
+
+	vReset(500);
+	for (i = 0; i < 4; i++) {
+		vTouch();
+		CHECK(bSlaveSend(&asP[i]));
+	}
+	vMasterRx(&asP[0]);
+	vMasterRx(&asP[1]);
+	vMasterOut(RING_MAX);
+	vAck(TRUE); // ACK は届かない
+
+	vMasterInit();
+	vMasterRx(&asP[3]);
+	vMasterRx(&asP[2]);
+	vMasterRx(&asP[1]);
+	vMasterRx(&asP[0]);
+	vMasterOut(RING_MAX);
+	vAck(FALSE);
+	CHECK(u8Log == 0);
+	CHECK(bAllOut(FALSE));
+	CHECK(au8Out[2] == 1 && au8Out[3] == 1);
+}
+
+// 他の Master へ移って ACK を受け、戻ってくる
+static void vTestMigrate(void)
+{
+	tsPkt sP, asP[4];
+	uint8 i;
+
+	vReset(1000);
+	for (i = 0; i < 3; i++) {
+		vTouch();
+		CHECK(bSlaveSend(&sP));
+		vMasterRx(&sP);
+	}
+	vMasterOut(RING_MAX);
+	vAck(FALSE);
+	CHECK(u8Log == 0);
+
+	// 他の Master が受けた分 (窓の外まで)
+	for (i = 0; i < 40; i++) {
+		vTouch();
+		CHECK(bSlaveSend(&sP));
+		au8Out[sP.au32Touch[0]]++;
+		vPop(TxWindow_u8Ack(sP.u16Seq + 1, 0, u32Now));
+	}
+	CHECK(u8Log == 0);
+
+	// 戻ってきて、入れ替わって届く
+	for (i = 0; i < 4; i++) {
+		vTouch();
+		CHECK(bSlaveSend(&asP[i]));
+	}
+	vMasterRx(&asP[2]);
+	vMasterRx(&asP[3]);
+	vMasterRx(&asP[0]);
+	vMasterRx(&asP[1]);
+	vMasterOut(RING_MAX);
+	vAck(FALSE);
+	CHECK(u8Log == 0);
+	CHECK(bAllOut(TRUE));
+
+	// 窓の中で他の Master が先頭を ACK した
+	for (i = 0; i < 4; i++) {
+		vTouch();
+		CHECK(bSlaveSend(&asP[i]));
+	}
+	au8Out[asP[0].au32Touch[0]]++;
+	au8Out[asP[1].au32Touch[0]]++;
+	vPop(TxWindow_u8Ack(asP[1].u16Seq + 1, 0, u32Now));
+	u32Now += TXWINDOW_RTO_MAX_MS;
+	CHECK(bSlaveSend(&sP) && sP.u16Seq == asP[2].u16Seq && sP.u8Back == 0);
+	vMasterRx(&sP);
+	CHECK(bSlaveSend(&sP) && sP.u16Seq == asP[3].u16Seq);
+	vMasterRx(&sP);
+	vMasterRx(&sP);
+	vMasterOut(RING_MAX);
+	vAck(FALSE);
+	CHECK(u8Log == 0);
+	CHECK(bAllOut(TRUE));
+}
+
+// ACK 待ちの送信元が追い出されても、その位置の新しい送信元の ACK は出さない
+static void vTestEvict(void)
+{
+	uint8 au8Buf[98];
+	uint16 i;
+
+	vMasterInit();
+	CHECK(bAccept(10, 10));
+	AckTable_vDelivered(SrcTable_u8Find(ADDR), 10, u32Now);
+	CHECK(AckTable_bWaiting());
+	for (i = 0; i < SRCTABLE_SOURCES; i++) {
+		SrcTable_u8Get(ADDR + 1 + i, u32Now);
+	}
+	CHECK(SrcTable_u8Find(ADDR) == SRCTABLE_NIL && SrcTable_psStats()->u32Evictions == 1);
+	CHECK(AckTable_u8Build(au8Buf, sizeof(au8Buf), u32Now) == 0);
+	CHECK(!AckTable_bWaiting());
+
+	// 戻ってきたら初めての送信元として扱う
+	CHECK(bAccept(20, 18));
+	CHECK(bAccept(18, 18));
+	AckTable_vDelivered(SrcTable_u8Find(ADDR), 18, u32Now);
+	CHECK(AckTable_u8Build(au8Buf, sizeof(au8Buf), u32Now) == 1 + XPORT_ACK_ENTRY_LEN);
+	CHECK(au8Buf[0] == 1 && au8Buf[5] == 0 && au8Buf[6] == 19 && au8Buf[7] == 0);
+}
+
+// MAC の番号の重複除去。再起動した送信元の番号が前の窓に入っても、間が空けば受け付ける
+static void vTestDupRestart(void)
+{
+	uint8 u8Src;
+	uint8 i;
+
+	vMasterInit();
+	u8Src = SrcTable_u8Get(ADDR, u32Now);
+	for (i = 0; i < 20; i++) {
+		CHECK(DupFilter_bAccept(u8Src, i, u32Now + i));
+	}
+	// MAC の再送
+	CHECK(!DupFilter_bAccept(u8Src, 19, u32Now + 25));
+	CHECK(!DupFilter_bAccept(u8Src, 5, u32Now + 30));
+
+	// 再起動して 0 から送り直す
+	u32Now += 20 + DUPFILTER_EXPIRE_MS + 1;
+	for (i = 0; i < 20; i++) {
+		CHECK(DupFilter_bAccept(u8Src, i, u32Now + i));
+	}
+	CHECK(!DupFilter_bAccept(u8Src, 10, u32Now + 25));
+	CHECK(DupFilter_psStats()->u32Duplicates == 3);
+	u32Now += 1000;
+}
+
+// 入れ替わり・欠落・重複のある無線 (bRestart なら Master の再起動も)
+static void vFuzz(uint32 u32Rounds, bool_t bRestart)
+{
+	uint32 r, n;
+	tsPkt sP;
+
+	for (r = 0; r < u32Rounds; r++) {
+		vReset(u32Next());
+		for (n = 0; n < 2000; n++) {
+			u32Now += 1 + u32Next() % 8;
+			if (u32Next() % 4 == 0) {
+				vTouch();
+			}
+			if (bSlaveSend(&sP)) {
+				vFly(&sP, u32Next() % 5 == 0);
+			}
+			if (u8Flight && u32Next() % 3) {
+				vLand(u32Next() % u8Flight, u32Next() % 10 == 0);
+			}
+			vMasterOut(u32Next() % 3);
+			if (u32Next() % 4 == 0) {
+				vAck(u32Next() % 5 == 0);
+			}
+			if (bRestart && u32Next() % 500 == 0) {
+				vMasterInit();
+			}
+		}
+		if (!bDrain() || !bAllOut(!bRestart)) {
+			u32Fail++;
+			fprintf(stderr, "fuzz: round %u%s: not delivered\n", r, bRestart ? " (restart)" : "");
+			return;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	uint32 u32Rounds = 200;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:S:")) != -1) {
+		switch (opt) {
+		case 'n': u32Rounds = strtoul(optarg, NULL, 0); break;
+		case 'S': u32Rand = strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-n rounds] [-S seed]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (u32Rand == 0) u32Rand = 1;
+
+	vTestReorder();
+	vTestRing();
+	vTestRestart();
+	vTestMigrate();
+	vTestEvict();
+	vTestDupRestart();
+	vFuzz(u32Rounds, FALSE);
+	vFuzz(u32Rounds, TRUE);
+
+	printf("XportTest: %s\n", u32Fail ? "NG" : "ok");
+	return u32Fail ? 1 : 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * host.h
+ *
+ * ToCoNet ホストランタイムの内部 API。
+ *
+ * 仮想時間 (ns 単位) で動く離散事象スケジューラの上に、ノード (1 台の
+ * TWE モジュール) を複数載せる。ファームウェア側から呼ばれる ToCoNet/AHI
+ * 関数は psHost_Cur (現在実行中のノード) に対して作用する。
+ *
+ * 事象には 2 種類ある。
+ *  - ハードウェア事象 (HOST_vSchedule): UART の 1 バイト送出完了や電波の
+ *    到達など、CPU の状態と無関係に指定時刻に処理される。
+ *  - CPU 事象 (HOST_vScheduleCpu): ノードのコールバックを呼ぶ。ノードが
+ *    WAIT_UART_OUTPUT 等でビジーの間は、ビジー終了時刻まで遅延される。
+ *    処理後は cbToCoNet_vMain が呼ばれる。
+ *
+ */
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include "jendefs.h"
+#include "serial.h"
+#include "utils.h"
+#include "ToCoNet.h"
+
+#define HOST_MAX_NODES    1024
+#define HOST_MAX_MACHINES 4
+#define HOST_UART_PORTS   2
+#define HOST_TX_QUEUE     4  // ToCoNet の送信キュー段数
+#define HOST_RX_QUEUE     4  // 受信済み未処理パケットの保持段数
+#define HOST_TICK_MS      4  // u16TickHz = 250
+#define HOST_SHORT_ADDR_NONE 0xFFFE // u16ShortAddress 未設定
+#define HOST_EEP_SEGMENTS    64
+#define HOST_EEP_SEGMENT_LEN 64
+
+#define HOST_NS_PER_US 1000ULL
+#define HOST_NS_PER_MS 1000000ULL
+#define HOST_NS_PER_S  1000000000ULL
+
+typedef struct _tsHostNode tsHostNode;
+
+// ファームウェアのコールバック一式
+typedef struct {
+	void (*pfvColdStart)(bool_t bAfterAhiInit);
+	void (*pfvWarmStart)(bool_t bAfterAhiInit);
+	void (*pfvMain)(void);
+	void (*pfvRxEvent)(tsRxDataApp *pRx);
+	void (*pfvTxEvent)(uint8 u8CbId, uint8 bStatus);
+	void (*pfvNwkEvent)(teEvent eEvent, uint32 u32arg);
+	void (*pfvHwEvent)(uint32 u32DeviceId, uint32 u32ItemBitmap);
+	uint8 (*pfu8HwInt)(uint32 u32DeviceId, uint32 u32ItemBitmap);
+} tsHostApp;
+
+// 無線フレーム (送信要求をそのまま媒体へ渡す)
+typedef struct {
+	uint32 u32AppId;
+	uint8 u8Channel;
+	uint32 u32SrcAddr;
+	uint32 u32DstAddr;
+	bool_t bAckReq;
+	uint8 u8Retry;
+	uint16 u16RetryDur;
+	uint8 u8CbId;
+	uint8 u8Seq;
+	uint8 u8Cmd;
+	uint8 u8Len;
+	uint8 auData[TOCONET_MAX_PAYLOAD];
+} tsHostFrame;
+
+// 無線媒体 (ドライバが実装する)
+typedef struct {
+	// 送信開始。完了時に HOST_vRadioTxDone を呼ぶこと。
+	void (*pfvTxStart)(tsHostNode *psNode, tsHostFrame *psFrame);
+	// スキャン。完了時に HOST_vNbScanDone / HOST_vEnergyScanDone を呼ぶこと。
+	void (*pfvNbScan)(tsHostNode *psNode, uint32 u32ChMask, uint16 u16Dur);
+	void (*pfvEnergyScan)(tsHostNode *psNode, uint32 u32ChMask, uint8 u8Count);
+} tsHostMedium;
+
+// ノード周辺の配線 (ドライバが実装する、NULL 可)
+typedef struct {
+	// UART から 1 バイト送出された (送出完了時刻に呼ばれる)
+	void (*pfvUartTx)(tsHostNode *psNode, uint8 u8Port, uint8 u8Byte);
+	// DIO 出力が変化した
+	void (*pfvDioChange)(tsHostNode *psNode, uint32 u32Before, uint32 u32After);
+	// PWM タイマの設定が変化した
+	void (*pfvTimerChange)(tsHostNode *psNode, tsTimerContext *psTC);
+} tsHostHooks;
+
+typedef struct {
+	uint32 u32TxReq;
+	uint32 u32TxQueueFull;
+	uint32 u32TxOk;
+	uint32 u32TxFail;
+	uint32 u32Rx;
+	uint32 u32RxDrop;
+	uint32 au32UartTxBytes[HOST_UART_PORTS];
+	uint32 au32UartTxDrop[HOST_UART_PORTS];
+	uint32 au32UartRxDrop[HOST_UART_PORTS];
+	uint32 u32TimerWrites;
+	uint32 u32EepWrites;
+	uint32 u32EepErases;
+	uint32 u32CpuEvents;
+	uint64 u64UartWaitNs;
+} tsHostStats;
+
+typedef struct {
+	bool_t bInit;
+	uint8 *pu8RxBuf;
+	uint16 u16RxSize;
+	uint16 u16RxHead;
+	uint16 u16RxCount;
+	uint16 u16TxSize;
+	uint64 u64ByteNs;
+	uint64 u64WireFree; // 最後に積んだバイトの送出完了時刻
+} tsHostUart;
+
+typedef struct {
+	tpfToCoNet_Event_StateMachine pf;
+	tsEvent sEv;
+} tsHostMachine;
+
+typedef struct {
+	tsHostFrame sFrame;
+	uint8 u8Lqi;
+	uint32 u32Tick;
+} tsHostRxEntry;
+
+struct _tsHostNode {
+	uint16 u16Id;
+	uint32 u32Serial;
+	tsHostApp sApp;
+	const tsHostHooks *psHooks;
+	void *pvUser;
+
+	// 電源・CPU
+	bool_t bPowered;
+	bool_t bSleeping;
+	bool_t bRamOff;
+	uint32 u32Epoch;      // スリープ/リセットで進め、古い CPU 事象を無効化する
+	uint64 u64BootNs;
+	uint64 u64Now;        // コールバック実行中のノードローカル時刻
+	uint64 u64BusyUntil;
+	bool_t bUartWake;     // UART 受信による vMain 呼び出しが予約済み
+	uint32 u32Rand;
+
+	// ToCoNet
+	tsToCoNet_AppContext sAppContext;
+	uint32 u32Mods;
+	bool_t bMacStarted;
+	uint8 u8Channel;      // 現在の受信チャネル
+	bool_t bScanning;
+	tsHostMachine asMachine[HOST_MAX_MACHINES];
+	uint8 u8Machines;
+	uint32 u32TickCount;  // ms
+	uint64 u64NextTick;
+
+	// 無線
+	tsHostFrame asTxQueue[HOST_TX_QUEUE];
+	uint8 u8TxHead;
+	uint8 u8TxCount;
+	bool_t bTxActive;
+	tsHostRxEntry asRxQueue[HOST_RX_QUEUE];
+	uint8 u8RxHead;
+	uint8 u8RxCount;
+	tsToCoNet_NbScan_Result sNbResult;
+	uint8 au8EnergyResult[1 + 32];
+
+	// UART
+	tsHostUart asUart[HOST_UART_PORTS];
+
+	// DIO / タイマ
+	uint32 u32DioOut;
+	uint32 u32DioDir;
+	uint32 u32DioIn;
+
+	// EEPROM (電源を切っても残る)
+	uint8 au8Eep[HOST_EEP_SEGMENTS * HOST_EEP_SEGMENT_LEN];
+	uint32 au32EepCycles[HOST_EEP_SEGMENTS]; // セグメントごとの書き換え回数
+
+	tsHostStats sStats;
+};
+
+typedef void (*tpfHostAction)(tsHostNode *psNode, uint32 u32Arg, void *pvArg);
+
+// 実行中ノード (コールバック外では NULL)
+extern tsHostNode *psHost_Cur;
+
+// スケジューラ
+PUBLIC void HOST_vReset(uint32 u32Seed);
+PUBLIC uint64 HOST_u64Now(void);
+PUBLIC uint64 HOST_u64NodeNow(tsHostNode *psNode);
+PUBLIC void HOST_vSchedule(uint64 u64At, tsHostNode *psNode, tpfHostAction pf, uint32 u32Arg, void *pvArg);
+PUBLIC void HOST_vScheduleCpu(uint64 u64At, tsHostNode *psNode, tpfHostAction pf, uint32 u32Arg, void *pvArg);
+PUBLIC bool_t HOST_bStep(uint64 u64Limit);
+PUBLIC void HOST_vRunUntil(uint64 u64End);
+PUBLIC uint32 HOST_u32Rand(void);
+
+// ノード
+PUBLIC tsHostNode *HOST_psNodeCreate(const tsHostApp *psApp, uint32 u32Serial);
+PUBLIC uint16 HOST_u16Nodes(void);
+PUBLIC tsHostNode *HOST_psNode(uint16 u16Id);
+PUBLIC void HOST_vNodePowerOn(tsHostNode *psNode, uint64 u64At);
+PUBLIC void HOST_vNodePowerOff(tsHostNode *psNode, uint64 u64At);
+PUBLIC void HOST_vNodeWake(tsHostNode *psNode, uint64 u64At);
+PUBLIC void HOST_vDispatchEvent(tsHostNode *psNode, teEvent eEvent, uint32 u32arg);
+
+// 無線 (媒体から呼ぶ)
+PUBLIC void HOST_vSetMedium(const tsHostMedium *psMedium);
+PUBLIC bool_t HOST_bRadioAccept(tsHostNode *psNode, const tsHostFrame *psFrame);
+PUBLIC void HOST_vRadioRx(tsHostNode *psNode, const tsHostFrame *psFrame, uint8 u8Lqi);
+PUBLIC void HOST_vRadioTxDone(tsHostNode *psNode, bool_t bStatus);
+PUBLIC void HOST_vNbScanDone(tsHostNode *psNode);
+PUBLIC void HOST_vEnergyScanDone(tsHostNode *psNode);
+
+// UART (ドライバから呼ぶ)
+PUBLIC void HOST_vUartRx(tsHostNode *psNode, uint8 u8Port, uint8 u8Byte);
+PUBLIC void HOST_vUartReset(tsHostNode *psNode);
+
+// 32bit の u32arg に載せるアドレス。ホストでは -no-pie で静的領域に置くこと。
+PUBLIC uint32 HOST_u32Ptr(void *pv);
+
+#endif /* HOST_H_ */
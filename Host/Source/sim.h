@@ -0,0 +1,75 @@
+/*
+ * sim.h
+ *
+ * 複数ノード離散事象シミュレータ (Host/Build/Sim) の内部 API。
+ *
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include "host.h"
+
+/****************************************************************************
+ * 無線チャネルモデル (SimChannel.c)
+ ****************************************************************************/
+
+typedef struct {
+	double dLoss;        // リンクに依らない基本パケットロス率
+	uint8 u8LqiMean;     // リンク LQI の平均
+	uint8 u8LqiSpread;   // リンクごとの LQI のばらつき (±)
+	uint8 u8LqiNoise;    // パケットごとの LQI の揺らぎ (±)
+	uint8 u8LqiMin;      // これ未満の LQI では受信できない
+	uint8 au8Noise[16];  // Energy Scan の値 (ch11..26)
+} tsSimChannelConf;
+
+typedef struct {
+	uint32 u32Frames;     // 送出したフレーム (ACK を除く)
+	uint32 u32Collisions; // 他の送信と重なったフレーム
+	uint32 u32Lost;       // 衝突以外で失われた受信
+	uint32 u32CcaFail;    // チャネルアクセス失敗 (CSMA 打ち切り)
+	uint32 u32MacRetries;
+	uint32 u32AppRetries;
+	uint32 u32AckLost;
+	uint64 u64AirNs;      // 総送信時間
+} tsSimChannelStats;
+
+PUBLIC void SIM_vChannelInit(const tsSimChannelConf *psConf);
+PUBLIC const tsHostMedium *SIM_psChannelMedium(void);
+PUBLIC const tsSimChannelStats *SIM_psChannelStats(void);
+// u8Ch (11..26) に妨害を加える (0 でやめる)
+PUBLIC void SIM_vChannelJam(uint8 u8Ch, uint8 u8Energy, double dLoss);
+
+/****************************************************************************
+ * PN533 (NFC リーダ) モデル (SimPn533.c)
+ ****************************************************************************/
+
+typedef struct {
+	tsHostNode *psNode;
+	uint8 u8Port;
+	bool_t bPowered;
+	uint64 u64ReadyAt;     // 電源投入後に応答できるようになる時刻
+	uint8 au8Frame[300];   // ホストからの受信中フレーム
+	uint16 u16Len;
+	uint64 u64TxFree;      // リーダ側 UART 送信の空き時刻
+	uint32 u32Token;       // 電源断・中断で進め、送信予定の応答を捨てる
+	bool_t bCard;
+	uint8 au8Idm[8];
+	uint8 u8PollRetries;   // RFConfiguration の MxRtyPassiveActivation
+	uint32 u32Polls;       // InListPassiveTarget の試行回数
+	uint32 u32Frames;
+	uint32 u32BadFrames;
+	double dDrop;          // コマンドごとに、ACK も応答も返さない確率
+	double dStuck;         // ACK だけ返し、ACK フレームで中断されるまで何も受け付けない確率
+	double dHang;          // 電源を入れ直すまで何も受け付けない確率
+	bool_t bStuck;
+	bool_t bHung;
+	uint32 u32Faults;      // 起こした故障の数
+} tsSimPn533;
+
+PUBLIC void SIM_vPn533Init(tsSimPn533 *psR, tsHostNode *psNode, uint8 u8Port);
+PUBLIC void SIM_vPn533Power(tsSimPn533 *psR, bool_t bOn);
+PUBLIC void SIM_vPn533Byte(tsSimPn533 *psR, uint8 u8Byte);
+PUBLIC void SIM_vPn533Card(tsSimPn533 *psR, const uint8 *pu8Idm);
+
+#endif /* SIM_H_ */
@@ -0,0 +1,238 @@
+/*
+ * AckTable.c
+ *
+ * Slave ごとの受信窓と ACK (AckTable.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "AckTable.h"
+#include "SrcTable.h"
+#include "../../Common/Source/packets.h"
+
+#define NIL SRCTABLE_NIL
+
+static uint8 u8QHead; // ACK 待ちの列
+static uint8 u8QTail;
+static uint16 u16Queued;
+static uint16 u16Fresh;    // 列のうち新しい ACK の数
+static uint32 u32QueuedAt; // 新しい ACK が来た最初の時刻
+static tsAckTableStats sStats;
+
+static tsAckTableSource *psAck(uint8 i)
+{
+	return &SrcTable_psAt(i)->sAck;
+}
+
+static void vAppend(uint8 i)
+{
+	psAck(i)->bQueued = TRUE;
+	psAck(i)->u8Queue = NIL;
+	if (u8QTail != NIL) psAck(u8QTail)->u8Queue = i; else u8QHead = i;
+	u8QTail = i;
+	u16Queued++;
+}
+
+// 新しい ACK を列に入れる (繰り返しとして列にいれば新しい ACK にする)
+static void vQueue(uint8 i, uint32 u32Now)
+{
+	tsAckTableSource *psA = psAck(i);
+
+	if (psA->bQueued && !psA->u8Repeat) {
+		return;
+	}
+	if (!psA->bQueued) {
+		vAppend(i);
+	}
+	psA->u8Repeat = 0;
+	if (u16Fresh++ == 0) {
+		u32QueuedAt = u32Now;
+	}
+}
+
+void AckTable_vInit()
+{
+	uint16 i;
+
+	memset(&sStats, 0, sizeof(sStats));
+	for (i = 0; i < SrcTable_psStats()->u16Sources; i++) {
+		psAck(i)->bValid = FALSE;
+		psAck(i)->bQueued = FALSE;
+	}
+	u8QHead = NIL;
+	u8QTail = NIL;
+	u16Queued = 0;
+	u16Fresh = 0;
+}
+
+void AckTable_vNew(uint8 u8Src)
+{
+	// ACK 待ちの列にいれば残し、送るときに飛ばす
+	psAck(u8Src)->bValid = FALSE;
+}
+
+// 待っていた番号を受け取った: 続けて受け取っている分も進める
+static void vTake(uint16 *pu16Next, uint8 *pu8Sack)
+{
+	(*pu16Next)++;
+	while (*pu8Sack & 1) {
+		(*pu16Next)++;
+		*pu8Sack >>= 1;
+	}
+	*pu8Sack >>= 1;
+}
+
+// 受信済みの u16Seq の再送: UART へ出し終えていれば ACK を返す
+static bool_t bDuplicate(uint8 i, uint16 u16Seq, uint32 u32Now)
+{
+	tsAckTableSource *psA = psAck(i);
+	int16 i16Diff = (int16)(u16Seq - psA->u16Done);
+
+	sStats.u32Duplicates++;
+	if (i16Diff < 0 || (i16Diff > 0 && i16Diff <= XPORT_ACK_SACK_BITS && (psA->u8DoneSack & (1 << (i16Diff - 1))))) {
+		vQueue(i, u32Now);
+	}
+	return FALSE;
+}
+
+bool_t AckTable_bAccept(uint8 u8Src, uint16 u16Seq, uint16 u16Base, uint32 u32Now)
+{
+	tsAckTableSource *psA = psAck(u8Src);
+	int16 i16Diff;
+
+	if (!psA->bValid) {
+		// 初めてのタッチパケット。先に送られて後から届く番号を落とさないよう、Slave の窓の先頭から待つ
+		psA->u16Next = u16Base;
+		psA->u8Sack = 0;
+		psA->u16Done = u16Base;
+		psA->u8DoneSack = 0;
+		psA->bValid = TRUE;
+	} else {
+		i16Diff = (int16)(u16Seq - psA->u16Next);
+		if (i16Diff > XPORT_ACK_SACK_BITS || i16Diff < -ACKTABLE_BEHIND) {
+			// 窓から大きく外れた (Slave の再起動や、他の Master から戻ってきた): 窓の先頭から作り直す
+			psA->u16Next = u16Base;
+			psA->u8Sack = 0;
+			psA->u16Done = u16Base;
+			psA->u8DoneSack = 0;
+			sStats.u32Resyncs++;
+		}
+	}
+
+	// 窓の先頭より前は Slave が ACK を受けている (他の Master からかもしれない)
+	while ((int16)(u16Base - psA->u16Next) > 0) {
+		vTake(&psA->u16Next, &psA->u8Sack);
+	}
+	while ((int16)(u16Base - psA->u16Done) > 0) {
+		vTake(&psA->u16Done, &psA->u8DoneSack);
+	}
+
+	i16Diff = (int16)(u16Seq - psA->u16Next);
+	if (i16Diff == 0) {
+		vTake(&psA->u16Next, &psA->u8Sack);
+	} else if (i16Diff > 0) {
+		if (psA->u8Sack & (1 << (i16Diff - 1))) {
+			return bDuplicate(u8Src, u16Seq, u32Now);
+		}
+		psA->u8Sack |= 1 << (i16Diff - 1);
+	} else {
+		// ACK が届かずに再送された
+		return bDuplicate(u8Src, u16Seq, u32Now);
+	}
+	sStats.u32Frames++;
+	return TRUE;
+}
+
+void AckTable_vDelivered(uint8 u8Src, uint16 u16Seq, uint32 u32Now)
+{
+	tsAckTableSource *psA;
+	int16 i16Diff;
+
+	if (u8Src == NIL || !psAck(u8Src)->bValid) {
+		return;
+	}
+	psA = psAck(u8Src);
+	i16Diff = (int16)(u16Seq - psA->u16Done);
+	if (i16Diff == 0) {
+		vTake(&psA->u16Done, &psA->u8DoneSack);
+	} else if (i16Diff > 0 && i16Diff <= XPORT_ACK_SACK_BITS) {
+		psA->u8DoneSack |= 1 << (i16Diff - 1);
+	} else {
+		// 受信リングにいる間に窓を作り直した
+		return;
+	}
+	vQueue(u8Src, u32Now);
+}
+
+bool_t AckTable_bWaiting()
+{
+	return u16Fresh != 0;
+}
+
+bool_t AckTable_bDue(uint32 u32Now)
+{
+	return u16Fresh && (u16Fresh >= XPORT_ACK_MAX || u32Now - u32QueuedAt >= ACKTABLE_DELAY_MS);
+}
+
+uint8 AckTable_u8Build(uint8 *pu8Buf, uint8 u8MaxLen, uint32 u32Now)
+{
+	uint8 *p = pu8Buf + 1;
+	uint8 n = 0;
+	uint8 u8Again = NIL; // このブロックに書いて列の最後に入れ直した最初のもの
+	uint8 i;
+
+	if (!u16Queued || u8MaxLen < 1 + XPORT_ACK_ENTRY_LEN) {
+		return 0;
+	}
+	while (u8QHead != NIL && u8QHead != u8Again && n < XPORT_ACK_MAX && 1 + (n + 1) * XPORT_ACK_ENTRY_LEN <= u8MaxLen) {
+		tsSrcEntry *psS = SrcTable_psAt(i = u8QHead);
+		tsAckTableSource *psA = &psS->sAck;
+
+		psA->bQueued = FALSE;
+		u8QHead = psA->u8Queue;
+		u16Queued--;
+		if (u8QHead == NIL) {
+			u8QTail = NIL;
+		}
+		if (!psA->u8Repeat) {
+			u16Fresh--;
+		}
+		if (!psA->bValid) {
+			// 列にいる間に表の位置が新しい送信元に使われた
+			psA->u8Repeat = 0;
+			continue;
+		}
+
+		*p++ = (uint8)(psS->u32Addr >> 24);
+		*p++ = (uint8)(psS->u32Addr >> 16);
+		*p++ = (uint8)(psS->u32Addr >> 8);
+		*p++ = (uint8)psS->u32Addr;
+		*p++ = (uint8)(psA->u16Done >> 8);
+		*p++ = (uint8)psA->u16Done;
+		*p++ = psA->u8DoneSack;
+		n++;
+
+		if (psA->u8Repeat) {
+			psA->u8Repeat--;
+		} else {
+			psA->u8Repeat = ACKTABLE_REPEAT;
+		}
+		if (psA->u8Repeat) {
+			// 失われても再送を待たずに済むよう、次のブロックに空きがあればもう一度載せる
+			vAppend(i);
+			if (u8Again == NIL) u8Again = i;
+		}
+	}
+	if (u16Fresh) {
+		u32QueuedAt = u32Now;
+	}
+	sStats.u32Acks += n;
+	pu8Buf[0] = n;
+	return n ? 1 + n * XPORT_ACK_ENTRY_LEN : 0;
+}
+
+const tsAckTableStats *AckTable_psStats()
+{
+	return &sStats;
+}
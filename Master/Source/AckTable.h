@@ -0,0 +1,69 @@
+/*
+ * AckTable.h
+ *
+ * Slave ごとのタッチパケットの受信窓と、返す ACK。
+ *
+ * 送信元ごとの記録 (SrcTable) に、次に待つ送信番号と、その先
+ * XPORT_ACK_SACK_BITS 個分の受信済みビットを持つ (packets.h を参照)。
+ * 同じ形で UART へ出し終えた番号も持ち、ACK はこちらから作る (受信リングに
+ * 残っているパケットは ACK しない)。UART へ出したら ACK 待ちの列に入れ、
+ * AckTable_u8Build でまとめて 1 つのブロックにする。送った ACK は、他の ACK を
+ * 送るときに空きがあればもう一度載せる (ブロードキャストは失われても再送されない)。
+ * 再送されたパケットは出力しない。UART へ出し終えていれば ACK を返し、
+ * まだ受信リングにあれば出したときの ACK に任せる。
+ * 初めての送信元と、待つ番号から大きく外れた番号 (Slave の再起動など) では
+ * パケットに付いた Slave の送信窓の先頭から待つ (後から届く前の番号を落とさない)。
+ *
+ */
+
+#ifndef ACKTABLE_H_
+#define ACKTABLE_H_
+
+#include <jendefs.h>
+
+#define ACKTABLE_BEHIND  16  // 待つ番号よりこれだけ前までは再送とみなす (Slave の送信窓より広く)
+#define ACKTABLE_DELAY_MS 8  // ACK をまとめるため、最初の ACK 待ちから送るまで待つ時間
+#define ACKTABLE_REPEAT  1   // 送った ACK を後のブロックの空きにもう一度載せる回数
+
+// 送信元ごとの状態 (SrcTable の記録に入る)
+typedef struct {
+	uint16 u16Next;    // 次に待つ番号
+	uint16 u16Done;    // UART へ出していない最も古い番号 (ACK に載せる)
+	uint8 u8Sack;      // bit i: u16Next + 1 + i を受信済み
+	uint8 u8DoneSack;  // bit i: u16Done + 1 + i を UART へ出した
+	bool_t bValid;     // タッチパケットを受け取った (窓がある)
+	bool_t bQueued;    // ACK 待ちの列にいる (表の位置を新しい送信元に使っても残る)
+	uint8 u8Repeat;    // 列にいるのが繰り返しなら残りの回数 (0 なら新しい ACK)
+	uint8 u8Queue;     // ACK 待ちの列の次
+} tsAckTableSource;
+
+typedef struct {
+	uint32 u32Frames;     // 受け取ったパケット
+	uint32 u32Duplicates; // 再送で届いた受信済みのパケット
+	uint32 u32Resyncs;    // 窓を作り直した回数
+	uint32 u32Acks;       // 返した ACK (送信元ごと)
+} tsAckTableStats;
+
+void AckTable_vInit();
+// 表の u8Src の位置を新しい送信元に使うとき (SrcTable から呼ぶ)
+void AckTable_vNew(uint8 u8Src);
+
+// 初めて受け取ったパケットなら TRUE。受信済みなら FALSE を返し、ACK 待ちにする
+// u16Base は Slave の送信窓の先頭 (ACK を受けていない最も古い番号)
+bool_t AckTable_bAccept(uint8 u8Src, uint16 u16Seq, uint16 u16Base, uint32 u32Now);
+
+// 受け取ったパケット (送信番号 u16Seq) を UART へ出したとき (u8Src は SrcTable_u8Find で引き直す)
+void AckTable_vDelivered(uint8 u8Src, uint16 u16Seq, uint32 u32Now);
+
+// 新しい ACK が列にある
+bool_t AckTable_bWaiting();
+
+// ACK を送るとき (最初の ACK 待ちから ACKTABLE_DELAY_MS 経ったか、1 ブロック分溜まった)
+bool_t AckTable_bDue(uint32 u32Now);
+
+// ACK 待ちのブロックを pu8Buf に最大 u8MaxLen バイトで書き、長さを返す (なければ 0)
+uint8 AckTable_u8Build(uint8 *pu8Buf, uint8 u8MaxLen, uint32 u32Now);
+
+const tsAckTableStats *AckTable_psStats();
+
+#endif /* ACKTABLE_H_ */
@@ -0,0 +1,121 @@
+/*
+ * BulkTx.c
+ *
+ * 版のついたオブジェクトの一斉配信 (BulkTx.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "BulkTx.h"
+#include "../../Common/Source/packets.h"
+
+typedef struct {
+	uint8 u8Version;      // 0 なら配っていない
+	const uint8 *pu8Data;
+	uint16 u16Len;
+	uint8 u8Chunks;
+	bool_t bRepair;       // 一通り送り終え、NACK で頼まれた分を送っている
+	uint8 au8Pending[BULK_CHUNKS_MAX / 8]; // 送る予定の区切り
+} tsBulkObject;
+
+static tsBulkObject asObj[BULK_OBJECTS];
+static uint8 u8Turn;  // 次に見るオブジェクト
+static tsBulkTxStats sStats;
+
+void BulkTx_vInit()
+{
+	memset(asObj, 0, sizeof(asObj));
+	u8Turn = 0;
+	memset(&sStats, 0, sizeof(sStats));
+}
+
+void BulkTx_vPublish(uint8 u8Obj, uint8 u8Version, const uint8 *pu8Data, uint16 u16Len)
+{
+	tsBulkObject *psO;
+	uint8 i;
+
+	if (u8Obj == 0 || u8Obj > BULK_OBJECTS) {
+		return;
+	}
+	psO = &asObj[u8Obj - 1];
+	memset(psO, 0, sizeof(tsBulkObject));
+	if (u8Version == 0 || u16Len == 0 || u16Len > BULK_CHUNK * BULK_CHUNKS_MAX) {
+		return;
+	}
+	psO->u8Version = u8Version;
+	psO->pu8Data = pu8Data;
+	psO->u16Len = u16Len;
+	psO->u8Chunks = (u16Len + BULK_CHUNK - 1) / BULK_CHUNK;
+	for (i = 0; i < psO->u8Chunks; i++) {
+		psO->au8Pending[i / 8] |= 1 << (i % 8);
+	}
+}
+
+uint8 BulkTx_u8Version(uint8 u8Obj)
+{
+	return (u8Obj == 0 || u8Obj > BULK_OBJECTS) ? 0 : asObj[u8Obj - 1].u8Version;
+}
+
+void BulkTx_vNack(const uint8 *pu8Data, uint8 u8Len)
+{
+	tsBulkObject *psO;
+	uint8 i;
+
+	if (u8Len < BULK_NACK_HDR_LEN || pu8Data[0] == 0 || pu8Data[0] > BULK_OBJECTS) {
+		return;
+	}
+	psO = &asObj[pu8Data[0] - 1];
+	sStats.u32Nacks++;
+	if (psO->u8Version == 0 || pu8Data[1] != psO->u8Version) {
+		sStats.u32Stale++;
+		return;
+	}
+	// 頼まれた区切りの和を送る予定に加える
+	for (i = 0; i < psO->u8Chunks && BULK_NACK_HDR_LEN + i / 8 < u8Len; i++) {
+		if (pu8Data[BULK_NACK_HDR_LEN + i / 8] & (1 << (i % 8))) {
+			psO->au8Pending[i / 8] |= 1 << (i % 8);
+		}
+	}
+}
+
+uint8 BulkTx_u8Next(uint8 *pu8Out)
+{
+	uint8 n, i;
+
+	for (n = 0; n < BULK_OBJECTS; n++) {
+		tsBulkObject *psO = &asObj[u8Turn];
+		uint8 u8Obj = u8Turn + 1;
+		uint16 u16Ofs, u16Len;
+
+		u8Turn = (u8Turn + 1) % BULK_OBJECTS;
+		if (psO->u8Version == 0) {
+			continue;
+		}
+		for (i = 0; i < psO->u8Chunks && !(psO->au8Pending[i / 8] & (1 << (i % 8))); i++)
+			;
+		if (i == psO->u8Chunks) {
+			// 予定がなくなれば、以後は送り直し
+			psO->bRepair = TRUE;
+			continue;
+		}
+		psO->au8Pending[i / 8] &= ~(1 << (i % 8));
+
+		u16Ofs = (uint16)i * BULK_CHUNK;
+		u16Len = psO->u16Len - u16Ofs < BULK_CHUNK ? psO->u16Len - u16Ofs : BULK_CHUNK;
+		pu8Out[0] = u8Obj;
+		pu8Out[1] = psO->u8Version;
+		pu8Out[2] = i;
+		pu8Out[3] = psO->u8Chunks;
+		memcpy(pu8Out + BULK_HDR_LEN, psO->pu8Data + u16Ofs, u16Len);
+		sStats.u32Chunks++;
+		if (psO->bRepair) sStats.u32Repairs++;
+		return BULK_HDR_LEN + u16Len;
+	}
+	return 0;
+}
+
+const tsBulkTxStats *BulkTx_psStats()
+{
+	return &sStats;
+}
@@ -0,0 +1,42 @@
+/*
+ * BulkTx.h
+ *
+ * 版のついたオブジェクト (有効な IDm の一覧など) の Slave への一斉配信。
+ *
+ * 版を出すとオブジェクトの全区切りを送る予定にし、BulkTx_bNext で 1 つずつ
+ * ブロードキャストする (packets.h の PACKET_CMD_BULK)。届かなかった Slave は
+ * 足りない区切りのビット表を NACK で返し、頼まれた区切りの和だけを送り直す。
+ * 配り終える時間はオブジェクトの大きさで決まり、リーダの数にはほとんど依らない。
+ * オブジェクトの中身は呼び出し側が持ち、版を出している間は書き換えないこと。
+ *
+ */
+
+#ifndef BULKTX_H_
+#define BULKTX_H_
+
+#include <jendefs.h>
+
+#define BULKTX_GAP_MS 8 // 区切りを送る間隔 (TDMA ではビーコンごとに 1 つ)
+
+typedef struct {
+	uint32 u32Chunks;     // 送った区切り
+	uint32 u32Repairs;    // そのうち NACK で頼まれて送り直した区切り
+	uint32 u32Nacks;      // 受けた NACK
+	uint32 u32Stale;      // 版の違う NACK
+} tsBulkTxStats;
+
+void BulkTx_vInit();
+
+// u8Obj (BULK_OBJ_*) の版 u8Version を出す (0 なら配るのをやめる)
+void BulkTx_vPublish(uint8 u8Obj, uint8 u8Version, const uint8 *pu8Data, uint16 u16Len);
+uint8 BulkTx_u8Version(uint8 u8Obj);
+
+// Slave から届いた PACKET_CMD_BULK (NACK) のペイロード
+void BulkTx_vNack(const uint8 *pu8Data, uint8 u8Len);
+
+// 次に送る区切りがあれば PACKET_CMD_BULK のペイロードを pu8Out に書き、長さを返す (なければ 0)
+uint8 BulkTx_u8Next(uint8 *pu8Out);
+
+const tsBulkTxStats *BulkTx_psStats();
+
+#endif /* BULKTX_H_ */
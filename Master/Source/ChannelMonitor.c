@@ -0,0 +1,191 @@
+/*
+ * ChannelMonitor.c
+ *
+ * チャネルの監視 (ChannelMonitor.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "ChannelMonitor.h"
+
+#define FRAC 4 // ノイズの平均の固定小数点 (1/4)
+
+static uint16 au16Noise[CHMON_CH_COUNT]; // チャネルごとのノイズ (×FRAC)
+static uint8 u8Cur;                      // 今のチャネル (0 なら始める前)
+static uint8 u8Next;                     // 次に調べる他のチャネル (添字)
+static bool_t bOwnTurn;                  // 次は今のチャネルを調べる
+static uint8 u8DupPercent;               // 重複パケットの割合 (平均)
+static uint8 au8DupSeen[CHMON_CH_COUNT]; // チャネルごとの、離れたときの重複の割合
+static uint8 u8NoiseOver;                // 今のチャネルのノイズが続けて閾値を超えた回数
+static uint8 u8DupOver;                  // 重複の割合が続けて閾値を超えた秒数
+static uint16 u16Dwell;                  // 次に移ってよくなるまでの秒数
+static tsChannelMonitorStats sStats;
+
+void ChannelMonitor_vInit()
+{
+	u8Cur = 0;
+	memset(&sStats, 0, sizeof(sStats));
+}
+
+void ChannelMonitor_vStart(uint8 u8Ch, const uint8 *pu8Energy)
+{
+	uint8 i;
+
+	for (i = 0; i < CHMON_CH_COUNT; i++) {
+		au16Noise[i] = (uint16)pu8Energy[i] * FRAC;
+	}
+	u8Next = 0;
+	bOwnTurn = TRUE;
+	ChannelMonitor_vSwitched(u8Ch);
+	memset(au8DupSeen, 0, sizeof(au8DupSeen));
+	u16Dwell = 0;
+}
+
+uint8 ChannelMonitor_u8Second(uint16 u16Packets, uint16 u16Duplicates)
+{
+	uint8 u8Ch;
+
+	if (!u8Cur) {
+		return 0;
+	}
+	if (u16Packets >= CHMON_DUP_MIN_PKT) {
+		uint8 u8Pct = (uint32)u16Duplicates * 100 / u16Packets;
+		u8DupPercent = (uint8)(((uint16)u8DupPercent * (CHMON_GAIN - 1) + u8Pct) / CHMON_GAIN);
+	}
+	if (u8DupPercent < CHMON_DUP_HIGH) {
+		u8DupOver = 0;
+	} else if (u8DupOver < 0xFF) {
+		u8DupOver++;
+	}
+	if (u16Dwell) u16Dwell--;
+
+	// 今のチャネルと他のチャネルを交互に調べる
+	bOwnTurn = !bOwnTurn;
+	if (bOwnTurn) {
+		return u8Cur;
+	}
+	if (u8Next + CHMON_CH_BASE == u8Cur) {
+		u8Next = (u8Next + 1) % CHMON_CH_COUNT;
+	}
+	u8Ch = u8Next + CHMON_CH_BASE;
+	u8Next = (u8Next + 1) % CHMON_CH_COUNT;
+	return u8Ch;
+}
+
+void ChannelMonitor_vEnergy(uint8 u8Ch, uint8 u8Energy)
+{
+	uint16 *pu16;
+
+	if (u8Ch < CHMON_CH_BASE || u8Ch >= CHMON_CH_BASE + CHMON_CH_COUNT) {
+		return;
+	}
+	pu16 = &au16Noise[u8Ch - CHMON_CH_BASE];
+	*pu16 = (*pu16 * (CHMON_GAIN - 1) + (uint16)u8Energy * FRAC) / CHMON_GAIN;
+	sStats.u32Samples++;
+
+	if (u8Ch != u8Cur) {
+		return;
+	}
+	if (*pu16 < CHMON_NOISE_HIGH * FRAC) {
+		u8NoiseOver = 0;
+	} else if (u8NoiseOver < 0xFF) {
+		u8NoiseOver++;
+	}
+}
+
+uint8 ChannelMonitor_u8Check(uint8 *pu8Reason)
+{
+	uint16 u16Best = 0xFFFF;
+	uint16 u16Need;
+	uint8 u8Best = 0;
+	uint8 i;
+
+	if (!u8Cur || u16Dwell) {
+		return 0;
+	}
+	if (u8NoiseOver >= CHMON_HOLD_SAMPLES) {
+		*pu8Reason = CHMON_REASON_NOISE;
+		u16Need = CHMON_MARGIN * FRAC;
+	} else if (u8DupOver >= CHMON_HOLD_S) {
+		// 重複が多いだけ (ノイズは見えない) でも、今より静かなチャネルでなければ移らない。
+		// リーダ同士の衝突による重複は、どのチャネルでも減らない
+		*pu8Reason = CHMON_REASON_DUP;
+		u16Need = CHMON_DUP_MARGIN * FRAC;
+	} else {
+		return 0;
+	}
+
+	for (i = 0; i < CHMON_CH_COUNT; i++) {
+		if (i + CHMON_CH_BASE == u8Cur || au16Noise[i] >= u16Best) {
+			continue;
+		}
+		// 重複で移るなら、前にいたとき重複が多かったチャネルは除く
+		if (*pu8Reason == CHMON_REASON_DUP && au8DupSeen[i] >= CHMON_DUP_HIGH) {
+			continue;
+		}
+		u16Best = au16Noise[i];
+		u8Best = i + CHMON_CH_BASE;
+	}
+	if (!u8Best || u16Best + u16Need > au16Noise[u8Cur - CHMON_CH_BASE]) {
+		return 0;
+	}
+	sStats.u16Switches++;
+	return u8Best;
+}
+
+uint8 ChannelMonitor_u8Rescan(const uint8 *pu8Energy)
+{
+	uint16 u16Best = 0xFFFF;
+	uint8 u8Best = 0;
+	uint8 i;
+
+	if (!u8Cur) {
+		return 0;
+	}
+	// 平均はせず、測った値に置き換える。重複の記録も忘れる
+	memset(au8DupSeen, 0, sizeof(au8DupSeen));
+	for (i = 0; i < CHMON_CH_COUNT; i++) {
+		au16Noise[i] = (uint16)pu8Energy[i] * FRAC;
+		if (i + CHMON_CH_BASE != u8Cur && au16Noise[i] < u16Best) {
+			u16Best = au16Noise[i];
+			u8Best = i + CHMON_CH_BASE;
+		}
+	}
+	sStats.u32Samples += CHMON_CH_COUNT;
+	if (u16Best + CHMON_MARGIN * FRAC > au16Noise[u8Cur - CHMON_CH_BASE]) {
+		return 0;
+	}
+	sStats.u16Switches++;
+	return u8Best;
+}
+
+void ChannelMonitor_vSwitched(uint8 u8Ch)
+{
+	if (u8Cur) {
+		au8DupSeen[u8Cur - CHMON_CH_BASE] = u8DupPercent;
+	}
+	u8Cur = u8Ch;
+	u8DupPercent = 0;
+	u8NoiseOver = 0;
+	u8DupOver = 0;
+	u16Dwell = CHMON_DWELL_S;
+}
+
+uint8 ChannelMonitor_u8Noise(uint8 u8Ch)
+{
+	if (u8Ch < CHMON_CH_BASE || u8Ch >= CHMON_CH_BASE + CHMON_CH_COUNT) {
+		return 0;
+	}
+	return au16Noise[u8Ch - CHMON_CH_BASE] / FRAC;
+}
+
+uint8 ChannelMonitor_u8DupPercent()
+{
+	return u8DupPercent;
+}
+
+const tsChannelMonitorStats *ChannelMonitor_psStats()
+{
+	return &sStats;
+}
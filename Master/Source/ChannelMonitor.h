@@ -0,0 +1,63 @@
+/*
+ * ChannelMonitor.h
+ *
+ * 運用中のチャネルの混み具合の監視と、移り先のチャネルの選択。
+ *
+ * 毎秒 1 チャネルずつ短い Energy Scan をかけ (今のチャネルは 1 秒おき、
+ * 他のチャネルは順に)、チャネルごとのノイズを平均しておく。今のチャネルは
+ * 受信に占める重複パケット (ACK を取りこぼした Slave の再送) の割合も見る。
+ * ノイズが CHMON_HOLD_SAMPLES 回続けて、または重複の割合が CHMON_HOLD_S 秒
+ * 続けて閾値を超え、ノイズが CHMON_MARGIN 以上低いチャネル (重複だけが
+ * 多いときは CHMON_DUP_MARGIN 以上低く、前にいたとき重複が多くなかった
+ * チャネル) があれば、最も静かなチャネルへ移るよう知らせる。リーダ同士の
+ * 衝突による重複ではチャネルを渡り歩かないよう、離れたチャネルの重複の割合は
+ * 覚えておく (rescan で忘れる)。移ってから CHMON_DWELL_S 秒は次の切り替えをしない。
+ *
+ */
+
+#ifndef CHANNELMONITOR_H_
+#define CHANNELMONITOR_H_
+
+#include <jendefs.h>
+
+#define CHMON_CH_BASE     11
+#define CHMON_CH_COUNT    16
+#define CHMON_NOISE_HIGH  100 // 今のチャネルのノイズ (Energy Scan の値) の上限
+#define CHMON_DUP_HIGH    20  // 受信に占める重複パケットの割合の上限 (%)
+#define CHMON_DUP_MIN_PKT 5   // 重複の割合を見るのに要る毎秒の受信数
+#define CHMON_MARGIN      30  // 移り先のノイズが今よりこれだけ低いこと
+#define CHMON_DUP_MARGIN  15  // 重複で移るときに、移り先のノイズが今よりこれだけ低いこと
+#define CHMON_GAIN        2   // 1 回の測定で平均を寄せる割合 (1/n)
+#define CHMON_HOLD_SAMPLES 2  // ノイズが閾値を続けて超えた回数
+#define CHMON_HOLD_S      4   // 重複の割合が閾値を続けて超えた秒数
+#define CHMON_DWELL_S     60  // 移ってから次に移ってよくなるまで
+
+#define CHMON_REASON_NOISE 1
+#define CHMON_REASON_DUP   2
+#define CHMON_REASON_RESCAN 3
+
+typedef struct {
+	uint32 u32Samples;  // 運用中の Energy Scan
+	uint16 u16Switches; // 移ると決めた回数
+} tsChannelMonitorStats;
+
+void ChannelMonitor_vInit();
+// 起動時の全チャネルの Energy Scan の結果で監視を始める
+void ChannelMonitor_vStart(uint8 u8Ch, const uint8 *pu8Energy);
+
+// 毎秒呼ぶ。次に調べるチャネルを返す (始める前は 0)
+uint8 ChannelMonitor_u8Second(uint16 u16Packets, uint16 u16Duplicates);
+void ChannelMonitor_vEnergy(uint8 u8Ch, uint8 u8Energy);
+
+// 移るべきなら移り先のチャネル (なければ 0)。pu8Reason に理由を入れる
+uint8 ChannelMonitor_u8Check(uint8 *pu8Reason);
+// 全チャネルを測り直した結果。今より CHMON_MARGIN 以上静かなチャネルがあればそれ (なければ 0)
+uint8 ChannelMonitor_u8Rescan(const uint8 *pu8Energy);
+// 移り終えたとき
+void ChannelMonitor_vSwitched(uint8 u8Ch);
+
+uint8 ChannelMonitor_u8Noise(uint8 u8Ch);
+uint8 ChannelMonitor_u8DupPercent();
+const tsChannelMonitorStats *ChannelMonitor_psStats();
+
+#endif /* CHANNELMONITOR_H_ */
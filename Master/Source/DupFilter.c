@@ -0,0 +1,66 @@
+/*
+ * DupFilter.c
+ *
+ * 送信元ごとの重複パケット除去 (DupFilter.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "DupFilter.h"
+#include "SrcTable.h"
+
+static tsDupFilterStats sStats;
+
+void DupFilter_vInit()
+{
+	memset(&sStats, 0, sizeof(sStats));
+}
+
+void DupFilter_vNew(uint8 u8Src)
+{
+	SrcTable_psAt(u8Src)->sDup.u32Window = 0;
+}
+
+bool_t DupFilter_bAccept(uint8 u8Src, uint8 u8Seq, uint32 u32Now)
+{
+	tsDupFilterSource *psD = &SrcTable_psAt(u8Src)->sDup;
+	int8 i8Diff;
+
+	if (psD->u32Window == 0 || u32Now - psD->u32At > DUPFILTER_EXPIRE_MS) {
+		// 新しい送信元か、しばらく受信がなかった (再送ではありえない)
+		psD->u8Top = u8Seq;
+		psD->u32Window = 1;
+		psD->u32At = u32Now;
+		return TRUE;
+	}
+
+	i8Diff = (int8)(u8Seq - psD->u8Top);
+	if (i8Diff > 0) {
+		// 新しい番号: 窓を進める
+		psD->u32Window = (i8Diff >= DUPFILTER_WINDOW) ? 1 : ((psD->u32Window << i8Diff) | 1);
+		psD->u8Top = u8Seq;
+		psD->u32At = u32Now;
+		return TRUE;
+	}
+	if (-i8Diff >= DUPFILTER_WINDOW) {
+		// 窓より大きく戻った: 送信元が再起動したとみなして窓を作り直す
+		psD->u32Window = 1;
+		psD->u8Top = u8Seq;
+		psD->u32At = u32Now;
+		return TRUE;
+	}
+	if (psD->u32Window & (1UL << -i8Diff)) {
+		sStats.u32Duplicates++;
+		return FALSE;
+	}
+	// 遅れて届いた未受信の番号
+	psD->u32Window |= 1UL << -i8Diff;
+	psD->u32At = u32Now;
+	return TRUE;
+}
+
+const tsDupFilterStats *DupFilter_psStats()
+{
+	return &sStats;
+}
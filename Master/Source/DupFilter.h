@@ -0,0 +1,42 @@
+/*
+ * DupFilter.h
+ *
+ * 送信元ごとの重複パケット除去。
+ *
+ * 送信元ごとの記録 (SrcTable) に、直近のシーケンス番号の窓 (最新値と
+ * 32 個分のビットマップ) を持つ。1 パケットあたりの処理は送信元の数に依らず O(1)。
+ * 重複は MAC の再送なので、最後に受け付けてから DUPFILTER_EXPIRE_MS 過ぎた
+ * パケットは窓を作り直して受け付ける (再起動した送信元の番号が前の窓に
+ * 入っても落とさない)。
+ *
+ */
+
+#ifndef DUPFILTER_H_
+#define DUPFILTER_H_
+
+#include <jendefs.h>
+
+#define DUPFILTER_WINDOW  32  // 送信元ごとに覚えるシーケンス番号の幅
+#define DUPFILTER_EXPIRE_MS 500 // 窓を覚えておく時間 (MAC の再送が続く時間より長く)
+
+// 送信元ごとの状態 (SrcTable の記録に入る)
+typedef struct {
+	uint32 u32Window;  // bit n: u8Top - n を受信済み (0 ならまだ受信なし)
+	uint32 u32At;      // 最後に受け付けた時刻
+	uint8 u8Top;       // 受信した最新のシーケンス番号
+} tsDupFilterSource;
+
+typedef struct {
+	uint32 u32Duplicates; // 除去した重複パケット
+} tsDupFilterStats;
+
+void DupFilter_vInit();
+// 表の u8Src の位置を新しい送信元に使うとき (SrcTable から呼ぶ)
+void DupFilter_vNew(uint8 u8Src);
+
+// 初めて受け取ったパケットなら TRUE、重複なら FALSE
+bool_t DupFilter_bAccept(uint8 u8Src, uint8 u8Seq, uint32 u32Now);
+
+const tsDupFilterStats *DupFilter_psStats();
+
+#endif /* DUPFILTER_H_ */
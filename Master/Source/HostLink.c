@@ -0,0 +1,197 @@
+/*
+ * HostLink.c
+ *
+ * ホストからのコマンドとクレジット (HostLink.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "HostLink.h"
+
+static uint8 au8Line[HOSTLINK_LINE_MAX];
+static uint8 u8LineLen;
+static bool_t bOverflow;     // 長すぎる行を読み捨てている
+static bool_t bStalled;      // クレジットが尽きて止めている
+static uint32 u32HeardAt;    // 最後にコマンドを受けた時刻
+static uint8 au8Idm[8];      // allow <IDm>
+static tsHostLinkStats sStats;
+
+void HostLink_vInit()
+{
+	u8LineLen = 0;
+	bOverflow = FALSE;
+	bStalled = FALSE;
+	memset(&sStats, 0, sizeof(sStats));
+}
+
+// 行の先頭が pcWord (と区切り) なら、その次の位置を返す
+static const uint8 *pu8Word(const uint8 *p, const char *pcWord)
+{
+	while (*pcWord) {
+		if (*p++ != (uint8)*pcWord++) {
+			return NULL;
+		}
+	}
+	if (*p == ' ') {
+		while (*p == ' ') p++;
+	} else if (*p) {
+		return NULL;
+	}
+	return p;
+}
+
+// 行の残りがちょうど pcWord か
+static bool_t bRestIs(const uint8 *p, const char *pcWord)
+{
+	p = pu8Word(p, pcWord);
+	return p != NULL && !*p;
+}
+
+// 行の残りが 16 桁の 16 進なら au8Idm に読む
+static bool_t bIdm(const uint8 *p)
+{
+	uint8 i;
+
+	for (i = 0; i < 16; i++, p++) {
+		uint8 u8Nibble;
+		if (*p >= '0' && *p <= '9') u8Nibble = *p - '0';
+		else if (*p >= 'A' && *p <= 'F') u8Nibble = *p - 'A' + 10;
+		else if (*p >= 'a' && *p <= 'f') u8Nibble = *p - 'a' + 10;
+		else return FALSE;
+		au8Idm[i / 2] = (i & 1) ? (au8Idm[i / 2] | u8Nibble) : (u8Nibble << 4);
+	}
+	while (*p == ' ') p++;
+	return !*p;
+}
+
+static uint8 u8Parse(const uint8 *p, uint16 *pu16Arg)
+{
+	const uint8 *q;
+
+	while (*p == ' ') p++;
+	if ((q = pu8Word(p, "credit")) != NULL) {
+		uint32 u32N = 0;
+		if (bRestIs(q, "off")) {
+			return HOSTCMD_CREDIT_OFF;
+		}
+		if (*q < '0' || *q > '9') {
+			return HOSTCMD_ERROR;
+		}
+		while (*q >= '0' && *q <= '9') {
+			u32N = u32N * 10 + (*q++ - '0');
+			if (u32N > HOSTLINK_CREDIT_MAX) u32N = HOSTLINK_CREDIT_MAX;
+		}
+		while (*q == ' ') q++;
+		if (*q) {
+			return HOSTCMD_ERROR;
+		}
+		*pu16Arg = u32N;
+		return HOSTCMD_CREDIT;
+	}
+	if (bRestIs(p, "stats")) {
+		return HOSTCMD_STATS;
+	}
+	if ((q = pu8Word(p, "format")) != NULL) {
+		if (bRestIs(q, "json")) return HOSTCMD_FORMAT_JSON;
+		if (bRestIs(q, "binary")) return HOSTCMD_FORMAT_BINARY;
+		return HOSTCMD_ERROR;
+	}
+	if (bRestIs(p, "rescan")) {
+		return HOSTCMD_RESCAN;
+	}
+	if ((q = pu8Word(p, "allow")) != NULL) {
+		if (bRestIs(q, "clear")) return HOSTCMD_ALLOW_CLEAR;
+		if (bRestIs(q, "commit")) return HOSTCMD_ALLOW_COMMIT;
+		if (bRestIs(q, "off")) return HOSTCMD_ALLOW_OFF;
+		if (bIdm(q)) return HOSTCMD_ALLOW;
+		return HOSTCMD_ERROR;
+	}
+	return HOSTCMD_ERROR;
+}
+
+uint8 HostLink_u8Char(uint8 u8Char, uint16 *pu16Arg)
+{
+	uint8 u8Cmd;
+
+	if (u8Char != '\r' && u8Char != '\n') {
+		if (u8LineLen < HOSTLINK_LINE_MAX - 1) {
+			au8Line[u8LineLen++] = u8Char;
+		} else {
+			bOverflow = TRUE;
+		}
+		return HOSTCMD_NONE;
+	}
+	if (bOverflow) {
+		u8LineLen = 0;
+		bOverflow = FALSE;
+		sStats.u32Errors++;
+		return HOSTCMD_ERROR;
+	}
+	if (u8LineLen == 0) {
+		// \r\n の \n や空行
+		return HOSTCMD_NONE;
+	}
+	au8Line[u8LineLen] = 0;
+	u8LineLen = 0;
+
+	u8Cmd = u8Parse(au8Line, pu16Arg);
+	if (u8Cmd == HOSTCMD_ERROR) {
+		sStats.u32Errors++;
+	}
+	return u8Cmd;
+}
+
+const uint8 *HostLink_pu8Idm()
+{
+	return au8Idm;
+}
+
+void HostLink_vCommand(uint8 u8Cmd, uint16 u16Arg, uint32 u32Now)
+{
+	u32HeardAt = u32Now;
+	sStats.u32Commands++;
+
+	if (u8Cmd == HOSTCMD_CREDIT) {
+		if (!sStats.bCredit) {
+			sStats.bCredit = TRUE;
+			sStats.u16Credits = 0;
+		}
+		sStats.u16Credits = (uint32)sStats.u16Credits + u16Arg > HOSTLINK_CREDIT_MAX
+				? HOSTLINK_CREDIT_MAX : sStats.u16Credits + u16Arg;
+	} else if (u8Cmd == HOSTCMD_CREDIT_OFF) {
+		sStats.bCredit = FALSE;
+	}
+}
+
+bool_t HostLink_bMaySend(uint32 u32Now)
+{
+	if (!sStats.bCredit || sStats.u16Credits) {
+		bStalled = FALSE;
+		return TRUE;
+	}
+	if (u32Now - u32HeardAt >= HOSTLINK_CREDIT_TIMEOUT_MS) {
+		// ホストが止まったか、クレジットを知らないものに替わった
+		sStats.bCredit = FALSE;
+		sStats.u32Timeouts++;
+		bStalled = FALSE;
+		return TRUE;
+	}
+	if (!bStalled) {
+		bStalled = TRUE;
+		sStats.u32Stalls++;
+	}
+	return FALSE;
+}
+
+void HostLink_vSent()
+{
+	if (sStats.bCredit && sStats.u16Credits) {
+		sStats.u16Credits--;
+	}
+}
+
+const tsHostLinkStats *HostLink_psStats()
+{
+	return &sStats;
+}
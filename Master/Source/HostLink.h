@@ -0,0 +1,78 @@
+/*
+ * HostLink.h
+ *
+ * ホスト (UART の相手) からのコマンドと、出力のクレジットによる流量制御。
+ *
+ * ホストは 1 行 1 コマンドの ASCII を送る (\r または \n で終わり)。
+ *   credit <n>     受け取れる出力を n 件増やす (クレジットによる制御を始める)
+ *   credit off     クレジットによる制御をやめる (既定)
+ *   stats          統計をすぐに出力する
+ *   format json    出力形式を JSON にする
+ *   format binary  出力形式をバイナリフレームにする
+ *   rescan         全チャネルを測り直し、静かなチャネルがあれば移る
+ *   allow clear    有効な IDm の一覧を作り始める
+ *   allow <IDm>    一覧に IDm (16 桁の 16 進) を加える
+ *   allow commit   作った一覧を Slave へ配り始める
+ *   allow off      一覧を配るのをやめる (Slave は判定せずに鳴らす)
+ * allow clear と allow <IDm> の返事には作っている一覧の件数 (idms)、allow commit の
+ * 返事には配る一覧の件数と版 (version) が付く。UART の受信キューは小さいので、
+ * ホストは返事のない allow <IDm> を 2 行までにして送る (Client.send_allowlist)。
+ * クレジットによる制御中は、出力 1 件 (JSON の 1 行、バイナリの 1 フレーム) を
+ * 送るごとにクレジットを 1 つ使い、なくなれば件の区切りで送るのを止める。
+ * 止めている間に送信リングが埋まれば、統計などの低い優先度の出力から捨て、
+ * タッチは受信リングに残して Slave への ACK を遅らせる (Slave が持ち続ける)。
+ * HOSTLINK_CREDIT_TIMEOUT_MS の間クレジットもコマンドも来なければ、
+ * ホストがいなくなったものとして制御をやめる。
+ *
+ */
+
+#ifndef HOSTLINK_H_
+#define HOSTLINK_H_
+
+#include <jendefs.h>
+
+#define HOSTLINK_LINE_MAX          32    // コマンド 1 行の最大長
+#define HOSTLINK_CREDIT_MAX        1024  // 溜めておけるクレジット
+#define HOSTLINK_CREDIT_TIMEOUT_MS 60000 // クレジットが尽きたまま待つ時間
+
+typedef enum {
+	HOSTCMD_NONE = 0,       // 行の途中
+	HOSTCMD_CREDIT,         // 引数はクレジット数
+	HOSTCMD_CREDIT_OFF,
+	HOSTCMD_STATS,
+	HOSTCMD_FORMAT_JSON,
+	HOSTCMD_FORMAT_BINARY,
+	HOSTCMD_RESCAN,
+	HOSTCMD_ALLOW,          // IDm は HostLink_pu8Idm()
+	HOSTCMD_ALLOW_CLEAR,
+	HOSTCMD_ALLOW_COMMIT,
+	HOSTCMD_ALLOW_OFF,
+	HOSTCMD_ERROR           // 読めない行
+} teHostCmd;
+
+typedef struct {
+	bool_t bCredit;       // クレジットによる制御中
+	uint16 u16Credits;    // 残りのクレジット
+	uint32 u32Commands;   // 受け付けたコマンド
+	uint32 u32Errors;     // 読めなかった行
+	uint32 u32Stalls;     // クレジットが尽きて送るのを止めた回数
+	uint32 u32Timeouts;   // ホストからの音沙汰がなく制御をやめた回数
+} tsHostLinkStats;
+
+void HostLink_vInit();
+
+// 受信した 1 文字。行が終わればコマンドを返す (HOSTCMD_CREDIT なら pu16Arg に数)
+uint8 HostLink_u8Char(uint8 u8Char, uint16 *pu16Arg);
+// HOSTCMD_ALLOW の IDm (8 バイト)
+const uint8 *HostLink_pu8Idm();
+// コマンドを実行したとき (credit はここでクレジットを足す)
+void HostLink_vCommand(uint8 u8Cmd, uint16 u16Arg, uint32 u32Now);
+
+// 次の 1 件を送り始めてよいか
+bool_t HostLink_bMaySend(uint32 u32Now);
+// 1 件を送り終えたとき
+void HostLink_vSent();
+
+const tsHostLinkStats *HostLink_psStats();
+
+#endif /* HOSTLINK_H_ */
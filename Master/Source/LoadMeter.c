@@ -0,0 +1,90 @@
+/*
+ * LoadMeter.c
+ *
+ * Master の負荷の計測 (LoadMeter.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "LoadMeter.h"
+
+#define READER_WORDS (LOADMETER_READER_BITS / 32)
+
+static uint16 au16Packets[LOADMETER_WINDOW_S]; // 秒ごとの受信パケット数
+static uint16 au16Touches[LOADMETER_WINDOW_S];
+static uint8 u8Slot;                           // 今数えている秒
+static uint32 au32Readers[2][READER_WORDS];    // [u8Half] が今の区間
+static uint8 u8Half;
+static uint8 u8Second;
+
+void LoadMeter_vInit()
+{
+	memset(au16Packets, 0, sizeof(au16Packets));
+	memset(au16Touches, 0, sizeof(au16Touches));
+	memset(au32Readers, 0, sizeof(au32Readers));
+	u8Slot = 0;
+	u8Half = 0;
+	u8Second = 0;
+}
+
+void LoadMeter_vPacket(uint32 u32SrcAddr, uint8 u8Touches)
+{
+	uint8 u8Bit = (uint8)((u32SrcAddr * 2654435761UL) >> 24);
+
+	if (au16Packets[u8Slot] < 0xFFFF) au16Packets[u8Slot]++;
+	au16Touches[u8Slot] += u8Touches;
+	au32Readers[u8Half][u8Bit / 32] |= 1UL << (u8Bit % 32);
+}
+
+void LoadMeter_vSecond()
+{
+	u8Slot = (u8Slot + 1) % LOADMETER_WINDOW_S;
+	au16Packets[u8Slot] = 0;
+	au16Touches[u8Slot] = 0;
+
+	if (++u8Second >= LOADMETER_READER_S) {
+		u8Second = 0;
+		u8Half ^= 1;
+		memset(au32Readers[u8Half], 0, sizeof(au32Readers[u8Half]));
+	}
+}
+
+uint8 LoadMeter_u8Readers()
+{
+	uint16 u16Count = 0;
+	uint8 i;
+
+	for (i = 0; i < READER_WORDS; i++) {
+		uint32 u32 = au32Readers[0][i] | au32Readers[1][i];
+		while (u32) {
+			u32 &= u32 - 1;
+			u16Count++;
+		}
+	}
+	return u16Count > 255 ? 255 : u16Count;
+}
+
+// 今数えている途中の秒は除いて平均する
+uint16 LoadMeter_u16TouchesPerMin()
+{
+	uint32 u32Sum = 0;
+	uint8 i;
+
+	for (i = 0; i < LOADMETER_WINDOW_S; i++) {
+		if (i != u8Slot) u32Sum += au16Touches[i];
+	}
+	u32Sum = u32Sum * 60 / (LOADMETER_WINDOW_S - 1);
+	return u32Sum > 0xFFFF ? 0xFFFF : u32Sum;
+}
+
+uint16 LoadMeter_u16PacketsPerSec()
+{
+	uint32 u32Sum = 0;
+	uint8 i;
+
+	for (i = 0; i < LOADMETER_WINDOW_S; i++) {
+		if (i != u8Slot) u32Sum += au16Packets[i];
+	}
+	return u32Sum / (LOADMETER_WINDOW_S - 1);
+}
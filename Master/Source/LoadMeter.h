@@ -0,0 +1,33 @@
+/*
+ * LoadMeter.h
+ *
+ * Master の負荷 (タッチを送ってくるリーダの数と受信の頻度) の計測。
+ *
+ * 受信したタッチパケットを秒ごとのバケットに数え、直近 LOADMETER_WINDOW_S
+ * 秒の平均を Keep-Alive で知らせる。リーダ数は送信元アドレスのハッシュを
+ * ビットマップに立てて数える (LOADMETER_READER_S 秒ごとに半分ずつ入れ替え)。
+ *
+ */
+
+#ifndef LOADMETER_H_
+#define LOADMETER_H_
+
+#include <jendefs.h>
+
+#define LOADMETER_WINDOW_S  5   // 受信頻度を平均する秒数
+#define LOADMETER_READER_S  15  // リーダ数を数える区間 (直近 2 区間を合わせる)
+#define LOADMETER_READER_BITS 256
+
+void LoadMeter_vInit();
+
+// タッチパケットを受信したとき (重複は u8Touches = 0 で呼ぶ)
+void LoadMeter_vPacket(uint32 u32SrcAddr, uint8 u8Touches);
+
+// 毎秒呼ぶ
+void LoadMeter_vSecond();
+
+uint8 LoadMeter_u8Readers();
+uint16 LoadMeter_u16TouchesPerMin();
+uint16 LoadMeter_u16PacketsPerSec();
+
+#endif /* LOADMETER_H_ */
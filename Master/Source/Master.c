@@ -20,6 +20,20 @@
 
 #include "../../Common/Source/packets.h"				// パケット
 #include "../../Common/Source/app_event.h"
+#include "../../Common/Source/BinFrame.h"			// バイナリ出力フレーム
+#include "../../Common/Source/Allowlist.h"			// 有効な IDm の一覧
+#include "SrcTable.h"								// Slave ごとの記録の表
+#include "DupFilter.h"								// 重複パケット除去
+#include "AckTable.h"								// タッチパケットの受信窓と ACK
+#include "LoadMeter.h"								// 負荷の計測
+#include "Roster.h"									// リーダごとの受信状況
+#include "ChannelMonitor.h"							// チャネルの監視と切り替え
+#include "HostLink.h"								// ホストからのコマンドとクレジット
+#include "BulkTx.h"									// Slave へのオブジェクトの一斉配信
+#include "../../Common/Source/Profile.h"			// ハンドラの処理時間 (make PROFILE=1)
+#ifdef USE_TDMA
+#include "SlotTable.h"								// TDMA のスロット割り当て
+#endif
 
 // ToCoNet 用パラメータ
 #define APP_ID   0x22FF84B2
@@ -27,12 +41,39 @@
 #define CHANNEL_MASK        0x7FFF800 //ch11~26
 #define CHANNEL_MASK_BASE	11
 #define MASTER_ADDR	0x0000
+// 1 チャネルで無理なく受けられるタッチパケット数 (毎秒)。これで負荷 100% とする
+#ifndef LOAD_PKT_CAPACITY
+#define LOAD_PKT_CAPACITY 50
+#endif
 //0x1FF800 //ch11 to ch20
+// チャネルを移ると知らせてから移るまでの時間 (ms)
+#define CHANNEL_SWITCH_LEAD_MS 2000
+// 移ると知らせている間の Keep-Alive の間隔 (ms)
+#define CHANNEL_SWITCH_KA_MS   200
+
+// 出力形式 (make OUTPUT=BINARY で既定をバイナリにする)
+#define OUTPUT_JSON   0 // 1 行 1 件の JSON
+#define OUTPUT_BINARY 1 // BinFrame.h のフレーム
+#ifdef USE_BINARY_OUTPUT
+#define OUTPUT_MODE_DEFAULT OUTPUT_BINARY
+#else
+#define OUTPUT_MODE_DEFAULT OUTPUT_JSON
+#endif
 
 // ポート定義
 #define PORT_LED_1 1
-#define UART_BAUD 115200 // シリアルのボーレート
+#ifndef UART_BAUD
+#define UART_BAUD 115200 // シリアルのボーレート (make UART_BAUD=... で変える)
+#endif
 #define UART_PORT E_AHI_UART_0
+#define UART_TX_RING_SIZE 2048 // UART 送信リング (2 のべき乗)
+#define UART_LINE_MAX 240      // 1 行の最大長 (reader 行が入る長さ)
+#define UART_RECORD_MAX BINFRAME_ENCODED_MAX(UART_LINE_MAX) // 出力 1 件の最大長
+#define UART_LOW_ROOM (UART_TX_RING_SIZE / 2) // 統計などはこれだけ空いているときだけ積む (残りはタッチ用)
+#define FELICA_RECORD_MAX 120  // タッチ 1 件の出力の最大長 (JSON 行)
+#define RX_RING_SIZE 16        // 受信パケットリング (2 のべき乗)
+#define RX_DATA_MAX 98         // 受信ペイロードの最大長
+#define TX_DATA_MAX 98         // 送信ペイロードの最大長
 
 // デバッグメッセージ
 #undef DBG
@@ -43,7 +84,10 @@
 #define dbg(...)
 #endif
 
-#define echo(...) vfPrintf(&sSerStream, LB __VA_ARGS__)
+// 1 行分を整形して送信リングに積む (入りきらなければ行ごと捨てる)
+#define echo(...) do { u16LineLen = 0; vfPrintf(&sLineStream, LB __VA_ARGS__); vOutputLine(); } while (0)
+// 送信リングが UART_LOW_ROOM だけ空いていなければ積まずに捨てる
+#define bLowRoom() ((uint16)(UART_TX_RING_SIZE - (u16TxTail - u16TxHead)) >= UART_LOW_ROOM)
 
 
 typedef struct {
@@ -58,8 +102,33 @@ typedef struct {
 
 	uint16 u16timerSecond;
 
+	// UART 出力形式 (OUTPUT_JSON / OUTPUT_BINARY)
+	uint8 u8OutputMode;
+
 } tsAppData;
 
+// 受信パケット (コールバックの外で整形するためのコピー)
+typedef struct {
+	uint32 u32SrcAddr;
+	uint8 u8Cmd;
+	uint8 u8Seq;
+	uint8 u8Lqi;
+	uint8 u8Len;
+	uint16 u16XportSeq; // タッチの送信番号 (PACKET_CMD_FELICA)
+	uint32 u32Tick;
+	uint8 au8Data[RX_DATA_MAX];
+} tsRxEntry;
+
+// UART 出力経路の統計
+typedef struct {
+	uint8 u8RxHighWater;   // 受信リングの最大使用数
+	uint32 u32RxDrop;      // 受信リングが一杯で捨てたパケット
+	uint16 u16TxHighWater; // 送信リングの最大使用バイト数
+	uint32 u32TxDrop;      // 送信リングが一杯で捨てた行
+	uint32 u32Shed;        // 送信リングが混んでいて捨てた統計やデバッグ出力
+	uint32 u32Malformed;   // タッチを 1 件も出せなかった壊れたタッチパケット (ACK しない)
+} tsUartStats;
+
 
 
 // 変数
@@ -67,28 +136,158 @@ static tsFILE sSerStream;          // シリアル用ストリーム
 static tsSerialPortSetup sSerPort; // シリアルポートデスクリプタ
 static uint32 u32Seq;              // 送信パケットのシーケンス番号
 static tsAppData sAppData;
-static uint32 u32BeforeSeq = -1;
 static uint32 u32LedTimer = 0;
+static uint8 u8SwitchCh = 0;       // 移ると知らせているチャネル (0 ならなし)
+static uint32 u32SwitchAt;         // 移る時刻
+static uint32 u32AnnounceAt;       // 最後に移ると知らせた時刻
+static bool_t bBgScan = FALSE;     // 運用中の Energy Scan の完了待ち
+static uint8 u8BgCh;               // その Energy Scan のチャネル
+static bool_t bRescanReq = FALSE;  // ホストから全チャネルの測り直しを頼まれた
+static bool_t bRescan = FALSE;     // 運用中の Energy Scan は全チャネル分
+static uint16 u16SecPackets = 0;   // この 1 秒の受信パケット (重複を含む)
+static uint16 u16SecDups = 0;      // そのうちの重複
+static bool_t bAckBusy = FALSE;    // ACK パケットの送信完了待ち
+// 有効な IDm の一覧 (Allowlist.h)。ホストが作っている途中のものと、配っているもの
+static uint8 au8AllowNext[ALLOWLIST_BYTES];
+static uint8 au8Allow[ALLOWLIST_BYTES];
+static uint16 u16AllowNextIdms;
+static uint16 u16AllowIdms;
+static uint8 u8AllowSeq;           // 前の版 (起動ごとに乱数から始め、前の起動の版と取り違えない)
+static bool_t bBulkBusy = FALSE;   // 一斉配信の区切りの送信完了待ち
+static uint8 u8BulkCbId;
+static uint32 u32BulkAt = 0;       // 最後に区切りを送った時刻
+static uint8 u8AckCbId;
+#ifdef USE_TDMA
+static uint32 u32BeaconAt = 0;     // 今のスーパーフレームの始まり
+static uint8 u8Superframe = 0;     // スーパーフレーム番号
+#endif
+
+// 受信リング (cbToCoNet_vRxEvent で積み、cbToCoNet_vMain で取り出す)
+static tsRxEntry asRxRing[RX_RING_SIZE];
+static uint8 u8RxHead = 0;
+static uint8 u8RxTail = 0;
+
+// UART 送信リング
+static uint8 au8TxRing[UART_TX_RING_SIZE];
+static uint16 u16TxHead = 0;
+static uint16 u16TxTail = 0;
+static bool_t bTxMid = FALSE;      // 1 件の途中まで UART へ移した (件の区切りでしかクレジットを見ない)
+
+// echo の整形先
+static tsFILE sLineStream;
+static uint8 au8Line[UART_LINE_MAX];
+static uint16 u16LineLen = 0;
+
+static tsUartStats sUartStats;
+
+static bool_t bTxRingPutChar(uint8 u8Device, uint8 u8Char);
+static bool_t bLinePutChar(uint8 u8Device, uint8 u8Char);
+static void vOutputLine();
+static void vProcessRxRing();
 
 
 // デバッグ出力用に UART を初期化
 static void vSerialInit() {
 	static uint8 au8SerialTxBuffer[96];
-	static uint8 au8SerialRxBuffer[32];
+	static uint8 au8SerialRxBuffer[64];
 
 	sSerPort.pu8SerialRxQueueBuffer = au8SerialRxBuffer;
 	sSerPort.pu8SerialTxQueueBuffer = au8SerialTxBuffer;
 	sSerPort.u32BaudRate = UART_BAUD;
+#ifdef USE_UART_FLOW
+	// RTS/CTS: ホストが CTS を下げれば送るのを止め、受信キューが埋まりかければ RTS を下げる
+	sSerPort.bUseHwFlowControl = TRUE;
+	sSerPort.u16AHI_UART_RTS_LOW = sizeof(au8SerialRxBuffer) / 4;
+	sSerPort.u16AHI_UART_RTS_HIGH = sizeof(au8SerialRxBuffer) * 3 / 4;
+#else
 	sSerPort.u16AHI_UART_RTS_LOW = 0xffff;
 	sSerPort.u16AHI_UART_RTS_HIGH = 0xffff;
+#endif
 	sSerPort.u16SerialRxQueueSize = sizeof(au8SerialRxBuffer);
 	sSerPort.u16SerialTxQueueSize = sizeof(au8SerialTxBuffer);
 	sSerPort.u8SerialPort = UART_PORT;
 	sSerPort.u8RX_FIFO_LEVEL = E_AHI_UART_FIFO_LEVEL_1;
 	SERIAL_vInit(&sSerPort);
 
-	sSerStream.bPutChar = SERIAL_bTxChar;
+	// 出力はいったん送信リングに積み、cbToCoNet_vMain で UART へ流す
+	sSerStream.bPutChar = bTxRingPutChar;
 	sSerStream.u8Device = UART_PORT;
+	sLineStream.bPutChar = bLinePutChar;
+	sLineStream.u8Device = UART_PORT;
+}
+
+// 送信リングへ 1 件分を積む。入りきらなければ何も積まない
+static bool_t bTxRingWrite(const uint8 *pu8Data, uint16 u16Len)
+{
+	uint16 u16Used = u16TxTail - u16TxHead;
+	uint16 i;
+
+	if (u16Len > UART_TX_RING_SIZE - u16Used) {
+		sUartStats.u32TxDrop++;
+		return FALSE;
+	}
+	for (i = 0; i < u16Len; i++) {
+		au8TxRing[u16TxTail++ & (UART_TX_RING_SIZE - 1)] = pu8Data[i];
+	}
+
+	u16Used += u16Len;
+	if (u16Used > sUartStats.u16TxHighWater) {
+		sUartStats.u16TxHighWater = u16Used;
+	}
+	return TRUE;
+}
+
+// ToCoNet のデバッグ出力用
+static bool_t bTxRingPutChar(uint8 u8Device, uint8 u8Char)
+{
+	return bTxRingWrite(&u8Char, 1);
+}
+
+static bool_t bLinePutChar(uint8 u8Device, uint8 u8Char)
+{
+	if (u16LineLen >= UART_LINE_MAX) {
+		return FALSE;
+	}
+	au8Line[u16LineLen++] = u8Char;
+	return TRUE;
+}
+
+// echo で整形した行を出力形式に合わせて送信リングへ積む
+static void vOutputLine()
+{
+	if (sAppData.u8OutputMode == OUTPUT_BINARY) {
+		uint8 au8Frame[UART_RECORD_MAX];
+		bTxRingWrite(au8Frame, BinFrame_u16Encode(BINFRAME_TYPE_TEXT, au8Line, u16LineLen, au8Frame));
+	} else {
+		bTxRingWrite(au8Line, u16LineLen);
+	}
+}
+
+// 送信リングから UART の送信キューへ、空いている分だけ移す
+// (クレジットによる制御中は、クレジットが尽きたら件の区切りで止める)
+static void vTxRingPump()
+{
+	uint8 u8End = sAppData.u8OutputMode == OUTPUT_BINARY ? BINFRAME_DELIMITER : '\n';
+
+	while (u16TxHead != u16TxTail) {
+		uint8 u8Char = au8TxRing[u16TxHead & (UART_TX_RING_SIZE - 1)];
+		if (!bTxMid && !HostLink_bMaySend(u32TickCount_ms)) {
+			break;
+		}
+		if (!SERIAL_bTxChar(UART_PORT, u8Char)) {
+			break;
+		}
+		u16TxHead++;
+		if (u8Char == u8End) {
+			// JSON の行頭の改行 (LB) は件に数えない
+			if (bTxMid) {
+				HostLink_vSent();
+			}
+			bTxMid = FALSE;
+		} else if (u8Char != '\r' || sAppData.u8OutputMode == OUTPUT_BINARY) {
+			bTxMid = TRUE;
+		}
+	}
 }
 
 static void vInitPort()
@@ -110,7 +309,22 @@ static void vInitHardware()
 }
 
 
-// Keep-Aliveの送信
+// 負荷 (%)。受信の頻度と UART 送信リングの埋まり具合の大きい方
+static uint8 u8Load()
+{
+	uint32 u32Rx = (uint32)LoadMeter_u16PacketsPerSec() * KEEPALIVE_LOAD_FULL / LOAD_PKT_CAPACITY;
+	uint32 u32Uart = (uint32)(uint16)(u16TxTail - u16TxHead) * KEEPALIVE_LOAD_FULL / UART_TX_RING_SIZE;
+	uint32 u32Load = u32Rx > u32Uart ? u32Rx : u32Uart;
+#ifdef USE_TDMA
+	// スロットが埋まれば、それ以上のリーダは競合スロットでしか送れない
+	uint32 u32Slots = (uint32)SlotTable_psStats()->u16Slots * KEEPALIVE_LOAD_FULL / TDMA_MAX_SLOTS;
+	if (u32Load < u32Slots) u32Load = u32Slots;
+#endif
+
+	return u32Load > KEEPALIVE_LOAD_FULL ? KEEPALIVE_LOAD_FULL : u32Load;
+}
+
+// Keep-Aliveの送信 (TDMA ではスーパーフレームの始まりを知らせるビーコン)
 static bool_t sendKeepAlive(){
 	tsTxDataApp tsTx;
 	memset(&tsTx, 0, sizeof(tsTxDataApp));
@@ -123,7 +337,30 @@ static bool_t sendKeepAlive(){
 	tsTx.u8CbId = u32Seq & 0xFF;
 	tsTx.u8Seq = u32Seq & 0xFF;
 	tsTx.u8Cmd = PACKET_CMD_KEEP_ALIVE;
-	tsTx.u8Len = 1;
+	tsTx.u8Len = KEEPALIVE_LEN;
+	tsTx.auData[0] = u8Load();
+	tsTx.auData[1] = LoadMeter_u8Readers();
+	tsTx.auData[2] = LoadMeter_u16TouchesPerMin() >> 8;
+	tsTx.auData[3] = LoadMeter_u16TouchesPerMin() & 0xFF;
+	tsTx.auData[4] = u32TickCount_ms >> 24;
+	tsTx.auData[5] = u32TickCount_ms >> 16;
+	tsTx.auData[6] = u32TickCount_ms >> 8;
+	tsTx.auData[7] = u32TickCount_ms;
+	tsTx.auData[10] = BulkTx_u8Version(BULK_OBJ_ALLOWLIST);
+	if (u8SwitchCh) {
+		int32 i32Left = (int32)(u32SwitchAt - u32TickCount_ms);
+		tsTx.auData[8] = u8SwitchCh;
+		tsTx.auData[9] = i32Left > 0 ? i32Left / KEEPALIVE_SWITCH_UNIT_MS : 0;
+		u32AnnounceAt = u32TickCount_ms;
+	}
+#ifdef USE_TDMA
+	tsTx.auData[KEEPALIVE_LEN] = u8Superframe++;
+	tsTx.auData[KEEPALIVE_LEN + 1] = SlotTable_u8Cycle();
+	tsTx.auData[KEEPALIVE_LEN + 2] = SlotTable_u8Grants(tsTx.auData + TDMA_BEACON_HDR, TDMA_GRANTS_MAX);
+	tsTx.u8Len = TDMA_BEACON_HDR + tsTx.auData[KEEPALIVE_LEN + 2] * TDMA_GRANT_LEN;
+#endif
+	// 空いている分に ACK を載せる
+	tsTx.u8Len += AckTable_u8Build(tsTx.auData + tsTx.u8Len, TX_DATA_MAX - tsTx.u8Len, u32TickCount_ms);
 	u32Seq++;
 
 	// 送信
@@ -131,19 +368,359 @@ static bool_t sendKeepAlive(){
 }
 
 
+// 溜まった ACK をまとめてブロードキャストで送る
+// (TDMA ではビーコンに載せ、載りきらなければビーコンのスロットで続けて送る)
+static void sendAck()
+{
+	tsTxDataApp tsTx;
+
+	memset(&tsTx, 0, sizeof(tsTxDataApp));
+
+	tsTx.u32SrcAddr = ToCoNet_u32GetSerial();
+	tsTx.u32DstAddr = TOCONET_MAC_ADDR_BROADCAST;
+	tsTx.bAckReq = FALSE;
+	tsTx.u8Retry = 0x00;
+	tsTx.u8CbId = u32Seq & 0xFF;
+	tsTx.u8Seq = u32Seq & 0xFF;
+	tsTx.u8Cmd = PACKET_CMD_ACK;
+	tsTx.u8Len = AckTable_u8Build(tsTx.auData, TX_DATA_MAX, u32TickCount_ms);
+	if (tsTx.u8Len == 0) {
+		// 列にいた送信元が追い出されていた
+		return;
+	}
+	u32Seq++;
+
+	// 送信が終わるまで次を送らない (混んでいるほど 1 パケットにまとまる)
+	bAckBusy = ToCoNet_bMacTxReq(&tsTx);
+	u8AckCbId = tsTx.u8CbId;
+}
+
+// 一斉配信 (BulkTx.h) の区切りがあれば 1 つ送る
+// (TDMA ではビーコンのスロットで、ビーコンと ACK に続けて)
+static void sendBulk()
+{
+	tsTxDataApp tsTx;
+
+	memset(&tsTx, 0, sizeof(tsTxDataApp));
+	tsTx.u8Len = BulkTx_u8Next(tsTx.auData);
+	if (tsTx.u8Len == 0) {
+		return;
+	}
+
+	tsTx.u32SrcAddr = ToCoNet_u32GetSerial();
+	tsTx.u32DstAddr = TOCONET_MAC_ADDR_BROADCAST;
+	tsTx.bAckReq = FALSE;
+	tsTx.u8Retry = 0x00;
+	tsTx.u8CbId = u32Seq & 0xFF;
+	tsTx.u8Seq = u32Seq & 0xFF;
+	tsTx.u8Cmd = PACKET_CMD_BULK;
+	u32Seq++;
+
+	bBulkBusy = ToCoNet_bMacTxReq(&tsTx);
+	u8BulkCbId = tsTx.u8CbId;
+	u32BulkAt = u32TickCount_ms;
+}
+
+// u8SwitchCh へ移ると知らせ始める
+static void vAnnounceSwitch(uint8 u8Reason)
+{
+	// 接続中の Slave が一緒に移れるよう、しばらく Keep-Alive で知らせる
+	u32SwitchAt = u32TickCount_ms + CHANNEL_SWITCH_LEAD_MS;
+	echo("{ \"type\": \"channel_switch\", \"from\": %d, \"to\": %d, \"reason\": \"%s\", \"noise\": %d, \"dup_pct\": %d }\r\n",
+			sAppData.u8channel, u8SwitchCh,
+			u8Reason == CHMON_REASON_NOISE ? "noise" : u8Reason == CHMON_REASON_DUP ? "retry" : "rescan",
+			ChannelMonitor_u8Noise(sAppData.u8channel), ChannelMonitor_u8DupPercent());
+#ifndef USE_TDMA
+	sendKeepAlive();
+#endif
+}
+
+// 毎秒、今のチャネルの様子を見て、移るか 1 チャネル分の Energy Scan をかける
+// (ホストから頼まれていれば全チャネル分)
+static void vChannelSecond()
+{
+	uint8 u8Ch = ChannelMonitor_u8Second(u16SecPackets, u16SecDups);
+	uint8 u8Reason;
+
+	u16SecPackets = 0;
+	u16SecDups = 0;
+	if (!u8Ch || u8SwitchCh || bBgScan) {
+		return;
+	}
+
+	u8SwitchCh = ChannelMonitor_u8Check(&u8Reason);
+	if (u8SwitchCh) {
+		vAnnounceSwitch(u8Reason);
+		return;
+	}
+
+	if (bRescanReq) {
+		// 全チャネル分なので 64ms ほど受信できない (Slave は送り直す)
+		bRescanReq = FALSE;
+		bBgScan = bRescan = ToCoNet_EnergyScan_bStart(CHANNEL_MASK, 2);
+		return;
+	}
+
+	// 受信できないのは数 ms だけ
+	bBgScan = ToCoNet_EnergyScan_bStart(1UL << u8Ch, 1);
+	u8BgCh = u8Ch;
+}
+
+// 全チャネルを測り直し終えたとき
+static void vRescanDone(const uint8 *pu8Result)
+{
+	if (pu8Result[0] == CHMON_CH_COUNT) {
+		u8SwitchCh = ChannelMonitor_u8Rescan(pu8Result + 1);
+	}
+	if (u8SwitchCh) {
+		vAnnounceSwitch(CHMON_REASON_RESCAN);
+	} else {
+		echo("{ \"type\": \"rescan\", \"channel\": %d, \"noise\": %d }\r\n",
+				sAppData.u8channel, ChannelMonitor_u8Noise(sAppData.u8channel));
+	}
+}
+
+// 知らせた時刻になったらチャネルを移る
+static void vChannelTick()
+{
+	if (!u8SwitchCh) {
+		return;
+	}
+	if ((int32)(u32TickCount_ms - u32SwitchAt) >= 0) {
+		sAppData.u8channel = u8SwitchCh;
+		sToCoNet_AppContext.u8Channel = u8SwitchCh;
+		ToCoNet_vRfConfig();
+		ChannelMonitor_vSwitched(u8SwitchCh);
+		u8SwitchCh = 0;
+		echo("{ \"type\": \"channel\", \"channel\": %d }\r\n", sAppData.u8channel);
+		return;
+	}
+#ifndef USE_TDMA
+	if (u32TickCount_ms - u32AnnounceAt >= CHANNEL_SWITCH_KA_MS) {
+		sendKeepAlive();
+	}
+#endif
+}
+
+// 毎秒、リーダごとの受信状況を数件ずつ出力する (タッチの出力を妨げないよう、送信リングが半分空いているときだけ)
+static void vRosterSecond()
+{
+	uint16 n = Roster_u16ReportsDue();
+
+	while (n--) {
+		if (!bLowRoom()) {
+			sUartStats.u32Shed += n + 1;
+			break;
+		}
+		uint16 u16Tpm;
+		uint32 u32Addr;
+		const tsRosterReader *psR = Roster_psReport(u32TickCount_ms, &u32Addr, &u16Tpm);
+		if (psR == NULL) {
+			break;
+		}
+		// health は Slave の健全性の記録 [送信, 失敗, NFC のリセット, スキャンの失敗]
+		u16LineLen = 0;
+		vfPrintf(&sLineStream, LB "{ \"type\": \"reader\", \"macaddress\": \"%08X\", \"age\": %u, \"lqi\": %d, "
+				"\"lqi_hist\": [%d, %d, %d, %d], \"rx\": %u, \"lost\": %u, \"dup\": %d, \"touches_per_min\": %d, ",
+				u32Addr, (u32TickCount_ms - psR->u32LastSeen) / 1000, psR->u16Lqi8 / 8,
+				psR->au8LqiHist[0], psR->au8LqiHist[1], psR->au8LqiHist[2], psR->au8LqiHist[3],
+				psR->u16Received, psR->u16Lost, psR->u16Duplicates, u16Tpm);
+		if (psR->bHealth) {
+			vfPrintf(&sLineStream, "\"health\": [%d, %d, %d, %d] }\r\n",
+					psR->u16Tx, psR->u16TxFail, psR->u16NfcResets, psR->u16ScanFails);
+		} else {
+			vfPrintf(&sLineStream, "\"health\": null }\r\n");
+		}
+		vOutputLine();
+	}
+}
+
+#ifdef USE_PROFILE
+// 毎秒、処理時間の表を 1 項目ずつ出力する (Profile.h。時間は us、hist は log2 の区間)
+static void vProfileSecond()
+{
+	tsProfileEntry sE;
+
+	if (!bLowRoom() || !Profile_bReport(&sE)) {
+		return;
+	}
+	echo("{ \"type\": \"profile\", \"site\": %d, \"state\": %d, \"event\": %d, \"calls\": %u, "
+			"\"min_us\": %u, \"avg_us\": %u, \"max_us\": %u, "
+			"\"hist\": [%d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d], \"overflows\": %u }\r\n",
+			sE.u8Site, sE.u16State, sE.u16Event, sE.u32Calls, sE.u32Min / PROFILE_COUNTS_PER_US,
+			sE.u32Sum / sE.u32Calls / PROFILE_COUNTS_PER_US, sE.u32Max / PROFILE_COUNTS_PER_US,
+			sE.au16Hist[0], sE.au16Hist[1], sE.au16Hist[2], sE.au16Hist[3], sE.au16Hist[4], sE.au16Hist[5],
+			sE.au16Hist[6], sE.au16Hist[7], sE.au16Hist[8], sE.au16Hist[9], sE.au16Hist[10], sE.au16Hist[11],
+			Profile_u32Overflows());
+}
+#endif
+
+// 統計をまとめて出力する (10 秒ごとと、ホストの stats コマンド)
+static void vOutputStats()
+{
+	echo("{ \"type\": \"uart\", \"rx_hwm\": %d, \"rx_drop\": %d, \"tx_hwm\": %d, \"tx_drop\": %d, \"shed\": %d, \"malformed\": %d }\r\n",
+			sUartStats.u8RxHighWater, sUartStats.u32RxDrop,
+			sUartStats.u16TxHighWater, sUartStats.u32TxDrop, sUartStats.u32Shed, sUartStats.u32Malformed);
+	echo("{ \"type\": \"host\", \"credit\": %s, \"credits\": %d, \"stalls\": %d, \"timeouts\": %d, \"commands\": %d, \"errors\": %d }\r\n",
+			HostLink_psStats()->bCredit ? "true" : "false", HostLink_psStats()->u16Credits,
+			HostLink_psStats()->u32Stalls, HostLink_psStats()->u32Timeouts,
+			HostLink_psStats()->u32Commands, HostLink_psStats()->u32Errors);
+	echo("{ \"type\": \"allow\", \"version\": %d, \"idms\": %d, \"chunks\": %d }\r\n",
+			BulkTx_u8Version(BULK_OBJ_ALLOWLIST), BulkTx_u8Version(BULK_OBJ_ALLOWLIST) ? u16AllowIdms : 0,
+			BulkTx_psStats()->u32Chunks);
+	echo("{ \"type\": \"bulk\", \"chunks\": %d, \"repairs\": %d, \"nacks\": %d, \"stale\": %d }\r\n",
+			BulkTx_psStats()->u32Chunks, BulkTx_psStats()->u32Repairs,
+			BulkTx_psStats()->u32Nacks, BulkTx_psStats()->u32Stale);
+	echo("{ \"type\": \"dedup\", \"sources\": %d, \"duplicates\": %d, \"evictions\": %d }\r\n",
+			SrcTable_psStats()->u16Sources, DupFilter_psStats()->u32Duplicates,
+			SrcTable_psStats()->u32Evictions);
+	echo("{ \"type\": \"clock\", \"tick\": %u }\r\n", u32TickCount_ms);
+	echo("{ \"type\": \"transport\", \"sources\": %d, \"frames\": %d, \"duplicates\": %d, \"resyncs\": %d, \"acks\": %d }\r\n",
+			SrcTable_psStats()->u16Sources, AckTable_psStats()->u32Frames,
+			AckTable_psStats()->u32Duplicates, AckTable_psStats()->u32Resyncs,
+			AckTable_psStats()->u32Acks);
+	echo("{ \"type\": \"load\", \"load\": %d, \"readers\": %d, \"touches_per_min\": %d }\r\n",
+			u8Load(), LoadMeter_u8Readers(), LoadMeter_u16TouchesPerMin());
+	echo("{ \"type\": \"rf\", \"channel\": %d, \"noise\": %d, \"dup_pct\": %d, \"switches\": %d }\r\n",
+			sAppData.u8channel, ChannelMonitor_u8Noise(sAppData.u8channel),
+			ChannelMonitor_u8DupPercent(), ChannelMonitor_psStats()->u16Switches);
+#ifdef USE_TDMA
+	echo("{ \"type\": \"tdma\", \"slots\": %d, \"cycle\": %d, \"joins\": %d, \"expired\": %d, \"refused\": %d }\r\n",
+			SlotTable_psStats()->u16Slots, SlotTable_u8Cycle(), SlotTable_psStats()->u32Joins,
+			SlotTable_psStats()->u32Expired, SlotTable_psStats()->u32Refused);
+#endif
+}
+
+// ホストからのコマンドを読んで実行する
+static void vHostInput()
+{
+	int16 i16Char;
+	PROFILE_BEGIN(PROFILE_SERIAL, 0, 0);
+
+	while ((i16Char = SERIAL_i16RxChar(UART_PORT)) >= 0) {
+		uint16 u16Arg = 0;
+		uint8 u8Cmd = HostLink_u8Char(i16Char, &u16Arg);
+		const char *pcCmd = NULL;
+		const char *pcResult = "ok";
+
+		switch (u8Cmd) {
+		case HOSTCMD_NONE:
+			continue;
+		case HOSTCMD_CREDIT:
+		case HOSTCMD_CREDIT_OFF:
+			// クレジットには返事をしない (返事がクレジットを使ってしまう)
+			HostLink_vCommand(u8Cmd, u16Arg, u32TickCount_ms);
+			continue;
+		case HOSTCMD_STATS:
+			pcCmd = "stats";
+			vOutputStats();
+			break;
+		case HOSTCMD_FORMAT_JSON:
+		case HOSTCMD_FORMAT_BINARY:
+			pcCmd = "format";
+			sAppData.u8OutputMode = u8Cmd == HOSTCMD_FORMAT_JSON ? OUTPUT_JSON : OUTPUT_BINARY;
+			break;
+		case HOSTCMD_ALLOW:
+			pcCmd = "allow";
+			Allowlist_vAdd(au8AllowNext, HostLink_pu8Idm());
+			u16AllowNextIdms++;
+			break;
+		case HOSTCMD_ALLOW_CLEAR:
+			pcCmd = "allow";
+			Allowlist_vClear(au8AllowNext);
+			u16AllowNextIdms = 0;
+			break;
+		case HOSTCMD_ALLOW_COMMIT:
+			// 版を進めると、Slave は区切りか次の Keep-Alive で受け取り始める
+			pcCmd = "allow";
+			memcpy(au8Allow, au8AllowNext, ALLOWLIST_BYTES);
+			u16AllowIdms = u16AllowNextIdms;
+			if (++u8AllowSeq == 0) u8AllowSeq = 1;
+			BulkTx_vPublish(BULK_OBJ_ALLOWLIST, u8AllowSeq, au8Allow, ALLOWLIST_BYTES);
+			break;
+		case HOSTCMD_ALLOW_OFF:
+			pcCmd = "allow";
+			BulkTx_vPublish(BULK_OBJ_ALLOWLIST, 0, NULL, 0);
+			break;
+		case HOSTCMD_RESCAN:
+			pcCmd = "rescan";
+			if (u8SwitchCh || bRescanReq || bRescan) {
+				pcResult = "busy";
+			} else {
+				// 次の毎秒の処理で、Energy Scan が空いていればかける
+				bRescanReq = TRUE;
+			}
+			break;
+		default:
+			pcCmd = "unknown";
+			pcResult = "error";
+			break;
+		}
+		if (u8Cmd != HOSTCMD_ERROR) {
+			HostLink_vCommand(u8Cmd, u16Arg, u32TickCount_ms);
+		}
+		if (u8Cmd == HOSTCMD_ALLOW || u8Cmd == HOSTCMD_ALLOW_CLEAR) {
+			// 受け取った件数を返す (ホストはこれを見て次の行を送る。UART の受信キューは小さい)
+			echo("{ \"type\": \"command\", \"command\": \"%s\", \"result\": \"%s\", \"idms\": %d }\r\n",
+					pcCmd, pcResult, u16AllowNextIdms);
+		} else if (u8Cmd == HOSTCMD_ALLOW_COMMIT) {
+			echo("{ \"type\": \"command\", \"command\": \"%s\", \"result\": \"%s\", \"idms\": %d, \"version\": %d }\r\n",
+					pcCmd, pcResult, u16AllowIdms, u8AllowSeq);
+		} else {
+			echo("{ \"type\": \"command\", \"command\": \"%s\", \"result\": \"%s\" }\r\n", pcCmd, pcResult);
+		}
+	}
+	PROFILE_END();
+}
 
 // ユーザ定義のイベントハンドラ
 static void vProcessEvCore(tsEvent *pEv, teEvent eEvent, uint32 u32evarg)
 {
+	PROFILE_BEGIN(PROFILE_CORE, pEv->eState, eEvent);
+
 	//	static int i = 0;
 	if (eEvent == E_EVENT_TICK_SECOND) {
 		sAppData.u16timerSecond += 1;
+		LoadMeter_vSecond();
+		if (pEv->eState == E_STATE_IDLE) {
+			vChannelSecond();
+		}
+#ifdef USE_TDMA
+		SlotTable_vSecond();
+#else
 		if((sAppData.u16timerSecond % 3)== 0){
 			sendKeepAlive();
 		}
+#endif
+		vRosterSecond();
+#ifdef USE_PROFILE
+		vProfileSecond();
+#endif
+		if((sAppData.u16timerSecond % 10)== 0){
+			if (bLowRoom()) {
+				vOutputStats();
+			} else {
+				sUartStats.u32Shed++;
+			}
+		}
 	}
 
 	if (eEvent == E_EVENT_TICK_TIMER) {
+		vChannelTick();
+#ifdef USE_TDMA
+		if (u32TickCount_ms - u32BeaconAt >= TDMA_SUPERFRAME_MS) {
+			// 遅れたときは詰めずに今から数え直す
+			u32BeaconAt = (u32TickCount_ms - u32BeaconAt < 2 * TDMA_SUPERFRAME_MS)
+					? u32BeaconAt + TDMA_SUPERFRAME_MS : u32TickCount_ms;
+			sendKeepAlive();
+			if (!bAckBusy && AckTable_bWaiting()) {
+				sendAck();
+			}
+			if (!bBulkBusy) {
+				sendBulk();
+			}
+		}
+#endif
 		u32LedTimer -= 4; //ms
 		if (u32LedTimer >= 0){
 			vPortSetLo(PORT_LED_1);
@@ -187,7 +764,6 @@ static void vProcessEvCore(tsEvent *pEv, teEvent eEvent, uint32 u32evarg)
 				dbg("\n\rCh%d is selected.", sAppData.u8channel);
 				echo("{ \"type\": \"channel\", \"channel\": %d }\r\n", sAppData.u8channel);
 
-				WAIT_UART_OUTPUT(UART_PORT);
 				//Ch変更
 				sToCoNet_AppContext.u8Channel = sAppData.u8channel;
 				ToCoNet_vRfConfig();
@@ -204,6 +780,7 @@ static void vProcessEvCore(tsEvent *pEv, teEvent eEvent, uint32 u32evarg)
 		default:
 			break;
 	}
+	PROFILE_END();
 }
 
 //
@@ -213,7 +790,20 @@ static void vProcessEvCore(tsEvent *pEv, teEvent eEvent, uint32 u32evarg)
 // 割り込み発生後に随時呼び出される
 void cbToCoNet_vMain(void)
 {
-
+	PROFILE_BEGIN(PROFILE_MAIN, 0, 0);
+
+	vHostInput();
+	vProcessRxRing();
+	vTxRingPump();
+#ifndef USE_TDMA
+	if (!bAckBusy && AckTable_bDue(u32TickCount_ms)) {
+		sendAck();
+	}
+	if (!bBulkBusy && u32TickCount_ms - u32BulkAt >= BULKTX_GAP_MS) {
+		sendBulk();
+	}
+#endif
+	PROFILE_END();
 	return;
 }
 
@@ -227,55 +817,318 @@ void idm2Hex(uint8 *idm, uint8 *buf){
 }
 
 
-// パケット受信時
-void cbToCoNet_vRxEvent(tsRxDataApp *pRx) {
-	//dbg("packet incoming");
-	u32LedTimer = 100; //ms
-	if (u32BeforeSeq != pRx->u8Seq)
+// タッチ 1 件を出力する (u32Time はタッチを読んだ時刻。Master の時刻で表す)
+static void vOutputFelica(tsRxEntry *psRx, uint8 *pu8Idm, uint32 u32Time, bool_t bBatch)
+{
+	if (sAppData.u8OutputMode == OUTPUT_BINARY)
+	{
+		tsBinFrameFelica sF;
+		uint8 au8Body[BINFRAME_FELICA_LEN];
+		uint8 au8Frame[BINFRAME_ENCODED_MAX(BINFRAME_FELICA_LEN)];
+
+		sF.u32SrcAddr = psRx->u32SrcAddr;
+		memcpy(sF.au8Idm, pu8Idm, 8);
+		sF.u8Seq = psRx->u8Seq;
+		sF.u8Lqi = psRx->u8Lqi;
+		sF.u32Tick = u32Time;
+		BinFrame_vPackFelica(&sF, au8Body);
+		bTxRingWrite(au8Frame, BinFrame_u16Encode(BINFRAME_TYPE_FELICA, au8Body, sizeof(au8Body), au8Frame));
+	}
+	else
 	{
+		uint8 buf[17] = {0};
+		idm2Hex(pu8Idm, buf);
+		if (bBatch) {
+			echo("{ \"type\": \"felica\", \"macaddress\": \"%08X\", \"idm\": \"%s\", \"time\": %u, \"age\": %d }\r\n",
+					psRx->u32SrcAddr, buf, u32Time, (int32)(psRx->u32Tick - u32Time));
+		} else {
+			echo("{ \"type\": \"felica\", \"macaddress\": \"%08X\", \"idm\": \"%s\", \"time\": %u }\r\n",
+					psRx->u32SrcAddr, buf, u32Time);
+		}
+	}
+}
 
+// Slave のデバッグログ (LogRecord.h) を読まずにそのまま出力する
+static void vOutputLog(tsRxEntry *psRx)
+{
+	uint8 u8Len = psRx->u8Len > LOG_FRAME_MAX ? LOG_FRAME_MAX : psRx->u8Len;
+
+	if (sAppData.u8OutputMode == OUTPUT_BINARY)
+	{
+		uint8 au8Body[4 + LOG_FRAME_MAX];
+		uint8 au8Frame[BINFRAME_ENCODED_MAX(4 + LOG_FRAME_MAX)];
+
+		au8Body[0] = psRx->u32SrcAddr >> 24;
+		au8Body[1] = psRx->u32SrcAddr >> 16;
+		au8Body[2] = psRx->u32SrcAddr >> 8;
+		au8Body[3] = psRx->u32SrcAddr;
+		memcpy(au8Body + 4, psRx->au8Data, u8Len);
+		bTxRingWrite(au8Frame, BinFrame_u16Encode(BINFRAME_TYPE_LOG, au8Body, 4 + u8Len, au8Frame));
+	}
+	else
+	{
+		uint8 buf[LOG_FRAME_MAX * 2 + 1];
+		uint8 i;
+		for (i = 0; i < u8Len; i++) {
+			buf[i * 2] = (((psRx->au8Data[i] >> 4) > 9) ? ('A' - 10) : '0') + (psRx->au8Data[i] >> 4);
+			buf[i * 2 + 1] = (((psRx->au8Data[i] & 0x0f) > 9) ? ('A' - 10) : '0') + (psRx->au8Data[i] & 0x0f);
+		}
+		buf[u8Len * 2] = 0;
+		echo("{ \"type\": \"log\", \"macaddress\": \"%08X\", \"data\": \"%s\" }\r\n", psRx->u32SrcAddr, buf);
+	}
+}
 
-		if (pRx->u8Cmd == PACKET_CMD_DEBUG)
+// まとめ送りの件数 (1 件の形式なら 1、壊れていれば 0)
+static uint8 u8FelicaCount(tsRxEntry *psRx)
+{
+	if (psRx->u8Len == FELICA_IDM_LEN) {
+		return 1;
+	}
+	if (psRx->u8Len >= 1 && psRx->au8Data[0] <= FELICA_BATCH_MAX
+			&& psRx->u8Len == FELICA_BATCH_LEN(psRx->au8Data[0])) {
+		return psRx->au8Data[0];
+	}
+	if (psRx->u8Len >= 1 && (psRx->au8Data[0] & FELICA_TIMED)
+			&& (psRx->au8Data[0] & ~FELICA_TIMED) <= FELICA_TIMED_MAX
+			&& psRx->u8Len == FELICA_TIMED_LEN(psRx->au8Data[0] & ~FELICA_TIMED)) {
+		return psRx->au8Data[0] & ~FELICA_TIMED;
+	}
+	return 0;
+}
+
+// 受信リングのパケットを整形して送信リングへ積む
+static void vProcessRxRing()
+{
+	while (u8RxHead != u8RxTail) {
+		tsRxEntry *psRx = &asRxRing[u8RxHead & (RX_RING_SIZE - 1)];
+		uint16 u16Need = UART_RECORD_MAX;
+
+		if (psRx->u8Cmd == PACKET_CMD_FELICA) {
+			u16Need = u8FelicaCount(psRx) * FELICA_RECORD_MAX;
+		}
+
+		// デバッグ出力は、混んでいれば後ろのタッチを待たせずに捨てる
+		if ((psRx->u8Cmd == PACKET_CMD_DEBUG || psRx->u8Cmd == PACKET_CMD_LOG) && !bLowRoom()) {
+			sUartStats.u32Shed++;
+			u8RxHead++;
+			continue;
+		}
+
+		// 送信リングに空きがなければ、次の vMain まで受信リングに残す
+		if ((uint16)(UART_TX_RING_SIZE - (u16TxTail - u16TxHead)) < u16Need) {
+			break;
+		}
+
+		if (psRx->u8Cmd == PACKET_CMD_DEBUG)
 		{
-			char buf[99];
-			memcpy(buf, pRx->auData, pRx->u8Len);
-			buf[pRx->u8Len] = 0;
-			echo("{ \"type\": \"debug\", \"macaddress\": \"%08X\", \"message\": \"%s\"}\r\n", pRx->u32SrcAddr, buf);
+			char buf[RX_DATA_MAX + 1];
+			memcpy(buf, psRx->au8Data, psRx->u8Len);
+			buf[psRx->u8Len] = 0;
+			echo("{ \"type\": \"debug\", \"macaddress\": \"%08X\", \"message\": \"%s\"}\r\n", psRx->u32SrcAddr, buf);
 		}
 
-		if (pRx->u8Cmd == PACKET_CMD_FELICA)
+		if (psRx->u8Cmd == PACKET_CMD_LOG)
 		{
-			uint8 idm[8];
-			uint8 buf[17] = {0};
-			memcpy(idm, pRx->auData, 8);
-			idm2Hex(idm, buf);
-			echo("{ \"type\": \"felica\", \"macaddress\": \"%08X\", \"idm\": \"%s\" }\r\n", pRx->u32SrcAddr, buf);
-			WAIT_UART_OUTPUT(UART_PORT);
+			vOutputLog(psRx);
 		}
 
-		u32BeforeSeq = pRx->u8Seq;
+		if (psRx->u8Cmd == PACKET_CMD_FELICA && psRx->u8Len == FELICA_IDM_LEN)
+		{
+			vOutputFelica(psRx, psRx->au8Data, psRx->u32Tick, FALSE);
+		}
+		else if (psRx->u8Cmd == PACKET_CMD_FELICA && (psRx->au8Data[0] & FELICA_TIMED))
+		{
+			// 時刻付きのまとめ送り (Slave が Master の時刻に合わせてある)
+			uint8 i, u8Count = u8FelicaCount(psRx);
+			uint8 *p = psRx->au8Data + 1;
+			for (i = 0; i < u8Count; i++, p += FELICA_TIMED_ENTRY_LEN) {
+				vOutputFelica(psRx, p, ((uint32)p[FELICA_IDM_LEN] << 24) | ((uint32)p[FELICA_IDM_LEN + 1] << 16)
+						| ((uint32)p[FELICA_IDM_LEN + 2] << 8) | p[FELICA_IDM_LEN + 3], TRUE);
+			}
+		}
+		else if (psRx->u8Cmd == PACKET_CMD_FELICA)
+		{
+			// まとめ送りを 1 件ずつに分ける (経過時間から読んだ時刻を推定する)
+			uint8 i, u8Count = u8FelicaCount(psRx);
+			uint8 *p = psRx->au8Data + 1;
+			for (i = 0; i < u8Count; i++, p += FELICA_BATCH_ENTRY_LEN) {
+				vOutputFelica(psRx, p, psRx->u32Tick - (((uint16)p[FELICA_IDM_LEN] << 8) | p[FELICA_IDM_LEN + 1]), TRUE);
+			}
+		}
+		if (psRx->u8Cmd == PACKET_CMD_FELICA && u16Need == 0) {
+			// 出力できなかったものは ACK しない (Slave はタッチを捨てずに持ち続ける)
+			sUartStats.u32Malformed++;
+		} else if (psRx->u8Cmd == PACKET_CMD_FELICA) {
+			// 送信リングに積んでから ACK を返す
+			AckTable_vDelivered(SrcTable_u8Find(psRx->u32SrcAddr), psRx->u16XportSeq, u32TickCount_ms);
+		}
 
+		u8RxHead++;
 	}
+}
 
+// Slave が送るパケットか (他の Master の Keep-Alive・ACK・一斉配信の区切りは FALSE)
+static bool_t bFromSlave(tsRxDataApp *pRx)
+{
+	switch (pRx->u8Cmd) {
+	case PACKET_CMD_FELICA:
+	case PACKET_CMD_LOG:
+	case PACKET_CMD_DEBUG:
+	case PACKET_CMD_HEALTH:
+	case PACKET_CMD_JOIN:
+		return TRUE;
+	case PACKET_CMD_BULK:
+		// Slave の NACK は宛先付き、Master の区切りはブロードキャスト
+		return pRx->u32DstAddr != TOCONET_MAC_ADDR_BROADCAST;
+	default:
+		return FALSE;
+	}
+}
+
+// パケット受信時の処理 (受信リングに積むだけで、UART は待たない)
+static void vRxPacket(tsRxDataApp *pRx)
+{
+	bool_t bNew;
+	uint16 u16Seq = 0;
+	uint8 u8Src;
+
+	//dbg("packet incoming");
+	u32LedTimer = 100; //ms
+	if (!bFromSlave(pRx)) {
+		// 近くの Master のパケットはリーダの記録にも受信リングにも入れない
+		return;
+	}
+	u8Src = SrcTable_u8Get(pRx->u32SrcAddr, u32TickCount_ms);
+	bNew = DupFilter_bAccept(u8Src, pRx->u8Seq, u32TickCount_ms);
+	Roster_vPacket(u8Src, pRx->u8Seq, pRx->u8Lqi, bNew, u32TickCount_ms);
+#ifdef USE_TDMA
+	if (pRx->u8Cmd == PACKET_CMD_JOIN) {
+		if (pRx->u8Len >= 1 && pRx->auData[0] == TDMA_JOIN_REQUEST) {
+			SlotTable_i16Join(pRx->u32SrcAddr);
+		} else {
+			SlotTable_vHeard(pRx->u32SrcAddr);
+		}
+		return;
+	}
+	SlotTable_vHeard(pRx->u32SrcAddr);
+#endif
+	if (u16SecPackets < 0xFFFF) u16SecPackets++;
+	if (bNew)
+	{
+		uint8 *pu8Data = pRx->auData;
+		uint8 u8Len = pRx->u8Len;
+
+		if (pRx->u8Cmd == PACKET_CMD_HEALTH) {
+			Roster_vHealth(u8Src, pu8Data, u8Len);
+			return;
+		}
+		if (pRx->u8Cmd == PACKET_CMD_BULK) {
+			BulkTx_vNack(pu8Data, u8Len);
+			return;
+		}
+		if (pRx->u8Cmd == PACKET_CMD_JOIN) {
+			// TDMA でない Master には用がない
+			return;
+		}
+		if ((uint8)(u8RxTail - u8RxHead) >= RX_RING_SIZE) {
+			// タッチは受け取ったことにしないので、Slave が送り直す
+			sUartStats.u32RxDrop++;
+			return;
+		}
+		if (pRx->u8Cmd == PACKET_CMD_FELICA) {
+			if (u8Len < FELICA_SEQ_LEN || pu8Data[2] > XPORT_ACK_SACK_BITS) {
+				return;
+			}
+			u16Seq = ((uint16)pu8Data[0] << 8) | pu8Data[1];
+			if (!AckTable_bAccept(u8Src, u16Seq, u16Seq - pu8Data[2], u32TickCount_ms)) {
+				// ACK が届かずに送り直されたもの
+				if (u16SecDups < 0xFFFF) u16SecDups++;
+				LoadMeter_vPacket(pRx->u32SrcAddr, 0);
+				Roster_vDuplicate(u8Src);
+				return;
+			}
+			pu8Data += FELICA_SEQ_LEN;
+			u8Len -= FELICA_SEQ_LEN;
+			_C {
+				uint8 u8Touches = u8Len == FELICA_IDM_LEN ? 1 : (u8Len ? pu8Data[0] & ~FELICA_TIMED : 0);
+				LoadMeter_vPacket(pRx->u32SrcAddr, u8Touches);
+				Roster_vTouches(u8Src, u8Touches);
+			}
+		}
+
+		tsRxEntry *psRx = &asRxRing[u8RxTail & (RX_RING_SIZE - 1)];
+		psRx->u32SrcAddr = pRx->u32SrcAddr;
+		psRx->u8Cmd = pRx->u8Cmd;
+		psRx->u8Seq = pRx->u8Seq;
+		psRx->u16XportSeq = u16Seq;
+		psRx->u8Lqi = pRx->u8Lqi;
+		psRx->u8Len = u8Len > RX_DATA_MAX ? RX_DATA_MAX : u8Len;
+		psRx->u32Tick = pRx->u32Tick;
+		memcpy(psRx->au8Data, pu8Data, psRx->u8Len);
+		u8RxTail++;
+
+		if ((uint8)(u8RxTail - u8RxHead) > sUartStats.u8RxHighWater) {
+			sUartStats.u8RxHighWater = u8RxTail - u8RxHead;
+		}
+	}
+	else
+	{
+		if (u16SecDups < 0xFFFF) u16SecDups++;
+		if (pRx->u8Cmd == PACKET_CMD_FELICA) {
+			// 届かなかった ACK の再送も無線の負荷として数える
+			LoadMeter_vPacket(pRx->u32SrcAddr, 0);
+		}
+	}
+}
+
+// パケット受信時
+void cbToCoNet_vRxEvent(tsRxDataApp *pRx)
+{
+	PROFILE_BEGIN(PROFILE_RX, 0, pRx->u8Cmd);
+
+	vRxPacket(pRx);
+	PROFILE_END();
 }
 
 // パケット送信完了時
 void cbToCoNet_vTxEvent(uint8 u8CbId, uint8 bStatus)
 {
+	PROFILE_BEGIN(PROFILE_TX, 0, bStatus);
+
 	//dbg(">> SEND %s seq=%u", bStatus ? "OK" : "NG", u32Seq);
+	if (bAckBusy && u8CbId == u8AckCbId) {
+		bAckBusy = FALSE;
+	}
+	if (bBulkBusy && u8CbId == u8BulkCbId) {
+		bBulkBusy = FALSE;
+	}
 	//E_ORDER_KICK イベントを通知
 	ToCoNet_Event_Process(E_ORDER_KICK, 0, vProcessEvCore);
+	PROFILE_END();
 	return;
 }
 
 // ネットワークイベント発生時
 void cbToCoNet_vNwkEvent(teEvent eEvent, uint32 u32arg)
 {
+	PROFILE_BEGIN(PROFILE_NWK, 0, eEvent);
 
 	switch (eEvent) {
 		case E_EVENT_TOCONET_NWK_START:
 			break;
 		case E_EVENT_TOCONET_ENERGY_SCAN_COMPLETE:
+			if (bBgScan) {
+				// 運用中の 1 チャネル分
+				uint8 *pu8Result = (uint8*)u32arg;
+				bBgScan = FALSE;
+				if (bRescan) {
+					bRescan = FALSE;
+					vRescanDone(pu8Result);
+				} else if (pu8Result[0] >= 1) {
+					ChannelMonitor_vEnergy(u8BgCh, pu8Result[1]);
+				}
+				break;
+			}
 			_C{
 				uint8 *pu8Result = (uint8*)u32arg;
 				uint8 u8ChCount = pu8Result[0];
@@ -291,7 +1144,9 @@ void cbToCoNet_vNwkEvent(teEvent eEvent, uint32 u32arg)
 						sAppData.u8channel = i + CHANNEL_MASK_BASE;
 						min = pu8Result[i + 1];
 					}
-					WAIT_UART_OUTPUT(UART_PORT);
+				}
+				if (u8ChCount == CHMON_CH_COUNT) {
+					ChannelMonitor_vStart(sAppData.u8channel, pu8Result + 1);
 				}
 				ToCoNet_Event_Process(E_EVENT_CHSCAN_FINISH, 0, vProcessEvCore);
 
@@ -300,6 +1155,7 @@ void cbToCoNet_vNwkEvent(teEvent eEvent, uint32 u32arg)
 		default:
 			break;
 	}
+	PROFILE_END();
 	return;
 }
 
@@ -338,6 +1194,32 @@ void cbAppColdStart(bool_t bAfterAhiInit)
 		sToCoNet_AppContext.u16ShortAddress = MASTER_ADDR;
 		sToCoNet_AppContext.u8TxMacRetry = 3;
 		u32Seq = 0;
+		sAppData.u8OutputMode = OUTPUT_MODE_DEFAULT;
+		SrcTable_vInit();
+		DupFilter_vInit();
+		AckTable_vInit();
+		bAckBusy = FALSE;
+		LoadMeter_vInit();
+		Roster_vInit();
+		ChannelMonitor_vInit();
+		HostLink_vInit();
+		Allowlist_vClear(au8AllowNext);
+		u16AllowNextIdms = 0;
+		u8AllowSeq = ToCoNet_u32GetRand();
+		BulkTx_vInit();
+#ifdef USE_PROFILE
+		Profile_vInit();
+#endif
+		bBulkBusy = FALSE;
+		u8SwitchCh = 0;
+		bBgScan = FALSE;
+		bRescanReq = FALSE;
+		bRescan = FALSE;
+		bTxMid = FALSE;
+#ifdef USE_TDMA
+		SlotTable_vInit();
+		u32BeaconAt = 0;
+#endif
 
 		dbg("Master Init complete. MAC start.\r\n");
 		dbg("APP_ID=%08X Ch=%d\r\n", sToCoNet_AppContext.u32AppId, sToCoNet_AppContext.u8Channel);
@@ -0,0 +1,148 @@
+/*
+ * Roster.c
+ *
+ * リーダごとの受信状況の記録 (Roster.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "Roster.h"
+#include "SrcTable.h"
+#include "../../Common/Source/packets.h"
+
+static uint16 u16Cursor; // 次に出力する表の位置
+static tsRosterStats sStats;
+
+void Roster_vInit()
+{
+	memset(&sStats, 0, sizeof(sStats));
+	u16Cursor = 0;
+}
+
+void Roster_vNew(uint8 u8Src, uint32 u32Now)
+{
+	tsRosterSource *psE = &SrcTable_psAt(u8Src)->sRoster;
+
+	memset(psE, 0, sizeof(tsRosterSource));
+	psE->bFresh = TRUE;
+	psE->u32ReportAt = u32Now;
+}
+
+// 一杯になる区間があれば全区間を半分にして、比を保つ
+static void vLqiHist(uint8 *pu8Hist, uint8 u8Lqi)
+{
+	uint8 i;
+
+	if (pu8Hist[u8Lqi * ROSTER_LQI_BINS / 256] == 0xFF) {
+		for (i = 0; i < ROSTER_LQI_BINS; i++) {
+			pu8Hist[i] >>= 1;
+		}
+	}
+	pu8Hist[u8Lqi * ROSTER_LQI_BINS / 256]++;
+}
+
+void Roster_vPacket(uint8 u8Src, uint8 u8Seq, uint8 u8Lqi, bool_t bNew, uint32 u32Now)
+{
+	tsRosterSource *psE = &SrcTable_psAt(u8Src)->sRoster;
+	int8 i8Diff;
+
+	if (psE->bFresh) {
+		// 新しいリーダ
+		psE->sR.u16Lqi8 = u8Lqi * 8;
+		psE->u8Seq = u8Seq - 1;
+		psE->bFresh = FALSE;
+	}
+
+	psE->sR.u32LastSeen = u32Now;
+	psE->sR.u16Lqi8 += u8Lqi - psE->sR.u16Lqi8 / 8;
+	vLqiHist(psE->sR.au8LqiHist, u8Lqi);
+
+	if (!bNew) {
+		// MAC の ACK が届かずに送り直された
+		if (psE->sR.u16Duplicates < 0xFFFF) psE->sR.u16Duplicates++;
+		sStats.u32Duplicates++;
+		return;
+	}
+	psE->sR.u16Received++;
+	sStats.u32Received++;
+
+	i8Diff = (int8)(u8Seq - psE->u8Seq);
+	if (i8Diff > 0 && i8Diff <= ROSTER_GAP_MAX) {
+		psE->sR.u16Lost += i8Diff - 1;
+		sStats.u32Lost += i8Diff - 1;
+		psE->u8Seq = u8Seq;
+	} else if (i8Diff < 0 && -i8Diff < ROSTER_LATE_MAX) {
+		// 遅れて届いた: 飛びとして数えた分を戻す
+		if (psE->sR.u16Lost) {
+			psE->sR.u16Lost--;
+			sStats.u32Lost--;
+		}
+	} else {
+		// 再起動したか、他の Master へ送っていた
+		psE->u8Seq = u8Seq;
+		sStats.u32Resyncs++;
+	}
+}
+
+void Roster_vDuplicate(uint8 u8Src)
+{
+	tsRosterReader *psR = &SrcTable_psAt(u8Src)->sRoster.sR;
+
+	if (psR->u16Duplicates < 0xFFFF) psR->u16Duplicates++;
+	sStats.u32Duplicates++;
+}
+
+void Roster_vTouches(uint8 u8Src, uint8 u8Touches)
+{
+	SrcTable_psAt(u8Src)->sRoster.sR.u16Touches += u8Touches;
+}
+
+void Roster_vHealth(uint8 u8Src, const uint8 *pu8Data, uint8 u8Len)
+{
+	tsRosterReader *psR = &SrcTable_psAt(u8Src)->sRoster.sR;
+
+	if (u8Len < HEALTH_LEN) {
+		return;
+	}
+	psR->bHealth = TRUE;
+	psR->u16Tx = ((uint16)pu8Data[0] << 8) | pu8Data[1];
+	psR->u16TxFail = ((uint16)pu8Data[2] << 8) | pu8Data[3];
+	psR->u16NfcResets = ((uint16)pu8Data[4] << 8) | pu8Data[5];
+	psR->u16ScanFails = ((uint16)pu8Data[6] << 8) | pu8Data[7];
+}
+
+uint16 Roster_u16ReportsDue()
+{
+	return (SrcTable_psStats()->u16Sources + ROSTER_REPORT_S - 1) / ROSTER_REPORT_S;
+}
+
+const tsRosterReader *Roster_psReport(uint32 u32Now, uint32 *pu32Addr, uint16 *pu16TouchesPerMin)
+{
+	uint16 u16Sources = SrcTable_psStats()->u16Sources;
+	tsSrcEntry *psS;
+	tsRosterSource *psE;
+	uint32 u32Ms, u32Rate;
+
+	if (u16Sources == 0) {
+		return NULL;
+	}
+	if (u16Cursor >= u16Sources) {
+		u16Cursor = 0;
+	}
+	psS = SrcTable_psAt(u16Cursor++);
+	psE = &psS->sRoster;
+	*pu32Addr = psS->u32Addr;
+
+	u32Ms = u32Now - psE->u32ReportAt;
+	u32Rate = u32Ms ? (uint16)(psE->sR.u16Touches - psE->u16TouchesAt) * 60000UL / u32Ms : 0;
+	*pu16TouchesPerMin = u32Rate > 0xFFFF ? 0xFFFF : u32Rate;
+	psE->u32ReportAt = u32Now;
+	psE->u16TouchesAt = psE->sR.u16Touches;
+	return &psE->sR;
+}
+
+const tsRosterStats *Roster_psStats()
+{
+	return &sStats;
+}
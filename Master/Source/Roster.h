@@ -0,0 +1,79 @@
+/*
+ * Roster.h
+ *
+ * 接続しているリーダ (Slave) ごとの受信状況の記録。
+ *
+ * 送信元ごとの記録 (SrcTable) に、最後に受信した時刻、LQI の平均と
+ * ヒストグラム、シーケンス番号の飛びから数えたロス、重複、タッチ数と、
+ * Slave が送ってくる健全性の記録 (packets.h の HEALTH) を持つ。
+ * 8 ビットのシーケンス番号は直前の番号との差で数え、大きく飛んだとき
+ * (再起動や他の Master へ移っていた間) はロスに数えずに数え直す。
+ * 255 台分を持つので記録は小さくし、受信・ロス・タッチの数は 16 ビットで
+ * 一周する (ホストは前回の出力との差を 65536 で割った余りで見る)。LQI の
+ * ヒストグラムは 8 ビットで、どれかが一杯になれば全区間を半分にする (比を見る)。
+ * Master はこれを ROSTER_REPORT_S 秒で一巡するよう、毎秒数件ずつ出力する。
+ *
+ */
+
+#ifndef ROSTER_H_
+#define ROSTER_H_
+
+#include <jendefs.h>
+
+#define ROSTER_GAP_MAX   64  // これより大きな番号の飛びはロスに数えない
+#define ROSTER_LATE_MAX  32  // これだけ前の番号までは遅れて届いたとみなす (DUPFILTER_WINDOW)
+#define ROSTER_LQI_BINS  4   // LQI のヒストグラムの区間数 (0..255 を等分)
+#define ROSTER_REPORT_S  30  // 全リーダを出力し終える間隔
+
+typedef struct {
+	uint32 u32LastSeen;    // 最後に受信した時刻 (ms)
+	uint16 u16Lqi8;        // LQI の平滑値 (1/8)
+	uint8 au8LqiHist[ROSTER_LQI_BINS];
+	uint16 u16Received;    // 受信したパケット (重複を除く)
+	uint16 u16Lost;        // シーケンス番号の飛びから数えた未受信のパケット
+	uint16 u16Duplicates;  // MAC の再送と ACK の届かなかったタッチパケットの再送
+	uint16 u16Touches;     // 受け取ったタッチ
+	bool_t bHealth;        // 健全性の記録を受け取った
+	uint16 u16Tx;          // 以下 Slave の健全性の記録 (Slave の起動から数える)
+	uint16 u16TxFail;
+	uint16 u16NfcResets;
+	uint16 u16ScanFails;
+} tsRosterReader;
+
+// 送信元ごとの状態 (SrcTable の記録に入る)
+typedef struct {
+	tsRosterReader sR;
+	uint32 u32ReportAt;   // 前回出力した時刻
+	uint16 u16TouchesAt;  // 前回出力したときの u16Touches
+	uint8 u8Seq;          // 最後に受信した番号
+	bool_t bFresh;        // まだパケットを数えていない
+} tsRosterSource;
+
+typedef struct {
+	uint32 u32Received;   // 全リーダの合計
+	uint32 u32Lost;
+	uint32 u32Duplicates;
+	uint32 u32Resyncs;    // 番号が大きく飛んで数え直した回数
+} tsRosterStats;
+
+void Roster_vInit();
+// 表の u8Src の位置を新しい送信元に使うとき (SrcTable から呼ぶ)
+void Roster_vNew(uint8 u8Src, uint32 u32Now);
+
+// パケットを受信したとき (bNew は DupFilter で重複でなかったか)
+void Roster_vPacket(uint8 u8Src, uint8 u8Seq, uint8 u8Lqi, bool_t bNew, uint32 u32Now);
+// Slave が ACK を受けられずに送り直したタッチパケットを受信したとき
+void Roster_vDuplicate(uint8 u8Src);
+// タッチを受け取ったとき
+void Roster_vTouches(uint8 u8Src, uint8 u8Touches);
+// Slave の健全性の記録 (PACKET_CMD_HEALTH のペイロード)
+void Roster_vHealth(uint8 u8Src, const uint8 *pu8Data, uint8 u8Len);
+
+// この 1 秒で出力する件数
+uint16 Roster_u16ReportsDue();
+// 次に出力するリーダ。pu32Addr にアドレス、pu16TouchesPerMin に前回の出力からのタッチの頻度を返す
+const tsRosterReader *Roster_psReport(uint32 u32Now, uint32 *pu32Addr, uint16 *pu16TouchesPerMin);
+
+const tsRosterStats *Roster_psStats();
+
+#endif /* ROSTER_H_ */
@@ -0,0 +1,135 @@
+/*
+ * SlotTable.c
+ *
+ * TDMA のスロット割り当て表 (SlotTable.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "SlotTable.h"
+
+typedef struct {
+	uint32 u32Addr;    // 0 なら空き
+	uint8 u8IdleS;     // 最後に届いてからの秒数
+	uint8 u8Announce;  // 新しい割り当てとして知らせる残り回数
+} tsSlotEntry;
+
+static tsSlotEntry asSlot[TDMA_MAX_SLOTS];
+static uint8 u8Next;   // 割り当て済みを順に載せる位置
+static uint8 u8NextNew; // 新しい割り当てを探し始める位置
+static tsSlotTableStats sStats;
+
+static int16 i16Find(uint32 u32Addr)
+{
+	uint8 i;
+
+	for (i = 0; i < TDMA_MAX_SLOTS; i++) {
+		if (asSlot[i].u32Addr == u32Addr) return i;
+	}
+	return -1;
+}
+
+void SlotTable_vInit()
+{
+	memset(asSlot, 0, sizeof(asSlot));
+	memset(&sStats, 0, sizeof(sStats));
+	u8Next = 0;
+	u8NextNew = 0;
+}
+
+int16 SlotTable_i16Join(uint32 u32Addr)
+{
+	int16 i16Slot = i16Find(u32Addr);
+
+	// 割り当て済みなら、知らせが届かなかったものとして知らせ直す
+	if (i16Slot < 0) {
+		i16Slot = i16Find(0);
+		if (i16Slot < 0) {
+			sStats.u32Refused++;
+			return -1;
+		}
+		asSlot[i16Slot].u32Addr = u32Addr;
+		sStats.u16Slots++;
+		sStats.u32Joins++;
+	}
+	asSlot[i16Slot].u8IdleS = 0;
+	asSlot[i16Slot].u8Announce = SLOTTABLE_ANNOUNCE;
+	return i16Slot;
+}
+
+void SlotTable_vHeard(uint32 u32Addr)
+{
+	int16 i16Slot = i16Find(u32Addr);
+
+	if (i16Slot >= 0) {
+		asSlot[i16Slot].u8IdleS = 0;
+	}
+}
+
+void SlotTable_vSecond()
+{
+	uint8 i;
+
+	for (i = 0; i < TDMA_MAX_SLOTS; i++) {
+		if (asSlot[i].u32Addr == 0) continue;
+		if (++asSlot[i].u8IdleS >= SLOTTABLE_IDLE_S) {
+			asSlot[i].u32Addr = 0;
+			sStats.u16Slots--;
+			sStats.u32Expired++;
+		}
+	}
+}
+
+uint8 SlotTable_u8Cycle()
+{
+	uint8 i = TDMA_MAX_SLOTS;
+
+	while (i > 0 && asSlot[i - 1].u32Addr == 0) i--;
+	return i <= TDMA_SLOTS ? 1 : (i + TDMA_SLOTS - 1) / TDMA_SLOTS;
+}
+
+static uint8 *pu8PutGrant(uint8 *p, uint8 u8Slot)
+{
+	uint32 u32Addr = asSlot[u8Slot].u32Addr;
+
+	*p++ = u32Addr >> 24;
+	*p++ = u32Addr >> 16;
+	*p++ = u32Addr >> 8;
+	*p++ = u32Addr;
+	*p++ = u8Slot;
+	return p;
+}
+
+uint8 SlotTable_u8Grants(uint8 *pu8Buf, uint8 u8Max)
+{
+	uint32 au32Put[(TDMA_MAX_SLOTS + 31) / 32] = { 0 };
+	uint8 i, u8Slot, n = 0;
+
+	// 新しい割り当てを先に (一度に来ても偏らないよう、前回の続きから)
+	for (i = 0; i < TDMA_MAX_SLOTS && n < u8Max; i++) {
+		u8Slot = u8NextNew;
+		u8NextNew = (u8NextNew + 1) % TDMA_MAX_SLOTS;
+		if (asSlot[u8Slot].u32Addr != 0 && asSlot[u8Slot].u8Announce > 0) {
+			asSlot[u8Slot].u8Announce--;
+			au32Put[u8Slot / 32] |= 1UL << (u8Slot % 32);
+			pu8Buf = pu8PutGrant(pu8Buf, u8Slot);
+			n++;
+		}
+	}
+	// 残りは割り当て済みを順に
+	for (i = 0; i < TDMA_MAX_SLOTS && n < u8Max && n < sStats.u16Slots; i++) {
+		u8Slot = u8Next;
+		u8Next = (u8Next + 1) % TDMA_MAX_SLOTS;
+		if (asSlot[u8Slot].u32Addr != 0 && !(au32Put[u8Slot / 32] & (1UL << (u8Slot % 32)))) {
+			pu8Buf = pu8PutGrant(pu8Buf, u8Slot);
+			n++;
+		}
+	}
+	return n;
+}
+
+const tsSlotTableStats *SlotTable_psStats()
+{
+	return &sStats;
+}
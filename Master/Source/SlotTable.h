@@ -0,0 +1,45 @@
+/*
+ * SlotTable.h
+ *
+ * TDMA (make TDMA=1) のスロット割り当て表。
+ *
+ * 競合スロットで参加要求を送ってきた Slave に空いている最も小さいスロット
+ * 番号を割り当て、次の SLOTTABLE_ANNOUNCE 回のビーコンで知らせる。残りの
+ * 場所には割り当て済みのものを順に載せ、Slave が自分の割り当てを確かめ
+ * られるようにする。SLOTTABLE_IDLE_S 秒何も届かない Slave のスロットは空ける。
+ *
+ */
+
+#ifndef SLOTTABLE_H_
+#define SLOTTABLE_H_
+
+#include <jendefs.h>
+#include "../../Common/Source/packets.h"
+
+#define SLOTTABLE_ANNOUNCE 2
+#define SLOTTABLE_IDLE_S   90 // Slave のハートビート (30 秒) を 3 回逃すまで
+
+typedef struct {
+	uint16 u16Slots;    // 割り当て中のスロット
+	uint32 u32Joins;    // 新しく割り当てた
+	uint32 u32Expired;  // 何も届かず空けた
+	uint32 u32Refused;  // 空きがなく断った
+} tsSlotTableStats;
+
+void SlotTable_vInit();
+
+// 参加要求。割り当てたスロット番号、空きがなければ -1
+int16 SlotTable_i16Join(uint32 u32Addr);
+// 割り当て済みの Slave から何か届いたとき
+void SlotTable_vHeard(uint32 u32Addr);
+// 毎秒呼ぶ
+void SlotTable_vSecond();
+
+// 周期 (何スーパーフレームで全スロットを回るか)
+uint8 SlotTable_u8Cycle();
+// ビーコンに載せる割り当てを pu8Buf に書き、件数を返す
+uint8 SlotTable_u8Grants(uint8 *pu8Buf, uint8 u8Max);
+
+const tsSlotTableStats *SlotTable_psStats();
+
+#endif /* SLOTTABLE_H_ */
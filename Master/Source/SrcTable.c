@@ -0,0 +1,112 @@
+/*
+ * SrcTable.c
+ *
+ * Slave ごとの記録の表 (SrcTable.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "SrcTable.h"
+
+#define NIL SRCTABLE_NIL
+
+static tsSrcEntry asEntry[SRCTABLE_SOURCES];
+static uint8 au8Bucket[SRCTABLE_BUCKETS];
+static uint8 u8Head; // 最も最近
+static uint8 u8Tail; // 最も古い
+static tsSrcTableStats sStats;
+
+static uint8 u8HashOf(uint32 u32Addr)
+{
+	return (uint8)(((u32Addr * 2654435761UL) >> 16) & (SRCTABLE_BUCKETS - 1));
+}
+
+static void vLruUnlink(uint8 i)
+{
+	tsSrcEntry *psE = &asEntry[i];
+
+	if (psE->u8Prev != NIL) asEntry[psE->u8Prev].u8Next = psE->u8Next; else u8Head = psE->u8Next;
+	if (psE->u8Next != NIL) asEntry[psE->u8Next].u8Prev = psE->u8Prev; else u8Tail = psE->u8Prev;
+}
+
+static void vLruPushFront(uint8 i)
+{
+	tsSrcEntry *psE = &asEntry[i];
+
+	psE->u8Prev = NIL;
+	psE->u8Next = u8Head;
+	if (u8Head != NIL) asEntry[u8Head].u8Prev = i; else u8Tail = i;
+	u8Head = i;
+}
+
+static void vHashRemove(uint8 i)
+{
+	uint8 *pu8 = &au8Bucket[u8HashOf(asEntry[i].u32Addr)];
+
+	while (*pu8 != i) {
+		pu8 = &asEntry[*pu8].u8Hash;
+	}
+	*pu8 = asEntry[i].u8Hash;
+}
+
+void SrcTable_vInit()
+{
+	memset(&sStats, 0, sizeof(sStats));
+	memset(au8Bucket, NIL, sizeof(au8Bucket));
+	u8Head = NIL;
+	u8Tail = NIL;
+}
+
+uint8 SrcTable_u8Find(uint32 u32Addr)
+{
+	uint8 i;
+
+	for (i = au8Bucket[u8HashOf(u32Addr)]; i != NIL; i = asEntry[i].u8Hash) {
+		if (asEntry[i].u32Addr == u32Addr) break;
+	}
+	return i;
+}
+
+uint8 SrcTable_u8Get(uint32 u32Addr, uint32 u32Now)
+{
+	uint8 i = SrcTable_u8Find(u32Addr);
+
+	if (i != NIL) {
+		if (i != u8Head) {
+			vLruUnlink(i);
+			vLruPushFront(i);
+		}
+		return i;
+	}
+
+	// 新しい送信元。空きがなければ最も古いものを追い出す
+	if (sStats.u16Sources < SRCTABLE_SOURCES) {
+		i = sStats.u16Sources++;
+		memset(&asEntry[i], 0, sizeof(tsSrcEntry));
+	} else {
+		i = u8Tail;
+		vLruUnlink(i);
+		vHashRemove(i);
+		sStats.u32Evictions++;
+	}
+	asEntry[i].u32Addr = u32Addr;
+	asEntry[i].u8Hash = au8Bucket[u8HashOf(u32Addr)];
+	au8Bucket[u8HashOf(u32Addr)] = i;
+	vLruPushFront(i);
+
+	DupFilter_vNew(i);
+	AckTable_vNew(i);
+	Roster_vNew(i, u32Now);
+	return i;
+}
+
+tsSrcEntry *SrcTable_psAt(uint8 u8Src)
+{
+	return &asEntry[u8Src];
+}
+
+const tsSrcTableStats *SrcTable_psStats()
+{
+	return &sStats;
+}
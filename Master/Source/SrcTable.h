@@ -0,0 +1,54 @@
+/*
+ * SrcTable.h
+ *
+ * Slave (送信元) ごとの記録の表。
+ *
+ * 重複の除去 (DupFilter)、タッチの受信窓と ACK (AckTable)、受信状況 (Roster) が
+ * 送信元ごとに持つ状態を 1 つの記録にまとめ、送信元アドレスをハッシュで引く。
+ * パケット 1 つにつき引くのは 1 回で、各モジュールには表の位置を渡す。
+ * 表が一杯なら最も長く受信のない送信元を追い出し (LRU)、その位置を新しい
+ * 送信元に使う。新しく使う位置は各モジュールの *_vNew で初期化する。
+ *
+ */
+
+#ifndef SRCTABLE_H_
+#define SRCTABLE_H_
+
+#include <jendefs.h>
+
+#include "DupFilter.h"
+#include "AckTable.h"
+#include "Roster.h"
+
+#define SRCTABLE_SOURCES 255  // 覚えておく送信元の数 (位置は uint8 なので 255 まで)
+#define SRCTABLE_BUCKETS 256  // ハッシュのバケット数 (2 のべき乗)
+#define SRCTABLE_NIL     0xFF // 表の位置がない
+
+typedef struct {
+	uint32 u32Addr;
+	tsDupFilterSource sDup;
+	tsAckTableSource sAck;
+	tsRosterSource sRoster;
+	uint8 u8Hash;  // 同じバケットの次
+	uint8 u8Prev;  // LRU リスト (先頭が最近)
+	uint8 u8Next;
+} tsSrcEntry;
+
+typedef struct {
+	uint16 u16Sources;   // 登録中の送信元
+	uint32 u32Evictions; // 追い出した送信元
+} tsSrcTableStats;
+
+// 表を空にする (続けて各モジュールの *_vInit を呼ぶ)
+void SrcTable_vInit();
+
+// u32Addr の位置。なければ作る。最近受信したものとして LRU の先頭に置く
+uint8 SrcTable_u8Get(uint32 u32Addr, uint32 u32Now);
+// u32Addr の位置 (なければ SRCTABLE_NIL)。LRU は変えない
+uint8 SrcTable_u8Find(uint32 u32Addr);
+// u8Src の位置の記録
+tsSrcEntry *SrcTable_psAt(uint8 u8Src);
+
+const tsSrcTableStats *SrcTable_psStats();
+
+#endif /* SRCTABLE_H_ */
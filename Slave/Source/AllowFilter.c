@@ -0,0 +1,79 @@
+/*
+ * AllowFilter.c
+ *
+ * 受け取った有効な IDm の一覧と判定 (AllowFilter.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "AllowFilter.h"
+#include "../../Common/Source/Allowlist.h"
+
+static uint8 au8Bits[ALLOWLIST_BYTES];
+static uint8 u8Want;        // 受け取っている版 (0 ならなし)
+static uint32 u32Since;     // 受け取り始めた時刻
+static tsAllowFilterStats sStats;
+
+void AllowFilter_vInit()
+{
+	u8Want = 0;
+	memset(&sStats, 0, sizeof(sStats));
+}
+
+bool_t AllowFilter_bVersion(uint8 u8Version, uint32 u32Now)
+{
+	if (u8Version == 0) {
+		// 一覧なし (allow off、Master の再起動後): 手元の一覧も使わない
+		sStats.u8Version = 0;
+		u8Want = 0;
+		return FALSE;
+	}
+	if (u8Version == sStats.u8Version || u8Version == u8Want) {
+		return FALSE;
+	}
+	sStats.u8Version = 0;
+	u8Want = u8Version;
+	u32Since = u32Now;
+	return TRUE;
+}
+
+uint8 AllowFilter_u8Want()
+{
+	return u8Want;
+}
+
+uint8 *AllowFilter_pu8Buffer()
+{
+	return au8Bits;
+}
+
+void AllowFilter_vLoaded(uint32 u32Now)
+{
+	if (u8Want == 0) {
+		return;
+	}
+	sStats.u8Version = u8Want;
+	sStats.u32Loads++;
+	sStats.u32FetchMsSum += u32Now - u32Since;
+	u8Want = 0;
+}
+
+uint8 AllowFilter_u8Check(const uint8 *pu8Idm)
+{
+	if (sStats.u8Version == 0) {
+		sStats.u32Unchecked++;
+		return ALLOWFILTER_UNCHECKED;
+	}
+	if (Allowlist_bCheck(au8Bits, pu8Idm)) {
+		sStats.u32Accepted++;
+		return ALLOWFILTER_ACCEPT;
+	}
+	sStats.u32Rejected++;
+	return ALLOWFILTER_REJECT;
+}
+
+const tsAllowFilterStats *AllowFilter_psStats()
+{
+	return &sStats;
+}
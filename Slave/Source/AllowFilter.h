@@ -0,0 +1,48 @@
+/*
+ * AllowFilter.h
+ *
+ * Master から一斉配信で受け取った有効な IDm の一覧 (Common/Source/Allowlist.h) と、
+ * それによるタッチの判定。
+ *
+ * 接続先が知らせる版 (Keep-Alive か一斉配信の区切り) が手元と違えば、
+ * BulkRx で受け取り直す (packets.h の BULK_OBJ_ALLOWLIST。受け取りは Slave.c)。
+ * 一覧は 1 つしか持たないので、受け取っている間は判定しない。版 0 は一覧なしで、
+ * 知らされたら手元の一覧も捨てる (allow off や Master の再起動)。
+ *
+ */
+
+#ifndef ALLOWFILTER_H_
+#define ALLOWFILTER_H_
+
+#include <jendefs.h>
+
+#define ALLOWFILTER_UNCHECKED 0 // 一覧がなく判定しなかった
+#define ALLOWFILTER_ACCEPT    1
+#define ALLOWFILTER_REJECT    2
+
+typedef struct {
+	uint8 u8Version;      // 使える一覧の版 (0 ならなし)
+	uint32 u32Loads;      // 受け取り終えた回数
+	uint32 u32FetchMsSum; // 新しい版を知ってから受け取り終えるまでの時間の合計
+	uint32 u32Accepted;   // 一覧にあったタッチ
+	uint32 u32Rejected;   // なかったタッチ
+	uint32 u32Unchecked;  // 判定しなかったタッチ
+} tsAllowFilterStats;
+
+void AllowFilter_vInit();
+
+// 接続先が知らせる版。受け取りを始めるなら TRUE (AllowFilter_pu8Buffer へ受け取る)。
+// FALSE で AllowFilter_u8Want が 0 なら受け取りをやめる
+bool_t AllowFilter_bVersion(uint8 u8Version, uint32 u32Now);
+// 受け取っている版 (0 ならなし)
+uint8 AllowFilter_u8Want();
+uint8 *AllowFilter_pu8Buffer();
+// 受け取り終えたとき
+void AllowFilter_vLoaded(uint32 u32Now);
+
+// 読んだ IDm を判定する (ALLOWFILTER_*)
+uint8 AllowFilter_u8Check(const uint8 *pu8Idm);
+
+const tsAllowFilterStats *AllowFilter_psStats();
+
+#endif /* ALLOWFILTER_H_ */
@@ -0,0 +1,56 @@
+/*
+ * BootStats.c
+ *
+ * 起動から使えるようになるまでの時間 (BootStats.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "BootStats.h"
+
+static tsBootStats sStats;
+
+void BootStats_vInit()
+{
+	memset(&sStats, 0, sizeof(sStats));
+}
+
+// 両方が揃ったときに一度だけ TRUE
+static bool_t bCheckReady(uint32 u32Now)
+{
+	if (sStats.u32ReadyMs || !sStats.u32NfcMs || !sStats.u32AssocMs) {
+		return FALSE;
+	}
+	// 起動直後 (0ms) に揃っても 0 を「まだ」と取り違えない
+	sStats.u32ReadyMs = u32Now ? u32Now : 1;
+	return TRUE;
+}
+
+bool_t BootStats_bNfcReady(uint32 u32Now)
+{
+	if (!sStats.u32NfcMs) {
+		sStats.u32NfcMs = u32Now ? u32Now : 1;
+	}
+	return bCheckReady(u32Now);
+}
+
+bool_t BootStats_bAssociated(uint32 u32Now)
+{
+	if (!sStats.u32AssocMs) {
+		sStats.u32AssocMs = u32Now ? u32Now : 1;
+	}
+	return bCheckReady(u32Now);
+}
+
+void BootStats_vTouch()
+{
+	if (!sStats.u32AssocMs && sStats.u16EarlyTouches < 0xFFFF) {
+		sStats.u16EarlyTouches++;
+	}
+}
+
+const tsBootStats *BootStats_psStats()
+{
+	return &sStats;
+}
@@ -0,0 +1,38 @@
+/*
+ * BootStats.h
+ *
+ * 起動してからタッチを送れるようになるまでの時間の記録。
+ *
+ * Slave は Master への接続 (vProcessEvCore) と PN533 の初期化
+ * (vProcessEvNfc) を別々の状態遷移で同時に進める。それぞれが終わった
+ * 時刻と、両方が揃った時刻 (タッチを読んですぐ送れるようになった時刻) を
+ * 起動からの ms で記録する。接続より先に読んだタッチは TouchLog に
+ * 溜めておき、接続してから送る。その数も数える。
+ * 揃うのは起動ごとに 1 回だけ数え、再接続や PN533 のリセットは数えない。
+ *
+ */
+
+#ifndef BOOTSTATS_H_
+#define BOOTSTATS_H_
+
+#include <jendefs.h>
+
+typedef struct {
+	uint32 u32NfcMs;        // PN533 の初期化が終わった時刻 (0 ならまだ)
+	uint32 u32AssocMs;      // Master に接続した時刻 (0 ならまだ)
+	uint32 u32ReadyMs;      // 両方が揃った時刻 (0 ならまだ)
+	uint16 u16EarlyTouches; // 接続より先に読んだタッチ
+} tsBootStats;
+
+void BootStats_vInit();
+
+// PN533 の初期化が終わったとき / Master に接続したとき。
+// これで初めて両方が揃えば TRUE
+bool_t BootStats_bNfcReady(uint32 u32Now);
+bool_t BootStats_bAssociated(uint32 u32Now);
+// タッチを読んだとき
+void BootStats_vTouch();
+
+const tsBootStats *BootStats_psStats();
+
+#endif /* BOOTSTATS_H_ */
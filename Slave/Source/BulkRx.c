@@ -0,0 +1,109 @@
+/*
+ * BulkRx.c
+ *
+ * 一斉配信されるオブジェクトの受け取り (BulkRx.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "BulkRx.h"
+#include "../../Common/Source/packets.h"
+
+static uint8 u8Obj;         // 受け取っているオブジェクト (0 ならなし)
+static uint8 u8Version;
+static uint8 *pu8Buf;
+static uint16 u16Len;
+static uint8 u8Chunks;
+static uint8 au8Have[BULK_CHUNKS_MAX / 8]; // 受け取った区切り
+static uint8 u8Have;
+static uint32 u32HeardAt;   // 最後に区切りを受け取った (か NACK を送った) 時刻
+static uint16 u16Wait;      // その時刻から NACK を送るまで
+static tsBulkRxStats sStats;
+
+void BulkRx_vInit()
+{
+	u8Obj = 0;
+	memset(&sStats, 0, sizeof(sStats));
+}
+
+void BulkRx_vStart(uint8 u8Object, uint8 u8Ver, uint8 *pu8Buffer, uint16 u16Length, uint32 u32Now, uint16 u16Extra)
+{
+	if (u16Length == 0 || u16Length > BULK_CHUNK * BULK_CHUNKS_MAX) {
+		u8Obj = 0;
+		return;
+	}
+	u8Obj = u8Object;
+	u8Version = u8Ver;
+	pu8Buf = pu8Buffer;
+	u16Len = u16Length;
+	u8Chunks = (u16Length + BULK_CHUNK - 1) / BULK_CHUNK;
+	memset(au8Have, 0, sizeof(au8Have));
+	u8Have = 0;
+	u32HeardAt = u32Now;
+	u16Wait = BULKRX_NACK_MS + u16Extra;
+}
+
+void BulkRx_vStop()
+{
+	u8Obj = 0;
+}
+
+bool_t BulkRx_bChunk(const uint8 *pu8Data, uint8 u8Len, uint32 u32Now)
+{
+	uint8 i;
+	uint16 u16Ofs, u16Size;
+
+	if (u8Obj == 0 || u8Len < BULK_HDR_LEN || pu8Data[0] != u8Obj || pu8Data[1] != u8Version
+			|| pu8Data[3] != u8Chunks || pu8Data[2] >= u8Chunks) {
+		return FALSE;
+	}
+	u32HeardAt = u32Now;
+	i = pu8Data[2];
+	if (au8Have[i / 8] & (1 << (i % 8))) {
+		sStats.u32Duplicates++;
+		return FALSE;
+	}
+	u16Ofs = (uint16)i * BULK_CHUNK;
+	u16Size = u16Len - u16Ofs < BULK_CHUNK ? u16Len - u16Ofs : BULK_CHUNK;
+	if (u8Len < BULK_HDR_LEN + u16Size) {
+		return FALSE;
+	}
+	memcpy(pu8Buf + u16Ofs, pu8Data + BULK_HDR_LEN, u16Size);
+	au8Have[i / 8] |= 1 << (i % 8);
+	sStats.u32Chunks++;
+	if (++u8Have < u8Chunks) {
+		return FALSE;
+	}
+	u8Obj = 0;
+	sStats.u32Completed++;
+	return TRUE;
+}
+
+uint8 BulkRx_u8Nack(uint8 *pu8Out, uint32 u32Now, uint16 u16Extra)
+{
+	uint8 u8Bytes = (u8Chunks + 7) / 8;
+	uint8 i;
+
+	if (u8Obj == 0 || u32Now - u32HeardAt < u16Wait) {
+		return 0;
+	}
+	u32HeardAt = u32Now;
+	u16Wait = BULKRX_NACK_MS + u16Extra;
+	sStats.u32Nacks++;
+
+	pu8Out[0] = u8Obj;
+	pu8Out[1] = u8Version;
+	for (i = 0; i < u8Bytes; i++) {
+		pu8Out[BULK_NACK_HDR_LEN + i] = ~au8Have[i];
+	}
+	if (u8Chunks % 8) {
+		pu8Out[BULK_NACK_HDR_LEN + u8Bytes - 1] &= (1 << (u8Chunks % 8)) - 1;
+	}
+	return BULK_NACK_HDR_LEN + u8Bytes;
+}
+
+const tsBulkRxStats *BulkRx_psStats()
+{
+	return &sStats;
+}
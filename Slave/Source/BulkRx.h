@@ -0,0 +1,43 @@
+/*
+ * BulkRx.h
+ *
+ * Master が一斉配信する版のついたオブジェクト (Master/Source/BulkTx.h) の受け取り。
+ *
+ * 受け取った区切りをビット表で覚え、区切りが BULKRX_NACK_MS (と散らし) の間
+ * 途切れたら、足りない区切りのビット表を NACK で返す (packets.h の
+ * Slave から送る PACKET_CMD_BULK)。全 Slave の NACK が揃わないよう、散らしは呼び出し側が
+ * 乱数で渡す。受け取るのは一度に 1 つのオブジェクトだけ。
+ *
+ */
+
+#ifndef BULKRX_H_
+#define BULKRX_H_
+
+#include <jendefs.h>
+
+#define BULKRX_NACK_MS        200 // 区切りが途切れてから NACK を送るまで
+#define BULKRX_NACK_SPREAD_MS 200 // それに足す散らしの範囲
+
+typedef struct {
+	uint32 u32Chunks;     // 受け取った区切り (重複を除く)
+	uint32 u32Duplicates; // 既に持っていた区切り
+	uint32 u32Nacks;      // 送った NACK
+	uint32 u32Completed;  // 受け取り終えたオブジェクト
+} tsBulkRxStats;
+
+void BulkRx_vInit();
+
+// u8Obj の版 u8Version を pu8Buf (u16Len バイト) へ受け取り始める (受け取り中のものは捨てる)
+void BulkRx_vStart(uint8 u8Obj, uint8 u8Version, uint8 *pu8Buf, uint16 u16Len, uint32 u32Now, uint16 u16Extra);
+void BulkRx_vStop();
+
+// PACKET_CMD_BULK のペイロード。受け取り終えれば TRUE
+bool_t BulkRx_bChunk(const uint8 *pu8Data, uint8 u8Len, uint32 u32Now);
+
+// NACK を送るときなら NACK のペイロードを pu8Out に書き、長さを返す
+// (なければ 0)。u16Extra は BULKRX_NACK_MS に足す待ち (区切りの間隔と散らし)
+uint8 BulkRx_u8Nack(uint8 *pu8Out, uint32 u32Now, uint16 u16Extra);
+
+const tsBulkRxStats *BulkRx_psStats();
+
+#endif /* BULKRX_H_ */
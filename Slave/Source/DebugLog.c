@@ -0,0 +1,70 @@
+/*
+ * DebugLog.c
+ *
+ * Master へ送るデバッグログ (DebugLog.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "DebugLog.h"
+#include "../../Common/Source/packets.h"
+
+static uint8 au8Buf[LOG_FRAME_MAX];
+static uint8 u8Len;
+static uint32 u32FirstAt;    // バッファの最初の記録の時刻
+static uint32 u32DropPending; // まだ知らせていない捨てた件数
+static tsDebugLogStats sStats;
+
+void DebugLog_vInit()
+{
+	memset(&sStats, 0, sizeof(sStats));
+	u8Len = 0;
+	u32DropPending = 0;
+}
+
+void DebugLog_vPut(uint8 u8Event, const uint32 *pu32Args, uint8 u8Argc, uint32 u32Now)
+{
+	uint8 au8Rec[LOGRECORD_LEN_MAX];
+	uint8 u8RecLen = LogRecord_u8Encode(u8Event, pu32Args, u8Argc, au8Rec);
+
+	if (u8Len + u8RecLen > LOG_FRAME_MAX) {
+		sStats.u32Dropped++;
+		u32DropPending++;
+		return;
+	}
+	if (u8Len == 0) {
+		u32FirstAt = u32Now;
+	}
+	memcpy(au8Buf + u8Len, au8Rec, u8RecLen);
+	u8Len += u8RecLen;
+	sStats.u32Records++;
+}
+
+bool_t DebugLog_bDue(uint32 u32Now)
+{
+	return u8Len && (u32Now - u32FirstAt >= DEBUGLOG_DELAY_MS || u8Len + LOGRECORD_LEN_MAX > LOG_FRAME_MAX);
+}
+
+uint8 DebugLog_u8Take(uint8 *pu8Buf, uint32 u32Now)
+{
+	uint8 u8Taken = u8Len;
+
+	memcpy(pu8Buf, au8Buf, u8Len);
+	u8Len = 0;
+	if (u8Taken) {
+		sStats.u32Frames++;
+		sStats.u32Bytes += u8Taken;
+	}
+	if (u32DropPending) {
+		uint32 u32Dropped = u32DropPending;
+		u32DropPending = 0;
+		DebugLog_vPut(LOG_LOG_DROPPED, &u32Dropped, 1, u32Now);
+	}
+	return u8Taken;
+}
+
+const tsDebugLogStats *DebugLog_psStats()
+{
+	return &sStats;
+}
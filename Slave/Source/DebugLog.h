@@ -0,0 +1,49 @@
+/*
+ * DebugLog.h
+ *
+ * Master へ送るデバッグログ (LogRecord.h の形式で、書式の文字列は送らない)。
+ *
+ * 記録は 1 パケット分 (LOG_FRAME_MAX) のバッファに詰め、最初の記録から
+ * DEBUGLOG_DELAY_MS 待つか、次の記録が入らなくなるほど溜まったら
+ * PACKET_CMD_LOG でまとめて送る。入りきらなかった記録は捨てて数え、
+ * 次のパケットの先頭に LOG_LOG_DROPPED で知らせる。
+ *
+ */
+
+#ifndef DEBUGLOG_H_
+#define DEBUGLOG_H_
+
+#include <jendefs.h>
+
+#include "../../Common/Source/LogEvents.h"
+#include "../../Common/Source/LogRecord.h"
+
+#define DEBUGLOG_DELAY_MS 1000 // 最初の記録から送るまで待つ時間
+
+typedef struct {
+	uint32 u32Records;  // 記録した件数
+	uint32 u32Dropped;  // バッファが一杯で捨てた件数
+	uint32 u32Frames;   // 送ったパケット
+	uint32 u32Bytes;    // 送ったバイト数
+} tsDebugLogStats;
+
+// 引数のある記録: DEBUGLOG(LOG_SYNC, u32TickCount_ms, a, b, c, d)
+#define DEBUGLOG(u8Event, u32Now, ...) do { \
+		const uint32 au32LogArgs[] = { __VA_ARGS__ }; \
+		DebugLog_vPut(u8Event, au32LogArgs, sizeof(au32LogArgs) / sizeof(uint32), u32Now); \
+	} while (0)
+
+void DebugLog_vInit();
+
+// 1 件記録する (引数がなければ pu32Args は NULL、u8Argc は 0)
+void DebugLog_vPut(uint8 u8Event, const uint32 *pu32Args, uint8 u8Argc, uint32 u32Now);
+
+// 送る時刻になった
+bool_t DebugLog_bDue(uint32 u32Now);
+
+// 溜まった記録を pu8Buf (LOG_FRAME_MAX バイト) へ移し、長さを返す
+uint8 DebugLog_u8Take(uint8 *pu8Buf, uint32 u32Now);
+
+const tsDebugLogStats *DebugLog_psStats();
+
+#endif /* DEBUGLOG_H_ */
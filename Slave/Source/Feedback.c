@@ -0,0 +1,177 @@
+/*
+ * Feedback.c
+ *
+ * ブザーと LED による知らせ (Feedback.h を参照)
+ *
+ */
+
+#include <string.h>
+#include <AppHardwareApi.h>
+#include "utils.h"
+
+#include "Feedback.h"
+
+// ポート定義
+#define PORT_LED_1 3
+#define PORT_LED_2 2
+#define PORT_LED_3 1
+#define PORT_LED_4 0
+#define PORT_PWM_1 11
+
+#define PWM_HZ 1500 // 起動時の PWM 周波数
+
+typedef struct {
+	uint16 u16Hz;  // 0 なら無音
+	uint16 u16Ms;  // 0 なら並びの終わり
+	uint8 u8Leds;  // この段の間に重ねて点ける LED
+} tsFeedbackStep;
+
+#define END {0, 0, 0}
+
+// 音の並び (FEEDBACK_* の順)。長さは 32ms 単位だった頃の音を引き継ぐ
+static const tsFeedbackStep asStartup[] = {
+	{523, 32, 0}, {659, 32, 0}, {783, 32, 0}, END
+};
+static const tsFeedbackStep asShutdown[] = {
+	{783, 32, 0}, {659, 32, 0}, {523, 32, 0}, END
+};
+static const tsFeedbackStep asConnect[] = {
+	{523, 96, 0}, {784, 96, 0}, END
+};
+static const tsFeedbackStep asDisconnect[] = {
+	{784, 96, 0}, {523, 96, 0}, END
+};
+static const tsFeedbackStep asError[] = {
+	{523, 96, FEEDBACK_LED_4}, {0, 32, 0}, {523, 96, FEEDBACK_LED_4}, {0, 32, 0},
+	{523, 96, FEEDBACK_LED_4}, END
+};
+static const tsFeedbackStep asSearch[] = {
+	{659, 32, 0}, {0, 64, 0}, {659, 32, 0}, END
+};
+static const tsFeedbackStep asTouch[] = {
+	{784, 64, 0}, {1047, 64, 0}, END
+};
+static const tsFeedbackStep asSendError[] = {
+	{466, 160, FEEDBACK_LED_4}, END
+};
+static const tsFeedbackStep asReject[] = {
+	{311, 64, FEEDBACK_LED_4}, {0, 32, 0}, {311, 64, FEEDBACK_LED_4}, {0, 32, 0},
+	{311, 64, FEEDBACK_LED_4}, END
+};
+
+static const tsFeedbackStep * const apsPatterns[FEEDBACK_PATTERNS] = {
+	asStartup, asShutdown, asConnect, asDisconnect, asError,
+	asSearch, asTouch, asSendError, asReject
+};
+
+static const uint8 au8LedPorts[4] = {PORT_LED_1, PORT_LED_2, PORT_LED_3, PORT_LED_4};
+
+static tsTimerContext sTimerPWM;
+static uint16 u16Hz;                  // 今鳴らしている周波数 (0 なら無音)
+static const tsFeedbackStep *psStep;  // 鳴らしている段 (NULL なら鳴らしていない)
+static uint32 u32StepEnd;             // その段の終わる時刻
+static uint8 u8Steady;                // 常時の LED
+static uint8 u8Out;                   // ポートに出している LED
+
+// 変わった LED のポートだけを書き換える
+static void vLedOut()
+{
+	uint8 u8Want = u8Steady | (psStep ? psStep->u8Leds : 0);
+	uint8 u8Diff = u8Want ^ u8Out;
+	uint8 i;
+
+	for (i = 0; u8Diff; i++, u8Diff >>= 1) {
+		if (u8Diff & 1) {
+			if (u8Want & (1 << i)) vPortSetHi(au8LedPorts[i]); else vPortSetLo(au8LedPorts[i]);
+		}
+	}
+	u8Out = u8Want;
+}
+
+// 周波数が変わるときだけタイマーを書き換える
+static void vTone(uint16 u16NewHz)
+{
+	if (u16NewHz == u16Hz) {
+		return;
+	}
+	u16Hz = u16NewHz;
+	if (u16NewHz == 0) {
+		sTimerPWM.u16duty = 0;
+	} else {
+		sTimerPWM.u16duty = 128;
+		sTimerPWM.u16Hz = u16NewHz;
+	}
+	vTimerChangeHz(&sTimerPWM);
+}
+
+void Feedback_vInit()
+{
+	uint8 i;
+
+	for (i = 0; i < 4; i++) {
+		vPortAsOutput(au8LedPorts[i]);
+		vPortSetHi(au8LedPorts[i]);
+	}
+	vWait(0x3ffff);
+	for (i = 0; i < 4; i++) {
+		vPortSetLo(au8LedPorts[i]);
+	}
+	psStep = NULL;
+	u8Steady = 0;
+	u8Out = 0;
+
+	memset(&sTimerPWM, 0, sizeof(tsTimerContext));
+	vPortAsOutput(PORT_PWM_1);
+	sTimerPWM.u16Hz = PWM_HZ;
+	sTimerPWM.u8PreScale = 1; // 1000〜2000Hz
+	sTimerPWM.u16duty = 0;
+	sTimerPWM.bPWMout = TRUE;
+	sTimerPWM.u8Device = E_AHI_DEVICE_TIMER1;
+	vTimerConfig(&sTimerPWM);
+	vTimerStart(&sTimerPWM);
+	u16Hz = 0;
+}
+
+void Feedback_vPlay(uint8 u8Pattern, uint32 u32Now)
+{
+	if (u8Pattern >= FEEDBACK_PATTERNS) {
+		return;
+	}
+	psStep = apsPatterns[u8Pattern];
+	u32StepEnd = u32Now + psStep->u16Ms;
+	vTone(psStep->u16Hz);
+	vLedOut();
+}
+
+void Feedback_vStop()
+{
+	psStep = NULL;
+	vTone(0);
+	vLedOut();
+}
+
+bool_t Feedback_bDue(uint32 u32Now)
+{
+	return psStep != NULL && (int32)(u32Now - u32StepEnd) >= 0;
+}
+
+void Feedback_vStep(uint32 u32Now)
+{
+	// tick の遅れで過ぎた段は飛ばす (前の段の終わりから数え、並びを伸ばさない)
+	while (psStep != NULL && (int32)(u32Now - u32StepEnd) >= 0) {
+		psStep++;
+		if (psStep->u16Ms == 0) {
+			Feedback_vStop();
+			return;
+		}
+		u32StepEnd += psStep->u16Ms;
+	}
+	vTone(psStep->u16Hz);
+	vLedOut();
+}
+
+void Feedback_vLed(uint8 u8Mask, bool_t bOn)
+{
+	u8Steady = bOn ? (u8Steady | u8Mask) : (u8Steady & ~u8Mask);
+	vLedOut();
+}
@@ -0,0 +1,55 @@
+/*
+ * Feedback.h
+ *
+ * ブザーと LED による知らせ (音の並びと、LED の点灯)。
+ *
+ * 音は「周波数・長さ・その間に点ける LED」の段を並べた表 (Feedback.c) を
+ * 順に鳴らす。タイマー (PWM) を書き換えるのは周波数が変わる段の境目だけで、
+ * 次の境目の時刻を覚えておき、tick ではそれを過ぎたかだけを見る。
+ * 鳴らしていない間は何もしない。
+ * LED は常時の点灯 (接続中・送信中など) に、鳴らしている段の LED を重ねて出し、
+ * 変わったポートだけを書き換える。
+ *
+ */
+
+#ifndef FEEDBACK_H_
+#define FEEDBACK_H_
+
+#include <jendefs.h>
+
+// LED (ビットの組み合わせで指定する)
+#define FEEDBACK_LED_1   0x01 // カードを読んでいる
+#define FEEDBACK_LED_2   0x02 // タッチの送信中
+#define FEEDBACK_LED_3   0x04 // 接続中
+#define FEEDBACK_LED_4   0x08 // Master の探索中・送信の失敗
+#define FEEDBACK_LED_ALL 0x0F
+
+// 音の並び
+#define FEEDBACK_STARTUP    0
+#define FEEDBACK_SHUTDOWN   1
+#define FEEDBACK_CONNECT    2
+#define FEEDBACK_DISCONNECT 3
+#define FEEDBACK_ERROR      4
+#define FEEDBACK_SEARCH     5
+#define FEEDBACK_TOUCH      6
+#define FEEDBACK_SEND_ERROR 7
+#define FEEDBACK_REJECT     8
+#define FEEDBACK_PATTERNS   9
+
+// ポートとブザーの PWM を設定し、LED を一度すべて点けてから消す (無音)
+void Feedback_vInit();
+
+// u8Pattern を最初から鳴らす (鳴らしているものは打ち切る)
+void Feedback_vPlay(uint8 u8Pattern, uint32 u32Now);
+// 鳴らしているものを止める
+void Feedback_vStop();
+
+// 次の段の境目を過ぎたか (鳴らしていなければ FALSE)
+bool_t Feedback_bDue(uint32 u32Now);
+// 次の段へ進める (Feedback_bDue が TRUE のとき)
+void Feedback_vStep(uint32 u32Now);
+
+// 常時の LED を点ける・消す
+void Feedback_vLed(uint8 u8Mask, bool_t bOn);
+
+#endif /* FEEDBACK_H_ */
@@ -0,0 +1,95 @@
+/*
+ * IdmCache.c
+ *
+ * 最近読んだ IDm のキャッシュ (IdmCache.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "IdmCache.h"
+
+typedef struct {
+	uint16 u16Hash; // 0 は空き
+	uint8 au8Idm[8];
+	uint32 u32Seen; // 最後に読んだ時刻 (ms)
+} tsIdmCacheEntry;
+
+static tsIdmCacheEntry asCache[IDMCACHE_SIZE];
+static uint16 u16Holdoff;
+static int8 i8Present = -1; // 直前のポーリングで読んだエントリ
+static tsIdmCacheStats sStats;
+
+static uint16 u16Hash(const uint8 *pu8Idm)
+{
+	uint16 u16H = 0x1D0F;
+	uint8 i;
+
+	for (i = 0; i < 8; i++) {
+		u16H = (u16H << 5 | u16H >> 11) ^ pu8Idm[i];
+	}
+	return u16H ? u16H : 1;
+}
+
+void IdmCache_vInit(uint16 u16HoldoffMs)
+{
+	memset(asCache, 0, sizeof(asCache));
+	memset(&sStats, 0, sizeof(sStats));
+	u16Holdoff = u16HoldoffMs;
+	i8Present = -1;
+}
+
+bool_t IdmCache_bCheck(const uint8 *pu8Idm, uint32 u32Now)
+{
+	uint16 u16H = u16Hash(pu8Idm);
+	uint8 u8Victim = 0;
+	uint32 u32VictimAge = 0;
+	uint8 i;
+
+	for (i = 0; i < IDMCACHE_SIZE; i++) {
+		tsIdmCacheEntry *psE = &asCache[i];
+		uint32 u32Age = u32Now - psE->u32Seen;
+
+		if (psE->u16Hash == 0 || u32Age >= u16Holdoff) {
+			// 空きか期限切れ
+			if (u32VictimAge < u16Holdoff) {
+				u8Victim = i;
+				u32VictimAge = 0xFFFFFFFFUL;
+			}
+			continue;
+		}
+		if (psE->u16Hash == u16H && memcmp(psE->au8Idm, pu8Idm, 8) == 0) {
+			psE->u32Seen = u32Now;
+			if (i8Present != (int8)i) {
+				sStats.u32Absorbed++;
+				i8Present = i;
+			}
+			return FALSE;
+		}
+		if (u32Age >= u32VictimAge) {
+			// 空きがなければ最も古いものを追い出す
+			u8Victim = i;
+			u32VictimAge = u32Age;
+		}
+	}
+
+	if (u32VictimAge < u16Holdoff) {
+		sStats.u32Evicted++;
+	}
+	asCache[u8Victim].u16Hash = u16H;
+	memcpy(asCache[u8Victim].au8Idm, pu8Idm, 8);
+	asCache[u8Victim].u32Seen = u32Now;
+	i8Present = u8Victim;
+	sStats.u32Accepted++;
+	return TRUE;
+}
+
+void IdmCache_vAbsent()
+{
+	i8Present = -1;
+}
+
+const tsIdmCacheStats *IdmCache_psStats()
+{
+	return &sStats;
+}
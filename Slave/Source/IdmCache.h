@@ -0,0 +1,36 @@
+/*
+ * IdmCache.h
+ *
+ * 最近読んだ IDm のキャッシュ (同じカードの読み直しを抑える)。
+ *
+ * IDMCACHE_SIZE 件の IDm を最後に見た時刻とともに持ち、保持時間内に
+ * 再び読まれたカードは新しいタッチとしない。カードをかざし続けている
+ * 間は時刻を更新するので、離してから保持時間が過ぎるまで抑える。
+ * 比較は IDm から作る 16 ビットのハッシュで先に絞る。
+ *
+ */
+
+#ifndef IDMCACHE_H_
+#define IDMCACHE_H_
+
+#include <jendefs.h>
+
+#define IDMCACHE_SIZE 8
+
+typedef struct {
+	uint32 u32Accepted; // 新しいタッチとしたもの
+	uint32 u32Absorbed; // 離して再びかざした・交互にかざしたなどで抑えたもの
+	uint32 u32Evicted;  // 保持時間内に追い出したもの
+} tsIdmCacheStats;
+
+void IdmCache_vInit(uint16 u16HoldoffMs);
+
+// カードを読んだとき。新しいタッチなら TRUE
+bool_t IdmCache_bCheck(const uint8 *pu8Idm, uint32 u32Now);
+
+// カードがなかったとき
+void IdmCache_vAbsent();
+
+const tsIdmCacheStats *IdmCache_psStats();
+
+#endif /* IDMCACHE_H_ */
@@ -0,0 +1,61 @@
+/*
+ * NfcRecovery.c
+ *
+ * PN533 の段階的な立て直し (NfcRecovery.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "NfcRecovery.h"
+
+static const uint16 au16BinMs[NFCREC_HIST_BINS - 1] = { 50, 100, 200, 500, 1000 };
+
+static uint8 u8Stage;        // 今試している段 (NFCREC_NONE なら正常)
+static uint32 u32Since;      // 無応答に気づいた時刻
+static tsNfcRecoveryStats sStats;
+
+void NfcRecovery_vInit()
+{
+	u8Stage = NFCREC_NONE;
+	memset(&sStats, 0, sizeof(sStats));
+}
+
+uint8 NfcRecovery_u8Escalate(uint32 u32Now)
+{
+	if (u8Stage == NFCREC_NONE) {
+		u32Since = u32Now;
+	}
+	if (u8Stage < NFCREC_POWER) {
+		u8Stage++;
+	}
+	sStats.au32Entered[u8Stage - 1]++;
+	return u8Stage;
+}
+
+uint8 NfcRecovery_u8Recovered(uint32 u32Now, uint32 *pu32Ms)
+{
+	uint8 u8Done = u8Stage;
+	uint32 u32Ms;
+	uint8 i;
+
+	if (u8Stage == NFCREC_NONE) {
+		return NFCREC_NONE;
+	}
+	u8Stage = NFCREC_NONE;
+	u32Ms = u32Now - u32Since;
+	for (i = 0; i < NFCREC_HIST_BINS - 1 && u32Ms >= au16BinMs[i]; i++)
+		;
+	sStats.au32Recovered[u8Done - 1]++;
+	if (sStats.aau16Hist[u8Done - 1][i] < 0xFFFF) {
+		sStats.aau16Hist[u8Done - 1][i]++;
+	}
+	sStats.u32DownMsSum += u32Ms;
+	*pu32Ms = u32Ms;
+	return u8Done;
+}
+
+const tsNfcRecoveryStats *NfcRecovery_psStats()
+{
+	return &sStats;
+}
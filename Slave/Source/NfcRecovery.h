@@ -0,0 +1,48 @@
+/*
+ * NfcRecovery.h
+ *
+ * PN533 が応答しなくなったときの段階的な立て直しと、その記録。
+ *
+ * 応答が NFC_SILENCE_MS 途切れたら、軽い手から順に試す。
+ *   1. 最後のコマンドを送り直す (応答の取りこぼし)
+ *   2. ACK フレームで処理中のコマンドを中断させてから送り直す
+ *   3. 初期化のコマンド列をやり直す (電源は入れたまま)
+ *   4. 電源を入れ直す (最後の手段。治るまで繰り返す)
+ * 1, 2 は NFCREC_WAIT_MS、3 はコマンドごとに NFC_SILENCE_MS 待って次の段へ進む。
+ * 応答が戻れば段を戻し、どの段で治ったかと、無応答に気づいてから治るまでの
+ * 時間を段ごとのヒストグラムに数える。
+ *
+ */
+
+#ifndef NFCRECOVERY_H_
+#define NFCRECOVERY_H_
+
+#include <jendefs.h>
+
+#define NFCREC_WAIT_MS   100 // 送り直し・中断の後に応答を待つ時間
+#define NFCREC_HIST_BINS 6   // 治るまでの時間の区間 (50, 100, 200, 500, 1000ms 未満とそれ以上)
+
+#define NFCREC_NONE   0
+#define NFCREC_RESEND 1
+#define NFCREC_ABORT  2
+#define NFCREC_REINIT 3
+#define NFCREC_POWER  4
+#define NFCREC_STAGES 4
+
+typedef struct {
+	uint32 au32Entered[NFCREC_STAGES];   // 段に入った回数 (添字は段 - 1)
+	uint32 au32Recovered[NFCREC_STAGES]; // その段で治った回数
+	uint16 aau16Hist[NFCREC_STAGES][NFCREC_HIST_BINS];
+	uint32 u32DownMsSum;                 // 治るまでの時間の合計
+} tsNfcRecoveryStats;
+
+void NfcRecovery_vInit();
+
+// 応答がないとき。次に試す段を返す (電源の入れ直しの後は電源の入れ直しのまま)
+uint8 NfcRecovery_u8Escalate(uint32 u32Now);
+// 応答が戻ったとき。立て直し中だったなら治した段 (でなければ NFCREC_NONE)
+uint8 NfcRecovery_u8Recovered(uint32 u32Now, uint32 *pu32Ms);
+
+const tsNfcRecoveryStats *NfcRecovery_psStats();
+
+#endif /* NFCRECOVERY_H_ */
@@ -0,0 +1,244 @@
+/*
+ * ParentCache.c
+ *
+ * 最後に接続した Master の記録 (ParentCache.h を参照)
+ *
+ */
+
+#include <string.h>
+#include <AppHardwareApi.h>
+
+#include "ParentCache.h"
+
+#define REC_MAGIC 0x5A
+#define REC_LEN   8
+
+// EEPROM 上のレコード: [0] REC_MAGIC [1] チャネル [2..5] アドレス (BE) [6] 予約 [7] チェックサム
+static bool_t bValid = FALSE;
+static uint8 u8Channel;
+static uint32 u32Addr;
+
+static bool_t bSearching = FALSE;
+static uint32 u32SearchFrom;
+static tsReconnectStats sStats;
+static tsParentCandidate asCand[PARENTCACHE_CANDIDATES];
+
+void ParentCache_vInit()
+{
+	uint8 au8Rec[REC_LEN];
+	uint8 u8SegLen, u8Sum = 0, i;
+
+	bValid = FALSE;
+	bSearching = FALSE;
+	memset(&sStats, 0, sizeof(sStats));
+	memset(asCand, 0, sizeof(asCand));
+
+	u16AHI_InitialiseEEP(&u8SegLen);
+	if (iAHI_ReadDataFromEEPROMsegment(PARENTCACHE_EEP_SEGMENT, 0, au8Rec, REC_LEN) != 0) {
+		return;
+	}
+	for (i = 0; i < REC_LEN; i++) u8Sum += au8Rec[i];
+	if (au8Rec[0] == REC_MAGIC && u8Sum == 0) {
+		u8Channel = au8Rec[1];
+		u32Addr = ((uint32)au8Rec[2] << 24) | ((uint32)au8Rec[3] << 16) | ((uint32)au8Rec[4] << 8) | au8Rec[5];
+		bValid = TRUE;
+	}
+}
+
+bool_t ParentCache_bGet(uint8 *pu8Channel, uint32 *pu32Addr)
+{
+	if (bValid) {
+		*pu8Channel = u8Channel;
+		*pu32Addr = u32Addr;
+	}
+	return bValid;
+}
+
+void ParentCache_vSet(uint8 u8Ch, uint32 u32Address)
+{
+	uint8 au8Rec[REC_LEN];
+	uint8 u8Sum = 0, i;
+
+	if (bValid && u8Ch == u8Channel && u32Address == u32Addr) {
+		return;
+	}
+	u8Channel = u8Ch;
+	u32Addr = u32Address;
+	bValid = TRUE;
+
+	au8Rec[0] = REC_MAGIC;
+	au8Rec[1] = u8Ch;
+	au8Rec[2] = u32Address >> 24;
+	au8Rec[3] = u32Address >> 16;
+	au8Rec[4] = u32Address >> 8;
+	au8Rec[5] = u32Address;
+	au8Rec[6] = 0;
+	for (i = 0; i < REC_LEN - 1; i++) u8Sum += au8Rec[i];
+	au8Rec[7] = (uint8)-u8Sum;
+	iAHI_WriteDataIntoEEPROMsegment(PARENTCACHE_EEP_SEGMENT, 0, au8Rec, REC_LEN);
+}
+
+void ParentCache_vReconnectStart(uint32 u32Now)
+{
+	if (!bSearching) {
+		bSearching = TRUE;
+		u32SearchFrom = u32Now;
+	}
+}
+
+void ParentCache_vReconnectDone(uint32 u32Now, bool_t bWarm)
+{
+	uint32 u32Ms = u32Now - u32SearchFrom;
+
+	if (!bSearching) {
+		return;
+	}
+	bSearching = FALSE;
+	if (bWarm) {
+		sStats.u16WarmOk++;
+		sStats.u32WarmMsSum += u32Ms;
+	} else {
+		sStats.u16Full++;
+		sStats.u32FullMsSum += u32Ms;
+	}
+	if (sStats.u32MaxMs < u32Ms) sStats.u32MaxMs = u32Ms;
+}
+
+void ParentCache_vWarmFailed()
+{
+	sStats.u16WarmFail++;
+}
+
+const tsReconnectStats *ParentCache_psStats()
+{
+	return &sStats;
+}
+
+void ParentCache_vMigrated()
+{
+	sStats.u16Migrations++;
+}
+
+static tsParentCandidate *psLookup(uint32 u32Address)
+{
+	uint8 i;
+
+	for (i = 0; i < PARENTCACHE_CANDIDATES; i++) {
+		if (asCand[i].u8Channel != 0 && asCand[i].u32Addr == u32Address) return &asCand[i];
+	}
+	return NULL;
+}
+
+void ParentCache_vFollow(uint8 u8Ch)
+{
+	tsParentCandidate *psC;
+
+	if (!bValid) {
+		return;
+	}
+	psC = psLookup(u32Addr);
+	if (psC) {
+		psC->u8Channel = u8Ch;
+	}
+	ParentCache_vSet(u8Ch, u32Addr);
+	sStats.u16Follows++;
+}
+
+void ParentCache_vScanBegin()
+{
+	uint8 i;
+
+	for (i = 0; i < PARENTCACHE_CANDIDATES; i++) {
+		asCand[i].u8Lqi = 0;
+	}
+}
+
+// 聞こえた Master を候補に入れる。なければ今回見つからなかったもの、なければ
+// LQI の最も低いものと入れ替える。今の接続先は必ず入れ、追い出さない
+static tsParentCandidate *psHeard(uint8 u8Ch, uint32 u32Address, uint8 u8Lqi)
+{
+	tsParentCandidate *psC = psLookup(u32Address);
+	bool_t bParent = bValid && u32Address == u32Addr;
+	uint8 i;
+
+	if (u8Lqi == 0) u8Lqi = 1;
+	if (psC == NULL) {
+		for (i = 0; i < PARENTCACHE_CANDIDATES; i++) {
+			if (bValid && asCand[i].u8Channel != 0 && asCand[i].u32Addr == u32Addr) continue;
+			if (psC == NULL || asCand[i].u8Lqi < psC->u8Lqi) psC = &asCand[i];
+		}
+		if (psC == NULL || (!bParent && psC->u8Lqi >= u8Lqi)) {
+			return NULL;
+		}
+		psC->u32Addr = u32Address;
+		psC->u8Load = PARENTCACHE_LOAD_UNKNOWN;
+	}
+	psC->u8Channel = u8Ch;
+	psC->u8Lqi = u8Lqi;
+	return psC;
+}
+
+void ParentCache_vScanFound(uint8 u8Ch, uint32 u32Address, uint8 u8Lqi)
+{
+	psHeard(u8Ch, u32Address, u8Lqi);
+}
+
+void ParentCache_vLoad(uint8 u8Ch, uint32 u32Address, uint8 u8Lqi, uint8 u8Load, uint32 u32Now)
+{
+	tsParentCandidate *psC = psHeard(u8Ch, u32Address, u8Lqi);
+
+	if (psC != NULL) {
+		psC->u8Load = u8Load;
+		psC->u32LoadAt = u32Now;
+	}
+}
+
+const tsParentCandidate *ParentCache_psFind(uint32 u32Address)
+{
+	uint8 i;
+
+	for (i = 0; i < PARENTCACHE_CANDIDATES; i++) {
+		if (asCand[i].u8Lqi != 0 && asCand[i].u32Addr == u32Address) return &asCand[i];
+	}
+	return NULL;
+}
+
+uint8 ParentCache_u8Load(uint32 u32Address, uint32 u32Now)
+{
+	tsParentCandidate *psC = psLookup(u32Address);
+
+	if (psC == NULL || psC->u8Load == PARENTCACHE_LOAD_UNKNOWN
+			|| u32Now - psC->u32LoadAt > PARENTCACHE_LOAD_AGE_MS) {
+		return PARENTCACHE_LOAD_UNKNOWN;
+	}
+	return psC->u8Load;
+}
+
+int16 ParentCache_i16Score(uint32 u32Address, uint8 u8Lqi, uint32 u32Now)
+{
+	uint8 u8Load = ParentCache_u8Load(u32Address, u32Now);
+
+	if (u8Load == PARENTCACHE_LOAD_UNKNOWN) {
+		u8Load = PARENTCACHE_LOAD_ASSUMED;
+	}
+	return (int16)u8Lqi - (int16)u8Load * PARENTCACHE_LOAD_WEIGHT;
+}
+
+const tsParentCandidate *ParentCache_psBest(uint32 u32Exclude, uint32 u32Now)
+{
+	const tsParentCandidate *psBest = NULL;
+	int16 i16Best = 0;
+	uint8 i;
+
+	for (i = 0; i < PARENTCACHE_CANDIDATES; i++) {
+		int16 i16Score;
+
+		if (asCand[i].u8Lqi == 0 || asCand[i].u32Addr == u32Exclude) continue;
+		i16Score = ParentCache_i16Score(asCand[i].u32Addr, asCand[i].u8Lqi, u32Now);
+		if (psBest == NULL || i16Score > i16Best) {
+			psBest = &asCand[i];
+			i16Best = i16Score;
+		}
+	}
+	return psBest;
+}
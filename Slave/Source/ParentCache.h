@@ -0,0 +1,76 @@
+/*
+ * ParentCache.h
+ *
+ * 最後に接続した Master (チャネルとアドレス) の記録と再接続の統計。
+ *
+ * 再接続ではまず記録したチャネルだけを調べ、見つからなければ全チャネルを
+ * 調べる。記録は RAM (RAM 保持スリープではそのまま残る) と EEPROM の
+ * PARENTCACHE_EEP_SEGMENT に置き、変わったときだけ書く。
+ *
+ * スキャン (前回のチャネルだけの確認を含む) で見つけた Master と、Keep-Alive が
+ * 聞こえた Master は候補として覚えておき、Keep-Alive で知らせてくる負荷と
+ * 合わせて点数 (LQI - 負荷 × PARENTCACHE_LOAD_WEIGHT) を付ける。接続先が
+ * 混んでいれば、点数の高い候補へ移るのに使う。接続先は必ず候補に入れておく。
+ *
+ */
+
+#ifndef PARENTCACHE_H_
+#define PARENTCACHE_H_
+
+#include <jendefs.h>
+
+#define PARENTCACHE_EEP_SEGMENT 0 // TouchLog は 8 から
+#define PARENTCACHE_CANDIDATES  8
+#define PARENTCACHE_LOAD_WEIGHT 1
+#define PARENTCACHE_LOAD_AGE_MS 30000 // これより古い負荷は不明とする
+#define PARENTCACHE_LOAD_UNKNOWN 0xFF
+#define PARENTCACHE_LOAD_ASSUMED 50   // 負荷が不明な Master の見込み (%)
+
+typedef struct {
+	uint32 u32Addr;
+	uint8 u8Channel;
+	uint8 u8Lqi;       // 最後に聞こえたときの LQI (0 は全チャネルスキャンで見つからなかった)
+	uint8 u8Load;      // Keep-Alive で知った負荷 (%)
+	uint32 u32LoadAt;  // 負荷を知った時刻
+} tsParentCandidate;
+
+typedef struct {
+	uint16 u16WarmOk;     // 記録したチャネルで見つかった
+	uint16 u16WarmFail;   // 見つからず全チャネルを調べた
+	uint16 u16Full;       // 全チャネルを調べて見つかった
+	uint32 u32WarmMsSum;  // 切断から接続までの時間の合計
+	uint32 u32FullMsSum;
+	uint32 u32MaxMs;
+	uint16 u16Migrations; // 混んでいる Master から移った
+	uint16 u16Follows;    // 接続先が知らせたチャネルへ一緒に移った
+} tsReconnectStats;
+
+void ParentCache_vInit();
+bool_t ParentCache_bGet(uint8 *pu8Channel, uint32 *pu32Addr);
+void ParentCache_vSet(uint8 u8Channel, uint32 u32Addr);
+
+// 切断・起動で接続を探し始めたとき / 見つかったとき
+void ParentCache_vReconnectStart(uint32 u32Now);
+void ParentCache_vReconnectDone(uint32 u32Now, bool_t bWarm);
+void ParentCache_vWarmFailed();
+void ParentCache_vMigrated();
+// 接続先の Master が u8Channel へ移ったとき (記録も書き換える)
+void ParentCache_vFollow(uint8 u8Channel);
+
+// スキャンの結果 (vScanBegin は全チャネルを調べるときだけ) と、u8Channel で聞こえた Keep-Alive の負荷
+void ParentCache_vScanBegin();
+void ParentCache_vScanFound(uint8 u8Channel, uint32 u32Addr, uint8 u8Lqi);
+void ParentCache_vLoad(uint8 u8Channel, uint32 u32Addr, uint8 u8Lqi, uint8 u8Load, uint32 u32Now);
+
+// 候補の中で点数が最も高いもの (u32Exclude は除く)。なければ NULL
+const tsParentCandidate *ParentCache_psBest(uint32 u32Exclude, uint32 u32Now);
+const tsParentCandidate *ParentCache_psFind(uint32 u32Addr);
+
+// 負荷 (%)。知らないか古ければ PARENTCACHE_LOAD_UNKNOWN
+uint8 ParentCache_u8Load(uint32 u32Addr, uint32 u32Now);
+// LQI と負荷の点数。負荷が分からなければ PARENTCACHE_LOAD_ASSUMED とみなす
+int16 ParentCache_i16Score(uint32 u32Addr, uint8 u8Lqi, uint32 u32Now);
+
+const tsReconnectStats *ParentCache_psStats();
+
+#endif /* PARENTCACHE_H_ */
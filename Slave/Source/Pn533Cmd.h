@@ -0,0 +1,47 @@
+/*
+ * Pn533Cmd.h
+ *
+ * Slave が PN533 に送るコマンドフレーム。
+ *
+ * LCS・DCS を含めてコンパイル時に組み立てておき、送るときは
+ * そのまま UART に書く。
+ *
+ */
+
+#ifndef PN533CMD_H_
+#define PN533CMD_H_
+
+#include <jendefs.h>
+
+// 00 00 FF LEN LCS <データ> DCS 00
+#define PN533_HEAD(n)  0x00, 0x00, 0xFF, (n), (uint8)(0x100 - (n))
+#define PN533_DCS(s)   (uint8)(0x100 - ((s) & 0xFF))
+
+#define PN533_CMD3(a, b, c) \
+	{ PN533_HEAD(3), a, b, c, PN533_DCS((a) + (b) + (c)), 0x00 }
+#define PN533_CMD4(a, b, c, d) \
+	{ PN533_HEAD(4), a, b, c, d, PN533_DCS((a) + (b) + (c) + (d)), 0x00 }
+#define PN533_CMD6(a, b, c, d, e, f) \
+	{ PN533_HEAD(6), a, b, c, d, e, f, PN533_DCS((a) + (b) + (c) + (d) + (e) + (f)), 0x00 }
+#define PN533_CMD9(a, b, c, d, e, f, g, h, i) \
+	{ PN533_HEAD(9), a, b, c, d, e, f, g, h, i, \
+	  PN533_DCS((a) + (b) + (c) + (d) + (e) + (f) + (g) + (h) + (i)), 0x00 }
+
+// ACK (処理中のコマンドを中断)
+static const uint8 au8Pn533Ack[] = { 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00 };
+
+// 初期化 (E_STATE_NFC_INIT で順に送る)
+static const uint8 au8Pn533Init[] = PN533_CMD3(0xD4, 0x18, 0x01);
+// 項目 2 (ATR_RES と InDataExchange などの時間切れ)。どちらも使わない
+static const uint8 au8Pn533Timeout[] = PN533_CMD6(0xD4, 0x32, 0x02, 0x00, 0x00, 0x00);
+// 項目 5 (MxRtyPassiveActivation = 0)。試し直しは Slave が次の InListPassiveTarget で行う
+static const uint8 au8Pn533Retry[] = PN533_CMD6(0xD4, 0x32, 0x05, 0x00, 0x00, 0x00);
+static const uint8 au8Pn533Config[] = PN533_CMD4(0xD4, 0x32, 0x81, 0xB7);
+
+// InListPassiveTarget (212kbps FeliCa, システムコード FFFF)
+static const uint8 au8Pn533Poll[] = PN533_CMD9(0xD4, 0x4A, 0x01, 0x01, 0x00, 0xFF, 0xFF, 0x00, 0x00);
+
+// RF を切る (次の InListPassiveTarget で自動的に入る)
+static const uint8 au8Pn533RfOff[] = PN533_CMD4(0xD4, 0x32, 0x01, 0x00);
+
+#endif /* PN533CMD_H_ */
@@ -0,0 +1,153 @@
+/*
+ * Pn533Parser.c
+ *
+ * PN533 フレームの逐次パーサ (Pn533Parser.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "Pn533Parser.h"
+
+enum {
+	S_IDLE = 0, // 00 待ち
+	S_ZERO1,    // 00 を受けた
+	S_ZERO2,    // 00 00 を受けた (00 が続く間はここに留まる)
+	S_LEN,
+	S_LCS,
+	S_EXT_LENM,
+	S_EXT_LENL,
+	S_EXT_LCS,
+	S_DATA,
+	S_DCS
+};
+
+void Pn533_vInit(tsPn533Parser *psP)
+{
+	memset(psP, 0, sizeof(tsPn533Parser));
+}
+
+void Pn533_vReset(tsPn533Parser *psP)
+{
+	psP->u8State = S_IDLE;
+}
+
+// 長さが決まったらデータ部へ
+static tePn533Result eBeginData(tsPn533Parser *psP, uint16 u16Len)
+{
+	if (u16Len == 0) {
+		psP->sStats.u32Checksum++;
+		psP->u8State = S_IDLE;
+	} else if (u16Len > PN533_DATA_MAX) {
+		psP->sStats.u32Overflows++;
+		psP->u8State = S_IDLE;
+	} else {
+		psP->u16Len = u16Len;
+		psP->u16Pos = 0;
+		psP->u8Sum = 0;
+		psP->u8State = S_DATA;
+	}
+	return E_PN533_NONE;
+}
+
+tePn533Result Pn533_eParse(tsPn533Parser *psP, uint8 u8Byte)
+{
+	switch (psP->u8State) {
+	case S_IDLE:
+		if (u8Byte == 0x00) {
+			psP->u8State = S_ZERO1;
+		} else {
+			psP->sStats.u32Resyncs++;
+		}
+		break;
+
+	case S_ZERO1:
+		if (u8Byte == 0x00) {
+			psP->u8State = S_ZERO2;
+		} else {
+			// ポストアンブルの後のゴミなど
+			psP->sStats.u32Resyncs++;
+			psP->u8State = S_IDLE;
+		}
+		break;
+
+	case S_ZERO2:
+		// プリアンブル + スタートコード 00 00 FF
+		if (u8Byte == 0xFF) {
+			psP->u8State = S_LEN;
+		} else if (u8Byte != 0x00) {
+			psP->sStats.u32Resyncs++;
+			psP->u8State = S_IDLE;
+		}
+		break;
+
+	case S_LEN:
+		psP->u16Len = u8Byte;
+		psP->u8State = S_LCS;
+		break;
+
+	case S_LCS:
+		psP->u8State = S_IDLE;
+		if (psP->u16Len == 0x00 && u8Byte == 0xFF) {
+			psP->sStats.u32Acks++;
+			return E_PN533_ACK;
+		}
+		if (psP->u16Len == 0xFF && u8Byte == 0x00) {
+			return E_PN533_NACK;
+		}
+		if (psP->u16Len == 0xFF && u8Byte == 0xFF) {
+			psP->u8State = S_EXT_LENM;
+			break;
+		}
+		if ((uint8)(psP->u16Len + u8Byte) != 0) {
+			psP->sStats.u32Checksum++;
+			break;
+		}
+		return eBeginData(psP, psP->u16Len);
+
+	case S_EXT_LENM:
+		psP->u16Len = (uint16)u8Byte << 8;
+		psP->u8State = S_EXT_LENL;
+		break;
+
+	case S_EXT_LENL:
+		psP->u16Len |= u8Byte;
+		psP->u8State = S_EXT_LCS;
+		break;
+
+	case S_EXT_LCS:
+		if ((uint8)((psP->u16Len >> 8) + psP->u16Len + u8Byte) != 0) {
+			psP->sStats.u32Checksum++;
+			psP->u8State = S_IDLE;
+			break;
+		}
+		return eBeginData(psP, psP->u16Len);
+
+	case S_DATA:
+		psP->au8Data[psP->u16Pos++] = u8Byte;
+		psP->u8Sum += u8Byte;
+		if (psP->u16Pos == psP->u16Len) {
+			psP->u8State = S_DCS;
+		}
+		break;
+
+	case S_DCS:
+		// ポストアンブルの 00 は次のフレームの前の 00 として読み捨てる
+		psP->u8State = S_IDLE;
+		if ((uint8)(psP->u8Sum + u8Byte) != 0) {
+			psP->sStats.u32Checksum++;
+			break;
+		}
+		if (psP->u16Len == 1 && psP->au8Data[0] == 0x7F) {
+			psP->sStats.u32Errors++;
+			return E_PN533_ERROR;
+		}
+		psP->sStats.u32Frames++;
+		return E_PN533_FRAME;
+
+	default:
+		psP->u8State = S_IDLE;
+		break;
+	}
+	return E_PN533_NONE;
+}
@@ -0,0 +1,60 @@
+/*
+ * Pn533Parser.h
+ *
+ * PN533 (RC-S380) から UART で届くフレームの逐次パーサ。
+ *
+ * 1 バイトずつ渡すと、フレームの区切りで結果を返す。データ部はパーサ内の
+ * バッファに置いたまま Pn533_pu8Data で参照する (次のバイトを渡すまで有効)。
+ *
+ *   ACK         00 00 FF 00 FF 00
+ *   NACK        00 00 FF FF 00 00
+ *   通常        00 00 FF LEN LCS TFI PD.. DCS 00
+ *   拡張        00 00 FF FF FF LENM LENL LCS TFI PD.. DCS 00
+ *   エラー      00 00 FF 01 FF 7F 81 00 (アプリケーションレベルのエラー)
+ *
+ * 先頭の 00 00 FF で同期する (前に余分な 00 があってもよい)。ポストアンブルは
+ * 読み捨てるので、省略されていてもよい。
+ *
+ */
+
+#ifndef PN533PARSER_H_
+#define PN533PARSER_H_
+
+#include <jendefs.h>
+
+#define PN533_DATA_MAX 265 // TFI を含むデータ部の最大長
+
+typedef enum {
+	E_PN533_NONE = 0, // フレームの途中
+	E_PN533_ACK,
+	E_PN533_NACK,
+	E_PN533_FRAME,    // 通常・拡張フレーム (Pn533_pu8Data で参照)
+	E_PN533_ERROR     // エラーフレーム
+} tePn533Result;
+
+typedef struct {
+	uint32 u32Frames;    // 正しく受け取った通常・拡張フレーム
+	uint32 u32Acks;
+	uint32 u32Errors;    // エラーフレーム
+	uint32 u32Resyncs;   // 同期を失って読み捨てたバイト
+	uint32 u32Checksum;  // LCS・DCS の不一致
+	uint32 u32Overflows; // PN533_DATA_MAX を超えるフレーム
+} tsPn533Stats;
+
+typedef struct {
+	uint8 u8State;
+	uint16 u16Len;
+	uint16 u16Pos;
+	uint8 u8Sum;
+	uint8 au8Data[PN533_DATA_MAX];
+	tsPn533Stats sStats;
+} tsPn533Parser;
+
+void Pn533_vInit(tsPn533Parser *psP);
+void Pn533_vReset(tsPn533Parser *psP); // 受信途中のフレームを捨てる (統計は残す)
+tePn533Result Pn533_eParse(tsPn533Parser *psP, uint8 u8Byte);
+
+#define Pn533_pu8Data(psP) ((psP)->au8Data)
+#define Pn533_u16Len(psP)  ((psP)->u16Len)
+
+#endif /* PN533PARSER_H_ */
@@ -19,6 +19,24 @@
 #include "ToCoNet_mod_prototype.h" // ToCoNet モジュール定義
 
 #include "type.h"
+#include "TouchLog.h"
+#include "Pn533Parser.h"
+#include "IdmCache.h"
+#include "Pn533Cmd.h"
+#include "ParentCache.h"
+#include "TimeSync.h"
+#include "TxWindow.h"
+#include "DebugLog.h"
+#include "BootStats.h"
+#include "NfcRecovery.h"
+#include "AllowFilter.h"
+#include "BulkRx.h"
+#include "Feedback.h"
+#include "../../Common/Source/Profile.h"
+#include "../../Common/Source/Allowlist.h"
+#ifdef USE_TDMA
+#include "TdmaSlot.h"
+#endif
 #include "../../Common/Source/app_event.h"
 #include "../../Common/Source/packets.h"				// パケット
 
@@ -29,16 +47,72 @@
 #define CHANNEL_MASK_BASE	11
 // スリープ時間(ms単位)
 #define SLEEP_INTERVAL 0
+// 起動音を鳴らしてから Master を探し始めるまでの時間 (ms)
+#define STARTUP_WAIT_MS	100
+// PN533 の電源を入れてから初期化を始めるまでの時間 (ms)
+#define NFC_POWERUP_MS	300
+// PN533 の応答がこれだけ途切れたら立て直しを始める (ms)
+#define NFC_SILENCE_MS	200
+// 電源を入れ直すときに切っておく時間 (ms)
+#define NFC_POWEROFF_MS	500
 // Masterの応答がなくなってから再接続を試みるまでの時間(秒単位)
 #define RECONNECT_TIME	10
+// 再接続で前回のチャネルだけを調べる時間 (ms)
+#define WARM_PROBE_DUR	128
+// 接続先の負荷がこれ以上なら、点数の高い候補へ移る (%)
+#define MIGRATE_LOAD	80
+// 接続してから、次に移ってよくなるまでの時間 (秒)
+#define MIGRATE_DWELL_S	30
+// 移り先の点数が今の接続先をこれだけ上回るときだけ移る
+#define MIGRATE_MARGIN	20
+// タッチをまとめて送るまでの待ち時間 (ms)。送信中に溜まった分は待たずにまとめる
+#ifndef FELICA_BATCH_WINDOW_MS
+#define FELICA_BATCH_WINDOW_MS 8
+#endif
+// 続けて送るときの間隔 (ms)。再接続後に溜まったタッチで無線を埋めないようにする
+#define TOUCH_REPLAY_MS 20
+// 送信に失敗したときに再送するまでの待ち時間 (ms)
+#define TOUCH_RETRY_MS 200
+// 時刻合わせの誤差と送信窓の統計を報告する間隔 (秒)
+#define TIMESYNC_REPORT_S 300
+// PN533 の立て直しの記録を出す間隔 (秒)
+#define NFC_REPORT_S 300
+// 健全性の記録 (PACKET_CMD_HEALTH) を送る間隔 (秒)。接続したときにも送る
+#define HEALTH_REPORT_S 60
+// 一斉配信の区切りの間隔 (ms)。TDMA の Master はビーコンごとに 1 つ送るので、NACK はそれより待つ
+#ifdef USE_TDMA
+#define BULK_GAP_MS TDMA_SUPERFRAME_MS
+#else
+#define BULK_GAP_MS 0
+#endif
+// 同じカードを新しいタッチとしない時間 (ms)。離してからこの時間が過ぎれば再び送る
+#ifndef IDM_HOLDOFF_MS
+#define IDM_HOLDOFF_MS 3000
+#endif
+
+// ポーリングのプロファイル (make POLL_PROFILE=NORMAL|LOWPOWER)
+//   NORMAL   1 回ずつ試し、応答が来たらすぐ次を送る (検出が最も速い)
+//   LOWPOWER カードがなければ RF を切り、POLL_GAP_MS 待ってから次を送る
+// PN533 の中で試し直させても (MxRtyPassiveActivation) UART の往復が減るだけで
+// 検出は速くならず、RFConfiguration の項目 2 の時間切れは InListPassiveTarget には
+// 効かないので、どちらのプロファイルも同じ値にしている (Pn533Cmd.h)
+#define POLL_PROFILE_NORMAL   1
+#define POLL_PROFILE_LOWPOWER 2
+#ifndef POLL_PROFILE
+#define POLL_PROFILE POLL_PROFILE_NORMAL
+#endif
+
+#if POLL_PROFILE == POLL_PROFILE_LOWPOWER
+#define POLL_GAP_MS  100  // NFC の無応答監視 (NFC_SILENCE_MS) より短くする
+#else
+#define POLL_GAP_MS  0
+#endif
+
+// ポーリングの統計を送る間隔 (秒)。make POLL_STATS=1 のときのみ
+#define POLL_STATS_INTERVAL 10
 
-// ポート定義
-#define PORT_LED_1 3
-#define PORT_LED_2 2
-#define PORT_LED_3 1
-#define PORT_LED_4 0
+// ポート定義 (LED とブザーは Feedback.c)
 #define PORT_SW_1 8
-#define PORT_PWM_1 11
 #define PORT_FELICA 5
 
 #define UART_BAUD 115200 // シリアルのボーレート
@@ -59,53 +133,60 @@
 
 // プロトタイプ宣言
 static bool_t sendSprintf();
-static void sendHexDebug(uint8 *data, uint8 size);
 
 // 変数
 static tsFILE sSerStream;          // シリアル用ストリーム
 static tsSerialPortSetup sSerPort; // シリアルポートデスクリプタ
 static uint32 u32Seq;              // 送信パケットのシーケンス番号
 static tsAppData sAppData;
-uint32 u32BeforeSeq = 0xff;
+uint32 u32BeforeSeq = 0xffffffff; // 親から最後に受けたパケットの番号 (重複の除去)
 tsFelicaResponse felicaResponse;
 
 uint8 u8NfcInitStage = 0;
-uint8 au8FelicaBuffer[128];
-uint8 u8FelicaBufferIndex = 0;
-uint8 au8BeforIdm[8] = {0};
+static tsPn533Parser sPn533;       // PN533 からの受信フレーム
+static const uint8 *pu8NfcLast;    // 最後に送ったコマンド (立て直しで送り直す)
+static uint8 u8NfcLastLen;
+static uint8 u8NfcWait;            // 応答を待つ時間 (ms)
+
+// ポーリングの状態と統計
+static uint32 u32PollSent = 0;     // 最後に InListPassiveTarget を送った時刻
+static uint32 u32PollAt = 0;       // 次に送る時刻 (0 なら応答待ち)
+static uint32 u32PollEmpty = 0;    // カードがなかった最後の応答の時刻
+static uint32 u32CardSince = 0;    // 新しいタッチの直前の u32PollEmpty (0 なら計測済み)
+static struct {
+	uint32 u32Polls;      // InListPassiveTarget の応答
+	uint32 u32PollsLast;  // 前回の報告時の u32Polls
+	uint32 u32Cards;      // 計測したタッチ
+	uint32 u32LatSumMs;   // カードがなかった最後のポーリングから sendIdm までの時間の合計
+	uint32 u32LatMaxMs;
+} sPollStats;
 uint8 u8ScanFailuer = 0;
-
-#define SOUND_FREQ 32
-
-#define SOUND_STARTUP 0
-#define SOUND_SHUTDOWN 1
-#define SOUND_CONNECT 2
-#define SOUND_DISCONNECT 3
-#define SOUND_ERROR 4
-#define SOUND_SEARCH 5
-#define SOUND_TOUCH 6
-#define SOUND_SEND_ERROR 7
-
-#define SOUND_LENGTH 15
-uint16 u16SoundTimer = 0;
-uint8 u8SoundSelect = 0;
-const uint16 au16Sounds[8][SOUND_LENGTH] = {
-	{523, 659, 783},
-	{783, 659, 523},
-	{523, 523, 523, 784, 784, 784},
-	{784, 784, 784, 523, 523, 523},
-	{523, 523, 523, 0, 523, 523, 523, 0, 523, 523, 523},
-	{659, 0, 0, 659, 0 , 0},
-	{784, 784, 1047, 1047},
-	{466, 466, 466, 466, 466}
-};
-
-tsTimerContext sTimerPWM;
+// 健全性の記録 (起動から数える。packets.h の HEALTH)
+static struct {
+	uint16 u16Tx;         // 送信の完了
+	uint16 u16TxFail;     // そのうち失敗
+	uint16 u16NfcResets;  // PN533 の応答がなく電源を入れ直した回数
+	uint16 u16ScanFails;  // Master を見つけられなかったスキャン
+} sHealth;
+static bool_t bWarmProbe = FALSE;  // 前回のチャネルだけを調べている
+static bool_t bWarmTried = FALSE;  // 今回の再接続で前回のチャネルを調べた
+static uint8 u8WarmCh;
+static uint32 u32WarmAddr;
+static bool_t bMigrating = FALSE;  // 混んでいる Master から u32WarmAddr へ移っている
+static uint32 u32ParentSince = 0;  // 今の Master に接続した時刻
+static uint8 u8FollowCh = 0;       // 接続先が知らせた移り先のチャネル (0 ならなし)
+static uint32 u32FollowAt;         // 移る時刻
+
+// 送信待ちのタッチ (TouchLog) の送信状態。ACK 待ちのフレームは TxWindow
+static bool_t bFelicaTxBusy = FALSE; // FeliCa パケットの送信完了待ち
+static uint8 u8FelicaCbId = 0;
+static uint16 u16FelicaSeq;          // 送信中のフレームの送信番号
+static uint32 u32FelicaNextTx = 0;   // 次に送ってよい時刻 (ms)
 
 // デバッグ出力用に UART を初期化
 static void vSerialInit() {
 	static uint8 au8SerialTxBuffer[96];
-	static uint8 au8SerialRxBuffer[32];
+	static uint8 au8SerialRxBuffer[128]; // 応答 (通常最大 36 バイト) と ACK が数組入る
 
 	sSerPort.pu8SerialRxQueueBuffer = au8SerialRxBuffer;
 	sSerPort.pu8SerialTxQueueBuffer = au8SerialTxBuffer;
@@ -123,245 +204,518 @@ static void vSerialInit() {
 }
 
 static void vSerialClear() {
-	while(!SERIAL_bRxQueueEmpty(&sSerPort)){
+	while(!SERIAL_bRxQueueEmpty(sSerPort.u8SerialPort)){
 		SERIAL_i16RxChar(sSerPort.u8SerialPort);
 	}
+	Pn533_vReset(&sPn533);
 }
 
 static void vInitPort()
 {
 	// 使用ポートの設定
-	vPortAsOutput(PORT_LED_1);
-	vPortAsOutput(PORT_LED_2);
-	vPortAsOutput(PORT_LED_3);
-	vPortAsOutput(PORT_LED_4);
 	vPortAsOutput(PORT_FELICA);
-
-
-	vPortSetHi(PORT_LED_1);
-	vPortSetHi(PORT_LED_2);
-	vPortSetHi(PORT_LED_3);
-	vPortSetHi(PORT_LED_4);
-
-	vWait(0x3ffff);
-
-	vPortSetLo(PORT_LED_1);
-	vPortSetLo(PORT_LED_2);
-	vPortSetLo(PORT_LED_3);
-	vPortSetLo(PORT_LED_4);
 	vPortSetLo(PORT_FELICA);
 
 	vPortAsInput(PORT_SW_1);
 }
 
+// ハードウェア初期化
+static void vInitHardware()
+{
+	// デバッグ出力用
+	vSerialInit();
+	ToCoNet_vDebugInit(&sSerStream);
+	ToCoNet_vDebugLevel(0);
+	Feedback_vInit();
+	vInitPort();
+}
+
 
-static void vSetPWM(uint16 value)
+static void vWritePn533(const uint8 *pu8Frame, uint8 u8Len)
 {
-	if(value == 0){
-		// Off
-		sTimerPWM.u16duty = 0;
-	}else{
-		// On
-		sTimerPWM.u16duty = 128;
-		sTimerPWM.u16Hz = value;
+	while (u8Len--) {
+		SERIAL_bTxChar(UART_PORT, *pu8Frame++);
 	}
+}
 
-	//vTimerConfig(&sTimerPWM);
-	vTimerChangeHz(&sTimerPWM);
+// 組み立て済みのコマンドを PN533 に送る
+static void vSendPn533(const uint8 *pu8Frame, uint8 u8Len)
+{
+	pu8NfcLast = pu8Frame;
+	u8NfcLastLen = u8Len;
+	vWritePn533(pu8Frame, u8Len);
+}
+
+// ACK フレームで処理中のコマンドを中断させる (最後のコマンドとしては覚えない)
+static void sendFelicaReset()
+{
+	vWritePn533(au8Pn533Ack, sizeof(au8Pn533Ack));
 }
 
-static void vPlaySound(uint8 sound){
-	u8SoundSelect = sound;
-	u16SoundTimer = 0;
-	vSetPWM(au16Sounds[sound][0]);
+static void vSendPoll()
+{
+	u32PollSent = u32TickCount_ms;
+	u32PollAt = 0;
+	vSendPn533(au8Pn533Poll, sizeof(au8Pn533Poll));
 }
 
-static void vInitPWM()
+
+
+// 溜まったデバッグログ (DebugLog) を接続先へ送る。書式の文字列は送らない
+static bool_t sendLog()
 {
-	memset(&sTimerPWM, 0, sizeof(tsTimerContext));
-	vPortAsOutput(PORT_PWM_1);
+	tsTxDataApp tsTx;
+
+	if (sAppData.u32parentAddr == 0) {
+		return FALSE;
+	}
+	memset(&tsTx, 0, sizeof(tsTxDataApp));
+
+	tsTx.u32SrcAddr = ToCoNet_u32GetSerial();
+	tsTx.u32DstAddr = sAppData.u32parentAddr;
+	tsTx.bAckReq = TRUE;
+	tsTx.u8Retry = 0x01; // 送信失敗時は1回再送
+	tsTx.u8CbId = u32Seq & 0xFF;
+	tsTx.u8Seq = u32Seq & 0xFF;
+	tsTx.u8Cmd = PACKET_CMD_LOG;
+	tsTx.u8Len = DebugLog_u8Take(tsTx.auData, u32TickCount_ms);
+	u32Seq++;
+
+	// 送信
+	return ToCoNet_bMacTxReq(&tsTx);
+}
+
 
-	// PWM
-	uint16 u16PWM_Hz = 1500; // PWM周波数
-  uint8 u8PWM_prescale = 0; // prescaleの設定
 
-  if (u16PWM_Hz < 10) u8PWM_prescale = 9;
-  else if (u16PWM_Hz < 100) u8PWM_prescale = 6;
-  else if (u16PWM_Hz < 1000) u8PWM_prescale = 3;
-  else if (u16PWM_Hz < 2000) u8PWM_prescale = 1;
-  else u8PWM_prescale = 0;
 
-	sTimerPWM.u16Hz = u16PWM_Hz;
-	sTimerPWM.u8PreScale = u8PWM_prescale;
-	sTimerPWM.u16duty = 0;
-	sTimerPWM.bPWMout = TRUE;
-  sTimerPWM.u8Device = E_AHI_DEVICE_TIMER1;
-	vTimerConfig(&sTimerPWM);
-	vTimerStart(&sTimerPWM);
+// 1 パケットに入るタッチの数 (Master の時刻が分かれば時刻付きの形式で送る)
+static uint8 u8BatchMax()
+{
+	return TimeSync_bSynced() ? FELICA_TIMED_MAX : FELICA_BATCH_MAX;
 }
 
-// ハードウェア初期化
-static void vInitHardware()
+// まだどのフレームにも入れていないタッチの数
+static uint8 u8Unsent()
 {
-	// デバッグ出力用
-	vSerialInit();
-	ToCoNet_vDebugInit(&sSerStream);
-	ToCoNet_vDebugLevel(0);
-	vInitPWM();
-	vInitPort();
+	return TouchLog_u8Count() - TxWindow_u8Entries();
 }
 
+// Masterへの送信実行。期限の来た再送を先に、なければまだ送っていないタッチで
+// 新しいフレームを開く。ログから消すのは Master の ACK を受けてから
+static bool_t sendIdm()
+{
+	tsTxDataApp tsTx;
+	int8 i8Frame = TxWindow_i8Due(u32TickCount_ms);
+	uint8 u8First, u8Count;
+	bool_t bTimed;
+	uint8 i;
 
-static void writeSerial(uint8 *buf, uint16 size){
-	uint16 i;
-	for(i=0; i<size; i++){
-		vPutChar(&sSerStream, buf[i]);
+	if (i8Frame < 0) {
+		u8Count = u8Unsent();
+		if (u8Count == 0 || !TxWindow_bCanOpen()) {
+			return FALSE;
+		}
+		if (u8Count > u8BatchMax()) {
+			u8Count = u8BatchMax();
+		}
+		i8Frame = TxWindow_i8Open(u8Count);
 	}
-	//sendHexDebug(buf, size);
-}
+	u8First = TxWindow_u8First(i8Frame);
+	u8Count = TxWindow_u8Count(i8Frame);
+	// 時刻の分からないうちに開いたフレームは、時刻付きに入りきらないことがある
+	bTimed = TimeSync_bSynced() && u8Count <= FELICA_TIMED_MAX;
 
-static uint8 calcDCS(uint8 *data, uint16 len)
-{
-  uint8 sum = 0;
-	uint16 i;
+	memset(&tsTx, 0, sizeof(tsTxDataApp));
+
+	tsTx.u32SrcAddr = ToCoNet_u32GetSerial();
+	tsTx.u32DstAddr = sAppData.u32parentAddr;
+	//tsTx.u32DstAddr = TOCONET_MAC_ADDR_BROADCAST;
 
-  for (i = 0; i < len; i++) {
-      sum += data[i];
-  }
-  return (uint8)-(sum & 0xff);
+	tsTx.bAckReq = TRUE;
+#ifdef USE_TDMA
+	tsTx.u8Retry = 0x00; // 隣のスロットにはみ出さないよう、失敗したら次のスロットで
+#else
+	tsTx.u8Retry = 0x03; // 送信失敗時は3回再送
+#endif
+	tsTx.u8CbId = u32Seq & 0xFF;
+	tsTx.u8Seq = u32Seq & 0xFF;
+	tsTx.u8Cmd = PACKET_CMD_FELICA;
+	tsTx.auData[0] = TxWindow_u16Seq(i8Frame) >> 8;
+	tsTx.auData[1] = TxWindow_u16Seq(i8Frame) & 0xFF;
+	tsTx.auData[2] = TxWindow_u16Seq(i8Frame) - TxWindow_u16Base();
+
+	if (bTimed) {
+		// タッチを読んだ時刻を Master の時刻にして付ける
+		uint8 *p = tsTx.auData + FELICA_SEQ_LEN;
+		*p++ = u8Count | FELICA_TIMED;
+		for (i = 0; i < u8Count; i++) {
+			tsTouchEntry *psT = TouchLog_psPeek(u8First + i);
+			uint32 u32Time = TimeSync_u32ToNetwork(psT->u32Tick);
+			memcpy(p, psT->au8Idm, FELICA_IDM_LEN);
+			p += FELICA_IDM_LEN;
+			*p++ = (uint8)(u32Time >> 24);
+			*p++ = (uint8)(u32Time >> 16);
+			*p++ = (uint8)(u32Time >> 8);
+			*p++ = (uint8)u32Time;
+		}
+		tsTx.u8Len = FELICA_SEQ_LEN + FELICA_TIMED_LEN(u8Count);
+	} else {
+		// 時刻が分からないうちは、1 件でも経過時間付きのまとめ送りの形式にする
+		uint8 *p = tsTx.auData + FELICA_SEQ_LEN;
+		*p++ = u8Count;
+		for (i = 0; i < u8Count; i++) {
+			tsTouchEntry *psT = TouchLog_psPeek(u8First + i);
+			uint32 u32Age = u32TickCount_ms - psT->u32Tick;
+			if (u32Age > 0xFFFF) u32Age = 0xFFFF;
+			memcpy(p, psT->au8Idm, FELICA_IDM_LEN);
+			p += FELICA_IDM_LEN;
+			*p++ = (uint8)(u32Age >> 8);
+			*p++ = (uint8)u32Age;
+		}
+		tsTx.u8Len = FELICA_SEQ_LEN + FELICA_BATCH_LEN(u8Count);
+	}
+	u32Seq++;
+
+	// 送信
+	Feedback_vLed(FEEDBACK_LED_2, TRUE);
+	if (!ToCoNet_bMacTxReq(&tsTx)) {
+		u32FelicaNextTx = u32TickCount_ms + TOUCH_RETRY_MS;
+		TxWindow_vSent(TxWindow_u16Seq(i8Frame), FALSE, u32TickCount_ms, u32FelicaNextTx);
+		return FALSE;
+	}
+	bFelicaTxBusy = TRUE;
+	u8FelicaCbId = tsTx.u8CbId;
+	u16FelicaSeq = TxWindow_u16Seq(i8Frame);
+
+	if (u32CardSince) {
+		uint32 u32Lat = u32TickCount_ms - u32CardSince;
+		sPollStats.u32Cards++;
+		sPollStats.u32LatSumMs += u32Lat;
+		if (sPollStats.u32LatMaxMs < u32Lat) sPollStats.u32LatMaxMs = u32Lat;
+		u32CardSince = 0;
+	}
+	return TRUE;
 }
 
-static void sendFelicaReset()
+// 接続中で送信中でなければ、送り直すフレームか新しいフレームを送る。
+// bNow でなければ、新しいフレームはまだ送っていない最初のタッチから待ち時間が
+// 過ぎるか 1 パケット分溜まるまで待つ
+static void vFlushTouches(bool_t bNow)
 {
-	uint8 buf[6] = {0x00, 0x00, 0xff, 0x00, 0xff, 0x00};
-	writeSerial(buf, 6);
-	WAIT_UART_OUTPUT(UART_PORT);
+	if (bFelicaTxBusy || sAppData.u32parentAddr == 0) {
+		return;
+	}
+	if ((int32)(u32TickCount_ms - u32FelicaNextTx) < 0) {
+		return;
+	}
+	if (TxWindow_i8Due(u32TickCount_ms) < 0) {
+		uint8 u8New = u8Unsent();
+		if (u8New == 0 || !TxWindow_bCanOpen()) {
+			return;
+		}
+#ifndef USE_TDMA
+		if (!bNow && u32TickCount_ms - TouchLog_psPeek(TouchLog_u8Count() - u8New)->u32Tick < FELICA_BATCH_WINDOW_MS
+				&& u8New < u8BatchMax()) {
+			return;
+		}
+#endif
+	}
+#ifdef USE_TDMA
+	// 自分のスロット (なければ競合スロット) でだけ送る。溜まった分はスロットでまとめる
+	if (TdmaSlot_bTxWindow(u32TickCount_ms) && sendIdm()) {
+		TdmaSlot_vTxDone(u32TickCount_ms);
+	}
+	return;
+#endif
+	sendIdm();
 }
 
-static void sendFelicaCommand(uint8 *command, uint16 commandLen){
-	uint8 buf[9];
-
-	uint8 dcs = calcDCS(command, commandLen);
+// Master の ACK のブロック (packets.h) から自分の分を探し、届いたタッチをログから消す
+static void vReceiveAcks(const uint8 *pu8Block, uint8 u8Len)
+{
+	uint32 u32Self = ToCoNet_u32GetSerial();
+	const uint8 *p = pu8Block + 1;
+	uint8 i;
 
-	/* transmit the command */
-	buf[0] = 0x00;
-	buf[1] = 0x00;
-	buf[2] = 0xff;
-	if (commandLen <= 255) {
-			/* normal frame */
-			buf[3] = commandLen;
-			buf[4] = (uint8)-buf[3];
-			writeSerial(buf, 5);
-	} else {
-			/* extended frame */
-			buf[3] = 0xff;
-			buf[4] = 0xff;
-			buf[5] = (uint8)((commandLen >> 8) & 0xff);
-			buf[6] = (uint8)((commandLen >> 0) & 0xff);
-			buf[7] = (uint8)-(buf[5] + buf[6]);
-			writeSerial(buf, 8);
+	for (i = 0; u8Len >= 1 && i < pu8Block[0] && 1 + (i + 1) * XPORT_ACK_ENTRY_LEN <= u8Len;
+			i++, p += XPORT_ACK_ENTRY_LEN) {
+		if ((((uint32)p[0] << 24) | ((uint32)p[1] << 16) | ((uint32)p[2] << 8) | p[3]) == u32Self) {
+			TouchLog_vAck(TxWindow_u8Ack(((uint16)p[4] << 8) | p[5], p[6], u32TickCount_ms));
+			vFlushTouches(FALSE);
+			return;
+		}
 	}
-	writeSerial(command, commandLen);
-	buf[0] = dcs;
-	buf[1] = 0x00;
-	writeSerial(buf, 2);
-	WAIT_UART_OUTPUT(UART_PORT);
 }
 
 
 
-static bool_t sendDebugMessage(char *message){
+// 健全性の記録を接続先へ送る
+static bool_t sendHealth()
+{
 	tsTxDataApp tsTx;
-	uint8 size;
 
-	if(sAppData.u32parentAddr == 0){
-		return;
+	if (sAppData.u32parentAddr == 0) {
+		return FALSE;
 	}
-
 	memset(&tsTx, 0, sizeof(tsTxDataApp));
 
 	tsTx.u32SrcAddr = ToCoNet_u32GetSerial();
 	tsTx.u32DstAddr = sAppData.u32parentAddr;
-
 	tsTx.bAckReq = TRUE;
-	tsTx.u8Retry = 0x01; // 送信失敗時は1回再送
+	tsTx.u8Retry = 0x01;
 	tsTx.u8CbId = u32Seq & 0xFF;
 	tsTx.u8Seq = u32Seq & 0xFF;
-	tsTx.u8Cmd = PACKET_CMD_DEBUG;
+	tsTx.u8Cmd = PACKET_CMD_HEALTH;
+	tsTx.auData[0] = sHealth.u16Tx >> 8;
+	tsTx.auData[1] = sHealth.u16Tx & 0xFF;
+	tsTx.auData[2] = sHealth.u16TxFail >> 8;
+	tsTx.auData[3] = sHealth.u16TxFail & 0xFF;
+	tsTx.auData[4] = sHealth.u16NfcResets >> 8;
+	tsTx.auData[5] = sHealth.u16NfcResets & 0xFF;
+	tsTx.auData[6] = sHealth.u16ScanFails >> 8;
+	tsTx.auData[7] = sHealth.u16ScanFails & 0xFF;
+	tsTx.u8Len = HEALTH_LEN;
+	u32Seq++;
+
+	return ToCoNet_bMacTxReq(&tsTx);
+}
 
-	size = strlen(message);
-	if(size > 98){
-		size = 98;
-		message[97] = 0;
+// 一斉配信 (BulkRx.h) で足りない区切りがあれば NACK を送る
+static bool_t sendBulkNack()
+{
+	tsTxDataApp tsTx;
+
+	memset(&tsTx, 0, sizeof(tsTxDataApp));
+	tsTx.u8Len = BulkRx_u8Nack(tsTx.auData, u32TickCount_ms,
+			BULK_GAP_MS + ToCoNet_u16GetRand() % BULKRX_NACK_SPREAD_MS);
+	if (tsTx.u8Len == 0) {
+		return FALSE;
 	}
 
-	memcpy(tsTx.auData, message, size);
-	tsTx.u8Len = size;
-	dbg("u8Len: %d", tsTx.u8Len);
+	tsTx.u32SrcAddr = ToCoNet_u32GetSerial();
+	tsTx.u32DstAddr = sAppData.u32parentAddr;
+	tsTx.bAckReq = TRUE;
+	tsTx.u8Retry = 0x01;
+	tsTx.u8CbId = u32Seq & 0xFF;
+	tsTx.u8Seq = u32Seq & 0xFF;
+	tsTx.u8Cmd = PACKET_CMD_BULK;
 	u32Seq++;
 
-	// 送信
 	return ToCoNet_bMacTxReq(&tsTx);
 }
 
+// 接続先が知らせる有効な IDm の一覧の版 (AllowFilter.h)
+static void vAllowVersion(uint8 u8Ver)
+{
+	if (AllowFilter_bVersion(u8Ver, u32TickCount_ms)) {
+		BulkRx_vStart(BULK_OBJ_ALLOWLIST, u8Ver, AllowFilter_pu8Buffer(), ALLOWLIST_BYTES,
+				u32TickCount_ms, BULK_GAP_MS + ToCoNet_u16GetRand() % BULKRX_NACK_SPREAD_MS);
+	} else if (AllowFilter_u8Want() == 0) {
+		BulkRx_vStop();
+	}
+}
+
+// 一斉配信の区切りを受け取ったとき (区切りも新しい版を知らせる)
+static void vBulkChunk(const uint8 *pu8Data, uint8 u8Len)
+{
+	const tsAllowFilterStats *psSt = AllowFilter_psStats();
 
+	if (u8Len < BULK_HDR_LEN || pu8Data[0] != BULK_OBJ_ALLOWLIST) {
+		return;
+	}
+	vAllowVersion(pu8Data[1]);
+	if (!BulkRx_bChunk(pu8Data, u8Len, u32TickCount_ms)) {
+		return;
+	}
+	AllowFilter_vLoaded(u32TickCount_ms);
+	DEBUGLOG(LOG_ALLOW, u32TickCount_ms, psSt->u8Version, psSt->u32FetchMsSum / psSt->u32Loads,
+			BulkRx_psStats()->u32Nacks, psSt->u32Accepted, psSt->u32Rejected, psSt->u32Unchecked);
+}
 
+// 読んだカードの音。一覧があれば Master の返事を待たずに受け付け・拒否を鳴らし分ける
+// (タッチはどちらでも Master へ送り、最終的な判定はホストで行う)
+static void vTouchFeedback(const uint8 *pu8Idm)
+{
+	Feedback_vPlay(AllowFilter_u8Check(pu8Idm) == ALLOWFILTER_REJECT ? FEEDBACK_REJECT : FEEDBACK_TOUCH,
+			u32TickCount_ms);
+}
 
-// Masterへの送信実行
-static bool_t sendIdm(uint8 *idm)
+#ifdef USE_TDMA
+// TDMA の参加要求・ハートビート
+static bool_t sendJoin(uint8 u8Kind)
 {
 	tsTxDataApp tsTx;
-
 	memset(&tsTx, 0, sizeof(tsTxDataApp));
 
 	tsTx.u32SrcAddr = ToCoNet_u32GetSerial();
 	tsTx.u32DstAddr = sAppData.u32parentAddr;
-	//tsTx.u32DstAddr = TOCONET_MAC_ADDR_BROADCAST;
-
 	tsTx.bAckReq = TRUE;
-	tsTx.u8Retry = 0x03; // 送信失敗時は3回再送
+	tsTx.u8Retry = 0x00;
 	tsTx.u8CbId = u32Seq & 0xFF;
 	tsTx.u8Seq = u32Seq & 0xFF;
-	tsTx.u8Cmd = PACKET_CMD_FELICA;
-
-	memcpy(tsTx.auData, idm, 8);
-	tsTx.u8Len = 8;
+	tsTx.u8Cmd = PACKET_CMD_JOIN;
+	tsTx.auData[0] = u8Kind;
+	tsTx.u8Len = 1;
 	u32Seq++;
 
-	// 送信
-	vPortSetHi(PORT_LED_2);
 	return ToCoNet_bMacTxReq(&tsTx);
 }
+#endif
+
+// 接続先が混んでいて、十分に点数の高い候補があれば移り先を u8WarmCh / u32WarmAddr に入れる
+static bool_t bMigrateTarget()
+{
+	const tsParentCandidate *psCur, *psAlt;
+	uint8 u8Load = ParentCache_u8Load(sAppData.u32parentAddr, u32TickCount_ms);
+
+	if (u8Load == PARENTCACHE_LOAD_UNKNOWN || u8Load < MIGRATE_LOAD
+			|| u32TickCount_ms - u32ParentSince < MIGRATE_DWELL_S * 1000UL) {
+		return FALSE;
+	}
+	psCur = ParentCache_psFind(sAppData.u32parentAddr);
+	psAlt = ParentCache_psBest(sAppData.u32parentAddr, u32TickCount_ms);
+	if (psCur == NULL || psAlt == NULL
+			|| ParentCache_i16Score(psAlt->u32Addr, psAlt->u8Lqi, u32TickCount_ms)
+			< ParentCache_i16Score(psCur->u32Addr, psCur->u8Lqi, u32TickCount_ms) + MIGRATE_MARGIN) {
+		return FALSE;
+	}
+	// 負荷は数秒遅れて伝わるので、皆で一度に移らないよう少しずつ (負荷 100% で毎秒 4%)
+	if (ToCoNet_u16GetRand() % 500 > u8Load - MIGRATE_LOAD) {
+		return FALSE;
+	}
+	u8WarmCh = psAlt->u8Channel;
+	u32WarmAddr = psAlt->u32Addr;
+	return TRUE;
+}
+
+// 起動してから接続と PN533 の初期化が揃ったとき
+static void vBootReady()
+{
+	const tsBootStats *psB = BootStats_psStats();
+	DEBUGLOG(LOG_READY, u32TickCount_ms, psB->u32NfcMs, psB->u32AssocMs, psB->u32ReadyMs, psB->u16EarlyTouches);
+}
+
+#ifdef USE_PROFILE
+// 処理時間の表を毎秒 1 項目ずつ送る (Profile.h)
+static void vReportProfile()
+{
+	tsProfileEntry sE;
+	uint32 u32Key;
 
+	if (sAppData.u32parentAddr == 0 || !Profile_bReport(&sE)) {
+		return;
+	}
+	u32Key = Profile_u32Key(&sE);
+	DEBUGLOG(LOG_PROFILE, u32TickCount_ms, u32Key, sE.u32Calls, sE.u32Min / PROFILE_COUNTS_PER_US,
+			sE.u32Sum / sE.u32Calls / PROFILE_COUNTS_PER_US, sE.u32Max / PROFILE_COUNTS_PER_US);
+	DEBUGLOG(LOG_PROFILE_HIST, u32TickCount_ms, u32Key, 0, sE.au16Hist[0], sE.au16Hist[1],
+			sE.au16Hist[2], sE.au16Hist[3], sE.au16Hist[4], sE.au16Hist[5]);
+	DEBUGLOG(LOG_PROFILE_HIST, u32TickCount_ms, u32Key, 6, sE.au16Hist[6], sE.au16Hist[7],
+			sE.au16Hist[8], sE.au16Hist[9], sE.au16Hist[10], sE.au16Hist[11]);
+}
+#endif
 
+// PN533 の立て直しの段ごとの記録 (入ったことのある段だけ)
+static void vReportNfcRecovery()
+{
+	const tsNfcRecoveryStats *psSt = NfcRecovery_psStats();
+	uint8 i;
 
-// ユーザ定義のイベントハンドラ
+	for (i = 0; i < NFCREC_STAGES; i++) {
+		const uint16 *pu16H = psSt->aau16Hist[i];
+		if (psSt->au32Entered[i] == 0) continue;
+		DEBUGLOG(LOG_NFC_STAGE, u32TickCount_ms, i + 1, psSt->au32Entered[i],
+				pu16H[0], pu16H[1], pu16H[2], pu16H[3], pu16H[4], pu16H[5]);
+	}
+}
+
+// Master への接続と、接続中の送信・切断・移動 (PN533 は vProcessEvNfc)
 static void vProcessEvCore(tsEvent *pEv, teEvent eEvent, uint32 u32evarg)
 {
+	PROFILE_BEGIN(PROFILE_CORE, pEv->eState, eEvent);
 
 	if (eEvent == E_EVENT_TICK_SECOND) {
 		sAppData.u32parentDisconnectTime++;
 
+#ifdef POLL_STATS
+		if (u32TickCount_ms / 1000 % POLL_STATS_INTERVAL == 0) {
+			DEBUGLOG(LOG_POLL, u32TickCount_ms,
+					(sPollStats.u32Polls - sPollStats.u32PollsLast) / POLL_STATS_INTERVAL,
+					sPollStats.u32Cards,
+					sPollStats.u32Cards ? sPollStats.u32LatSumMs / sPollStats.u32Cards : 0,
+					sPollStats.u32LatMaxMs);
+			sPollStats.u32PollsLast = sPollStats.u32Polls;
+		}
+#endif
+		if (u32TickCount_ms / 1000 % TIMESYNC_REPORT_S == 0 && TimeSync_bSynced()) {
+			const tsTimeSyncStats *psTs = TimeSync_psStats();
+			const tsTxWindowStats *psTw = TxWindow_psStats();
+			uint32 u32Kept = psTs->u32Samples - psTs->u32Steps;
+			DEBUGLOG(LOG_SYNC, u32TickCount_ms, psTs->u32Samples, psTs->u32Steps,
+					u32Kept ? psTs->u32ErrSumMs / u32Kept : 0, psTs->u16ErrMaxMs);
+			DEBUGLOG(LOG_XPORT, u32TickCount_ms, psTw->u32Frames, psTw->u32Acked, psTw->u32Retransmits,
+					psTw->u32Timeouts, psTw->u32FastRetx, psTw->u16SrttMs, psTw->u16RttvarMs, TxWindow_u16RtoMs());
+		}
+
+		if (u32TickCount_ms / 1000 % NFC_REPORT_S == 0) {
+			vReportNfcRecovery();
+		}
+		if (u32TickCount_ms / 1000 % HEALTH_REPORT_S == 0) {
+			sendHealth();
+		}
+#ifdef USE_PROFILE
+		vReportProfile();
+#endif
+
 		if (sAppData.u32parentDisconnectTime > RECONNECT_TIME)
 		{
 			dbg("master disconnected.");
-			vPlaySound(SOUND_DISCONNECT);
+			Feedback_vPlay(FEEDBACK_DISCONNECT, u32TickCount_ms);
 			sAppData.u32parentDisconnectTime = 0;
 			sAppData.u32parentAddr = 0;
 			ToCoNet_Event_SetState(pEv, E_STATE_CHSCAN_INIT);
 		}
+		else if (pEv->eState == E_STATE_CONNECTED && bMigrateTarget())
+		{
+			dbg("migrate to %08x.", u32WarmAddr);
+			ParentCache_vMigrated();
+			bMigrating = TRUE;
+			sAppData.u32parentAddr = 0;
+			ToCoNet_Event_SetState(pEv, E_STATE_CHSCAN_INIT);
+		}
 	}
 
 	if (eEvent == E_EVENT_TICK_TIMER) {
-		sAppData.u8tick_ms += 4;
+		if (u8FollowCh && (int32)(u32TickCount_ms - u32FollowAt) >= 0) {
+			// 接続先と同じ時刻にチャネルを移る (接続はそのまま)
+			if (sAppData.u32parentAddr != 0) {
+				dbg("follow to ch%d.", u8FollowCh);
+				sAppData.u8channel = u8FollowCh;
+				sToCoNet_AppContext.u8Channel = u8FollowCh;
+				ToCoNet_vRfConfig();
+				ParentCache_vFollow(u8FollowCh);
+			}
+			u8FollowCh = 0;
+		}
+#ifdef USE_TDMA
+		if (sAppData.u32parentAddr != 0) {
+			uint8 u8Join = TdmaSlot_u8JoinDue(u32TickCount_ms);
+			if (u8Join != TDMA_JOIN_NONE && sendJoin(u8Join)) {
+				TdmaSlot_vJoinSent(u8Join, u32TickCount_ms, ToCoNet_u16GetRand());
+			}
+		}
+#endif
+		vFlushTouches(FALSE);
+		if (DebugLog_bDue(u32TickCount_ms)) {
+			sendLog();
+		}
+		if (sAppData.u32parentAddr != 0) {
+			sendBulkNack();
+		}
 
-		// サウンドの再生
-		u16SoundTimer += 4;
-		uint16 soundIndex = u16SoundTimer/SOUND_FREQ;
-		if(soundIndex<SOUND_LENGTH){
-			vSetPWM(au16Sounds[u8SoundSelect][soundIndex]);
-		}else{
-			u16SoundTimer = SOUND_FREQ * (SOUND_LENGTH+1);
+		// 音は段の境目でだけ進める
+		if (Feedback_bDue(u32TickCount_ms)) {
+			Feedback_vStep(u32TickCount_ms);
 		}
 	}
 
@@ -376,8 +730,8 @@ static void vProcessEvCore(tsEvent *pEv, teEvent eEvent, uint32 u32evarg)
 				if (u32evarg & EVARG_START_UP_WAKEUP_RAMHOLD_MASK) {
 				}
 				sAppData.u32parentDisconnectTime = 0;
-				vPlaySound(SOUND_STARTUP);
-			}else if(ToCoNet_Event_u32TickFrNewState(pEv) > 1000) {
+				Feedback_vPlay(FEEDBACK_STARTUP, u32TickCount_ms);
+			}else if(ToCoNet_Event_u32TickFrNewState(pEv) > STARTUP_WAIT_MS) {
 				// 空きチャンネルスキャンに入る
 				u8ScanFailuer = 0;
 				sAppData.u32parentDisconnectTime = 0;
@@ -388,20 +742,32 @@ static void vProcessEvCore(tsEvent *pEv, teEvent eEvent, uint32 u32evarg)
 		case E_STATE_CHSCAN_INIT:
 			if (eEvent == E_EVENT_NEW_STATE) {
 				dbg("E_EVENT_NEW_STATE");
-				vPlaySound(SOUND_SEARCH);
-				if(u8ScanFailuer > 5){
-					ToCoNet_Event_SetState(pEv, E_STATE_APP_SHUTDOWN);
+				Feedback_vLed(FEEDBACK_LED_3, FALSE);
+				if (bMigrating) {
+					// 移り先 (bMigrateTarget) のチャネルだけを調べる
+					bWarmProbe = TRUE;
+				} else {
+					Feedback_vPlay(FEEDBACK_SEARCH, u32TickCount_ms);
+					if(u8ScanFailuer > 5){
+						ToCoNet_Event_SetState(pEv, E_STATE_APP_SHUTDOWN);
+					}
+					ParentCache_vReconnectStart(u32TickCount_ms);
+					// 前回の Master が分かっていれば、まずそのチャネルだけを調べる
+					bWarmProbe = !bWarmTried && ParentCache_bGet(&u8WarmCh, &u32WarmAddr);
 				}
-				vPortSetLo(PORT_LED_3);
-				vPortSetHi(PORT_FELICA);
 			}
 
 			//dbg("wait a small tick");
-			if (ToCoNet_Event_u32TickFrNewState(pEv) > 200) {
+			if (ToCoNet_Event_u32TickFrNewState(pEv) > (bWarmProbe ? 0 : 200)) {
 				ToCoNet_vRfConfig();
-				vPortSetHi(PORT_LED_4);
+				Feedback_vLed(FEEDBACK_LED_4, TRUE);
 				dbg("master scan...");
-				ToCoNet_NbScan_bStart(CHANNEL_MASK, 128);
+				if (bWarmProbe) {
+					bWarmTried = TRUE;
+					ToCoNet_NbScan_bStart(1UL << u8WarmCh, WARM_PROBE_DUR);
+				} else {
+					ToCoNet_NbScan_bStart(CHANNEL_MASK, 128);
+				}
 				ToCoNet_Event_SetState(pEv, E_STATE_CHSCANNING);
 			}
 			break;
@@ -410,29 +776,67 @@ static void vProcessEvCore(tsEvent *pEv, teEvent eEvent, uint32 u32evarg)
 			if (eEvent == E_EVENT_CHSCAN_FINISH)
 			{
 				dbg("CHSCAN finish. Ch%d selected.", sAppData.u8channel);
-				vPortSetHi(PORT_LED_3);
-				vPortSetLo(PORT_LED_4);
-				vPlaySound(SOUND_CONNECT);
+				Feedback_vLed(FEEDBACK_LED_3, TRUE);
+				Feedback_vLed(FEEDBACK_LED_4, FALSE);
+				if (!bMigrating) Feedback_vPlay(FEEDBACK_CONNECT, u32TickCount_ms);
 				//Ch変更
 				sToCoNet_AppContext.u8Channel = sAppData.u8channel;
 				ToCoNet_vRfConfig();
 
-				sendDebugMessage("Hello!");
+				ParentCache_vSet(sAppData.u8channel, sAppData.u32parentAddr);
+				ParentCache_vReconnectDone(u32TickCount_ms, bWarmProbe);
+				u32ParentSince = u32TickCount_ms;
+				u8FollowCh = 0;
+				TimeSync_vConnected(sAppData.u32parentAddr);
+				// ACK を待っていたフレームは新しい接続先へ送り直す (同じ Master なら ACK だけが返る)
+				TxWindow_vResend();
+#ifdef USE_TDMA
+				TdmaSlot_vReset(ToCoNet_u16GetRand());
+#endif
+				bWarmProbe = FALSE;
+				bWarmTried = FALSE;
+				bMigrating = FALSE;
+				_C {
+					const tsReconnectStats *psRs = ParentCache_psStats();
+					DEBUGLOG(LOG_CONNECTED, u32TickCount_ms,
+							psRs->u16WarmOk, psRs->u16WarmOk + psRs->u16WarmFail, psRs->u16Full,
+							psRs->u16WarmOk ? psRs->u32WarmMsSum / psRs->u16WarmOk : 0,
+							psRs->u16Full ? psRs->u32FullMsSum / psRs->u16Full : 0,
+							psRs->u16Migrations, psRs->u16Follows);
+				}
+				sendHealth();
+				if (BootStats_bAssociated(u32TickCount_ms)) {
+					vBootReady();
+				}
 
-				ToCoNet_Event_SetState(pEv, E_STATE_NFC_INIT);
+				// 接続前に読んだタッチは vFlushTouches がここから送る
+				ToCoNet_Event_SetState(pEv, E_STATE_CONNECTED);
 			}
 			if (eEvent == E_EVENT_CHSCAN_FAIL)
 			{
 				dbg("CHSCAN failed.");
-				vPortSetLo(PORT_LED_4);
-				u8ScanFailuer++;
+				Feedback_vLed(FEEDBACK_LED_4, FALSE);
+				if (bWarmProbe) {
+					// 前回のチャネル (移り先) にいなければ全チャネルを調べる
+					if (!bMigrating) ParentCache_vWarmFailed();
+					bWarmProbe = FALSE;
+					bMigrating = FALSE;
+				} else {
+					// 全チャネルで見つからなければ、次はまた前回のチャネルから
+					u8ScanFailuer++;
+					sHealth.u16ScanFails++;
+					bWarmTried = FALSE;
+				}
 				ToCoNet_Event_SetState(pEv, E_STATE_CHSCAN_INIT);
 			}
 
 			//タイムアウト
 			if (ToCoNet_Event_u32TickFrNewState(pEv) > 2500) {
 				dbg("CHSCAN timeout.");
-				vPortSetLo(PORT_LED_4);
+				sHealth.u16ScanFails++;
+				Feedback_vLed(FEEDBACK_LED_4, FALSE);
+				bWarmProbe = FALSE;
+				bMigrating = FALSE;
 				ToCoNet_Event_SetState(pEv, E_STATE_CHSCAN_INIT);
 			}
 
@@ -440,21 +844,111 @@ static void vProcessEvCore(tsEvent *pEv, teEvent eEvent, uint32 u32evarg)
 
 			break;
 
+		case E_STATE_CONNECTED:
+			// タッチの送信と切断・移動の判断は毎 tick・毎秒の処理で
+			break;
+
+		case E_STATE_APP_SHUTDOWN:
+			if (eEvent == E_EVENT_NEW_STATE){
+				Feedback_vPlay(FEEDBACK_SHUTDOWN, u32TickCount_ms);
+			}else if(ToCoNet_Event_u32TickFrNewState(pEv) > 200) {
+				ToCoNet_Event_SetState(pEv, E_STATE_APP_SLEEP);
+			}
+			break;
+
+		case E_STATE_APP_SLEEP:
+			dbg("E_STATE_APP_SLEEP");
+			if (eEvent == E_EVENT_NEW_STATE) {
+				dbg("Sleeping...\r\n");
+				Feedback_vStop();
+				Feedback_vLed(FEEDBACK_LED_ALL, FALSE);
+				vPortSetLo(PORT_FELICA);
+				sAppData.u32parentAddr = 0;
+				WAIT_UART_OUTPUT(UART_PORT);
+				vAHI_DioWakeEnable(1<<PORT_SW_1, 0);
+				ToCoNet_vSleep(E_AHI_WAKE_TIMER_0, SLEEP_INTERVAL, FALSE, TRUE);
+			}
+			break;
+
+		default:
+			break;
+	}
+	PROFILE_END();
+}
+
+// PN533 の応答が途切れたとき。軽い手から順に試す (NfcRecovery.h)
+static void vNfcRecover(tsEvent *pEv)
+{
+	sAppData.u8tick_ms = 0;
+	switch (NfcRecovery_u8Escalate(u32TickCount_ms)) {
+	case NFCREC_RESEND:
+		u8NfcWait = NFCREC_WAIT_MS;
+		vSerialClear();
+		vWritePn533(pu8NfcLast, u8NfcLastLen);
+		break;
+	case NFCREC_ABORT:
+		u8NfcWait = NFCREC_WAIT_MS;
+		vSerialClear();
+		sendFelicaReset();
+		vWritePn533(pu8NfcLast, u8NfcLastLen);
+		break;
+	case NFCREC_REINIT:
+		ToCoNet_Event_SetState(pEv, E_STATE_NFC_INIT);
+		break;
+	default:
+		ToCoNet_Event_SetState(pEv, E_STATE_NFC_RESET);
+		break;
+	}
+}
+
+// PN533 が応答したとき
+static void vNfcAlive()
+{
+	uint32 u32Ms;
+	uint8 u8Stage;
+
+	sAppData.u8tick_ms = 0;
+	u8NfcWait = NFC_SILENCE_MS;
+	u8Stage = NfcRecovery_u8Recovered(u32TickCount_ms, &u32Ms);
+	if (u8Stage != NFCREC_NONE) {
+		DEBUGLOG(LOG_NFC_RECOVER, u32TickCount_ms, u8Stage, u32Ms);
+	}
+}
+
+// PN533 の初期化とポーリング。Master への接続 (vProcessEvCore) とは別に進め、
+// 接続前に読んだタッチは TouchLog に溜めておく
+static void vProcessEvNfc(tsEvent *pEv, teEvent eEvent, uint32 u32evarg)
+{
+	PROFILE_BEGIN(PROFILE_NFC, pEv->eState, eEvent);
+
+	if (eEvent == E_EVENT_TICK_TIMER) {
+		sAppData.u8tick_ms += 4;
+	}
+
+	switch (pEv->eState) {
+		case E_STATE_IDLE:
+			if (eEvent == E_EVENT_START_UP) {
+				vPortSetHi(PORT_FELICA);
+			} else if (eEvent == E_EVENT_TICK_TIMER && ToCoNet_Event_u32TickFrNewState(pEv) > NFC_POWERUP_MS) {
+				ToCoNet_Event_SetState(pEv, E_STATE_NFC_INIT);
+			}
+			break;
+
 		case E_STATE_NFC_RESET:
 
 			if (eEvent == E_EVENT_NEW_STATE) {
-				sendDebugMessage("NFC Reset");
+				const tsPn533Stats *psSt = &sPn533.sStats;
+				sHealth.u16NfcResets++;
+				DEBUGLOG(LOG_NFC_RESET, u32TickCount_ms,
+						psSt->u32Resyncs, psSt->u32Checksum, psSt->u32Overflows, psSt->u32Errors);
 				vPortSetLo(PORT_FELICA);
-				vPlaySound(SOUND_ERROR);
+				Feedback_vPlay(FEEDBACK_ERROR, u32TickCount_ms);
 			}else if(eEvent == E_EVENT_TICK_TIMER){
-				if (ToCoNet_Event_u32TickFrNewState(pEv) > 4000){
-					ToCoNet_Event_SetState(pEv, E_STATE_NFC_INIT);
-				}else if (ToCoNet_Event_u32TickFrNewState(pEv) > 2500){
+				if (ToCoNet_Event_u32TickFrNewState(pEv) > NFC_POWEROFF_MS + NFC_POWERUP_MS){
 					vSerialClear();
 					sendFelicaReset();
-					sendFelicaReset();
-					sendFelicaReset();
-				}else if (ToCoNet_Event_u32TickFrNewState(pEv) > 500){
+					ToCoNet_Event_SetState(pEv, E_STATE_NFC_INIT);
+				}else if (ToCoNet_Event_u32TickFrNewState(pEv) > NFC_POWEROFF_MS){
 					vPortSetHi(PORT_FELICA);
 				}
 			}
@@ -463,159 +957,114 @@ static void vProcessEvCore(tsEvent *pEv, teEvent eEvent, uint32 u32evarg)
 
 		case E_STATE_NFC_INIT:
 			if (eEvent == E_EVENT_NEW_STATE) {
-				sendDebugMessage("NFC Init");
+				DebugLog_vPut(LOG_NFC_INIT, NULL, 0, u32TickCount_ms);
 				sAppData.u8tick_ms = 0;
+				u8NfcWait = NFC_SILENCE_MS;
 				u8NfcInitStage = 1;
 				vSerialClear();
-				sendFelicaCommand((uint8*)"\xd4\x18\x01", 3);
+				vSendPn533(au8Pn533Init, sizeof(au8Pn533Init));
 			}else if(eEvent == E_EVENT_NFC_RESPONSE){
 				sAppData.u8tick_ms = 0;
 				if(u8NfcInitStage == 1)
-					sendFelicaCommand((uint8*)"\xd4\x32\x02\x00\x00\x00", 6);
+					vSendPn533(au8Pn533Timeout, sizeof(au8Pn533Timeout));
 				else if(u8NfcInitStage == 2)
-					sendFelicaCommand((uint8*)"\xd4\x32\x05\x00\x00\x00", 6);
+					vSendPn533(au8Pn533Retry, sizeof(au8Pn533Retry));
 				else if(u8NfcInitStage == 3)
-					sendFelicaCommand((uint8*)"\xd4\x32\x81\xb7", 4);
+					vSendPn533(au8Pn533Config, sizeof(au8Pn533Config));
 				else{
-					sAppData.u8tick_ms = 0;
+					vNfcAlive();
+					if (BootStats_bNfcReady(u32TickCount_ms)) {
+						vBootReady();
+					}
 					ToCoNet_Event_SetState(pEv, E_STATE_POLLING);
 				}
 				u8NfcInitStage++;
 			}
-			if(eEvent == E_EVENT_TICK_TIMER && sAppData.u8tick_ms > 200){
-				ToCoNet_Event_SetState(pEv, E_STATE_NFC_RESET);
+			if(eEvent == E_EVENT_TICK_TIMER && sAppData.u8tick_ms > u8NfcWait){
+				vNfcRecover(pEv);
 			}
 
 			break;
 
 		case E_STATE_POLLING:
-			if (eEvent == E_EVENT_NEW_STATE || eEvent == E_EVENT_NFC_RESPONSE) {
-				sendFelicaCommand((uint8*)"\xd4\x4a\x01\x01\x00\xff\xff\x00\x00", 9);
+			if (eEvent == E_EVENT_NEW_STATE) {
+				vSendPoll();
 			}
 
 			if(eEvent == E_EVENT_NFC_RESPONSE){
-				sAppData.u8tick_ms = 0;
+				vNfcAlive();
+				if(felicaResponse.length < 2 || felicaResponse.data[1] != 0x4B){
+					// RF オフなどの応答。次のポーリングは時刻が来てから
+					if(u32PollAt == 0) vSendPoll();
+					break;
+				}
+				sPollStats.u32Polls++;
 				if(felicaResponse.length==22){
-					vPortSetHi(PORT_LED_1);
-					if(memcmp(au8BeforIdm, felicaResponse.data+6, 8) != 0){
-						vPlaySound(SOUND_TOUCH);
-						sendIdm(felicaResponse.data+6);
-						memcpy(au8BeforIdm, felicaResponse.data+6, 8);
+					Feedback_vLed(FEEDBACK_LED_1, TRUE);
+					// 保持時間内に読んだカードは送らない
+					if(IdmCache_bCheck(felicaResponse.data+6, u32TickCount_ms)){
+						vTouchFeedback(felicaResponse.data+6);
+						BootStats_vTouch();
+						u32CardSince = u32PollEmpty;
+						_C {
+							uint32 u32Dropped = TouchLog_psStats()->u32Dropped;
+							TouchLog_vAppend(felicaResponse.data+6, u32TickCount_ms);
+							if (TouchLog_psStats()->u32Dropped != u32Dropped) {
+								// 一杯で最も古いタッチが捨てられた
+								TxWindow_vDropped();
+							}
+						}
+						vFlushTouches(FALSE);
 					}
+					vSendPoll();
 				}else{
-					vPortSetLo(PORT_LED_1);
-					memset(au8BeforIdm, 0, 8);
+					Feedback_vLed(FEEDBACK_LED_1, FALSE);
+					IdmCache_vAbsent();
+					u32PollEmpty = u32TickCount_ms;
+#if POLL_GAP_MS > 0
+					u32PollAt = u32TickCount_ms + POLL_GAP_MS;
+					vSendPn533(au8Pn533RfOff, sizeof(au8Pn533RfOff));
+#else
+					vSendPoll();
+#endif
+				}
+			}else if(eEvent == E_EVENT_TICK_TIMER){
+				if(u32PollAt != 0 && (int32)(u32TickCount_ms - u32PollAt) >= 0){
+					vSendPoll();
+				}else if(sAppData.u8tick_ms > u8NfcWait){
+					vNfcRecover(pEv);
 				}
-			}else if(eEvent == E_EVENT_TICK_TIMER && sAppData.u8tick_ms > 200){
-				ToCoNet_Event_SetState(pEv, E_STATE_NFC_RESET);
 			}
 
 			break;
 
-		case E_STATE_APP_SHUTDOWN:
-			if (eEvent == E_EVENT_NEW_STATE){
-				vPlaySound(SOUND_SHUTDOWN);
-			}else if(ToCoNet_Event_u32TickFrNewState(pEv) > 200) {
-				ToCoNet_Event_SetState(pEv, E_STATE_APP_SLEEP);
-			}
-			break;
-
-		case E_STATE_APP_SLEEP:
-			dbg("E_STATE_APP_SLEEP");
-			if (eEvent == E_EVENT_NEW_STATE) {
-				dbg("Sleeping...\r\n");
-				vPortSetLo(PORT_LED_1);
-				vPortSetLo(PORT_LED_2);
-				vPortSetLo(PORT_LED_3);
-				vPortSetLo(PORT_LED_4);
-				vPortSetLo(PORT_FELICA);
-				sAppData.u32parentAddr = 0;
-				WAIT_UART_OUTPUT(UART_PORT);
-				vAHI_DioWakeEnable(1<<PORT_SW_1, 0);
-				ToCoNet_vSleep(E_AHI_WAKE_TIMER_0, SLEEP_INTERVAL, FALSE, TRUE);
-			}
-			break;
-
 		default:
 			break;
 	}
-
-}
-
-static void sendHexDebug(uint8 *data, uint8 size){
-	uint8 debug[40] = {0};
-	uint8 i;
-	uint8 c;
-	for(i=0; i<size; i++){
-		c = data[i];
-		debug[2*i] = ((c>>4)>9 ? ('A'-10) : '0')  + (c>>4);
-		debug[2*i+1] = ((c&0x0f)>9 ? ('A'-10)  : '0') + (c&0x0f);
-	}
-	sendDebugMessage(debug);
-
+	PROFILE_END();
 }
 
-
-
+// PN533 からの受信を、溜まっている分すべて処理する
 void vHandleSerialInput(){
-	uint8 i;
-	if (!SERIAL_bRxQueueEmpty(sSerPort.u8SerialPort)) {
-		// FIFOキューから１バイトずつ取り出して処理する。
-
-		int16 i16Char;
-		uint8 u8Char;
-		i16Char = SERIAL_i16RxChar(sSerPort.u8SerialPort);
-		u8Char = (uint8)i16Char;
-
-		au8FelicaBuffer[u8FelicaBufferIndex] = u8Char;
-
-		if(
-				(u8FelicaBufferIndex == 0 && u8Char != 0x00) ||
-				(u8FelicaBufferIndex == 1 && u8Char != 0x00) ||
-				(u8FelicaBufferIndex == 2 && u8Char != 0xff)
-			){
-			u8FelicaBufferIndex = 0;
-		}else{
-			u8FelicaBufferIndex++;
-		}
+	PROFILE_BEGIN(PROFILE_SERIAL, 0, 0);
 
-		if(u8FelicaBufferIndex == 6){
-
-			if(au8FelicaBuffer[3] == 0x00 && au8FelicaBuffer[4] == 0xff && au8FelicaBuffer[5] == 0x00){
-				//ACK
-				u8FelicaBufferIndex = 0;
-				//sendDebugMessage("ACK");
-				ToCoNet_Event_Process(E_EVENT_NFC_ACK, 0, vProcessEvCore);
-			}else if(((au8FelicaBuffer[3] + au8FelicaBuffer[4]) & 0xff) != 0){
-				// エラー
-				u8FelicaBufferIndex = 0;
-				//sendDebugMessage("LE");
-			}else{
-				felicaResponse.length = au8FelicaBuffer[3];
-			}
-		}
-
-
-		if(u8FelicaBufferIndex == (5 + felicaResponse.length + 2)){
-			//sendHexDebug(au8FelicaBuffer,u8FelicaBufferIndex);
-
-			for(i=0; i<felicaResponse.length; i++){
-				felicaResponse.data[i] = au8FelicaBuffer[5+i];
-			}
-			uint8 dcs = calcDCS(felicaResponse.data, felicaResponse.length);
-			if(dcs == au8FelicaBuffer[5+felicaResponse.length] && au8FelicaBuffer[5+felicaResponse.length+1] == 0x00){
-				// DCS/フッタ一致
-				//sendHexDebug(felicaResponse.data, felicaResponse.length);
-				ToCoNet_Event_Process(E_EVENT_NFC_RESPONSE, 0, vProcessEvCore);
-			}else{
-				//sendDebugMessage("DCS M");
-			}
-			u8FelicaBufferIndex = 0;
+	while (!SERIAL_bRxQueueEmpty(sSerPort.u8SerialPort)) {
+		switch (Pn533_eParse(&sPn533, (uint8)SERIAL_i16RxChar(sSerPort.u8SerialPort))) {
+		case E_PN533_ACK:
+			ToCoNet_Event_Process(E_EVENT_NFC_ACK, 0, vProcessEvNfc);
+			break;
+		case E_PN533_FRAME:
+		case E_PN533_ERROR:
+			// データはパーサのバッファを直接参照する
+			felicaResponse.data = Pn533_pu8Data(&sPn533);
+			felicaResponse.length = Pn533_u16Len(&sPn533);
+			ToCoNet_Event_Process(E_EVENT_NFC_RESPONSE, 0, vProcessEvNfc);
+			break;
+		default:
+			break;
 		}
-
-
-
-  }
+	}
+	PROFILE_END();
 }
 
 
@@ -626,12 +1075,17 @@ void vHandleSerialInput(){
 // 割り込み発生後に随時呼び出される
 void cbToCoNet_vMain(void)
 {
+	PROFILE_BEGIN(PROFILE_MAIN, 0, 0);
+
 	vHandleSerialInput();
+	PROFILE_END();
 }
 
 // パケット受信時
 void cbToCoNet_vRxEvent(tsRxDataApp *pRx)
 {
+	PROFILE_BEGIN(PROFILE_RX, 0, pRx->u8Cmd);
+
 #ifdef DBG
 	uint8 *p = pRx->auData;
 	dbg("\n\r[PKT Ad:%04x,Cmd:%02x,Ln:%03d,Seq:%03d,Lq:%03d,Tms:%05d ",
@@ -644,42 +1098,102 @@ void cbToCoNet_vRxEvent(tsRxDataApp *pRx)
 	// ToDo: Ping応答
 #endif
 
-	if (u32BeforeSeq != pRx->u8Seq)
+	// 番号は送信元ごとなので、重複は親のパケットどうしでだけ比べる
+	// (他の Master や Slave の番号が親と同じでも、親の Keep-Alive や ACK を落とさない)
+	if (pRx->u32SrcAddr != sAppData.u32parentAddr || u32BeforeSeq != pRx->u8Seq)
 	{
 		if (pRx->u8Cmd == PACKET_CMD_KEEP_ALIVE)
 		{
-			sAppData.u32parentDisconnectTime = 0;
-			dbg("Keep-Alive was received.");
+			// 同じチャネルの他の Master の負荷も覚えておく
+			if (pRx->u8Len >= KEEPALIVE_LEN) {
+				ParentCache_vLoad(sAppData.u8channel, pRx->u32SrcAddr, pRx->u8Lqi, pRx->auData[0], u32TickCount_ms);
+			}
+			if (pRx->u32SrcAddr == sAppData.u32parentAddr) {
+				sAppData.u32parentDisconnectTime = 0;
+				dbg("Keep-Alive was received.");
+				if (pRx->u8Len >= KEEPALIVE_LEN) {
+					TimeSync_vSample(((uint32)pRx->auData[4] << 24) | ((uint32)pRx->auData[5] << 16)
+							| ((uint32)pRx->auData[6] << 8) | pRx->auData[7], u32TickCount_ms);
+					if (pRx->auData[8]) {
+						u8FollowCh = pRx->auData[8];
+						u32FollowAt = u32TickCount_ms + (uint32)pRx->auData[9] * KEEPALIVE_SWITCH_UNIT_MS;
+					}
+					vAllowVersion(pRx->auData[10]);
+				}
+#ifdef USE_TDMA
+				TdmaSlot_vBeacon(pRx->auData, pRx->u8Len, ToCoNet_u32GetSerial(), u32TickCount_ms);
+				// ACK はビーコンの割り当ての後
+				if (pRx->u8Len > TDMA_BEACON_HDR) {
+					uint8 u8Ofs = TDMA_BEACON_HDR + pRx->auData[KEEPALIVE_LEN + 2] * TDMA_GRANT_LEN;
+					if (pRx->u8Len > u8Ofs) vReceiveAcks(pRx->auData + u8Ofs, pRx->u8Len - u8Ofs);
+				}
+#else
+				if (pRx->u8Len > KEEPALIVE_LEN) {
+					vReceiveAcks(pRx->auData + KEEPALIVE_LEN, pRx->u8Len - KEEPALIVE_LEN);
+				}
+#endif
+			}
+		}
+		else if (pRx->u8Cmd == PACKET_CMD_ACK && pRx->u32SrcAddr == sAppData.u32parentAddr)
+		{
+			vReceiveAcks(pRx->auData, pRx->u8Len);
+		}
+		else if (pRx->u8Cmd == PACKET_CMD_BULK && pRx->u32SrcAddr == sAppData.u32parentAddr)
+		{
+			vBulkChunk(pRx->auData, pRx->u8Len);
 		}
 
-		u32BeforeSeq = pRx->u8Seq;
+		if (pRx->u32SrcAddr == sAppData.u32parentAddr) {
+			u32BeforeSeq = pRx->u8Seq;
+		}
 	}
 
-
+	PROFILE_END();
 	return;
 }
 
 // パケット送信完了時
 void cbToCoNet_vTxEvent(uint8 u8CbId, uint8 bStatus) {
+	PROFILE_BEGIN(PROFILE_TX, 0, bStatus);
+
 	dbg("\n\r[TX CbID:%02x Status:%s]", u8CbId, bStatus ? "OK" : "Err");
+	sHealth.u16Tx++;
+	if (!bStatus) sHealth.u16TxFail++;
+	if (bFelicaTxBusy && u8CbId == u8FelicaCbId) {
+		bFelicaTxBusy = FALSE;
+		if (bStatus) {
+			// ACK を待ちながら、送信中に溜まったタッチは待たずに続けて送る。
+			// まだ 1 パケット以上溜まっている (再接続後など) ときは間隔を空ける
+			TxWindow_vSent(u16FelicaSeq, TRUE, u32TickCount_ms, 0);
+			u32FelicaNextTx = u32TickCount_ms
+					+ (u8Unsent() >= u8BatchMax() ? TOUCH_REPLAY_MS : 0);
+			vFlushTouches(TRUE);
+		} else {
+			// ログに残したまま、しばらく待って送り直す
+			u32FelicaNextTx = u32TickCount_ms + TOUCH_RETRY_MS;
+			TxWindow_vSent(u16FelicaSeq, FALSE, u32TickCount_ms, u32FelicaNextTx);
+		}
+	}
 	if (bStatus)
 	{
 
-		vPortSetLo(PORT_LED_2);
-		vPortSetLo(PORT_LED_4);
+		Feedback_vLed(FEEDBACK_LED_2 | FEEDBACK_LED_4, FALSE);
 		ToCoNet_Event_Process(E_EVENT_TRANSMIT_FINISH, 0, vProcessEvCore);
 	}
 	else
 	{
-		vPlaySound(SOUND_SEND_ERROR);
-		vPortSetHi(PORT_LED_4);
+		Feedback_vPlay(FEEDBACK_SEND_ERROR, u32TickCount_ms);
+		Feedback_vLed(FEEDBACK_LED_4, TRUE);
 		ToCoNet_Event_Process(E_EVENT_TRANSMIT_FAIL, 0, vProcessEvCore);
 	}
+	PROFILE_END();
 	return;
 }
 
 // ネットワークイベント発生時
 void cbToCoNet_vNwkEvent(teEvent eEvent, uint32 u32arg) {
+	PROFILE_BEGIN(PROFILE_NWK, 0, eEvent);
+
 	switch (eEvent) {
 
 		//case E_EVENT_TOCONET_NWK_START:
@@ -689,18 +1203,32 @@ void cbToCoNet_vNwkEvent(teEvent eEvent, uint32 u32arg) {
 				tsToCoNet_NbScan_Entitiy *nbNode = NULL;
 				tsToCoNet_NbScan_Result *pNbsc = (tsToCoNet_NbScan_Result *)u32arg;
 				dbg("%d", u32arg);
-				uint8 i, u8lqi=0;
+				uint8 i;
+				int16 i16Score, i16Best = 0;
 
 				if (pNbsc->u8scanMode & TOCONET_NBSCAN_NORMAL_MASK) {
 					dbg("Mode: Normal Scan");
 					dbg("nodes: %d", pNbsc->u8found);
-					// 全チャネルスキャン結果
+					// 見つけた Master はどれも候補として覚える
+					if (!bWarmProbe) {
+						ParentCache_vScanBegin();
+					}
 					for (i = 0; i < pNbsc->u8found && i < 10; i++) {
 						tsToCoNet_NbScan_Entitiy *pEnt = &pNbsc->sScanResult[pNbsc->u8IdxLqiSort[i]];
 						if (pEnt->bFound) {
 							dbg("%d Ch:%d Addr:%08x LQI:%d", i, pEnt->u8ch, pEnt->u32addr, pEnt->u8lqi);
-							if(u8lqi < pEnt->u8lqi){
-								nbNode = pEnt;
+							ParentCache_vScanFound(pEnt->u8ch, pEnt->u32addr, pEnt->u8lqi);
+							if (bWarmProbe) {
+								// 前回のチャネル (移り先) だけを調べたときは、その Master にだけつなぐ。
+								// いなければ失敗として全チャネルを調べる
+								if (pEnt->u32addr == u32WarmAddr) nbNode = pEnt;
+							} else {
+								// 全チャネルスキャン結果。LQI と負荷の点数が最も高い Master を選ぶ
+								i16Score = ParentCache_i16Score(pEnt->u32addr, pEnt->u8lqi, u32TickCount_ms);
+								if (nbNode == NULL || i16Best < i16Score) {
+									nbNode = pEnt;
+									i16Best = i16Score;
+								}
 							}
 						}
 						WAIT_UART_OUTPUT(UART_PORT);
@@ -710,6 +1238,7 @@ void cbToCoNet_vNwkEvent(teEvent eEvent, uint32 u32arg) {
 					if (nbNode != NULL) {
 						sAppData.u8channel = nbNode->u8ch;
 						sAppData.u32parentAddr = nbNode->u32addr;
+						u32BeforeSeq = 0xffffffff;
 						ToCoNet_Event_Process(E_EVENT_CHSCAN_FINISH, 0, vProcessEvCore);
 					}
 					else {
@@ -726,6 +1255,7 @@ void cbToCoNet_vNwkEvent(teEvent eEvent, uint32 u32arg) {
 		default:
 			break;
 	}
+	PROFILE_END();
 }
 
 // ハードウェア割り込み発生後（遅延呼び出し）
@@ -761,13 +1291,37 @@ void cbAppColdStart(bool_t bAfterAhiInit)
 
 		// clear application context
 		memset(&sAppData, 0x00, sizeof(sAppData));
+		Pn533_vInit(&sPn533);
+		ParentCache_vInit();
+		TimeSync_vInit();
+#ifdef USE_TDMA
+		TdmaSlot_vInit();
+#endif
+		IdmCache_vInit(IDM_HOLDOFF_MS);
+
+		// 送信待ちのタッチ (EEPROM に残っていれば復元する)
+		TouchLog_vInit(TRUE);
+		memset(&sHealth, 0, sizeof(sHealth));
+		DebugLog_vInit();
+		BootStats_vInit();
+		NfcRecovery_vInit();
+		AllowFilter_vInit();
+		BulkRx_vInit();
+#ifdef USE_PROFILE
+		Profile_vInit();
+#endif
+		u8NfcWait = NFC_SILENCE_MS;
+		bFelicaTxBusy = FALSE;
+		u32FelicaNextTx = 0;
+		u8FollowCh = 0;
 		sAppData.u8channel = 15;
 		sAppData.u8retry = 1;
 		sAppData.u32parentAddr = 0x0;
 
 
-		// ユーザ定義のイベントハンドラを登録
+		// ユーザ定義のイベントハンドラを登録 (接続と PN533 を別々に進める)
 		ToCoNet_Event_Register_State_Machine(vProcessEvCore);
+		ToCoNet_Event_Register_State_Machine(vProcessEvNfc);
 
 		// ハードウェア初期化
 		vInitHardware();
@@ -795,6 +1349,10 @@ void cbAppColdStart(bool_t bAfterAhiInit)
 		// MAC 層開始
 		ToCoNet_vMacStart();
 
+		// 送信番号は再起動のたびに変え、Master に前の番号の再送と取り違えさせない
+		TxWindow_vInit(ToCoNet_u16GetRand());
+		u32Seq = ToCoNet_u32GetRand();
+
 	}
 }
 
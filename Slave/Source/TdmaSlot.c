@@ -0,0 +1,194 @@
+/*
+ * TdmaSlot.c
+ *
+ * TDMA で Slave が送ってよい時刻 (TdmaSlot.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "TdmaSlot.h"
+
+#define TICK_MS        4
+#define CONTENTION_AT  ((1 + TDMA_SLOTS) * TDMA_SLOT_MS) // 競合スロットの始まり
+#define JOIN_BACKOFF   8 // 参加要求を送り直すまでの最大スーパーフレーム数
+
+static bool_t bBeacon = FALSE;   // スーパーフレームの時刻が分かっている
+static uint32 u32BeaconTick;
+static uint8 u8BeaconSeq;
+static uint8 u8Cycle;
+
+static bool_t bSlot = FALSE;
+static uint8 u8Slot;
+static bool_t bNoSlotTimer;      // u32NoSlotSince が有効
+static uint32 u32NoSlotSince;    // スロットがないと分かった時刻
+static uint32 u32GrantTick;      // 最後に自分の割り当てがビーコンに載った時刻
+static uint32 u32UsedTick;       // 最後に自分のスロットで送った時刻
+static uint32 u32LastTx;
+
+static bool_t bJoinWait;         // u32JoinAt まで参加要求を待つ
+static uint32 u32JoinAt;
+static uint8 u8JoinSlot;         // 参加要求を送る競合スロット
+
+static tsTdmaStats sStats;
+
+// 今のスーパーフレームの番号と、その中での経過時間
+static bool_t bFrame(uint32 u32Now, uint8 *pu8Seq, uint16 *pu16Off)
+{
+	uint32 u32Dt = u32Now - u32BeaconTick;
+	uint32 u32N = u32Dt / TDMA_SUPERFRAME_MS;
+
+	if (!bBeacon || u32N > TDMA_BEACON_LOST) {
+		return FALSE;
+	}
+	*pu8Seq = (uint8)(u8BeaconSeq + u32N);
+	*pu16Off = (uint16)(u32Dt % TDMA_SUPERFRAME_MS);
+	return TRUE;
+}
+
+// 自分の番のスーパーフレームの、自分のスロットの最初の tick か
+static bool_t bSlotStart(uint32 u32Now)
+{
+	uint8 u8Seq;
+	uint16 u16Off, u16Start;
+
+	if (!bSlot || !bFrame(u32Now, &u8Seq, &u16Off)) {
+		return FALSE;
+	}
+	u16Start = (1 + u8Slot % TDMA_SLOTS) * TDMA_SLOT_MS;
+	return (u8Seq % u8Cycle) == u8Slot / TDMA_SLOTS
+			&& u16Off >= u16Start && u16Off < u16Start + TICK_MS
+			&& u32Now - u32UsedTick >= TDMA_SLOT_MS;
+}
+
+static void vDropSlot(uint32 u32Now)
+{
+	bSlot = FALSE;
+	bNoSlotTimer = TRUE;
+	u32NoSlotSince = u32Now;
+	sStats.u32Lost++;
+}
+
+void TdmaSlot_vInit()
+{
+	memset(&sStats, 0, sizeof(sStats));
+	TdmaSlot_vReset(0);
+}
+
+void TdmaSlot_vReset(uint16 u16Rand)
+{
+	bBeacon = FALSE;
+	bSlot = FALSE;
+	bNoSlotTimer = FALSE;
+	bJoinWait = FALSE;
+	u8JoinSlot = u16Rand % TDMA_CONTENTION;
+	u32UsedTick = 0;
+	u32LastTx = 0;
+}
+
+void TdmaSlot_vBeacon(const uint8 *pu8Data, uint8 u8Len, uint32 u32Self, uint32 u32Now)
+{
+	const uint8 *p = pu8Data + TDMA_BEACON_HDR;
+	uint8 i, n;
+
+	if (u8Len < TDMA_BEACON_HDR) {
+		return;
+	}
+	n = pu8Data[KEEPALIVE_LEN + 2];
+	if (u8Len < TDMA_BEACON_HDR + n * TDMA_GRANT_LEN) {
+		return;
+	}
+	sStats.u32Beacons++;
+	if (!bSlot && !bNoSlotTimer) {
+		bNoSlotTimer = TRUE;
+		u32NoSlotSince = u32Now;
+	}
+	bBeacon = TRUE;
+	u32BeaconTick = u32Now;
+	u8BeaconSeq = pu8Data[KEEPALIVE_LEN];
+	u8Cycle = pu8Data[KEEPALIVE_LEN + 1] ? pu8Data[KEEPALIVE_LEN + 1] : 1;
+
+	for (i = 0; i < n; i++, p += TDMA_GRANT_LEN) {
+		uint32 u32Addr = ((uint32)p[0] << 24) | ((uint32)p[1] << 16) | ((uint32)p[2] << 8) | p[3];
+
+		if (u32Addr == u32Self) {
+			if (!bSlot || u8Slot != p[4]) {
+				sStats.u32Granted++;
+			}
+			bSlot = TRUE;
+			bNoSlotTimer = FALSE;
+			u8Slot = p[4];
+			u32GrantTick = u32Now;
+		} else if (bSlot && u8Slot == p[4]) {
+			// 空けられて他の Slave に渡った
+			vDropSlot(u32Now);
+		}
+	}
+	if (bSlot && u32Now - u32GrantTick > TDMA_GRANT_TIMEOUT_MS) {
+		vDropSlot(u32Now);
+	}
+}
+
+bool_t TdmaSlot_bTxWindow(uint32 u32Now)
+{
+	uint8 u8Seq;
+	uint16 u16Off;
+
+	if (bSlot) {
+		return bSlotStart(u32Now);
+	}
+	// 競合スロットは参加要求のためのもの。しばらく割り当てられなければ (Master の
+	// スロットが一杯など) タッチもそこで送る
+	return bNoSlotTimer && u32Now - u32NoSlotSince >= TDMA_GRANT_TIMEOUT_MS
+			&& bFrame(u32Now, &u8Seq, &u16Off) && u16Off >= CONTENTION_AT;
+}
+
+void TdmaSlot_vTxDone(uint32 u32Now)
+{
+	u32LastTx = u32Now;
+	if (bSlot) {
+		u32UsedTick = u32Now;
+		sStats.u32SlotTx++;
+	} else {
+		sStats.u32SharedTx++;
+	}
+}
+
+uint8 TdmaSlot_u8JoinDue(uint32 u32Now)
+{
+	uint8 u8Seq;
+	uint16 u16Off, u16At;
+
+	if (bSlot) {
+		return (bSlotStart(u32Now) && u32Now - u32LastTx >= TDMA_HEARTBEAT_MS)
+				? TDMA_JOIN_HEARTBEAT : TDMA_JOIN_NONE;
+	}
+	if (!bFrame(u32Now, &u8Seq, &u16Off) || (bJoinWait && (int32)(u32Now - u32JoinAt) < 0)) {
+		return TDMA_JOIN_NONE;
+	}
+	u16At = CONTENTION_AT + u8JoinSlot * TDMA_SLOT_MS;
+	return (u16Off >= u16At && u16Off < u16At + TICK_MS) ? TDMA_JOIN_REQUEST : TDMA_JOIN_NONE;
+}
+
+void TdmaSlot_vJoinSent(uint8 u8Kind, uint32 u32Now, uint16 u16Rand)
+{
+	if (u8Kind == TDMA_JOIN_HEARTBEAT) {
+		TdmaSlot_vTxDone(u32Now);
+		return;
+	}
+	// 割り当てがビーコンに載らなければ、ずらして送り直す
+	sStats.u32Joins++;
+	bJoinWait = TRUE;
+	u32JoinAt = u32Now + TDMA_SUPERFRAME_MS * (1 + u16Rand % JOIN_BACKOFF);
+	u8JoinSlot = (u16Rand >> 8) % TDMA_CONTENTION;
+}
+
+bool_t TdmaSlot_bHasSlot()
+{
+	return bSlot;
+}
+
+const tsTdmaStats *TdmaSlot_psStats()
+{
+	return &sStats;
+}
@@ -0,0 +1,54 @@
+/*
+ * TdmaSlot.h
+ *
+ * TDMA (make TDMA=1) で Slave が送ってよい時刻を決める。
+ *
+ * 接続先のビーコンを受けた tick をスーパーフレームの始まりとし、ビーコンを
+ * 取りこぼしても TDMA_BEACON_LOST 回までは同じ間隔で続くものとみなす。
+ * スロットを割り当てられていれば、自分の番のスーパーフレームのそのスロットの
+ * 最初の tick で 1 パケットだけ送る。なければ競合スロットで参加要求を送る。
+ * TDMA_GRANT_TIMEOUT_MS 経っても割り当てられなければ、タッチも競合スロットで送る。
+ *
+ * tick は 4ms なので、スロットの始まりは最大 4ms 早まる。TDMA_SLOT_MS は
+ * その分と送信・ACK が収まる長さにしてある。
+ *
+ */
+
+#ifndef TDMASLOT_H_
+#define TDMASLOT_H_
+
+#include <jendefs.h>
+#include "../../Common/Source/packets.h"
+
+#define TDMA_BEACON_LOST       4     // 続けて取りこぼしてもよいビーコンの数
+#define TDMA_GRANT_TIMEOUT_MS  10000 // 自分の割り当てがビーコンに載らなければ参加し直す
+#define TDMA_HEARTBEAT_MS      30000 // 何も送らないときに自分のスロットで知らせる間隔
+
+typedef struct {
+	uint32 u32Beacons;   // 受けたビーコン
+	uint32 u32Joins;     // 送った参加要求
+	uint32 u32Granted;   // スロットを割り当てられた
+	uint32 u32Lost;      // 割り当てを失った (他の Slave に渡った・知らせが途絶えた)
+	uint32 u32SlotTx;    // 自分のスロットで送った
+	uint32 u32SharedTx;  // 競合スロットで送った
+} tsTdmaStats;
+
+void TdmaSlot_vInit();
+// 接続先が変わったとき (割り当てを捨てる)
+void TdmaSlot_vReset(uint16 u16Rand);
+void TdmaSlot_vBeacon(const uint8 *pu8Data, uint8 u8Len, uint32 u32Self, uint32 u32Now);
+
+// 今の tick でタッチを送ってよいか。送ったら TdmaSlot_vTxDone を呼ぶ
+bool_t TdmaSlot_bTxWindow(uint32 u32Now);
+void TdmaSlot_vTxDone(uint32 u32Now);
+
+// 今の tick で送るべき PACKET_CMD_JOIN の種類 (なければ TDMA_JOIN_NONE)。
+// 送ったら TdmaSlot_vJoinSent を呼ぶ (u16Rand は次の参加要求までの待ちに使う)
+#define TDMA_JOIN_NONE 0xFF
+uint8 TdmaSlot_u8JoinDue(uint32 u32Now);
+void TdmaSlot_vJoinSent(uint8 u8Kind, uint32 u32Now, uint16 u16Rand);
+
+bool_t TdmaSlot_bHasSlot();
+const tsTdmaStats *TdmaSlot_psStats();
+
+#endif /* TDMASLOT_H_ */
@@ -0,0 +1,78 @@
+/*
+ * TimeSync.c
+ *
+ * ネットワーク時刻 (TimeSync.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "TimeSync.h"
+
+#define FRAC_BITS 4 // オフセットの固定小数点 (1/16 ms)
+#define FRAC (1 << FRAC_BITS)
+
+static bool_t bSynced = FALSE;
+static uint32 u32SyncedTo;       // 合わせている Master
+// オフセット (Master の時刻 - 自分の時刻) は ms の整数部と 1/FRAC ms の端数に分けて持つ。
+// 稼働時間の差は何日にもなるので、固定小数点にするのは小さい端数と誤差だけ
+static uint32 u32OffsetMs;
+static int32 i32OffsetFrac;      // 0..FRAC-1
+static tsTimeSyncStats sStats;
+
+void TimeSync_vInit()
+{
+	bSynced = FALSE;
+	u32SyncedTo = 0;
+	u32OffsetMs = 0;
+	i32OffsetFrac = 0;
+	memset(&sStats, 0, sizeof(sStats));
+}
+
+void TimeSync_vConnected(uint32 u32Master)
+{
+	if (u32Master != u32SyncedTo) {
+		bSynced = FALSE;
+		u32SyncedTo = u32Master;
+	}
+}
+
+void TimeSync_vSample(uint32 u32Master, uint32 u32Local)
+{
+	uint32 u32Sample = u32Master + TIMESYNC_DELAY_MS - u32Local;
+	int32 i32ErrMs = (int32)(u32Sample - u32OffsetMs);
+	int32 i32Err;
+	uint32 u32Abs = (uint32)(i32ErrMs < 0 ? -i32ErrMs : i32ErrMs);
+
+	sStats.u32Samples++;
+	if (!bSynced || u32Abs > TIMESYNC_STEP_MS) {
+		u32OffsetMs = u32Sample;
+		i32OffsetFrac = 0;
+		bSynced = TRUE;
+		sStats.u32Steps++;
+		return;
+	}
+	i32Err = i32ErrMs * FRAC - i32OffsetFrac;
+	u32Abs = (uint32)(i32Err < 0 ? -i32Err : i32Err) / FRAC;
+	sStats.u32ErrSumMs += u32Abs;
+	if (sStats.u16ErrMaxMs < u32Abs) sStats.u16ErrMaxMs = u32Abs;
+	// 寄せた端数の繰り上がり・繰り下がりを整数部へ移す
+	i32OffsetFrac += i32Err / TIMESYNC_GAIN;
+	u32OffsetMs += (uint32)(i32OffsetFrac >> FRAC_BITS);
+	i32OffsetFrac &= FRAC - 1;
+}
+
+bool_t TimeSync_bSynced()
+{
+	return bSynced;
+}
+
+uint32 TimeSync_u32ToNetwork(uint32 u32Local)
+{
+	return u32Local + u32OffsetMs + (uint32)((i32OffsetFrac + FRAC / 2) >> FRAC_BITS);
+}
+
+const tsTimeSyncStats *TimeSync_psStats()
+{
+	return &sStats;
+}
@@ -0,0 +1,44 @@
+/*
+ * TimeSync.h
+ *
+ * 接続先の Master の時刻 (Keep-Alive の [4..7]) に合わせたネットワーク時刻。
+ *
+ * Keep-Alive を受けるたびに Master の時刻と自分の u32TickCount_ms の差
+ * (オフセット) を測り、1/TIMESYNC_GAIN ずつ寄せる。tick が 4ms なので 1 回の
+ * 測定は数 ms ずれるが、平均すれば 1ms 程度に収まる。差が TIMESYNC_STEP_MS
+ * を超えたら (Master の再起動など) 寄せずにそのまま合わせる。
+ *
+ * タッチは自分の時刻で記録しておき、送るときに変換する。再送・まとめ送り・
+ * 接続先の切り替えをしても、タッチを読んだ時刻は変わらない。
+ *
+ */
+
+#ifndef TIMESYNC_H_
+#define TIMESYNC_H_
+
+#include <jendefs.h>
+
+#define TIMESYNC_GAIN     4   // 1 回の測定で寄せる割合 (1/n)
+#define TIMESYNC_STEP_MS  50  // これ以上ずれていたら合わせ直す
+#define TIMESYNC_DELAY_MS 2   // Master の送信要求から受信までの平均的な遅れ
+
+typedef struct {
+	uint32 u32Samples;    // 測定の回数
+	uint32 u32Steps;      // 合わせ直した回数 (最初の測定を含む)
+	uint32 u32ErrSumMs;   // 寄せる前の差の絶対値の合計 (合わせ直しを除く)
+	uint16 u16ErrMaxMs;
+} tsTimeSyncStats;
+
+void TimeSync_vInit();
+// 接続したとき。前と違う Master なら次の測定でそのまま合わせる
+void TimeSync_vConnected(uint32 u32Master);
+// 接続先の Keep-Alive を受けたとき
+void TimeSync_vSample(uint32 u32Master, uint32 u32Local);
+
+bool_t TimeSync_bSynced();
+// 自分の時刻を Master の時刻にする
+uint32 TimeSync_u32ToNetwork(uint32 u32Local);
+
+const tsTimeSyncStats *TimeSync_psStats();
+
+#endif /* TIMESYNC_H_ */
@@ -0,0 +1,186 @@
+/*
+ * TouchLog.c
+ *
+ * 送信待ちタッチのログ (TouchLog.h を参照)
+ *
+ */
+
+#include <string.h>
+#include <AppHardwareApi.h>
+#include "ToCoNet.h"
+
+#include "TouchLog.h"
+
+#define REC_LEN      16
+#define REC_MAGIC    0xA5
+#define REC_PENDING  0x01
+#define REC_ACKED    0x00
+
+// EEPROM 上のレコード
+//   [0] REC_MAGIC [1] 状態 [2..3] ID (BE) [4..11] IDm [12..14] 予約 [15] チェックサム
+
+static tsTouchEntry asLog[TOUCHLOG_SIZE];
+static uint16 au16Id[TOUCHLOG_SIZE]; // 各エントリの ID (EEPROM のスロットを決める)
+static uint8 u8Head = 0;
+static uint8 u8Tail = 0;
+static uint16 u16NextId = 0;
+static tsTouchLogStats sStats;
+
+#ifdef USE_TOUCH_LOG_EEPROM
+static uint8 u8Sum(const uint8 *pu8, uint8 u8Len)
+{
+	uint8 u8S = 0;
+	while (u8Len--) u8S += *pu8++;
+	return u8S;
+}
+
+static void vSlot(uint16 u16Id, uint16 *pu16Seg, uint8 *pu8Ofs)
+{
+	uint8 u8Slot = u16Id & (TOUCHLOG_SIZE - 1);
+	*pu16Seg = TOUCHLOG_EEP_FIRST + u8Slot / 4;
+	*pu8Ofs = (u8Slot % 4) * REC_LEN;
+}
+
+static void vEepWrite(uint16 u16Id, const uint8 *pu8Idm)
+{
+	uint8 au8Rec[REC_LEN];
+	uint16 u16Seg;
+	uint8 u8Ofs;
+
+	memset(au8Rec, 0, sizeof(au8Rec));
+	au8Rec[0] = REC_MAGIC;
+	au8Rec[1] = REC_PENDING;
+	au8Rec[2] = u16Id >> 8;
+	au8Rec[3] = u16Id;
+	memcpy(au8Rec + 4, pu8Idm, 8);
+	au8Rec[15] = (uint8)-u8Sum(au8Rec, 15);
+
+	vSlot(u16Id, &u16Seg, &u8Ofs);
+	iAHI_WriteDataIntoEEPROMsegment(u16Seg, u8Ofs, au8Rec, REC_LEN);
+}
+
+static void vEepAck(uint16 u16Id)
+{
+	uint8 u8State = REC_ACKED;
+	uint16 u16Seg;
+	uint8 u8Ofs;
+
+	vSlot(u16Id, &u16Seg, &u8Ofs);
+	iAHI_WriteDataIntoEEPROMsegment(u16Seg, u8Ofs + 1, &u8State, 1);
+}
+
+// 読めたレコードが正しければ ID を返す
+static bool_t bEepRead(uint8 u8Slot, uint8 *au8Rec)
+{
+	uint8 u8State;
+
+	iAHI_ReadDataFromEEPROMsegment(TOUCHLOG_EEP_FIRST + u8Slot / 4, (u8Slot % 4) * REC_LEN, au8Rec, REC_LEN);
+	// 状態バイトは ACK で書き換わるので、チェックサムは書いたときの値で見る
+	u8State = au8Rec[1];
+	au8Rec[1] = REC_PENDING;
+	if (au8Rec[0] != REC_MAGIC || u8Sum(au8Rec, REC_LEN) != 0) {
+		return FALSE;
+	}
+	au8Rec[1] = u8State;
+	return TRUE;
+}
+
+static void vEepRestore()
+{
+	uint8 au8Rec[REC_LEN];
+	uint16 u16Max = 0;
+	bool_t bFound = FALSE;
+	uint8 i;
+
+	// 最新の ID を探し、そこから遡って TOUCHLOG_SIZE 件を ID 順に見る
+	for (i = 0; i < TOUCHLOG_SIZE; i++) {
+		if (bEepRead(i, au8Rec)) {
+			uint16 u16Id = ((uint16)au8Rec[2] << 8) | au8Rec[3];
+			if (!bFound || (int16)(u16Id - u16Max) > 0) {
+				u16Max = u16Id;
+			}
+			bFound = TRUE;
+		}
+	}
+	if (!bFound) {
+		return;
+	}
+
+	u16NextId = u16Max - (TOUCHLOG_SIZE - 1);
+	for (i = 0; i < TOUCHLOG_SIZE; i++, u16NextId++) {
+		uint8 u8Slot = u16NextId & (TOUCHLOG_SIZE - 1);
+		if (bEepRead(u8Slot, au8Rec) && au8Rec[1] == REC_PENDING
+				&& (((uint16)au8Rec[2] << 8) | au8Rec[3]) == u16NextId) {
+			// 時刻は前回起動時のものなので、復元した時刻とする
+			au16Id[u8Tail & (TOUCHLOG_SIZE - 1)] = u16NextId;
+			memcpy(asLog[u8Tail & (TOUCHLOG_SIZE - 1)].au8Idm, au8Rec + 4, 8);
+			asLog[u8Tail & (TOUCHLOG_SIZE - 1)].u32Tick = u32TickCount_ms;
+			u8Tail++;
+			sStats.u32Restored++;
+		}
+	}
+}
+#endif
+
+void TouchLog_vInit(bool_t bRestore)
+{
+	u8Head = 0;
+	u8Tail = 0;
+	u16NextId = 0;
+	memset(&sStats, 0, sizeof(sStats));
+
+#ifdef USE_TOUCH_LOG_EEPROM
+	uint8 u8SegLen;
+	u16AHI_InitialiseEEP(&u8SegLen);
+	if (bRestore) {
+		vEepRestore();
+	}
+#endif
+}
+
+void TouchLog_vAppend(const uint8 *pu8Idm, uint32 u32Tick)
+{
+	uint8 u8Idx;
+
+	if ((uint8)(u8Tail - u8Head) >= TOUCHLOG_SIZE) {
+		// 最も古いものを捨てる (EEPROM 上は新しいレコードで上書きされる)
+		u8Head++;
+		sStats.u32Dropped++;
+	}
+	u8Idx = u8Tail & (TOUCHLOG_SIZE - 1);
+	memcpy(asLog[u8Idx].au8Idm, pu8Idm, 8);
+	asLog[u8Idx].u32Tick = u32Tick;
+	au16Id[u8Idx] = u16NextId;
+#ifdef USE_TOUCH_LOG_EEPROM
+	vEepWrite(u16NextId, pu8Idm);
+#endif
+	u16NextId++;
+	u8Tail++;
+	sStats.u32Appended++;
+}
+
+uint8 TouchLog_u8Count()
+{
+	return u8Tail - u8Head;
+}
+
+tsTouchEntry *TouchLog_psPeek(uint8 u8Index)
+{
+	return &asLog[(u8Head + u8Index) & (TOUCHLOG_SIZE - 1)];
+}
+
+void TouchLog_vAck(uint8 u8Count)
+{
+	while (u8Count-- && u8Head != u8Tail) {
+#ifdef USE_TOUCH_LOG_EEPROM
+		vEepAck(au16Id[u8Head & (TOUCHLOG_SIZE - 1)]);
+#endif
+		u8Head++;
+		sStats.u32Acked++;
+	}
+}
+
+const tsTouchLogStats *TouchLog_psStats()
+{
+	return &sStats;
+}
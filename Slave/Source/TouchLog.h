@@ -0,0 +1,47 @@
+/*
+ * TouchLog.h
+ *
+ * Master へ届くまでタッチを保持する送信待ちログ。
+ *
+ * RAM 上のリングに TOUCHLOG_SIZE 件まで保持し、Master からの ACK で
+ * 先頭から消す。一杯になったら最も古いものを捨てる。
+ *
+ * USE_TOUCH_LOG_EEPROM を定義すると EEPROM にも書き、RAM OFF スリープ
+ * や電源断の後、TouchLog_vInit で未送信のタッチを復元する。
+ * 1 件 16 バイトのレコードを ID 順にスロットへ書き、ACK されたら状態の
+ * 1 バイトだけを書き換える (1 タッチあたり 2 回の書き込みを
+ * TOUCHLOG_EEP_SEGMENTS 個のセグメントに分散する)。
+ *
+ */
+
+#ifndef TOUCHLOG_H_
+#define TOUCHLOG_H_
+
+#include <jendefs.h>
+#include "type.h"
+
+#define TOUCHLOG_SIZE 64 // 保持する件数 (2 のべき乗)
+
+// EEPROM の配置 (セグメント 64 バイト、1 セグメント 4 件)
+#define TOUCHLOG_EEP_FIRST    8
+#define TOUCHLOG_EEP_SEGMENTS (TOUCHLOG_SIZE / 4)
+
+typedef struct {
+	uint32 u32Appended; // 記録したタッチ
+	uint32 u32Acked;    // ACK されて消したタッチ
+	uint32 u32Dropped;  // 一杯で捨てたタッチ
+	uint32 u32Restored; // 起動時に EEPROM から復元したタッチ
+} tsTouchLogStats;
+
+void TouchLog_vInit(bool_t bRestore);
+void TouchLog_vAppend(const uint8 *pu8Idm, uint32 u32Tick);
+
+uint8 TouchLog_u8Count();
+tsTouchEntry *TouchLog_psPeek(uint8 u8Index); // 0 が最も古い
+
+// 先頭から u8Count 件を ACK 済みとして消す
+void TouchLog_vAck(uint8 u8Count);
+
+const tsTouchLogStats *TouchLog_psStats();
+
+#endif /* TOUCHLOG_H_ */
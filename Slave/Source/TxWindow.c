@@ -0,0 +1,252 @@
+/*
+ * TxWindow.c
+ *
+ * タッチパケットの送信窓 (TxWindow.h を参照)
+ *
+ */
+
+#include <string.h>
+
+#include "TxWindow.h"
+#include "../../Common/Source/packets.h"
+
+#define FRAME_SEND  0 // これから送る
+#define FRAME_WAIT  1 // ACK 待ち (u32DueAt に送り直す)
+#define FRAME_ACKED 2 // ACK を受けた (先のフレームの ACK 待ち)
+
+#define RTO_GRANULARITY_MS 4 // tick
+
+typedef struct {
+	uint16 u16Seq;
+	uint8 u8Count;    // 入れたタッチの数
+	uint8 u8State;
+	uint8 u8Tries;    // 送った回数
+	bool_t bMacOk;    // 最後の送信で MAC の ACK を受けた
+	bool_t bFast;     // 後の ACK で抜けが分かった
+	uint32 u32SentAt; // 最後に送った時刻
+	uint32 u32DueAt;
+} tsFrame;
+
+static tsFrame asFrame[TXWINDOW_FRAMES]; // 0 が最も古い
+static uint8 u8Frames;
+static uint16 u16NextSeq;
+static bool_t bRttValid;
+static uint32 u32Srtt8;   // RTT の平滑値 (1/8 ms)
+static uint32 u32Rttvar4; // RTT のばらつき (1/4 ms)
+static uint8 u8Backoff;   // 続けてタイムアウトした回数
+static tsTxWindowStats sStats;
+
+void TxWindow_vInit(uint16 u16Seq)
+{
+	memset(&sStats, 0, sizeof(sStats));
+	u8Frames = 0;
+	u16NextSeq = u16Seq;
+	bRttValid = FALSE;
+	u8Backoff = 0;
+}
+
+uint8 TxWindow_u8Entries()
+{
+	return TxWindow_u8First(u8Frames);
+}
+
+bool_t TxWindow_bCanOpen()
+{
+	return u8Frames < TXWINDOW_FRAMES;
+}
+
+int8 TxWindow_i8Due(uint32 u32Now)
+{
+	uint8 i;
+
+	for (i = 0; i < u8Frames; i++) {
+		if (asFrame[i].u8State == FRAME_SEND
+				|| (asFrame[i].u8State == FRAME_WAIT && (int32)(u32Now - asFrame[i].u32DueAt) >= 0)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int8 TxWindow_i8Open(uint8 u8Count)
+{
+	tsFrame *psF;
+
+	if (u8Frames >= TXWINDOW_FRAMES) {
+		return -1;
+	}
+	psF = &asFrame[u8Frames];
+	memset(psF, 0, sizeof(tsFrame));
+	psF->u16Seq = u16NextSeq++;
+	psF->u8Count = u8Count;
+	psF->u8State = FRAME_SEND;
+	return u8Frames++;
+}
+
+uint16 TxWindow_u16Seq(int8 i8Frame)
+{
+	return asFrame[i8Frame].u16Seq;
+}
+
+uint8 TxWindow_u8First(int8 i8Frame)
+{
+	uint8 i, u8First = 0;
+
+	for (i = 0; i < i8Frame; i++) {
+		u8First += asFrame[i].u8Count;
+	}
+	return u8First;
+}
+
+uint8 TxWindow_u8Count(int8 i8Frame)
+{
+	return asFrame[i8Frame].u8Count;
+}
+
+uint16 TxWindow_u16Base()
+{
+	return u8Frames ? asFrame[0].u16Seq : u16NextSeq;
+}
+
+uint16 TxWindow_u16RtoMs()
+{
+	uint32 u32Rto = TXWINDOW_RTO_INIT_MS;
+
+	if (bRttValid) {
+		u32Rto = u32Srtt8 / 8 + (u32Rttvar4 > RTO_GRANULARITY_MS ? u32Rttvar4 : RTO_GRANULARITY_MS);
+		if (u32Rto < TXWINDOW_RTO_MIN_MS) u32Rto = TXWINDOW_RTO_MIN_MS;
+	}
+	u32Rto <<= u8Backoff;
+	return u32Rto > TXWINDOW_RTO_MAX_MS ? TXWINDOW_RTO_MAX_MS : u32Rto;
+}
+
+void TxWindow_vSent(uint16 u16Seq, bool_t bOk, uint32 u32Now, uint32 u32RetryAt)
+{
+	tsFrame *psF = NULL;
+	uint8 i;
+
+	for (i = 0; i < u8Frames; i++) {
+		if (asFrame[i].u16Seq == u16Seq && asFrame[i].u8State != FRAME_ACKED) {
+			psF = &asFrame[i];
+		}
+	}
+	if (psF == NULL) {
+		// 送信中に ACK を受けた
+		return;
+	}
+	if (psF->u8Tries) {
+		sStats.u32Retransmits++;
+		if (psF->bFast) {
+			sStats.u32FastRetx++;
+		} else if (psF->u8State == FRAME_WAIT && psF->bMacOk) {
+			// 届いたはずなのに ACK が来なかった: RTO を延ばす
+			sStats.u32Timeouts++;
+			if (TxWindow_u16RtoMs() < TXWINDOW_RTO_MAX_MS) u8Backoff++;
+		}
+	} else {
+		sStats.u32Frames++;
+	}
+	if (psF->u8Tries < 0xFF) psF->u8Tries++;
+	psF->u8State = FRAME_WAIT;
+	psF->bMacOk = bOk;
+	psF->bFast = FALSE;
+	psF->u32SentAt = u32Now;
+	psF->u32DueAt = bOk ? u32Now + TxWindow_u16RtoMs() : u32RetryAt;
+}
+
+// RTT を 1 回測った
+static void vRttSample(uint32 u32Rtt)
+{
+	if (!bRttValid) {
+		u32Srtt8 = u32Rtt * 8;
+		u32Rttvar4 = u32Rtt * 2;
+		bRttValid = TRUE;
+	} else {
+		int32 i32Delta = (int32)u32Rtt - (int32)(u32Srtt8 / 8);
+		u32Srtt8 += i32Delta;
+		u32Rttvar4 += (i32Delta < 0 ? -i32Delta : i32Delta) - (int32)(u32Rttvar4 / 4);
+	}
+	u8Backoff = 0;
+	sStats.u16SrttMs = u32Srtt8 / 8;
+	sStats.u16RttvarMs = u32Rttvar4 / 4;
+}
+
+uint8 TxWindow_u8Ack(uint16 u16Next, uint8 u8Sack, uint32 u32Now)
+{
+	uint8 i, u8Pop = 0, u8Done = 0;
+	tsFrame *psLatest = NULL; // 今回 ACK を受けた中で最後に送ったフレーム
+	uint32 u32Latest = 0;
+
+	for (i = 0; i < u8Frames; i++) {
+		tsFrame *psF = &asFrame[i];
+		int16 i16Diff = (int16)(psF->u16Seq - u16Next);
+
+		if (psF->u8State == FRAME_ACKED) {
+			continue;
+		}
+		if (i16Diff < 0 || (i16Diff >= 1 && i16Diff <= XPORT_ACK_SACK_BITS && (u8Sack & (1 << (i16Diff - 1))))) {
+			if (psF->u8State == FRAME_WAIT && (psLatest == NULL || (int32)(psF->u32SentAt - u32Latest) > 0)) {
+				psLatest = psF;
+				u32Latest = psF->u32SentAt;
+			}
+			psF->u8State = FRAME_ACKED;
+			sStats.u32Acked++;
+		}
+	}
+	// RTT はこの ACK を返させたフレームで測る (前のフレームは ACK が失われて遅れたかもしれない)
+	if (psLatest && psLatest->u8Tries == 1 && psLatest->bMacOk) {
+		vRttSample(u32Now - psLatest->u32SentAt);
+	}
+
+	// 後から送ったフレームが届いたのに ACK のないフレームは、RTO を待たずに送り直す
+	for (i = 0; psLatest && i < u8Frames; i++) {
+		tsFrame *psF = &asFrame[i];
+		if (psF->u8State == FRAME_WAIT && psF->bMacOk && !psF->bFast
+				&& (int32)(u32Latest - psF->u32SentAt) > 0) {
+			psF->bFast = TRUE;
+			psF->u32DueAt = u32Now;
+		}
+	}
+
+	// 先頭から ACK を受けた分を消す
+	while (u8Done < u8Frames && asFrame[u8Done].u8State == FRAME_ACKED) {
+		u8Pop += asFrame[u8Done].u8Count;
+		u8Done++;
+	}
+	if (u8Done) {
+		memmove(asFrame, asFrame + u8Done, (u8Frames - u8Done) * sizeof(tsFrame));
+		u8Frames -= u8Done;
+	}
+	return u8Pop;
+}
+
+void TxWindow_vDropped()
+{
+	uint8 i;
+
+	for (i = 0; i < u8Frames; i++) {
+		if (asFrame[i].u8Count) {
+			asFrame[i].u8Count--;
+			return;
+		}
+	}
+}
+
+void TxWindow_vResend()
+{
+	uint8 i;
+
+	for (i = 0; i < u8Frames; i++) {
+		if (asFrame[i].u8State == FRAME_WAIT) {
+			asFrame[i].u8State = FRAME_SEND;
+			asFrame[i].bMacOk = FALSE;
+			asFrame[i].bFast = FALSE;
+		}
+	}
+	u8Backoff = 0;
+}
+
+const tsTxWindowStats *TxWindow_psStats()
+{
+	return &sStats;
+}
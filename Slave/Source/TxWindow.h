@@ -0,0 +1,69 @@
+/*
+ * TxWindow.h
+ *
+ * Master へのタッチパケットの送信窓 (送信番号、ACK 待ち、再送)。
+ *
+ * 送信待ちログ (TouchLog) の先頭から順に、1 パケット分ずつを送信番号の
+ * 付いたフレームにして送る。ACK を待たずに TXWINDOW_FRAMES 個まで送り、
+ * Master が UART へ出して返す ACK (packets.h の XPORT_ACK) で先頭から
+ * 消していく。MAC の ACK は無線 1 区間の確認にしか使わない。
+ *
+ * ACK が再送タイムアウト (RTO) までに来なければ同じ番号で送り直す。
+ * RTO は送信から ACK までの時間 (RTT) の平滑値とばらつきから決め
+ * (再送したフレームでは測らない)、タイムアウトのたびに倍にする。
+ * 後のフレームの ACK が先に来たら、抜けたフレームは RTO を待たずに送り直す。
+ *
+ */
+
+#ifndef TXWINDOW_H_
+#define TXWINDOW_H_
+
+#include <jendefs.h>
+
+#define TXWINDOW_FRAMES     4    // ACK を待たずに送るフレームの数 (XPORT_ACK_SACK_BITS まで)
+#define TXWINDOW_RTO_INIT_MS 500 // RTT を測るまでの RTO
+#define TXWINDOW_RTO_MIN_MS 40
+#define TXWINDOW_RTO_MAX_MS 4000
+
+typedef struct {
+	uint32 u32Frames;      // 新しく送ったフレーム
+	uint32 u32Retransmits; // 送り直したフレーム
+	uint32 u32Timeouts;    // RTO で送り直したフレーム
+	uint32 u32FastRetx;    // 後の ACK から抜けを知って送り直したフレーム
+	uint32 u32Acked;       // ACK を受けたフレーム
+	uint16 u16SrttMs;      // RTT の平滑値
+	uint16 u16RttvarMs;    // RTT のばらつき
+} tsTxWindowStats;
+
+// u16Seq は最初に使う送信番号 (再起動のたびに変える)
+void TxWindow_vInit(uint16 u16Seq);
+
+// 送っているフレームに入っているタッチの数
+uint8 TxWindow_u8Entries();
+// 新しいフレームを開けるか
+bool_t TxWindow_bCanOpen();
+// 送り直すフレーム (なければ -1)
+int8 TxWindow_i8Due(uint32 u32Now);
+// ログの TxWindow_u8Entries() 番目から u8Count 件で新しいフレームを開く
+int8 TxWindow_i8Open(uint8 u8Count);
+
+// フレームの送信番号と、ログの何番目から何件か
+uint16 TxWindow_u16Seq(int8 i8Frame);
+uint8 TxWindow_u8First(int8 i8Frame);
+uint8 TxWindow_u8Count(int8 i8Frame);
+// 窓の先頭 (ACK を受けていない最も古いフレーム) の送信番号
+uint16 TxWindow_u16Base();
+
+// 送信番号 u16Seq の送信の結果 (bOk は MAC の ACK)。ACK がなければ u32RetryAt に送り直す
+void TxWindow_vSent(uint16 u16Seq, bool_t bOk, uint32 u32Now, uint32 u32RetryAt);
+// Master の ACK (次に待つ番号と先の受信)。ログの先頭から消してよい件数を返す
+uint8 TxWindow_u8Ack(uint16 u16Next, uint8 u8Sack, uint32 u32Now);
+// ログが一杯で最も古いタッチが捨てられたとき
+void TxWindow_vDropped();
+// 接続し直したとき。送ったフレームはすべて送り直す
+void TxWindow_vResend();
+
+uint16 TxWindow_u16RtoMs();
+const tsTxWindowStats *TxWindow_psStats();
+
+#endif /* TXWINDOW_H_ */
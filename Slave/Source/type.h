@@ -1,3 +1,6 @@
+#ifndef TYPE_H_
+#define TYPE_H_
+
 
 typedef struct {
 	// MAC SETTING
@@ -14,7 +17,16 @@ typedef struct {
 } tsAppData;
 
 
+// 送信待ちのタッチ
+typedef struct {
+	uint8 au8Idm[8];
+	uint32 u32Tick; // タッチした時刻 (ms)
+} tsTouchEntry;
+
+// PN533 からの応答 (data はパーサのバッファを指す)
 typedef struct {
 	uint16 length;
-	uint8 data[128];
+	uint8 *data;
 } tsFelicaResponse;
+
+#endif /* TYPE_H_ */